@@ -2,6 +2,9 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 CameraManager::CameraManager()
 {
 }
@@ -12,13 +15,17 @@ CameraManager::~CameraManager()
 
 static auto cameraSinTime = 0.f;
 
-auto CameraManager::Update(float dt) -> void
+auto CameraManager::Update(float dt, std::int64_t time) -> void
 {
 	cameraSinTime += dt;
 
-	m_cameraPosition.x = std::sinf(cameraSinTime) * 5.f;
+	m_cameraAspectRatio = m_pendingAspectRatio.load(std::memory_order_relaxed);
+	m_horizontalFOV = m_pendingHorizontalFOV.load(std::memory_order_relaxed);
+	m_verticalFOV = m_horizontalFOV / m_cameraAspectRatio;
+
+	m_cameraPosition.x = std::sin(cameraSinTime) * 5.f;
 	m_cameraPosition.y = 0.f;
-	m_cameraPosition.z = std::cosf(cameraSinTime) * 5.f;
+	m_cameraPosition.z = std::cos(cameraSinTime) * 5.f;
 
 	const auto lookingAt = glm::vec3{};
 
@@ -35,7 +42,48 @@ auto CameraManager::Update(float dt) -> void
 		m_cameraPosition, m_cameraPosition + m_cameraForward, m_cameraUp);
 	m_viewMatrix = glm::transpose(m_viewMatrix);
 
-	
+	// The write buffer holds whatever was published two updates ago, both
+	// states get written:
+	auto& snapshots = m_snapshot.GetWriteBuffer();
+	snapshots.previous = m_lastSnapshot;
+	auto& snapshot = snapshots.current;
+	snapshot.projection = m_projectionMatrix;
+	snapshot.view = m_viewMatrix;
+	snapshot.position = m_cameraPosition;
+	snapshot.forward = m_cameraForward;
+	snapshot.right = m_cameraRight;
+	snapshot.up = m_cameraUp;
+	snapshot.updateNumber = ++m_updateNumber;
+	snapshot.time = time;
+	m_lastSnapshot = snapshot;
+	m_snapshot.Publish();
+}
+
+auto CameraManager::AcquireInterpolatedSnapshot(std::int64_t now)
+	-> DXRCameraMatrices
+{
+	const auto& snapshots = m_snapshot.Acquire();
+	const auto& previous = snapshots.previous;
+	const auto& current = snapshots.current;
+	// Nothing to blend with before the second update, or without stamps:
+	if (previous.updateNumber == 0 || current.time <= previous.time)
+		return current;
+
+	// At current.time previous is shown, one tick later current:
+	const auto alpha = std::clamp(
+		static_cast<float>(now - current.time) /
+			static_cast<float>(current.time - previous.time),
+		0.f, 1.f);
+	auto out = current;
+	out.position = glm::mix(previous.position, current.position, alpha);
+	out.forward =
+		glm::normalize(glm::mix(previous.forward, current.forward, alpha));
+	out.right = glm::normalize(
+		glm::cross(out.forward, glm::mix(previous.up, current.up, alpha)));
+	out.up = glm::cross(out.right, out.forward);
+	out.view = glm::transpose(
+		glm::lookAtRH(out.position, out.position + out.forward, out.up));
+	return out;
 }
 
 
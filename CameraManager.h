@@ -1,6 +1,10 @@
 #pragma once
 
 #include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+#include "DXRTripleBuffer.h"
+
+#include <atomic>
 
 struct CameraManager
 {
@@ -11,7 +15,24 @@ struct CameraManager
 
 	CameraManager();
 	~CameraManager();
-	auto Update(float dt) -> void;
+
+	// Moves the camera and publishes the new state, stamped with time (clock
+	// ticks, see DXRCameraMatrices::time). Call from one thread only, the
+	// getters below belong to that thread too:
+	auto Update(float dt, std::int64_t time = 0) -> void;
+
+	// The latest state Update() published, complete and consistent. Safe
+	// while Update() runs on another thread, but only one thread may call
+	// the Acquire functions (the render thread). Stays valid until the next
+	// call:
+	inline auto AcquireSnapshot() -> const DXRCameraMatrices&
+	{
+		return m_snapshot.Acquire().current;
+	}
+
+	// The camera one tick behind now, blended between the last two states
+	// by their time stamps. The latest state if they have none:
+	auto AcquireInterpolatedSnapshot(std::int64_t now) -> DXRCameraMatrices;
 
 	inline auto GetViewMatrix() const -> glm::mat4
 	{
@@ -68,15 +89,16 @@ struct CameraManager
 		return m_farPlane;
 	}
 
+	// Any thread (window resizes come from the window thread), takes effect
+	// with the next Update():
 	inline auto SetAspectRatio(float ratio) -> void
 	{
-		m_cameraAspectRatio = ratio;
-		m_verticalFOV = m_horizontalFOV / m_cameraAspectRatio;
+		m_pendingAspectRatio.store(ratio, std::memory_order_relaxed);
 	}
 
 	inline auto SetHorizontalFOV(float fov) -> void
 	{
-		m_horizontalFOV = fov;
+		m_pendingHorizontalFOV.store(fov, std::memory_order_relaxed);
 	}
 
   private:
@@ -90,4 +112,16 @@ struct CameraManager
 	THREAD_MARKER(Update) float m_verticalFOV{m_horizontalFOV / m_cameraAspectRatio};
 	THREAD_MARKER(Update) float m_nearPlane{0.01f};
 	THREAD_MARKER(Update) float m_farPlane{1000.f};
+	THREAD_MARKER(Update) std::uint64_t m_updateNumber{};
+
+	std::atomic<float> m_pendingAspectRatio{16.f / 9.f};
+	std::atomic<float> m_pendingHorizontalFOV{90.f};
+	// The last two states, what interpolation needs:
+	struct Snapshots
+	{
+		DXRCameraMatrices previous{};
+		DXRCameraMatrices current{};
+	};
+	DXRTripleBuffer<Snapshots> m_snapshot{};
+	THREAD_MARKER(Update) DXRCameraMatrices m_lastSnapshot{};
 };
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "DXRAssets.h"
+#include "DXRMeshBuilder.h"
+#include "DXRTextureContainer.h"
+
+#include "RawImage.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#pragma warning(push, 0)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#pragma GCC diagnostic ignored "-Wextra"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wshadow"
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+auto DecodeImageRGBA8(const void* imageData, int size, DXRImageRGBA8& out)
+	-> bool
+{
+	int width{};
+	int height{};
+	stbi_set_flip_vertically_on_load(1);
+	const auto bitmap_image_data =
+		stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(imageData),
+							  size, &width, &height, NULL, 4);
+	if (!bitmap_image_data)
+		return false;
+
+	out.width = width;
+	out.height = height;
+	out.pixels.resize(out.GetRowPitch() * static_cast<std::size_t>(height));
+	memcpy(out.pixels.data(), bitmap_image_data, out.pixels.size());
+
+	stbi_image_free(bitmap_image_data);
+	return true;
+}
+
+// x, y, z, nx, ny, nz, u, v, col
+static constexpr DXRVertex3D k_CubeVertices[] = {
+	// -z
+	{ -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
+	{ -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
+	{  1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
+	{ -1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
+	// +z
+	{ -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
+	{ -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
+	{  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
+	{ -1.0f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
+	// -y
+	{ -1.0f, -1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f, -1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
+	{ -1.0f, -1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
+	{  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
+	{ -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
+	// +y
+	{ -1.0f, 1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f, 1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
+	{  1.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
+	{ -1.0f, 1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
+	{  1.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
+	{ -1.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
+	// -x
+	{ -1.0f,-1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
+	{ -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
+	{ -1.0f, 1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
+	{ -1.0f,-1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
+	{ -1.0f, 1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
+	{ -1.0f,-1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
+	// +x
+	{ 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
+	{ 1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
+	{ 1.0f,  1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
+	{ 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
+	{ 1.0f,  1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
+	{ 1.0f, -1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
+};
+
+auto GetTextureFormatInfo(DXRTextureFormat format) -> DXRTextureFormatInfo
+{
+	switch (format)
+	{
+	case DXRTextureFormat::RGBA8Unorm:
+		return {1, 4};
+	case DXRTextureFormat::RGBA32Float:
+		return {1, 16};
+	case DXRTextureFormat::BC1Unorm:
+		return {4, 8};
+	case DXRTextureFormat::BC3Unorm:
+	case DXRTextureFormat::BC7Unorm:
+		return {4, 16};
+	default:
+		return {};
+	}
+}
+
+auto SampleTexturePoint(const DXRImageRGBA8* texture, float u, float v)
+	-> glm::vec4
+{
+	const auto texel = SampleTexturePointPacked(texture, u, v);
+	glm::vec4 color{};
+	for (int channel{}; channel < 4; channel++)
+	{
+		color[channel] = static_cast<float>((texel >> (channel * 8)) & 0xFF) *
+						 (1.f / 255.f);
+	}
+	return color;
+}
+
+auto GetCubeMeshVertices() -> std::span<const DXRVertex3D>
+{
+	return k_CubeVertices;
+}
+
+auto GetCubeMesh() -> const DXRIndexedMesh&
+{
+	static const auto mesh = [] {
+		DXRIndexedMesh out{};
+		BuildIndexedMesh(k_CubeVertices, out);
+		return out;
+	}();
+	return mesh;
+}
+
+auto GetGroundMesh() -> const DXRIndexedMesh&
+{
+	static const auto mesh = [] {
+		DXRIndexedMesh out{};
+		for (const auto z : {-10.f, 10.f})
+		{
+			for (const auto x : {-10.f, 10.f})
+			{
+				out.vertices.push_back(DXRVertex3D{x, -1.f, z, 0.f, 1.f, 0.f,
+												   x > 0.f ? 1.f : 0.f,
+												   z > 0.f ? 1.f : 0.f,
+												   0xFFFFFFFF});
+			}
+		}
+		out.indices = {0, 2, 1, 1, 2, 3};
+		return out;
+	}();
+	return mesh;
+}
+
+auto GetEmbeddedTextureData() -> const unsigned char*
+{
+	return textureDataRaw;
+}
+
+auto GetEmbeddedTextureSize() -> int
+{
+	return static_cast<int>(sizeof textureDataRaw);
+}
+
+auto GetCookedTexturePath() -> const char*
+{
+	return "SNIFF.dxrt";
+}
+
+auto LoadDefaultTextureRGBA8(DXRImageRGBA8& out) -> bool
+{
+	DXRTextureContainer container{};
+	if (container.Open(GetCookedTexturePath()) &&
+		CopyTextureContainerMip(container, 0, out))
+		return true;
+
+	return DecodeImageRGBA8(GetEmbeddedTextureData(), GetEmbeddedTextureSize(),
+							out);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+
+#include <cmath>
+#include <cstring>
+#include <span>
+#include <vector>
+
+// Decoded RGBA8 image, rows are tightly packed and bottom-up (flipped on
+// load, that's what the UVs of our meshes expect):
+struct DXRImageRGBA8
+{
+	int width{};
+	int height{};
+	std::vector<unsigned char> pixels{};
+
+	inline auto GetRowPitch() const -> std::size_t
+	{
+		return static_cast<std::size_t>(width) * 4;
+	}
+};
+
+// Float counterpart of DXRImageRGBA8, four floats per texel, linear:
+struct DXRImageRGBA32F
+{
+	int width{};
+	int height{};
+	std::vector<float> pixels{};
+
+	// In bytes, like DXRImageRGBA8::GetRowPitch():
+	inline auto GetRowPitch() const -> std::size_t
+	{
+		return static_cast<std::size_t>(width) * 4 * sizeof(float);
+	}
+};
+
+// Texture formats of the asset pipeline, the values end up in .dxrt files:
+enum struct DXRTextureFormat : std::uint32_t
+{
+	Unknown = 0,
+	RGBA8Unorm = 1,
+	RGBA32Float = 2,
+	BC1Unorm = 3,
+	BC3Unorm = 4,
+	BC7Unorm = 5,
+};
+
+// Block compressed formats store 4x4 texel blocks, everything else is one
+// texel per block. Zeroes for unknown formats:
+struct DXRTextureFormatInfo
+{
+	std::uint32_t blockSize{};
+	std::uint32_t bytesPerBlock{};
+};
+
+auto GetTextureFormatInfo(DXRTextureFormat format) -> DXRTextureFormatInfo;
+
+// BCn blocks, a row of blocks after the other, bottom-up like the images
+// they were encoded from (DXRBlockCompression.h):
+struct DXRCompressedImage
+{
+	DXRTextureFormat format{};
+	// In texels:
+	int width{};
+	int height{};
+	std::vector<unsigned char> blocks{};
+
+	inline auto GetBlocksWide() const -> std::uint32_t
+	{
+		return (static_cast<std::uint32_t>(width) + 3) / 4;
+	}
+
+	inline auto GetBlocksHigh() const -> std::uint32_t
+	{
+		return (static_cast<std::uint32_t>(height) + 3) / 4;
+	}
+
+	inline auto GetRowPitch() const -> std::size_t
+	{
+		return static_cast<std::size_t>(GetBlocksWide()) *
+			   GetTextureFormatInfo(format).bytesPerBlock;
+	}
+};
+
+// Decodes any format stb_image understands to RGBA8:
+auto DecodeImageRGBA8(const void* imageData, int size, DXRImageRGBA8& out)
+	-> bool;
+
+// pixelShader2DText's MIN_MAG_MIP_POINT / BORDER sampler on the CPU, the
+// texel DXRSoftwareRasterizer fetches for u, v as 0..1 floats, transparent
+// black outside the image:
+auto SampleTexturePoint(const DXRImageRGBA8* texture, float u, float v)
+	-> glm::vec4;
+
+// Same texel as it is stored, RGBA8 packed with red in the low byte, 0
+// outside the image. Inline, the rasterizer calls it for every pixel:
+inline auto SampleTexturePointPacked(const DXRImageRGBA8* texture, float u,
+									 float v) -> std::uint32_t
+{
+	if (!texture || texture->width <= 0 || texture->height <= 0)
+		return 0;
+	const auto fx = std::floor(u * static_cast<float>(texture->width));
+	const auto fy = std::floor(v * static_cast<float>(texture->height));
+	if (!(fx >= 0.f && fy >= 0.f && fx < static_cast<float>(texture->width) &&
+		  fy < static_cast<float>(texture->height)))
+		return 0;
+	std::uint32_t texel{};
+	std::memcpy(&texel,
+				texture->pixels.data() +
+					static_cast<std::size_t>(fy) * texture->GetRowPitch() +
+					static_cast<std::size_t>(fx) * 4,
+				sizeof texel);
+	return texel;
+}
+
+// The textured cube LoadRenderingAssets draws, 36 vertices, triangle list:
+auto GetCubeMeshVertices() -> std::span<const DXRVertex3D>;
+
+// The same cube welded and optimized by DXRMeshBuilder, built on first use:
+auto GetCubeMesh() -> const DXRIndexedMesh&;
+
+// 20x20 units at y = -1, under the cube, facing up with the texture
+// stretched across it once. The scene the path tracer and lightmap
+// benchmarks light:
+auto GetGroundMesh() -> const DXRIndexedMesh&;
+
+// The texture that ships inside the executable (RawImage.h):
+auto GetEmbeddedTextureData() -> const unsigned char*;
+auto GetEmbeddedTextureSize() -> int;
+
+// Cooked version of the embedded texture, DXRTextureCooker writes it next to
+// the executables at build time:
+auto GetCookedTexturePath() -> const char*;
+
+// The texture the renderers draw with, tightly packed RGBA8:
+// Copies mip 0 out of the cooked container, decodes the embedded PNG only
+// if that isn't there.
+auto LoadDefaultTextureRGBA8(DXRImageRGBA8& out) -> bool;
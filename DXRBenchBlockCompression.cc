@@ -0,0 +1,172 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRBlockCompression.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+namespace
+{
+// Smooth gradients, hard edges and a bit of noise, 1K:
+auto MakeTestImage(int size) -> DXRImageRGBA8
+{
+	DXRImageRGBA8 image{};
+	image.width = size;
+	image.height = size;
+	image.pixels.resize(image.GetRowPitch() * static_cast<std::size_t>(size));
+	std::uint32_t seed{12345};
+	for (int y{}; y < size; y++)
+	{
+		for (int x{}; x < size; x++)
+		{
+			const auto texel = image.pixels.data() +
+							   static_cast<std::size_t>(y) * image.GetRowPitch() +
+							   static_cast<std::size_t>(x) * 4;
+			seed = seed * 1664525u + 1013904223u;
+			const auto noise = static_cast<int>(seed >> 29);
+			const auto checker = ((x / 37) ^ (y / 23)) & 1;
+			texel[0] = static_cast<unsigned char>((x * 255 / size + noise) & 0xFF);
+			texel[1] = static_cast<unsigned char>(checker ? 200 : 40);
+			texel[2] = static_cast<unsigned char>((y * 255 / size) & 0xFF);
+			texel[3] = static_cast<unsigned char>(x < size / 2 ? 255 : y & 0xFF);
+		}
+	}
+	return image;
+}
+
+auto GetFormatName(DXRTextureFormat format) -> const char*
+{
+	switch (format)
+	{
+	case DXRTextureFormat::BC1Unorm:
+		return "bc1";
+	case DXRTextureFormat::BC3Unorm:
+		return "bc3";
+	default:
+		return "bc7";
+	}
+}
+
+auto GetQualityName(DXRBCQuality quality) -> const char*
+{
+	switch (quality)
+	{
+	case DXRBCQuality::Fast:
+		return "fast";
+	case DXRBCQuality::Normal:
+		return "normal";
+	default:
+		return "high";
+	}
+}
+
+// Single threaded encode of every format and quality, PSNR of the round trip:
+auto MeasureFormats(DXRBenchmarkState& state, const DXRImageRGBA8& image)
+	-> void
+{
+	const auto texels = static_cast<double>(image.width) * image.height;
+	// BC1 turns alpha < 128 into transparent black, compare against that
+	// instead of counting it as color error:
+	auto bc1Reference = image;
+	for (std::size_t n{}; n < bc1Reference.pixels.size(); n += 4)
+	{
+		if (bc1Reference.pixels[n + 3] < 128)
+			std::fill_n(bc1Reference.pixels.begin() +
+							static_cast<std::ptrdiff_t>(n),
+						4, static_cast<unsigned char>(0));
+	}
+
+	const DXRTextureFormat formats[]{DXRTextureFormat::BC1Unorm,
+									 DXRTextureFormat::BC3Unorm,
+									 DXRTextureFormat::BC7Unorm};
+	const DXRBCQuality qualities[]{DXRBCQuality::Fast, DXRBCQuality::Normal,
+								   DXRBCQuality::High};
+	for (const auto format : formats)
+	{
+		for (const auto quality : qualities)
+		{
+			DXRBCEncodeDesc desc{};
+			desc.format = format;
+			desc.quality = quality;
+			desc.threadCount = 1;
+
+			const auto label =
+				std::string{GetFormatName(format)} + "/" + GetQualityName(quality);
+			DXRCompressedImage compressed{};
+			state.Measure(
+				label, 1,
+				[&] { EncodeBlockCompressed(image, compressed, desc); }, texels,
+				"texels");
+
+			DXRImageRGBA8 decoded{};
+			DecodeBlockCompressed(compressed, decoded);
+			state.Report(label + "/psnr",
+						 ComputePSNR(format == DXRTextureFormat::BC1Unorm
+										 ? bc1Reference
+										 : image,
+									 decoded),
+						 "dB");
+			if (format != DXRTextureFormat::BC1Unorm)
+			{
+				state.Report(label + "/psnr-rgba",
+							 ComputePSNR(image, decoded, true), "dB");
+			}
+		}
+	}
+}
+} // namespace
+
+DXRBENCHMARK(BlockCompressionEmbedded)
+{
+	DXRImageRGBA8 image{};
+	if (!DecodeImageRGBA8(GetEmbeddedTextureData(), GetEmbeddedTextureSize(),
+						  image))
+		return;
+	MeasureFormats(state, image);
+}
+
+DXRBENCHMARK(BlockCompressionSynthetic)
+{
+	MeasureFormats(state, MakeTestImage(1024));
+}
+
+// Normal quality BC7, 1..N threads:
+DXRBENCHMARK(BlockCompressionThreads)
+{
+	const auto image = MakeTestImage(1024);
+	const auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (std::uint32_t threads{1}; threads <= maxThreads; threads *= 2)
+	{
+		DXRBCEncodeDesc desc{};
+		desc.threadCount = threads;
+		DXRCompressedImage compressed{};
+		state.Measure(
+			"bc7/" + std::to_string(threads) + "threads", 1,
+			[&] { EncodeBlockCompressed(image, compressed, desc); },
+			1024.0 * 1024.0, "texels");
+	}
+}
+
+// CPU decode, what the software rasterizer pays when it loads a BCn
+// container:
+DXRBENCHMARK(BlockCompressionDecode)
+{
+	const auto image = MakeTestImage(1024);
+	for (const auto format : {DXRTextureFormat::BC1Unorm,
+							  DXRTextureFormat::BC3Unorm,
+							  DXRTextureFormat::BC7Unorm})
+	{
+		DXRBCEncodeDesc desc{};
+		desc.format = format;
+		desc.quality = DXRBCQuality::Fast;
+		DXRCompressedImage compressed{};
+		EncodeBlockCompressed(image, compressed, desc);
+
+		DXRImageRGBA8 decoded{};
+		state.Measure(
+			GetFormatName(format), 5,
+			[&] { DecodeBlockCompressed(compressed, decoded); },
+			1024.0 * 1024.0, "texels");
+	}
+}
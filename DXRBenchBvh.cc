@@ -0,0 +1,184 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRBvh.h"
+#include "DXRJobSystem.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace
+{
+// Rolling terrain on a grid with clumps of small, randomly oriented
+// triangles on top, like foliage: big and tiny triangles, dense and empty
+// regions, the cases a median split gets wrong.
+auto MakeScene(std::uint32_t grid, std::uint32_t clumps) -> DXRIndexedMesh
+{
+	DXRIndexedMesh mesh{};
+	const auto vertex = [&](float x, float y, float z) {
+		mesh.vertices.push_back(
+			DXRVertex3D{x, y, z, 0.f, 1.f, 0.f, 0.f, 0.f, 0xFFFFFFFF});
+		return static_cast<std::uint32_t>(mesh.vertices.size() - 1);
+	};
+	const auto height = [](float x, float z) {
+		return 2.f * std::sin(x * 0.05f) * std::cos(z * 0.07f) +
+			   0.5f * std::sin(x * 0.31f + z * 0.17f);
+	};
+
+	const auto size = static_cast<float>(grid);
+	for (std::uint32_t z{}; z <= grid; z++)
+	{
+		for (std::uint32_t x{}; x <= grid; x++)
+		{
+			const auto fx = static_cast<float>(x) - size * 0.5f;
+			const auto fz = static_cast<float>(z) - size * 0.5f;
+			vertex(fx, height(fx, fz), fz);
+		}
+	}
+	for (std::uint32_t z{}; z < grid; z++)
+	{
+		for (std::uint32_t x{}; x < grid; x++)
+		{
+			const auto a = z * (grid + 1) + x;
+			const auto b = a + 1;
+			const auto c = a + grid + 1;
+			const auto d = c + 1;
+			mesh.indices.insert(mesh.indices.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	std::mt19937 random{3};
+	std::uniform_real_distribution<float> position{-size * 0.5f, size * 0.5f};
+	std::normal_distribution<float> spread{0.f, 1.5f};
+	std::uniform_real_distribution<float> leaf{-0.2f, 0.2f};
+	for (std::uint32_t clump{}; clump < clumps; clump++)
+	{
+		const auto cx = position(random);
+		const auto cz = position(random);
+		for (int n{}; n < 256; n++)
+		{
+			const auto x = cx + spread(random);
+			const auto z = cz + spread(random);
+			const auto y = height(x, z) + std::abs(spread(random));
+			const auto a = vertex(x, y, z);
+			const auto b = vertex(x + leaf(random), y + leaf(random),
+								  z + leaf(random));
+			const auto c = vertex(x + leaf(random), y + leaf(random),
+								  z + leaf(random));
+			mesh.indices.insert(mesh.indices.end(), {a, b, c});
+		}
+	}
+	return mesh;
+}
+
+// Rays from above the scene down onto it, some grazing:
+auto MakeRays(std::uint32_t count, float size) -> std::vector<DXRRay>
+{
+	std::mt19937 random{11};
+	std::uniform_real_distribution<float> position{-size * 0.5f, size * 0.5f};
+	std::vector<DXRRay> rays(count);
+	for (auto& ray : rays)
+	{
+		ray.origin = {position(random), 20.f, position(random)};
+		const glm::vec3 target{position(random), 0.f, position(random)};
+		ray.direction = glm::normalize(target - ray.origin);
+	}
+	return rays;
+}
+
+auto IntersectBruteForce(const DXRIndexedMesh& mesh, const DXRRay& ray,
+						 DXRRayHit& hit) -> bool
+{
+	// A single leaf with every triangle:
+	DXRBvh flat{};
+	flat.nodes.push_back({glm::vec3{-1e30f}, 0, glm::vec3{1e30f},
+						  static_cast<std::uint32_t>(mesh.indices.size() / 3)});
+	flat.primitives.resize(mesh.indices.size() / 3);
+	for (std::uint32_t n{}; n < flat.primitives.size(); n++)
+	{
+		flat.primitives[n] = n;
+	}
+	return IntersectBvh(flat, mesh.vertices, mesh.indices, ray, hit);
+}
+} // namespace
+
+// Build time (Mtris/s) sequential and on the job system, SAH cost for a few
+// bin counts, and closest hits against brute force. errors counts invalid
+// trees, job builds that differ from the sequential one and rays whose hit
+// differs from brute force.
+DXRBENCHMARK(BvhBuild)
+{
+	std::uint64_t errors{};
+	constexpr std::uint32_t k_Grid{256};
+	const auto scene = MakeScene(k_Grid, 256);
+	const auto triangles = static_cast<double>(scene.indices.size() / 3);
+	state.Report("triangles", triangles, "");
+
+	for (const auto bins : {4u, 8u, 16u, 32u})
+	{
+		DXRBvhBuildDesc desc{};
+		desc.binCount = bins;
+		DXRBvh bvh{};
+		errors += !BuildBvh(scene, bvh, desc);
+		errors += !ValidateBvh(bvh, scene.vertices, scene.indices);
+		const auto stats = GetBvhStats(bvh, desc);
+		const auto label = "bins" + std::to_string(bins);
+		state.Report(label + "/sah", stats.sahCost, "");
+		if (bins == 16)
+		{
+			state.Report(label + "/nodes", stats.nodes, "");
+			state.Report(label + "/leaves", stats.leaves, "");
+			state.Report(label + "/depth", stats.depth, "");
+			state.Report(label + "/largestleaf", stats.largestLeaf, "");
+		}
+	}
+
+	DXRBvh sequential{};
+	state.Measure(
+		"build", 3, [&] { BuildBvh(scene, sequential); }, triangles, "tris");
+
+	DXRJobSystem jobs{};
+	DXRBvh parallel{};
+	state.Measure(
+		"buildjobs", 3, [&] { BuildBvh(scene, parallel, {}, &jobs); },
+		triangles, "tris");
+	state.Report("threads", jobs.GetThreadCount(), "");
+	errors += sequential.nodes.size() != parallel.nodes.size() ||
+			  std::memcmp(sequential.nodes.data(), parallel.nodes.data(),
+						  sequential.nodes.size() * sizeof(DXRBvhNode)) ||
+			  sequential.primitives != parallel.primitives;
+
+	const auto rays = MakeRays(4096, static_cast<float>(k_Grid));
+	std::uint32_t hits{};
+	for (std::size_t n{}; n < rays.size(); n += 16)
+	{
+		DXRRayHit expected{};
+		DXRRayHit hit{};
+		const auto hitExpected = IntersectBruteForce(scene, rays[n], expected);
+		const auto hitBvh = IntersectBvh(sequential, scene.vertices,
+										 scene.indices, rays[n], hit);
+		errors += hitExpected != hitBvh || hit.t != expected.t;
+		hits += hitBvh;
+	}
+	state.Report("hits", hits, "");
+	state.Measure(
+		"rays", 5,
+		[&] {
+			DXRRayHit hit{};
+			for (const auto& ray : rays)
+			{
+				hits += IntersectBvh(sequential, scene.vertices, scene.indices,
+									 ray, hit);
+			}
+		},
+		static_cast<double>(rays.size()), "rays");
+
+	// The mesh the renderer draws:
+	const auto& cube = GetCubeMesh();
+	DXRBvh cubeBvh{};
+	errors += !BuildBvh(cube, cubeBvh);
+	errors += !ValidateBvh(cubeBvh, cube.vertices, cube.indices);
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
@@ -0,0 +1,59 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRHeadlessRenderer.h"
+
+#include <thread>
+
+DXRBENCHMARK(CameraUpdate)
+{
+	const auto cam = CameraManager::GetInstance();
+	state.Measure("update", 100000, [&] { cam->Update(1.f / 60.f); });
+}
+
+// One full headless frame: events, update, camera, render.
+DXRBENCHMARK(HeadlessFrame)
+{
+	DXRHeadlessRenderer renderer{1280, 720};
+	const auto cam = CameraManager::GetInstance();
+	state.Measure("frame", 500, [&] {
+		renderer.DispatchEvents();
+		renderer.Update(1.f / 60.f);
+		cam->Update(1.f / 60.f);
+		renderer.Render();
+	});
+}
+
+DXRBENCHMARK(AssetDecode)
+{
+	DXRImageRGBA8 image{};
+	DecodeImageRGBA8(GetEmbeddedTextureData(), GetEmbeddedTextureSize(),
+					 image);
+	state.Measure(
+		"embeddedpng", 20,
+		[&] {
+			DecodeImageRGBA8(GetEmbeddedTextureData(),
+							 GetEmbeddedTextureSize(), image);
+		},
+		static_cast<double>(image.width) * image.height, "texels");
+}
+
+// Round trip latency of DXRFenceEvent between two threads:
+DXRBENCHMARK(FenceEventPingPong)
+{
+	constexpr std::uint64_t k_Iterations{20000};
+	DXRFenceEvent ping{};
+	DXRFenceEvent pong{};
+	std::jthread other([&] {
+		for (std::uint64_t n{1}; n <= k_Iterations + 1; n++)
+		{
+			ping.Wait(n);
+			pong.Signal(n);
+		}
+	});
+	std::uint64_t value{};
+	state.Measure("roundtrip", k_Iterations, [&] {
+		value++;
+		ping.Signal(value);
+		pong.Wait(value);
+	});
+}
@@ -0,0 +1,212 @@
+#include "DXRBenchmark.h"
+#include "DXRDescriptorAllocator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+// View counts of a scene: mostly single textures, some material tables:
+auto NextViewCount(std::mt19937& random) -> std::uint32_t
+{
+	const auto roll = random() % 100;
+	if (roll < 70)
+		return 1;
+	if (roll < 95)
+		return 2 + static_cast<std::uint32_t>(random() % 7);
+	return 16 + static_cast<std::uint32_t>(random() % 113);
+}
+} // namespace
+
+// Random allocations and frees against a shadow map of who owns each slot,
+// with Validate() checking the lists and bitmaps along the way. errors
+// counts overlaps, out of range indices and broken invariants; everything
+// freed at the end has to be one range again.
+DXRBENCHMARK(DescriptorFreeListFuzz)
+{
+	// Small enough to run full now and then:
+	constexpr std::uint32_t k_Capacity{1u << 12};
+	std::uint64_t errors{};
+
+	for (std::uint32_t seed{1}; seed <= 8; seed++)
+	{
+		std::mt19937 random{seed};
+		DXRDescriptorFreeList list{k_Capacity};
+		std::vector<std::uint32_t> owner(k_Capacity, ~0u);
+		std::vector<DXRDescriptorAllocation> live{};
+		std::uint32_t failed{};
+		for (std::uint32_t op{}; op < 200000; op++)
+		{
+			// Drift between mostly allocating and mostly freeing so the list
+			// runs full and empty:
+			const auto allocateShare = (op / 20000) % 2 ? 60u : 40u;
+			if (live.empty() || random() % 100 < allocateShare)
+			{
+				const auto allocation = list.Allocate(NextViewCount(random));
+				if (!allocation.IsValid())
+				{
+					failed++;
+					continue;
+				}
+				if (allocation.index + allocation.count > k_Capacity)
+				{
+					errors++;
+					continue;
+				}
+				for (std::uint32_t n{}; n < allocation.count; n++)
+				{
+					errors += owner[allocation.index + n] != ~0u;
+					owner[allocation.index + n] = allocation.block;
+				}
+				live.push_back(allocation);
+			}
+			else
+			{
+				const auto pick = random() % live.size();
+				const auto allocation = live[pick];
+				live[pick] = live.back();
+				live.pop_back();
+				for (std::uint32_t n{}; n < allocation.count; n++)
+				{
+					errors += owner[allocation.index + n] != allocation.block;
+					owner[allocation.index + n] = ~0u;
+				}
+				list.Free(allocation);
+			}
+			if (!(op % 4096))
+				errors += !list.Validate();
+		}
+		if (seed == 1)
+		{
+			std::uint32_t largest{};
+			const auto ranges = list.GetFreeRanges(largest);
+			state.Report("used", list.GetUsedCount(), "");
+			state.Report("freeranges", ranges, "");
+			state.Report("largestfree", largest, "");
+			state.Report("failed", failed, "");
+		}
+		for (const auto& allocation : live)
+		{
+			list.Free(allocation);
+		}
+		std::uint32_t largest{};
+		errors += list.GetFreeRanges(largest) != 1 || largest != k_Capacity;
+		errors += !list.Validate() || list.GetUsedCount();
+	}
+
+	// Throughput at about half full:
+	DXRDescriptorFreeList list{k_Capacity};
+	std::mt19937 random{42};
+	std::vector<DXRDescriptorAllocation> live{};
+	while (list.GetUsedCount() < k_Capacity / 2)
+	{
+		live.push_back(list.Allocate(NextViewCount(random)));
+	}
+	std::vector<std::uint32_t> counts(4096);
+	for (auto& count : counts)
+	{
+		count = NextViewCount(random);
+	}
+	state.Measure(
+		"allocfree", 200,
+		[&] {
+			for (std::size_t n{}; n < counts.size(); n++)
+			{
+				auto& slot = live[(n * 7919) % live.size()];
+				list.Free(slot);
+				slot = list.Allocate(counts[n]);
+			}
+		},
+		static_cast<double>(counts.size()), "pairs");
+	errors += !list.Validate();
+	state.Report("errors", static_cast<double>(errors), "");
+}
+
+// Frames with a 2 frame GPU latency: each frame builds transient tables,
+// streams persistent views in and out. errors counts a persistent slot
+// handed out again before the frame that freed it retired, and transient
+// ranges overlapping ones still in flight.
+DXRBENCHMARK(DescriptorAllocatorFrames)
+{
+	constexpr std::uint32_t k_Persistent{8192};
+	constexpr std::uint32_t k_Transient{4096};
+	constexpr std::uint32_t k_Frames{20000};
+	std::uint64_t errors{};
+
+	DXRDescriptorAllocator allocator{{k_Persistent, k_Transient}};
+	errors += allocator.GetCapacity() != k_Persistent + k_Transient;
+	DXRBenchGPUQueue fence{};
+	std::mt19937 random{7};
+
+	// Fence value of the frame each persistent slot was freed in:
+	std::vector<std::uint64_t> freedIn(k_Persistent);
+	// Fence value of the frame each transient slot was last used in:
+	std::vector<std::uint64_t> usedIn(k_Transient);
+	std::vector<DXRDescriptorAllocation> live{};
+
+	const auto frame = [&] {
+		allocator.Retire(fence.GetCompletedValue());
+		const auto current = fence.GetSignaledValue() + 1;
+
+		for (int table{}; table < 48; table++)
+		{
+			const auto count = 1 + static_cast<std::uint32_t>(random() % 16);
+			std::uint32_t index{};
+			if (!allocator.AllocateTransient(fence, count, index))
+			{
+				errors++;
+				continue;
+			}
+			for (std::uint32_t n{}; n < count; n++)
+			{
+				const auto slot = index + n;
+				if (slot < k_Persistent || slot >= k_Persistent + k_Transient)
+				{
+					errors++;
+					continue;
+				}
+				auto& used = usedIn[slot - k_Persistent];
+				errors += used && used != current &&
+						  used > fence.GetCompletedValue();
+				used = current;
+			}
+		}
+
+		for (int view{}; view < 4; view++)
+		{
+			const auto allocation =
+				allocator.AllocatePersistent(NextViewCount(random));
+			if (!allocation.IsValid())
+				continue;
+			for (std::uint32_t n{}; n < allocation.count; n++)
+			{
+				const auto freed = freedIn[allocation.index + n];
+				errors += freed > fence.GetCompletedValue();
+			}
+			live.push_back(allocation);
+		}
+		while (live.size() > 300)
+		{
+			const auto pick = random() % live.size();
+			const auto allocation = live[pick];
+			live[pick] = live.back();
+			live.pop_back();
+			for (std::uint32_t n{}; n < allocation.count; n++)
+			{
+				freedIn[allocation.index + n] = current;
+			}
+			allocator.Free(allocation);
+		}
+
+		allocator.Submit(fence.Signal());
+	};
+	state.Measure("frame", k_Frames, frame, 1, "frames");
+
+	errors += !allocator.GetPersistent().Validate();
+	state.Report("retiring", static_cast<double>(allocator.GetRetiringCount()),
+				 "");
+	state.Report("persistentused", allocator.GetPersistent().GetUsedCount(),
+				 "");
+	state.Report("errors", static_cast<double>(errors), "");
+}
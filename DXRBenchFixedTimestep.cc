@@ -0,0 +1,126 @@
+#include "DXRBenchmark.h"
+#include "CameraManager.h"
+#include "DXRFixedTimestep.h"
+
+#include <string>
+
+namespace
+{
+// The loop main.cc's update worker runs, against any clock, for the given
+// number of seconds of clock time. frame(scheduler) runs after every wait.
+template <typename Clock>
+auto RunTicks(Clock& clock, const DXRFixedTimestepDesc& desc, double seconds,
+			  auto&& frame) -> DXRFixedTimestepStats
+{
+	DXRFixedTimestep scheduler{clock, desc};
+	const auto end =
+		clock.Now() + static_cast<std::int64_t>(
+						  seconds * static_cast<double>(clock.GetFrequency()));
+	while (clock.Now() < end)
+	{
+		scheduler.WaitForNextTick();
+		frame(scheduler);
+	}
+	return scheduler.GetStats();
+}
+} // namespace
+
+// Manual clock: frames of irregular length (some longer than a tick, one long
+// stall) must still run exactly the ticks due by the last Step(), with alpha
+// in [0, 1] and every tick stamped one dt after the last.
+DXRBENCHMARK(FixedTimestepDeterminism)
+{
+	DXRManualClock clock{};
+	DXRFixedTimestepDesc desc{};
+	desc.maxTicksPerStep = 1000;
+	std::uint64_t badAlpha{};
+	std::uint64_t badStamps{};
+	std::uint64_t frames{};
+	std::int64_t lastStamp{};
+	std::int64_t due{};
+	const auto stats = RunTicks(clock, desc, 10.0, [&](auto& scheduler) {
+		frames++;
+		due = clock.Now() / scheduler.GetTickDuration();
+		const auto alpha = scheduler.Step([&](float) {
+			const auto stamp = scheduler.GetTickTime();
+			badStamps += lastStamp && stamp - lastStamp !=
+										  scheduler.GetTickDuration();
+			lastStamp = stamp;
+		});
+		badAlpha += alpha < 0.f || alpha > 1.f;
+		// 1 to 13 ms frames, and a 250 ms hitch once:
+		clock.Advance(frames == 500 ? 250000000
+									: static_cast<std::int64_t>(
+										  1000000 + (frames * 7919) % 12000000));
+	});
+	state.Report("ticks", static_cast<double>(stats.ticks), "");
+	state.Report("due", static_cast<double>(due), "");
+	state.Report("dropped", static_cast<double>(stats.droppedTicks), "");
+	state.Report("frames", static_cast<double>(frames), "");
+	state.Report("badalpha", static_cast<double>(badAlpha), "");
+	state.Report("badstamps", static_cast<double>(badStamps), "");
+
+	// The same run with the default catch-up cap drops the hitch instead:
+	clock = {};
+	frames = 0;
+	lastStamp = 0;
+	const auto capped =
+		RunTicks(clock, DXRFixedTimestepDesc{}, 10.0, [&](auto& scheduler) {
+			frames++;
+			scheduler.Step([](float) {});
+			clock.Advance(frames == 500 ? 250000000
+										: static_cast<std::int64_t>(
+											  1000000 +
+											  (frames * 7919) % 12000000));
+		});
+	state.Report("capped/ticks", static_cast<double>(capped.ticks), "");
+	state.Report("capped/dropped", static_cast<double>(capped.droppedTicks),
+				 "");
+}
+
+// Real clock at 120 Hz with a cheap tick: how late the wake ups are with
+// different sleep/spin splits, and how much of a core the loop keeps busy.
+// The old loop called Update() back to back, a busy fraction of 1.
+DXRBENCHMARK(FixedTimestepJitter)
+{
+	constexpr double k_Seconds{0.5};
+	const auto cam = CameraManager::GetInstance();
+	for (const auto slackMs : {0, 1, 2})
+	{
+		DXRPlatformClock clock{};
+		DXRFixedTimestepDesc desc{};
+		desc.wakeUpSlack = slackMs / 1000.0;
+		const auto stats = RunTicks(clock, desc, k_Seconds, [&](auto& scheduler) {
+			scheduler.Step(
+				[&](float dt) { cam->Update(dt, scheduler.GetTickTime()); });
+		});
+		const auto label = "slack" + std::to_string(slackMs) + "ms";
+		state.Report(label + "/ticks", static_cast<double>(stats.ticks), "");
+		state.Report(label + "/jittermean", stats.GetJitterMean() * 1e6, "us");
+		state.Report(label + "/jittermax", stats.jitterMax * 1e6, "us");
+		state.Report(label + "/busy", stats.GetBusyFraction() * 100.0, "%");
+	}
+}
+
+// Render side of the interpolation: ticks stamped with manual clock times,
+// snapshots acquired in between must land between the last two positions.
+DXRBENCHMARK(CameraInterpolation)
+{
+	const auto cam = CameraManager::GetInstance();
+	DXRManualClock clock{};
+	DXRFixedTimestep scheduler{clock};
+	std::uint64_t outside{};
+	state.Measure("acquire", 10000, [&] {
+		clock.Advance(scheduler.GetTickDuration() / 3);
+		scheduler.Step(
+			[&](float dt) { cam->Update(dt, scheduler.GetTickTime()); });
+		const auto current = cam->AcquireSnapshot();
+		const auto blended = cam->AcquireInterpolatedSnapshot(clock.Now());
+		// The camera orbits at radius 5, the blend is at most one tick's arc
+		// away from the current position:
+		const auto step = glm::length(blended.position - current.position);
+		const auto arc = 5.f * scheduler.GetDeltaTime() * 1.001f;
+		outside += !(step <= arc) || blended.time != current.time;
+	});
+	state.Report("outside", static_cast<double>(outside), "");
+}
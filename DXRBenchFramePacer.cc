@@ -0,0 +1,69 @@
+#include "DXRBenchmark.h"
+#include "DXRFramePacer.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+// 2ms of CPU recording, 3ms of GPU work per frame:
+// One frame in flight serializes to ~5ms, two or more should approach the
+// GPU bound ~3ms.
+DXRBENCHMARK(FramePacerMockQueue)
+{
+	constexpr std::chrono::microseconds k_CPUTime{2000};
+	constexpr std::chrono::microseconds k_GPUTime{3000};
+	constexpr std::uint64_t k_Frames{60};
+
+	for (std::uint32_t frames{1}; frames <= 3; frames++)
+	{
+		// No latency, the GPU thread sleeps off Execute()'s work:
+		DXRBenchGPUQueue queue{0};
+		DXRFramePacer pacer{frames};
+
+		const auto label = std::to_string(frames) + "inflight";
+		state.Measure(label, k_Frames, [&] {
+			pacer.BeginFrame(queue);
+			std::this_thread::sleep_for(k_CPUTime);
+			queue.Execute(k_GPUTime);
+			pacer.EndFrame(queue);
+		});
+		pacer.Flush(queue);
+
+		state.Report(label + "/stalls",
+					 static_cast<double>(pacer.GetStallCount()) /
+						 static_cast<double>(pacer.GetFrameCount()) * 100.0,
+					 "%");
+	}
+}
+
+// Pacer bookkeeping alone, against a queue that is always done:
+DXRBENCHMARK(FramePacerOverhead)
+{
+	struct IdleQueue
+	{
+		std::uint64_t completed{};
+		auto Signal(std::uint64_t value) -> void
+		{
+			completed = value;
+		}
+		auto GetCompletedValue() -> std::uint64_t
+		{
+			return completed;
+		}
+		auto Wait(std::uint64_t) -> void
+		{
+		}
+	};
+
+	IdleQueue queue{};
+	DXRFramePacer pacer{3};
+	std::uint32_t slots{};
+	state.Measure(
+		"frame", 1000000,
+		[&] {
+			slots += pacer.BeginFrame(queue);
+			pacer.EndFrame(queue);
+		},
+		1.0, "frames");
+	state.Report("slotsum", static_cast<double>(slots), "");
+}
@@ -0,0 +1,284 @@
+#include "DXRBenchmark.h"
+#include "DXRGpuHeapAllocator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+struct TraceOp
+{
+	// Index into the replay's allocations, freed if size is 0:
+	std::uint32_t id{};
+	std::uint64_t size{};
+	std::uint64_t alignment{};
+	DXRGpuMemoryType type{};
+	DXRGpuHeapKind kind{};
+};
+
+struct Trace
+{
+	std::vector<TraceOp> ops{};
+	std::uint32_t ids{};
+};
+
+// Texture sizes spread evenly over 64KB..8MB in log space, like BC7 mip
+// chains of 256² to 2048² textures:
+auto NextTextureSize(std::mt19937& random) -> std::uint64_t
+{
+	const auto shift = 16 + random() % 7;
+	const auto size = std::uint64_t{1} << shift;
+	return size + (size / 16) * (random() % 16);
+}
+
+// Streams 24 levels in and out on top of a resident set: each level loads
+// textures and vertex/index buffers, the level before it unloads once the
+// next one is in. In between, the render targets are recreated at other
+// sizes, some of them 4MB aligned MSAA ones. Always the same trace for the
+// same seed.
+auto MakeStreamingTrace(std::uint32_t seed) -> Trace
+{
+	std::mt19937 random{seed};
+	Trace trace{};
+	const auto allocate = [&](std::uint64_t size, std::uint64_t alignment,
+							  DXRGpuHeapKind kind) {
+		trace.ops.push_back({trace.ids, size, alignment,
+							 DXRGpuMemoryType::Default, kind});
+		return trace.ids++;
+	};
+	const auto release = [&](std::uint32_t id) {
+		trace.ops.push_back({id});
+	};
+	const auto load = [&](std::uint32_t count,
+						  std::vector<std::uint32_t>& ids) {
+		for (std::uint32_t n{}; n < count; n++)
+		{
+			if (random() % 4)
+			{
+				ids.push_back(allocate(NextTextureSize(random),
+									   DXRGpuHeapAllocator::k_DefaultAlignment,
+									   DXRGpuHeapKind::Texture));
+			}
+			else
+			{
+				const auto size = (std::uint64_t{1} << (12 + random() % 10)) *
+								  (1 + random() % 3);
+				ids.push_back(allocate(size,
+									   DXRGpuHeapAllocator::k_DefaultAlignment,
+									   DXRGpuHeapKind::Buffer));
+			}
+		}
+	};
+
+	std::vector<std::uint32_t> resident{};
+	load(120, resident);
+
+	std::vector<std::uint32_t> targets{};
+	const auto recreateTargets = [&] {
+		for (const auto id : targets)
+		{
+			release(id);
+		}
+		targets.clear();
+		const auto width = 1280 + random() % 1280;
+		const auto height = 720 + random() % 720;
+		const auto pixels = std::uint64_t{width} * height;
+		const bool msaa = random() % 3 == 0;
+		// Color, depth, two half resolution ones:
+		for (const auto bytes : {pixels * 4, pixels * 4, pixels, pixels})
+		{
+			targets.push_back(allocate(
+				msaa ? bytes * 4 : bytes,
+				msaa ? DXRGpuHeapAllocator::k_MsaaAlignment
+					 : DXRGpuHeapAllocator::k_DefaultAlignment,
+				DXRGpuHeapKind::RenderTarget));
+		}
+	};
+	recreateTargets();
+
+	std::vector<std::uint32_t> previous{};
+	for (int level{}; level < 24; level++)
+	{
+		std::vector<std::uint32_t> current{};
+		load(150 + static_cast<std::uint32_t>(random() % 100), current);
+		// A few streamed assets stay resident for good:
+		for (std::uint32_t n{}; n < 4; n++)
+		{
+			resident.push_back(current[random() % current.size()]);
+		}
+		for (const auto id : previous)
+		{
+			if (std::find(resident.begin(), resident.end(), id) ==
+				resident.end())
+				release(id);
+		}
+		previous = std::move(current);
+		if (random() % 2)
+			recreateTargets();
+	}
+	return trace;
+}
+
+struct ReplayResult
+{
+	DXRGpuHeapAllocatorStats stats{};
+	std::uint64_t peakUsed{};
+	std::uint64_t peakHeapBytes{};
+	std::uint64_t failed{};
+	std::uint64_t hash{};
+	bool valid{true};
+};
+
+// Replays trace, every 256 ops validating and folding the placements into a
+// hash:
+auto Replay(DXRGpuHeapAllocator& allocator, const Trace& trace,
+			std::vector<DXRGpuAllocation>& allocations) -> ReplayResult
+{
+	ReplayResult result{};
+	result.hash = 14695981039346656037ull;
+	allocations.assign(trace.ids, {});
+	std::uint32_t count{};
+	for (const auto& op : trace.ops)
+	{
+		if (op.size)
+		{
+			const auto allocation =
+				allocator.Allocate(op.size, op.alignment, op.type, op.kind);
+			result.failed += !allocation.IsValid();
+			allocations[op.id] = allocation;
+			result.hash = (result.hash ^ allocation.heap) * 1099511628211ull;
+			result.hash = (result.hash ^ allocation.offset) * 1099511628211ull;
+		}
+		else
+		{
+			allocator.Free(allocations[op.id]);
+			allocations[op.id] = {};
+		}
+		const auto stats = allocator.GetStats();
+		result.peakUsed = std::max(result.peakUsed, stats.usedBytes);
+		result.peakHeapBytes = std::max(result.peakHeapBytes, stats.heapBytes);
+		if (!(++count % 256))
+			result.valid = result.valid && allocator.Validate();
+	}
+	result.stats = allocator.GetStats();
+	result.valid = result.valid && allocator.Validate();
+	return result;
+}
+
+auto MiB(std::uint64_t bytes) -> double
+{
+	return static_cast<double>(bytes) / static_cast<double>(1u << 20);
+}
+} // namespace
+
+// Replays a level streaming trace twice: placements have to match exactly,
+// heaps have to be a fraction of one committed resource per allocation, and
+// defragmentation has to give heaps back. errors counts failed allocations,
+// mismatched replays, broken invariants and leaked heaps.
+DXRBENCHMARK(GpuHeapAllocatorTrace)
+{
+	std::uint64_t errors{};
+	const auto trace = MakeStreamingTrace(1);
+	std::uint64_t allocationCount{};
+	for (const auto& op : trace.ops)
+	{
+		allocationCount += op.size != 0;
+	}
+
+	std::vector<DXRGpuAllocation> allocations{};
+	DXRGpuHeapAllocator allocator{};
+	const auto result = Replay(allocator, trace, allocations);
+	errors += result.failed + !result.valid;
+	state.Report("ops", static_cast<double>(trace.ops.size()), "");
+	// Committed resources would be one OS allocation each:
+	state.Report("committed", static_cast<double>(allocationCount), "allocs");
+	state.Report("heapscreated",
+				 static_cast<double>(result.stats.heapsCreated), "allocs");
+	state.Report("peakused", MiB(result.peakUsed), "MiB");
+	state.Report("peakheaps", MiB(result.peakHeapBytes), "MiB");
+	state.Report("liveheaps", result.stats.heaps, "");
+	state.Report("fragmentation", allocator.GetFragmentation(), "");
+
+	DXRGpuHeapAllocator again{};
+	std::vector<DXRGpuAllocation> replayed{};
+	errors += Replay(again, trace, replayed).hash != result.hash;
+
+	// Defragment, moving like the renderer would: copy, repoint, free:
+	const auto before = allocator.GetStats();
+	std::vector<DXRGpuMove> moves{};
+	allocator.PlanDefragmentation(~0ull, moves);
+	std::uint64_t movedBytes{};
+	for (const auto& move : moves)
+	{
+		const auto id = std::find_if(allocations.begin(), allocations.end(),
+									 [&](const auto& allocation) {
+										 return allocation.heap ==
+													move.from.heap &&
+												allocation.offset ==
+													move.from.offset;
+									 });
+		if (id == allocations.end())
+		{
+			errors++;
+			continue;
+		}
+		*id = move.to;
+		allocator.Free(move.from);
+		movedBytes += move.from.size;
+	}
+	errors += !allocator.Validate();
+	const auto after = allocator.GetStats();
+	errors += after.usedBytes != before.usedBytes;
+	state.Report("defragmoves", static_cast<double>(moves.size()), "");
+	state.Report("defragmoved", MiB(movedBytes), "MiB");
+	state.Report("heapsbefore", before.heaps, "");
+	state.Report("heapsafter", after.heaps, "");
+	state.Report("heapbytesbefore", MiB(before.heapBytes), "MiB");
+	state.Report("heapbytesafter", MiB(after.heapBytes), "MiB");
+	state.Report("fragmentationafter", allocator.GetFragmentation(), "");
+
+	for (const auto& allocation : allocations)
+	{
+		allocator.Free(allocation);
+	}
+	std::vector<std::uint32_t> released{};
+	allocator.CollectReleasedHeaps(released);
+	const auto empty = allocator.GetStats();
+	errors += empty.usedBytes || empty.allocations || !allocator.Validate();
+	errors += released.size() != empty.heapsReleased;
+	// Only the empty heaps kept for later are left, at most one per pool:
+	errors += empty.heaps > 4;
+
+	state.Measure(
+		"replay", 5,
+		[&] {
+			DXRGpuHeapAllocator timed{};
+			Replay(timed, trace, allocations);
+		},
+		static_cast<double>(trace.ops.size()), "ops");
+	state.Report("errors", static_cast<double>(errors), "");
+}
+
+// The same trace with a budget below its peak: allocations that need a new
+// heap fail instead of going over, heap bytes never exceed the budget.
+DXRBENCHMARK(GpuHeapAllocatorBudget)
+{
+	std::uint64_t errors{};
+	const auto trace = MakeStreamingTrace(2);
+	std::vector<DXRGpuAllocation> allocations{};
+
+	DXRGpuHeapAllocator unlimited{};
+	const auto peak = Replay(unlimited, trace, allocations).peakHeapBytes;
+
+	DXRGpuHeapAllocatorDesc desc{};
+	desc.budget = peak * 3 / 4;
+	DXRGpuHeapAllocator allocator{desc};
+	const auto result = Replay(allocator, trace, allocations);
+	errors += !result.valid || result.peakHeapBytes > desc.budget;
+	errors += !result.failed || result.failed != result.stats.budgetFailures;
+	state.Report("budget", MiB(desc.budget), "MiB");
+	state.Report("peakheaps", MiB(result.peakHeapBytes), "MiB");
+	state.Report("failed", static_cast<double>(result.failed), "");
+	state.Report("errors", static_cast<double>(errors), "");
+}
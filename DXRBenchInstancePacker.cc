@@ -0,0 +1,108 @@
+#include "DXRBenchmark.h"
+#include "DXRHeadlessRenderer.h"
+#include "DXRInstancePacker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+// Random placement, rotation, scale and color:
+auto MakeInstances(std::size_t count) -> std::vector<DXRInstance>
+{
+	std::mt19937 random{3};
+	std::uniform_real_distribution<float> position{-50.f, 50.f};
+	std::uniform_real_distribution<float> scale{0.5f, 2.f};
+	std::normal_distribution<float> gaussian{};
+	std::vector<DXRInstance> instances(count);
+	for (auto& instance : instances)
+	{
+		instance.position = {position(random), position(random),
+							 position(random)};
+		instance.scale = scale(random);
+		instance.rotation = glm::normalize(DXRQuat{
+			gaussian(random), gaussian(random), gaussian(random),
+			gaussian(random)});
+		instance.color = static_cast<std::uint32_t>(random());
+	}
+	return instances;
+}
+} // namespace
+
+// 100k instances into a structured buffer sized array, SSE against the
+// scalar reference. mismatches counts entries that differ in any bit.
+DXRBENCHMARK(InstancePacker)
+{
+	constexpr std::size_t k_Count{100000};
+	const auto instances = MakeInstances(k_Count);
+	std::vector<DXRInstanceData> scalar(k_Count);
+	std::vector<DXRInstanceData> simd(k_Count);
+	const auto megabytes =
+		static_cast<double>(k_Count * sizeof(DXRInstanceData)) / 1e6;
+	state.Report("buffer", megabytes, "MB");
+
+	const auto scalarSeconds = state.Measure(
+		"scalar", 50, [&] { PackInstancesScalar(instances, scalar); },
+		static_cast<double>(k_Count), "instances");
+	const auto simdSeconds = state.Measure(
+		"simd", 50, [&] { PackInstances(instances, simd); },
+		static_cast<double>(k_Count), "instances");
+	state.Report("simd/bandwidth", megabytes / 1e3 / simdSeconds, "GB/s");
+	state.Report("speedup", scalarSeconds / simdSeconds, "x");
+
+	std::uint64_t mismatches{};
+	for (std::size_t n{}; n < k_Count; n++)
+	{
+		mismatches += memcmp(&scalar[n], &simd[n], sizeof scalar[n]) != 0;
+	}
+	state.Report("mismatches", static_cast<double>(mismatches), "");
+
+	// Tails that don't fill a group of four, and unaligned output:
+	std::vector<DXRInstanceData> unaligned(8);
+	const std::span<DXRInstanceData> shifted{
+		reinterpret_cast<DXRInstanceData*>(
+			reinterpret_cast<unsigned char*>(unaligned.data()) + 4),
+		7};
+	PackInstances(std::span{instances}.first(7), shifted);
+	std::uint64_t tailMismatches{};
+	for (std::size_t n{}; n < 7; n++)
+	{
+		tailMismatches +=
+			memcmp(&scalar[n], &shifted[n], sizeof scalar[n]) != 0;
+	}
+	state.Report("unaligned/mismatches", static_cast<double>(tailMismatches),
+				 "");
+}
+
+// 1024 small cubes in one DrawIndexedInstanced() on the headless renderer:
+DXRBENCHMARK(InstancedCubes)
+{
+	const auto cam = CameraManager::GetInstance();
+	cam->SetAspectRatio(1920.f / 1080.f);
+	cam->Update(0.7f);
+
+	constexpr int k_Grid{32};
+	std::vector<DXRInstance> instances{};
+	for (int y{}; y < k_Grid; y++)
+	{
+		for (int x{}; x < k_Grid; x++)
+		{
+			DXRInstance instance{};
+			instance.position = {(static_cast<float>(x) - k_Grid / 2.f) * 0.3f,
+								 (static_cast<float>(y) - k_Grid / 2.f) * 0.3f,
+								 0.f};
+			instance.scale = 0.1f;
+			instances.push_back(instance);
+		}
+	}
+
+	DXRHeadlessRenderer renderer{1920, 1080};
+	renderer.DispatchEvents();
+	renderer.Update(0.f);
+	renderer.SetInstances(instances);
+	state.Measure(
+		"frame", 20, [&] { renderer.Render(); },
+		static_cast<double>(instances.size()), "instances");
+}
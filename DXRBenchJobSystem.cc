@@ -0,0 +1,236 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRInstancePacker.h"
+#include "DXRJobSystem.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace
+{
+// 1, 2, 4... up to the hardware thread count, and that count itself:
+auto GetThreadCounts() -> std::vector<std::uint32_t>
+{
+	const auto hardware = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<std::uint32_t> counts{};
+	for (std::uint32_t count{1}; count < hardware; count *= 2)
+	{
+		counts.push_back(count);
+	}
+	counts.push_back(hardware);
+	return counts;
+}
+
+auto MakeSystem(std::uint32_t threads) -> std::unique_ptr<DXRJobSystem>
+{
+	// One thread means the main thread alone, but a system always has a
+	// worker. Give it the smallest one and keep it out of ParallelFor by
+	// running the work inline below:
+	DXRJobSystemDesc desc{};
+	desc.workerCount = std::max(threads, 2u) - 1;
+	return std::make_unique<DXRJobSystem>(desc);
+}
+
+// Spins every instance a bit and packs the result, what a frame of
+// transform updates does:
+auto UpdateTransforms(std::span<DXRInstance> instances,
+					  std::span<DXRInstanceData> out, float dt) -> void
+{
+	const auto spin = glm::angleAxis(dt, glm::vec3{0.f, 1.f, 0.f});
+	for (auto& instance : instances)
+	{
+		instance.rotation = glm::normalize(spin * instance.rotation);
+		instance.position.y += dt;
+	}
+	PackInstances(instances, out);
+}
+} // namespace
+
+// The same work on 1..N threads: decoding the embedded PNG (big uneven jobs),
+// updating and packing instance transforms (many small even ones) and the
+// scheduling overhead of empty jobs.
+DXRBENCHMARK(JobSystemScaling)
+{
+	constexpr std::size_t k_Textures{16};
+	constexpr std::size_t k_Instances{1 << 20};
+	constexpr std::size_t k_EmptyJobs{10000};
+
+	std::mt19937 random{5};
+	std::uniform_real_distribution<float> position{-50.f, 50.f};
+	std::vector<DXRInstance> instances(k_Instances);
+	for (auto& instance : instances)
+	{
+		instance.position = {position(random), position(random),
+							 position(random)};
+	}
+	std::vector<DXRInstanceData> packed(k_Instances);
+	std::vector<DXRImageRGBA8> images(k_Textures);
+
+	for (const auto threads : GetThreadCounts())
+	{
+		const auto jobs = MakeSystem(threads);
+		const auto label = std::to_string(threads) + "t";
+		auto parallelFor = [&](std::size_t count, std::size_t grain,
+							   auto&& fn) {
+			if (threads == 1)
+				fn(std::size_t{}, count);
+			else
+				jobs->ParallelFor(0, count, grain, fn);
+		};
+
+		bool decoded{true};
+		const auto decodeTime = state.Measure(
+			label + "/texturedecode", 3,
+			[&] {
+				parallelFor(k_Textures, 1,
+							[&](std::size_t first, std::size_t last) {
+								for (auto i = first; i < last; i++)
+								{
+									decoded &= DecodeImageRGBA8(
+										GetEmbeddedTextureData(),
+										GetEmbeddedTextureSize(), images[i]);
+								}
+							});
+			});
+		state.Report(label + "/textures",
+					 static_cast<double>(k_Textures) / decodeTime, "/s");
+		if (!decoded)
+			state.Report(label + "/decodefailed", 1.0, "");
+
+		state.Measure(
+			label + "/transforms", 10,
+			[&] {
+				parallelFor(k_Instances, 4096,
+							[&](std::size_t first, std::size_t last) {
+								UpdateTransforms(
+									std::span{instances}.subspan(first,
+																 last - first),
+									std::span{packed}.subspan(first,
+															  last - first),
+									1.f / 120.f);
+							});
+			},
+			static_cast<double>(k_Instances), "instances");
+
+		state.Measure(
+			label + "/emptyjobs", 10,
+			[&] {
+				DXRJobCounter counter{};
+				for (std::size_t i{}; i < k_EmptyJobs; i++)
+				{
+					jobs->Run([] {}, &counter);
+				}
+				jobs->Wait(counter);
+			},
+			static_cast<double>(k_EmptyJobs), "jobs");
+		state.Report(label + "/steals",
+					 static_cast<double>(jobs->GetStealCount()), "");
+	}
+}
+
+// Correctness with more threads than cores: a dependency chain, nested
+// ParallelFor, jobs queued from outside threads, main thread affinity and a
+// loop on a dedicated thread.
+// errors has to stay 0.
+DXRBENCHMARK(JobSystemStress)
+{
+	DXRJobSystemDesc desc{};
+	desc.workerCount = 4;
+	DXRJobSystem jobs{desc};
+	std::uint64_t errors{};
+
+	state.Measure("graph", 100, [&] {
+		// Fill -> sum -> check on the main thread:
+		std::vector<std::uint32_t> values(1 << 16);
+		std::atomic<std::uint64_t> sum{};
+		bool onMainThread{};
+		DXRJobCounter filled{}, summed{}, checked{};
+		for (std::size_t block{}; block < 16; block++)
+		{
+			jobs.Run(
+				[&, block] {
+					// Nested, waits inside a job:
+					const auto size = values.size() / 16;
+					jobs.ParallelFor(block * size, (block + 1) * size, 256,
+									 [&](std::size_t first, std::size_t last) {
+										 for (auto i = first; i < last; i++)
+										 {
+											 values[i] =
+												 static_cast<std::uint32_t>(i);
+										 }
+									 });
+				},
+				&filled);
+		}
+		jobs.Run(
+			[&] {
+				sum = std::accumulate(values.begin(), values.end(),
+									  std::uint64_t{});
+			},
+			&summed, &filled);
+		jobs.RunOnMainThread([&] { onMainThread = jobs.IsMainThread(); },
+							 &checked, &summed);
+		jobs.Wait(checked);
+
+		const auto n = static_cast<std::uint64_t>(values.size());
+		errors += sum != n * (n - 1) / 2;
+		errors += !onMainThread;
+	});
+
+	// Jobs from a thread that isn't part of the system:
+	std::atomic<std::uint32_t> ran{};
+	{
+		DXRJobCounter counter{};
+		std::jthread outside{[&] {
+			for (int i{}; i < 1000; i++)
+			{
+				jobs.Run([&] { ran++; }, &counter);
+			}
+			jobs.Wait(counter);
+		}};
+	}
+	errors += ran != 1000;
+
+	// A loop on a dedicated thread, like the update loop, handing jobs to the
+	// workers while the main thread waits on its own. Neither Wait() may
+	// pick the loop up:
+	{
+		std::atomic<bool> stop{};
+		std::atomic<std::uint32_t> ticks{};
+		DXRJobCounter loopDone{};
+		jobs.RunDedicated(
+			[&] {
+				while (!stop.load(std::memory_order_relaxed))
+				{
+					DXRJobCounter tick{};
+					jobs.Run([&] { ticks++; }, &tick);
+					jobs.Wait(tick);
+				}
+			},
+			&loopDone);
+		std::atomic<std::uint32_t> items{};
+		for (int i{}; i < 100; i++)
+		{
+			jobs.ParallelFor(0, 1024, 16,
+							 [&](std::size_t first, std::size_t last) {
+								 items += static_cast<std::uint32_t>(last -
+																	 first);
+							 });
+		}
+		while (!ticks.load())
+		{
+			std::this_thread::yield();
+		}
+		stop.store(true, std::memory_order_relaxed);
+		jobs.Wait(loopDone);
+		errors += items != 100 * 1024;
+	}
+
+	state.Report("errors", static_cast<double>(errors), "");
+	state.Report("steals", static_cast<double>(jobs.GetStealCount()), "");
+}
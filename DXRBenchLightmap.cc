@@ -0,0 +1,187 @@
+#include "DXRBenchmark.h"
+#include "CameraManager.h"
+#include "DXRAssets.h"
+#include "DXRInstancePacker.h"
+#include "DXRJobSystem.h"
+#include "DXRLightmap.h"
+#include "DXRSoftwareRasterizer.h"
+#include "DXRTextureContainer.h"
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+
+namespace
+{
+// Mean ambient occlusion of the baked texels whose distance from the y
+// axis is within [minRadius, maxRadius):
+auto GetMeanOcclusion(const DXRLightmap& lightmap, float minRadius,
+					  float maxRadius) -> float
+{
+	double sum{};
+	std::uint64_t count{};
+	for (std::size_t texel{}; texel < lightmap.coverage.size(); texel++)
+	{
+		if (lightmap.coverage[texel] != DXRLightmap::k_Covered)
+			continue;
+		const auto& p = lightmap.positions[texel];
+		const auto radius = std::sqrt(p.x * p.x + p.z * p.z);
+		if (radius < minRadius || radius >= maxRadius)
+			continue;
+		sum += lightmap.lighting.pixels[texel * 4 + 3];
+		count++;
+	}
+	return count ? static_cast<float>(sum / static_cast<double>(count)) : 0.f;
+}
+} // namespace
+
+// Bakes the cube LoadRenderingAssets draws and the ground under it, in the
+// scene DXRBenchPathTracer.cc lights (four small cubes around it), at
+// 128^2 to 512^2 texels. Reports unwrap and bake times with Mtexels/s
+// (unwrap per atlas texel, bake per baked texel, the ones a chart only
+// touches included) and Mrays/s on all cores, how many charts came out and
+// the mean ambient occlusion of the ground next to the cubes and away from
+// them.
+// errors counts lightmap UVs outside [0, 1], ground that isn't darker next
+// to the cubes, composites that don't survive a .dxrt round trip, and
+// seams: pixels of the baked cube, drawn by DXRSoftwareRasterizer with the
+// composite texture from CameraManager's camera, that sample an empty texel.
+DXRBENCHMARK(Lightmap)
+{
+	std::uint64_t errors{};
+	DXRJobSystem jobs{};
+	state.Report("threads", jobs.GetThreadCount(), "");
+
+	DXRImageRGBA8 texture{};
+	if (!LoadDefaultTextureRGBA8(texture))
+		return;
+	const DXRIndexedMesh meshes[]{GetCubeMesh(), GetGroundMesh()};
+	std::vector<DXRRayScene> scenes(2);
+	for (std::size_t n{}; n < 2; n++)
+	{
+		DXRBvh bvh{};
+		errors += !BuildBvh(meshes[n], bvh);
+		errors += !BuildRayScene(bvh, meshes[n].vertices, meshes[n].indices,
+								 scenes[n]);
+	}
+
+	std::vector<DXRInstance> instances(6);
+	std::vector<std::uint32_t> instanceMeshes{0, 1, 0, 0, 0, 0};
+	for (std::uint32_t n{2}; n < 6; n++)
+	{
+		const auto angle = static_cast<float>(n) * 1.5707963f;
+		instances[n].scale = 0.4f;
+		instances[n].position = {std::cos(angle) * 2.2f, -0.6f,
+								 std::sin(angle) * 2.2f};
+	}
+	std::vector<DXRInstanceData> packed(instances.size());
+	PackInstances(instances, packed);
+	DXRRayTopLevel scene{};
+	scene.Update(scenes, packed, instanceMeshes);
+
+	DXRLightmapDesc desc{};
+	desc.aoSamples = 32;
+	desc.skyRadiance = {0.3f, 0.4f, 0.6f};
+	desc.sunIrradiance = glm::vec3{2.5f};
+
+	CameraManager camera{};
+	camera.SetAspectRatio(640.f / 360.f);
+	camera.Update(0.5f);
+
+	for (const std::uint32_t instance : {0u, 1u})
+	{
+		const auto name = instance ? std::string{"ground"} : "cube";
+		const auto& mesh = meshes[instanceMeshes[instance]];
+		for (const auto resolution : {128u, 256u, 512u})
+		{
+			const auto label = name + "/" + std::to_string(resolution);
+			desc.resolution = resolution;
+			DXRLightmap lightmap{};
+			state.Measure(
+				label + "/unwrap", 3,
+				[&] {
+					errors +=
+						!UnwrapLightmap(mesh, packed[instance], desc, lightmap);
+				},
+				static_cast<double>(resolution) * resolution, "texels");
+			std::uint64_t texels{};
+			for (const auto coverage : lightmap.coverage)
+			{
+				texels += coverage != DXRLightmap::k_Empty;
+			}
+			for (const auto& vertex : lightmap.mesh.vertices)
+			{
+				errors += !(vertex.u >= 0.f && vertex.u <= 1.f &&
+							vertex.v >= 0.f && vertex.v <= 1.f);
+			}
+			state.Report(label + "/charts", lightmap.charts, "");
+			state.Report(label + "/texels", static_cast<double>(texels), "");
+
+			// Unwrapped again before every bake, the last one's dilation
+			// filled the padding:
+			std::uint64_t rays{};
+			const auto seconds = state.Measure(
+				label + "/bake", 1,
+				[&] {
+					UnwrapLightmap(mesh, packed[instance], desc, lightmap);
+					rays = BakeLightmap(scene, desc, lightmap, &jobs);
+				},
+				static_cast<double>(texels), "texels");
+			state.Report(label + "/rays",
+						 static_cast<double>(rays) / seconds / 1e6, "Mrays/s");
+
+			DXRImageRGBA8 composite{};
+			CompositeLightmap(lightmap, &texture, composite);
+			if (instance)
+			{
+				const auto near = GetMeanOcclusion(lightmap, 0.f, 1.5f);
+				const auto far = GetMeanOcclusion(lightmap, 5.f, 1e9f);
+				state.Report(label + "/occlusion/near", near, "");
+				state.Report(label + "/occlusion/far", far, "");
+				errors += near >= far;
+				continue;
+			}
+
+			// Seams, the cube drawn with its bake:
+			DXRSoftwareRasterizer rasterizer{};
+			rasterizer.Resize(640, 360);
+			const float clear[4]{};
+			rasterizer.Clear(clear);
+			rasterizer.SetTexture(&composite);
+			DXRGraphicsConstants constants{};
+			constants.projection = camera.GetProjectionMatrix();
+			constants.view = camera.GetViewMatrix();
+			constants.model = glm::mat4{1.f};
+			rasterizer.DrawIndexedInstanced(lightmap.mesh.vertices,
+											lightmap.mesh.indices,
+											{&packed[instance], 1}, constants);
+			rasterizer.Execute();
+			std::uint64_t seams{};
+			for (std::size_t n{}; n < rasterizer.GetColorBuffer().size(); n++)
+			{
+				seams += rasterizer.GetDepthBuffer()[n] < 1.f &&
+						 (rasterizer.GetColorBuffer()[n] >> 24) == 0;
+			}
+			state.Report(label + "/seams", static_cast<double>(seams),
+						 "pixels");
+			errors += seams;
+
+			// The composite as the texture pipeline stores it:
+			std::vector<unsigned char> cooked{};
+			errors += !CookTextureContainer({&composite, 1}, cooked);
+			const auto path = (std::filesystem::temp_directory_path() /
+							   "DXRBenchLightmap.dxrt")
+								  .string();
+			errors += !WriteTextureContainer(path.c_str(), cooked);
+			DXRTextureContainer container{};
+			DXRImageRGBA8 loaded{};
+			errors += !container.Open(path.c_str()) ||
+					  !CopyTextureContainerMip(container, 0, loaded);
+			errors += loaded.pixels != composite.pixels;
+			container.Close();
+			std::filesystem::remove(path);
+		}
+	}
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
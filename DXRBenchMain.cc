@@ -0,0 +1,34 @@
+#include "DXRBenchmark.h"
+#include "DXRSingleton.h"
+
+#include <cstdio>
+#include <string_view>
+
+// DXRBench [filter]
+// Runs every registered benchmark whose name contains `filter`. Returns 1
+// if any of them reported errors.
+int main(int argc, const char* const* argv)
+{
+	InitializeSingletonInstances();
+
+	const std::string_view filter = argc > 1 ? argv[1] : "";
+	double errors{};
+
+	for (const auto& benchmark : GetRegisteredBenchmarks())
+	{
+		if (!filter.empty() &&
+			benchmark.name.find(filter) == std::string_view::npos)
+			continue;
+
+		DXRBenchmarkState state{benchmark.name};
+		benchmark.function(state);
+		errors += state.GetErrors();
+	}
+
+	if (errors != 0.0)
+	{
+		std::printf("DXRBench: %.0f errors\n", errors);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRMeshBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <string>
+
+namespace
+{
+// UV sphere as triangle soup, triangles shuffled like a careless exporter
+// would leave them:
+auto MakeSphereSoup(std::uint32_t rings, std::uint32_t segments)
+	-> std::vector<DXRVertex3D>
+{
+	const auto vertex = [&](std::uint32_t ring, std::uint32_t segment) {
+		const auto u = static_cast<float>(segment) / static_cast<float>(segments);
+		const auto v = static_cast<float>(ring) / static_cast<float>(rings);
+		const auto theta = u * 2.f * std::numbers::pi_v<float>;
+		const auto phi = v * std::numbers::pi_v<float>;
+		const glm::vec3 n{std::sin(phi) * std::cos(theta), std::cos(phi),
+						  std::sin(phi) * std::sin(theta)};
+		return DXRVertex3D{n.x, n.y, n.z, n.x, n.y, n.z, u, v, 0xFFFFFFFF};
+	};
+
+	std::vector<std::array<DXRVertex3D, 3>> triangles{};
+	for (std::uint32_t ring{}; ring < rings; ring++)
+	{
+		for (std::uint32_t segment{}; segment < segments; segment++)
+		{
+			const auto a = vertex(ring, segment);
+			const auto b = vertex(ring, segment + 1);
+			const auto c = vertex(ring + 1, segment);
+			const auto d = vertex(ring + 1, segment + 1);
+			triangles.push_back({a, c, b});
+			triangles.push_back({b, c, d});
+		}
+	}
+	std::mt19937 random{42};
+	std::shuffle(triangles.begin(), triangles.end(), random);
+
+	std::vector<DXRVertex3D> soup{};
+	for (const auto& triangle : triangles)
+	{
+		soup.insert(soup.end(), triangle.begin(), triangle.end());
+	}
+	return soup;
+}
+
+auto ReportStats(DXRBenchmarkState& state, const std::string& label,
+				 const DXRIndexedMesh& mesh) -> void
+{
+	const auto stats = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	state.Report(label + "/acmr", stats.acmr, "");
+	state.Report(label + "/atvr", stats.atvr, "");
+}
+} // namespace
+
+// ACMR/ATVR (16 entry FIFO) after every stage of BuildIndexedMesh().
+// "welded" keeps the shuffled input order.
+DXRBENCHMARK(MeshBuilderSphere)
+{
+	const auto soup = MakeSphereSoup(128, 256);
+	const auto triangles = static_cast<double>(soup.size() / 3);
+	state.Report("unindexed/acmr", 3.0, "");
+
+	DXRIndexedMesh welded{};
+	state.Measure(
+		"weld", 5, [&] { WeldVertices(soup, welded); },
+		static_cast<double>(soup.size()), "vertices");
+	state.Report("weld/vertices", static_cast<double>(welded.vertices.size()),
+				 "");
+	ReportStats(state, "welded", welded);
+
+	auto cache = welded;
+	state.Measure(
+		"tipsify", 5,
+		[&] {
+			cache.indices = welded.indices;
+			OptimizeVertexCache(cache.indices, cache.vertices.size());
+		},
+		triangles, "triangles");
+	ReportStats(state, "tipsify", cache);
+
+	auto overdraw = cache;
+	state.Measure(
+		"overdraw", 5,
+		[&] {
+			overdraw.indices = cache.indices;
+			OptimizeOverdraw(overdraw.indices, overdraw.vertices);
+		},
+		triangles, "triangles");
+	ReportStats(state, "overdraw", overdraw);
+
+	DXRIndexedMesh built{};
+	state.Measure(
+		"build", 5, [&] { BuildIndexedMesh(soup, built); }, triangles,
+		"triangles");
+	ReportStats(state, "build", built);
+
+	std::vector<unsigned char> packed{};
+	const auto format = PackIndices(built, packed);
+	state.Report("build/indexbytes", static_cast<double>(packed.size()), "");
+	state.Report("build/16bit", format == DXRIndexFormat::UInt16 ? 1.0 : 0.0,
+				 "");
+	state.Report("soupbytes",
+				 static_cast<double>(soup.size() * sizeof(DXRVertex3D)), "");
+	state.Report("build/bytes",
+				 static_cast<double>(built.vertices.size() *
+										 sizeof(DXRVertex3D) +
+									 packed.size()),
+				 "");
+}
+
+// What the renderers draw:
+DXRBENCHMARK(MeshBuilderCube)
+{
+	const auto& mesh = GetCubeMesh();
+	state.Report("vertices", static_cast<double>(mesh.vertices.size()), "");
+	state.Report("indices", static_cast<double>(mesh.indices.size()), "");
+	ReportStats(state, "cube", mesh);
+}
@@ -0,0 +1,165 @@
+#include "DXRBenchmark.h"
+#include "DXRJobSystem.h"
+#include "DXRMipGenerator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+namespace
+{
+// 4K RGBA8 with gradients and high frequency noise, so the filters have
+// something to do:
+auto MakeTestImage(int size) -> DXRImageRGBA8
+{
+	DXRImageRGBA8 image{};
+	image.width = size;
+	image.height = size;
+	image.pixels.resize(image.GetRowPitch() * static_cast<std::size_t>(size));
+	std::uint32_t seed{12345};
+	for (std::size_t n{}; n < image.pixels.size(); n++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		const auto texel = n / 4;
+		const auto x = texel % static_cast<std::size_t>(size);
+		const auto y = texel / static_cast<std::size_t>(size);
+		const auto gradient = (x + y * (n & 3)) & 0xFF;
+		image.pixels[n] =
+			static_cast<unsigned char>((gradient + (seed >> 28)) & 0xFF);
+	}
+	return image;
+}
+
+auto MaxDifference(const std::vector<DXRImageRGBA8>& a,
+				   const std::vector<DXRImageRGBA8>& b) -> int
+{
+	int diff{};
+	for (std::size_t m{}; m < std::min(a.size(), b.size()); m++)
+	{
+		for (std::size_t n{}; n < a[m].pixels.size(); n++)
+		{
+			diff = std::max(diff, std::abs(static_cast<int>(a[m].pixels[n]) -
+										   static_cast<int>(b[m].pixels[n])));
+		}
+	}
+	return diff;
+}
+
+auto GetSIMDName(DXRMipSIMD simd) -> const char*
+{
+	switch (simd)
+	{
+	case DXRMipSIMD::Scalar:
+		return "scalar";
+	case DXRMipSIMD::SSE:
+		return "sse";
+	case DXRMipSIMD::AVX2:
+		return "avx2";
+	default:
+		return "best";
+	}
+}
+} // namespace
+
+// Full chain from a 4K base, single threaded, every kernel set.
+// maxdiff is the largest channel difference against the scalar kernels, AVX2
+// uses FMA so Kaiser may round one step differently.
+DXRBENCHMARK(MipGenerator4K)
+{
+	const auto base = MakeTestImage(4096);
+	const auto texels = 4096.0 * 4096.0;
+
+	const DXRMipFilter filters[]{DXRMipFilter::Box, DXRMipFilter::Kaiser};
+	for (const auto filter : filters)
+	{
+		for (const auto srgb : {false, true})
+		{
+			const auto prefix =
+				std::string{filter == DXRMipFilter::Box ? "box" : "kaiser"} +
+				(srgb ? "/srgb" : "");
+
+			std::vector<DXRImageRGBA8> reference{};
+			for (auto simd{DXRMipSIMD::Scalar}; simd <= GetBestMipSIMD();
+				 simd = static_cast<DXRMipSIMD>(static_cast<int>(simd) + 1))
+			{
+				DXRMipGeneratorDesc desc{};
+				desc.filter = filter;
+				desc.srgb = srgb;
+				desc.simd = simd;
+				desc.threadCount = 1;
+
+				std::vector<DXRImageRGBA8> mips{};
+				const auto label = prefix + "/" + GetSIMDName(simd);
+				state.Measure(
+					label, 3,
+					[&] { GenerateMipChainRGBA8(base, mips, desc); }, texels,
+					"texels");
+				if (simd == DXRMipSIMD::Scalar)
+				{
+					reference = std::move(mips);
+				}
+				else
+				{
+					state.Report(label + "/maxdiff",
+								 MaxDifference(reference, mips), "");
+				}
+			}
+		}
+	}
+}
+
+// Best kernels, 1..N threads, then every core through a job system (what
+// the renderer does):
+DXRBENCHMARK(MipGenerator4KThreads)
+{
+	const auto base = MakeTestImage(4096);
+	const auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<DXRImageRGBA8> reference{};
+	for (std::uint32_t threads{1}; threads <= maxThreads; threads *= 2)
+	{
+		DXRMipGeneratorDesc desc{};
+		desc.filter = DXRMipFilter::Kaiser;
+		desc.threadCount = threads;
+
+		state.Measure(
+			"kaiser/" + std::to_string(threads) + "threads", 3,
+			[&] { GenerateMipChainRGBA8(base, reference, desc); },
+			4096.0 * 4096.0, "texels");
+	}
+
+	DXRJobSystem jobs{};
+	DXRMipGeneratorDesc desc{};
+	desc.filter = DXRMipFilter::Kaiser;
+	desc.jobs = &jobs;
+	std::vector<DXRImageRGBA8> mips{};
+	state.Measure(
+		"kaiser/jobs", 3, [&] { GenerateMipChainRGBA8(base, mips, desc); },
+		4096.0 * 4096.0, "texels");
+	state.Report("kaiser/jobs/maxdiff", MaxDifference(reference, mips), "");
+}
+
+// Float chain, 2K (a 4K RGBA32F base alone is 256MB):
+DXRBENCHMARK(MipGeneratorFloat)
+{
+	const auto bytes = MakeTestImage(2048);
+	DXRImageRGBA32F base{};
+	base.width = bytes.width;
+	base.height = bytes.height;
+	base.pixels.resize(bytes.pixels.size());
+	std::transform(bytes.pixels.begin(), bytes.pixels.end(),
+				   base.pixels.begin(), [](unsigned char c) {
+					   return static_cast<float>(c) / 255.f;
+				   });
+
+	DXRMipGeneratorDesc desc{};
+	desc.threadCount = 1;
+	for (const auto filter : {DXRMipFilter::Box, DXRMipFilter::Kaiser})
+	{
+		desc.filter = filter;
+		std::vector<DXRImageRGBA32F> mips{};
+		state.Measure(filter == DXRMipFilter::Box ? "box" : "kaiser", 3,
+					  [&] { GenerateMipChainRGBA32F(base, mips, desc); },
+					  2048.0 * 2048.0, "texels");
+	}
+}
@@ -0,0 +1,218 @@
+#include "DXRBenchmark.h"
+#include "DXRHeadlessRenderer.h"
+#include "DXRObjectLifetime.h"
+
+#include <array>
+#include <memory>
+
+namespace
+{
+// DXRWindowRenderer's objects and dependencies, the 2D ones included:
+enum struct MockObject : std::uint32_t
+{
+	FactoryAndAdapter,
+	DeviceAndSwapChain,
+	SwapChainSize,
+	Heaps,
+	RenderTargets,
+	CommandAllocators,
+	CommandList,
+	Fence,
+	UploadRing,
+	InstanceBuffers,
+	RootSignature,
+	PipelineState,
+	DepthBuffer,
+	D3D11On12DeviceAndContext,
+	D2DFactory,
+	D2DDeviceAndContext,
+	D2DBrushes,
+	D2D1RenderTargets,
+	RenderingAssets,
+	Count,
+};
+
+auto MakeMockLifetime() -> DXRObjectLifetime<MockObject>
+{
+	using Object = MockObject;
+	DXRObjectLifetime<MockObject> objects{};
+	objects.DependsOn(Object::DeviceAndSwapChain, {Object::FactoryAndAdapter});
+	objects.DependsOn(Object::SwapChainSize, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::Heaps, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::RenderTargets,
+					  {Object::SwapChainSize, Object::Heaps});
+	objects.DependsOn(Object::CommandAllocators, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::CommandList, {Object::CommandAllocators});
+	objects.DependsOn(Object::Fence, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::UploadRing, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::InstanceBuffers, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::RootSignature, {Object::DeviceAndSwapChain});
+	objects.DependsOn(Object::PipelineState, {Object::RootSignature});
+	objects.DependsOn(Object::DepthBuffer,
+					  {Object::SwapChainSize, Object::Heaps});
+	objects.DependsOn(Object::D3D11On12DeviceAndContext,
+					  {Object::SwapChainSize, Object::CommandList});
+	objects.DependsOn(Object::D2DFactory, {Object::SwapChainSize});
+	objects.DependsOn(Object::D2DDeviceAndContext,
+					  {Object::D3D11On12DeviceAndContext, Object::D2DFactory});
+	objects.DependsOn(Object::D2DBrushes, {Object::D2DDeviceAndContext});
+	objects.DependsOn(Object::D2D1RenderTargets,
+					  {Object::RenderTargets, Object::D2DDeviceAndContext});
+	objects.DependsOn(Object::RenderingAssets,
+					  {Object::Heaps, Object::CommandList, Object::Fence,
+					   Object::UploadRing});
+	return objects;
+}
+
+// Stands in for the renderer's COM pointers: the old Create*() functions
+// each returned early when their pointers were set, a few per object.
+struct MockRenderer
+{
+	static inline constexpr std::uint32_t k_Count{
+		static_cast<std::uint32_t>(MockObject::Count)};
+	static inline constexpr std::uint32_t k_PointersPerObject{4};
+
+	std::array<std::array<std::unique_ptr<int>, k_PointersPerObject>, k_Count>
+		pointers{};
+	std::uint64_t creates{};
+
+	[[gnu::noinline]] auto Create(MockObject object) -> bool
+	{
+		auto& set = pointers[static_cast<std::uint32_t>(object)];
+		for (auto& pointer : set)
+		{
+			if (!pointer)
+			{
+				pointer = std::make_unique<int>();
+				creates++;
+			}
+		}
+		return true;
+	}
+
+	auto Release(MockObject object) -> void
+	{
+		for (auto& pointer : pointers[static_cast<std::uint32_t>(object)])
+		{
+			pointer.reset();
+		}
+	}
+};
+} // namespace
+
+// Per frame cost of making sure every device object exists: the old walk
+// through every Create*() against the tracked IsClean() check, and what a
+// resize and a device loss rebuild. errors counts objects rebuilt outside
+// the expected set and objects missing afterwards.
+DXRBENCHMARK(ObjectLifetime)
+{
+	MockRenderer renderer{};
+	auto objects = MakeMockLifetime();
+	const auto create = [&](MockObject object) {
+		return renderer.Create(object);
+	};
+	std::uint64_t errors{};
+	errors += !objects.Rebuild(create);
+	errors += !objects.IsClean();
+
+	constexpr std::uint32_t k_Frames{10000};
+	state.Measure(
+		"validateall", 100,
+		[&] {
+			for (std::uint32_t frame{}; frame < k_Frames; frame++)
+			{
+				for (std::uint32_t n{}; n < MockRenderer::k_Count; n++)
+				{
+					errors += !renderer.Create(static_cast<MockObject>(n));
+				}
+			}
+		},
+		k_Frames, "frames");
+	state.Measure(
+		"tracked", 100,
+		[&] {
+			for (std::uint32_t frame{}; frame < k_Frames; frame++)
+			{
+				if (!objects.IsClean())
+					errors += !objects.Rebuild(create);
+			}
+		},
+		k_Frames, "frames");
+	errors += renderer.creates != MockRenderer::k_Count *
+									  MockRenderer::k_PointersPerObject;
+
+	// A resize releases what depends on the size, and only that comes back:
+	const auto resized = objects.GetDependentMask(MockObject::SwapChainSize);
+	for (std::uint32_t n{}; n < MockRenderer::k_Count; n++)
+	{
+		if (resized & (std::uint64_t{1} << n))
+			renderer.Release(static_cast<MockObject>(n));
+	}
+	auto rebuilds = objects.GetRebuildCount();
+	auto creates = renderer.creates;
+	objects.Invalidate(MockObject::SwapChainSize);
+	errors += !objects.Rebuild(create);
+	const auto resizeRebuilds = objects.GetRebuildCount() - rebuilds;
+	state.Report("resize/rebuilt", static_cast<double>(resizeRebuilds), "");
+	errors +=
+		resizeRebuilds != static_cast<std::uint64_t>(std::popcount(resized));
+	errors += renderer.creates - creates !=
+			  resizeRebuilds * MockRenderer::k_PointersPerObject;
+	// The assets and the pipeline have nothing to do with the size:
+	using Lifetime = decltype(objects);
+	errors += (resized & Lifetime::GetMask(MockObject::RenderingAssets)) != 0;
+	errors += (resized & Lifetime::GetMask(MockObject::PipelineState)) != 0;
+
+	// A device loss rebuilds everything:
+	for (std::uint32_t n{}; n < MockRenderer::k_Count; n++)
+	{
+		renderer.Release(static_cast<MockObject>(n));
+	}
+	rebuilds = objects.GetRebuildCount();
+	creates = renderer.creates;
+	objects.InvalidateAll();
+	errors += !objects.Rebuild(create);
+	const auto lostRebuilds = objects.GetRebuildCount() - rebuilds;
+	state.Report("devicelost/rebuilt", static_cast<double>(lostRebuilds), "");
+	errors += lostRebuilds != MockRenderer::k_Count;
+	errors += renderer.creates - creates !=
+			  MockRenderer::k_Count * MockRenderer::k_PointersPerObject;
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
+
+// The headless renderer's steady frames rebuild nothing, a resize rebuilds
+// the framebuffer only and an asset reload the texture only.
+DXRBENCHMARK(HeadlessObjectLifetime)
+{
+	// Resizes apply on the next frame:
+	DXRHeadlessRenderer renderer{640, 360, 0, {0.0, 0.0}};
+	const auto cam = CameraManager::GetInstance();
+	const auto frame = [&] {
+		renderer.DispatchEvents();
+		renderer.Update(1.f / 60.f);
+		cam->Update(1.f / 60.f);
+		renderer.Render();
+	};
+	std::uint64_t errors{};
+	frame();
+	auto rebuilds = renderer.GetRebuildCount();
+	state.Measure("steady", 100, frame);
+	errors += renderer.GetRebuildCount() != rebuilds;
+
+	renderer.GetWindow()->SetSize(800, 450);
+	frame();
+	const auto resizeRebuilds = renderer.GetRebuildCount() - rebuilds;
+	state.Report("resize/rebuilt", static_cast<double>(resizeRebuilds), "");
+	errors += resizeRebuilds != 2;
+	errors += renderer.GetRasterizer()->GetWidth() != 800;
+
+	rebuilds = renderer.GetRebuildCount();
+	renderer.ReloadRenderingAssets();
+	frame();
+	const auto reloadRebuilds = renderer.GetRebuildCount() - rebuilds;
+	state.Report("reload/rebuilt", static_cast<double>(reloadRebuilds), "");
+	errors += reloadRebuilds != 1;
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
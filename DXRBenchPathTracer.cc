@@ -0,0 +1,250 @@
+#include "DXRBenchmark.h"
+#include "CameraManager.h"
+#include "DXRAssets.h"
+#include "DXRInstancePacker.h"
+#include "DXRJobSystem.h"
+#include "DXRPathTracer.h"
+#include "DXRSoftwareRasterizer.h"
+#include "DXRTextureContainer.h"
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace
+{
+// Bottom levels for meshes, for the best kernels this CPU runs:
+auto BuildMeshes(std::span<const DXRIndexedMesh> meshes,
+				 std::vector<DXRRayScene>& out) -> std::uint64_t
+{
+	std::uint64_t errors{};
+	out.resize(meshes.size());
+	for (std::size_t n{}; n < meshes.size(); n++)
+	{
+		DXRBvh bvh{};
+		errors += !BuildBvh(meshes[n], bvh);
+		errors += !BuildRayScene(bvh, meshes[n].vertices, meshes[n].indices,
+								 out[n]);
+	}
+	return errors;
+}
+
+// Top-down RGBA8 color buffer to a bottom-up float image:
+auto ToImage(const DXRSoftwareRasterizer& rasterizer) -> DXRImageRGBA32F
+{
+	DXRImageRGBA32F image{};
+	const std::size_t width{rasterizer.GetWidth()};
+	const std::size_t height{rasterizer.GetHeight()};
+	image.width = static_cast<int>(width);
+	image.height = static_cast<int>(height);
+	image.pixels.resize(width * height * 4);
+	const auto& color = rasterizer.GetColorBuffer();
+	for (std::size_t y{}; y < height; y++)
+	{
+		const auto row = height - 1 - y;
+		for (std::size_t x{}; x < width; x++)
+		{
+			const auto texel = color[y * width + x];
+			for (std::size_t channel{}; channel < 4; channel++)
+			{
+				image.pixels[(row * width + x) * 4 + channel] =
+					static_cast<float>((texel >> (channel * 8)) & 0xFF) /
+					255.f;
+			}
+		}
+	}
+	return image;
+}
+} // namespace
+
+// The cube LoadRenderingAssets draws, from CameraManager's camera:
+// - against DXRSoftwareRasterizer: under a plain sky, camera rays through
+//   pixel centres, a convex mesh is exactly its texture, so one sample has to
+//   match the raster image (raster/differing counts pixels off by more than
+//   the 8 bit rounding, texels that flip where the two interpolate UVs
+//   differently). The image goes through a .dxrt file and back like a golden
+//   image would.
+// - lit by sun and sky on a ground plane with a few more cubes: error
+//   against a 256 sample reference after 4, 16 and 64 samples for the blue
+//   noise and white noise samplers, and the noise estimate GetStats() makes.
+// - Msamples/s (paths per second) for 1, 2, 4... job threads.
+// errors counts raster mismatches past 0.5% of the pixels, a golden image
+// that doesn't survive the round trip and blue noise ending up worse than
+// white noise.
+DXRBENCHMARK(PathTracer)
+{
+	std::uint64_t errors{};
+	DXRJobSystem jobs{};
+	state.Report("threads", jobs.GetThreadCount(), "");
+
+	// The embedded PNG, not whatever SNIFF.dxrt the working directory has.
+	// raster/differing counts texel flips, and BC7 noise adds texel edges:
+	DXRImageRGBA8 texture{};
+	if (!DecodeImageRGBA8(GetEmbeddedTextureData(), GetEmbeddedTextureSize(),
+						  texture))
+		return;
+	const DXRIndexedMesh meshes[]{GetCubeMesh(), GetGroundMesh()};
+	std::vector<DXRRayScene> scenes{};
+	errors += BuildMeshes(meshes, scenes);
+
+	constexpr std::uint32_t k_Width{640};
+	constexpr std::uint32_t k_Height{360};
+	CameraManager camera{};
+	camera.SetAspectRatio(static_cast<float>(k_Width) /
+						  static_cast<float>(k_Height));
+	camera.Update(0.5f);
+
+	// Raster reference, one identity instance like DXRHeadlessRenderer:
+	std::vector<DXRInstanceData> cube(1);
+	PackInstances(std::vector<DXRInstance>(1), cube);
+	DXRSoftwareRasterizer rasterizer{};
+	rasterizer.Resize(k_Width, k_Height);
+	const float clear[4]{};
+	rasterizer.Clear(clear);
+	rasterizer.SetTexture(&texture);
+	DXRGraphicsConstants constants{};
+	constants.projection = camera.GetProjectionMatrix();
+	constants.view = camera.GetViewMatrix();
+	constants.model = glm::mat4{1.f};
+	rasterizer.DrawIndexedInstanced(meshes[0].vertices, meshes[0].indices, cube,
+									constants);
+	rasterizer.Execute();
+	const auto raster = ToImage(rasterizer);
+
+	{
+		DXRRayTopLevel topLevel{};
+		topLevel.Update(scenes, cube);
+		DXRPathTracerDesc desc{};
+		desc.jitter = false;
+		DXRPathTracer tracer{desc};
+		tracer.Resize(k_Width, k_Height);
+		tracer.SetScene(&topLevel, meshes, &texture);
+		tracer.SetCamera(camera.GetViewMatrix(), camera.GetProjectionMatrix());
+		state.Measure(
+			"unlit/frame", 3,
+			[&] {
+				tracer.Reset();
+				tracer.RenderFrame(&jobs);
+			},
+			k_Width * k_Height, "samples");
+		DXRImageRGBA32F traced{};
+		tracer.Resolve(traced);
+		const auto difference = CompareImages(raster, traced, 1.5f / 255.f);
+		state.Report("raster/rmse", difference.rmse, "");
+		state.Report("raster/differing",
+					 static_cast<double>(difference.differingPixels), "pixels");
+		errors += difference.differingPixels * 200 > k_Width * k_Height;
+
+		// Golden image round trip:
+		std::vector<unsigned char> cooked{};
+		errors += !CookTextureContainer({&traced, 1}, cooked);
+		const auto path =
+			(std::filesystem::temp_directory_path() / "DXRBenchPathTracer.dxrt")
+				.string();
+		errors += !WriteTextureContainer(path.c_str(), cooked);
+		DXRTextureContainer container{};
+		DXRImageRGBA32F golden{};
+		errors += !container.Open(path.c_str()) ||
+				  !CopyTextureContainerMip(container, 0, golden);
+		errors += golden.pixels != traced.pixels;
+		container.Close();
+		std::filesystem::remove(path);
+	}
+
+	// Lit scene: the cube, the ground and four smaller cubes around it:
+	std::vector<DXRInstance> instances(6);
+	std::vector<std::uint32_t> instanceMeshes{0, 1, 0, 0, 0, 0};
+	for (std::uint32_t n{2}; n < 6; n++)
+	{
+		const auto angle = static_cast<float>(n) * 1.5707963f;
+		instances[n].scale = 0.4f;
+		instances[n].position = {std::cos(angle) * 2.2f, -0.6f,
+								 std::sin(angle) * 2.2f};
+	}
+	std::vector<DXRInstanceData> packed(instances.size());
+	PackInstances(instances, packed);
+	DXRRayTopLevel topLevel{};
+	topLevel.Update(scenes, packed, instanceMeshes);
+
+	constexpr std::uint32_t k_LitWidth{256};
+	constexpr std::uint32_t k_LitHeight{144};
+	DXRPathTracerDesc lit{};
+	lit.skyRadiance = {0.3f, 0.4f, 0.6f};
+	lit.sunIrradiance = glm::vec3{2.5f};
+	const auto makeTracer = [&](const DXRPathTracerDesc& desc) {
+		auto tracer = std::make_unique<DXRPathTracer>(desc);
+		tracer->Resize(k_LitWidth, k_LitHeight);
+		tracer->SetScene(&topLevel, meshes, &texture);
+		tracer->SetCamera(camera.GetViewMatrix(),
+						  camera.GetProjectionMatrix());
+		return tracer;
+	};
+
+	// White noise with a seed of its own, correlated with neither sampler:
+	DXRImageRGBA32F reference{};
+	{
+		auto desc = lit;
+		desc.sampler = DXRPathTracerSampler::White;
+		desc.seed = 1;
+		auto tracer = makeTracer(desc);
+		for (std::uint32_t n{}; n < 256; n++)
+		{
+			tracer->RenderFrame(&jobs);
+		}
+		tracer->Resolve(reference);
+		state.Report("reference/relativenoise",
+					 tracer->GetStats().relativeNoise, "");
+	}
+
+	float blueError{};
+	float whiteError{};
+	for (const auto sampler :
+		 {DXRPathTracerSampler::BlueNoise, DXRPathTracerSampler::White})
+	{
+		const std::string name =
+			sampler == DXRPathTracerSampler::BlueNoise ? "blue" : "white";
+		auto desc = lit;
+		desc.sampler = sampler;
+		auto tracer = makeTracer(desc);
+		for (const auto samples : {4u, 16u, 64u})
+		{
+			while (tracer->GetStats().samples < samples)
+			{
+				tracer->RenderFrame(&jobs);
+			}
+			DXRImageRGBA32F image{};
+			tracer->Resolve(image);
+			const auto label = name + "/" + std::to_string(samples) + "spp";
+			const auto rmse = CompareImages(reference, image).rmse;
+			state.Report(label + "/rmse", rmse, "");
+			state.Report(label + "/relativenoise",
+						 tracer->GetStats().relativeNoise, "");
+			(sampler == DXRPathTracerSampler::BlueNoise ? blueError
+														: whiteError) +=
+				rmse;
+		}
+	}
+	errors += blueError > whiteError;
+
+	// Scaling, job systems with 1, 2, 4... threads:
+	const auto hardware = std::max(std::thread::hardware_concurrency(), 1u);
+	for (std::uint32_t threads{1}; threads <= hardware; threads *= 2)
+	{
+		std::unique_ptr<DXRJobSystem> scaling{};
+		if (threads > 1)
+		{
+			DXRJobSystemDesc jobsDesc{};
+			jobsDesc.workerCount = threads - 1;
+			scaling = std::make_unique<DXRJobSystem>(jobsDesc);
+		}
+		auto tracer = makeTracer(lit);
+		state.Measure(
+			std::to_string(threads) + "threads/frame", 8,
+			[&] { tracer->RenderFrame(scaling.get()); },
+			k_LitWidth * k_LitHeight, "samples");
+	}
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
@@ -0,0 +1,227 @@
+#include "DXRBenchmark.h"
+#include "DXRPipelineRegistry.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace
+{
+// Stands in for the driver: some work per pipeline, the result remembers
+// its key so lookups can be checked.
+struct StubPipelineFactory
+{
+	struct Pipeline
+	{
+		std::uint64_t hash{};
+		std::uint64_t work{};
+	};
+
+	std::atomic<std::uint64_t>* calls{};
+	std::uint32_t work{};
+
+	auto Create(const DXRPipelineKey& key, Pipeline& out) -> bool
+	{
+		if (calls)
+			calls->fetch_add(1, std::memory_order_relaxed);
+		out.hash = GetPipelineKeyHash(key);
+		out.work = out.hash;
+		for (std::uint32_t n{}; n < work; n++)
+		{
+			out.work = (out.work ^ (out.work >> 31)) * 0x9E3779B97F4A7C15ull;
+		}
+		return true;
+	}
+};
+
+// Every combination of a few shaders and states, what a renderer with
+// a handful of materials and passes ends up with:
+auto GenerateKeys() -> std::vector<DXRPipelineKey>
+{
+	std::vector<DXRPipelineKey> keys{};
+	const DXRPipelineFormat colorFormats[]{DXRPipelineFormat::RGBA8Unorm,
+										   DXRPipelineFormat::RGBA16Float};
+	for (std::uint64_t shader{}; shader < 16; shader++)
+	{
+		for (std::uint8_t blend{}; blend < 4; blend++)
+		{
+			for (std::uint8_t cull{}; cull < 3; cull++)
+			{
+				for (std::uint8_t depth{}; depth < 4; depth++)
+				{
+					for (const auto format : colorFormats)
+					{
+						DXRPipelineKey key{};
+						key.vertexShader = 0x1000 + shader / 4;
+						key.pixelShader = 0x2000 + shader;
+						key.renderTargetCount = 1;
+						key.renderTargetFormats[0] = format;
+						key.depthFormat = DXRPipelineFormat::D32Float;
+						key.blend = static_cast<DXRBlendMode>(blend);
+						key.cull = static_cast<DXRCullMode>(cull);
+						key.depth = static_cast<DXRDepthMode>(depth);
+						key.vertexLayout = DXRVertexLayout::Quantized;
+						keys.push_back(key);
+					}
+				}
+			}
+		}
+	}
+	return keys;
+}
+} // namespace
+
+// Key hashing and lookups of known keys (the per draw cost), and how many
+// distinct 64-bit hashes the generated keys get.
+DXRBENCHMARK(PipelineKeyLookup)
+{
+	const auto keys = GenerateKeys();
+	const auto count = static_cast<double>(keys.size());
+	state.Report("keys", count, "");
+
+	std::uint64_t sink{};
+	state.Measure(
+		"hash", 1000,
+		[&] {
+			for (const auto& key : keys)
+			{
+				sink += GetPipelineKeyHash(key);
+			}
+		},
+		count, "keys");
+
+	std::vector<std::uint64_t> hashes{};
+	for (const auto& key : keys)
+	{
+		hashes.push_back(GetPipelineKeyHash(key));
+	}
+	std::ranges::sort(hashes);
+	const auto distinct = std::ranges::unique(hashes).begin() - hashes.begin();
+	state.Report("distincthashes", static_cast<double>(distinct), "");
+
+	DXRPipelineRegistry<StubPipelineFactory> registry{{}};
+	for (const auto& key : keys)
+	{
+		registry.Request(key);
+	}
+	// Random order, so the table isn't walked front to back:
+	std::vector<std::uint32_t> order(1 << 16);
+	std::mt19937 random{3};
+	for (auto& index : order)
+	{
+		index = static_cast<std::uint32_t>(random() % keys.size());
+	}
+	std::uint64_t errors{};
+	state.Measure(
+		"request", 20,
+		[&] {
+			for (const auto index : order)
+			{
+				const auto handle = registry.Request(keys[index]);
+				errors += handle.index != index;
+			}
+		},
+		static_cast<double>(order.size()), "lookups");
+	state.Measure(
+		"get", 20,
+		[&] {
+			for (const auto index : order)
+			{
+				sink += registry.Get({index})->hash;
+			}
+		},
+		static_cast<double>(order.size()), "lookups");
+	state.Report("errors", static_cast<double>(errors), "");
+	if (!sink)
+		state.Report("sink", 0.0, "");
+}
+
+// Creating every pipeline of the set up front, on the requesting thread and
+// on the job system; duplicate requests must not create anything twice.
+DXRBENCHMARK(PipelineRegistryCreate)
+{
+	const auto keys = GenerateKeys();
+	const auto count = static_cast<double>(keys.size());
+	std::uint64_t errors{};
+
+	const auto run = [&](DXRJobSystem* jobs) {
+		std::atomic<std::uint64_t> calls{};
+		DXRPipelineRegistry<StubPipelineFactory> registry{{&calls, 20000},
+														  jobs};
+		std::vector<DXRPipelineHandle> handles{};
+		// Every key twice, the second round only finds them:
+		for (int round{}; round < 2; round++)
+		{
+			for (const auto& key : keys)
+			{
+				handles.push_back(registry.Request(key));
+			}
+		}
+		for (std::size_t n{}; n < keys.size(); n++)
+		{
+			const auto pipeline = registry.Wait(handles[n]);
+			errors += !pipeline ||
+					  pipeline->hash != GetPipelineKeyHash(keys[n]) ||
+					  handles[n].index != handles[n + keys.size()].index;
+		}
+		errors += calls != keys.size();
+		errors += registry.GetStats().shared != keys.size();
+	};
+
+	state.Measure("inline", 3, [&] { run(nullptr); }, count, "pipelines");
+
+	DXRJobSystem jobs{};
+	const auto label = std::to_string(jobs.GetThreadCount()) + "t";
+	state.Measure(label, 3, [&] { run(&jobs); }, count, "pipelines");
+	state.Report("errors", static_cast<double>(errors), "");
+}
+
+// Threads outside the job system (loaders, render threads) requesting and
+// waiting for the same keys at once, each in its own order: every Wait()
+// has to return the pipeline, however far along its creation is.
+DXRBENCHMARK(PipelineRegistryShared)
+{
+	const auto keys = GenerateKeys();
+	const auto count = static_cast<double>(keys.size());
+	const auto threadCount =
+		std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+	std::atomic<std::uint64_t> errors{};
+
+	const auto run = [&](DXRJobSystem* jobs) {
+		std::atomic<std::uint64_t> calls{};
+		DXRPipelineRegistry<StubPipelineFactory> registry{{&calls, 20000},
+														  jobs};
+		{
+			std::vector<std::jthread> threads{};
+			for (std::uint32_t t{}; t < threadCount; t++)
+			{
+				threads.emplace_back([&, t] {
+					std::vector<std::size_t> order(keys.size());
+					for (std::size_t n{}; n < order.size(); n++)
+					{
+						order[n] = n;
+					}
+					std::ranges::shuffle(order, std::mt19937{t});
+					for (const auto n : order)
+					{
+						const auto pipeline =
+							registry.Wait(registry.Request(keys[n]));
+						if (!pipeline ||
+							pipeline->hash != GetPipelineKeyHash(keys[n]))
+							errors.fetch_add(1, std::memory_order_relaxed);
+					}
+				});
+			}
+		}
+		errors += calls != keys.size();
+	};
+
+	state.Report("threads", static_cast<double>(threadCount), "");
+	state.Measure("inline", 3, [&] { run(nullptr); }, count, "pipelines");
+
+	DXRJobSystem jobs{};
+	const auto label = std::to_string(jobs.GetThreadCount()) + "t";
+	state.Measure(label, 3, [&] { run(&jobs); }, count, "pipelines");
+	state.Report("errors", static_cast<double>(errors.load()), "");
+}
@@ -0,0 +1,283 @@
+#include "DXRBenchmark.h"
+#include "CameraManager.h"
+#include "DXRAssets.h"
+#include "DXRJobSystem.h"
+#include "DXRRayQuery.h"
+
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <string>
+
+namespace
+{
+// The renderer's cube at the origin, where CameraManager looks, on a rolling
+// ground plane littered with smaller copies of it.
+auto MakeScene(std::uint32_t grid, std::uint32_t cubes) -> DXRIndexedMesh
+{
+	DXRIndexedMesh mesh{};
+	const auto height = [](float x, float z) {
+		return -2.f + 0.5f * std::sin(x * 0.3f) * std::cos(z * 0.4f);
+	};
+	const auto addCube = [&](const glm::vec3& center, float scale) {
+		const auto& cube = GetCubeMesh();
+		const auto base = static_cast<std::uint32_t>(mesh.vertices.size());
+		for (auto vertex : cube.vertices)
+		{
+			vertex.x = center.x + vertex.x * scale;
+			vertex.y = center.y + vertex.y * scale;
+			vertex.z = center.z + vertex.z * scale;
+			mesh.vertices.push_back(vertex);
+		}
+		for (const auto index : cube.indices)
+		{
+			mesh.indices.push_back(base + index);
+		}
+	};
+
+	// Half a unit apart:
+	const auto extent = static_cast<float>(grid) * 0.25f;
+	const auto base = static_cast<std::uint32_t>(mesh.vertices.size());
+	for (std::uint32_t z{}; z <= grid; z++)
+	{
+		for (std::uint32_t x{}; x <= grid; x++)
+		{
+			const auto fx = static_cast<float>(x) * 0.5f - extent;
+			const auto fz = static_cast<float>(z) * 0.5f - extent;
+			mesh.vertices.push_back(DXRVertex3D{
+				fx, height(fx, fz), fz, 0.f, 1.f, 0.f, 0.f, 0.f, 0xFFFFFFFF});
+		}
+	}
+	for (std::uint32_t z{}; z < grid; z++)
+	{
+		for (std::uint32_t x{}; x < grid; x++)
+		{
+			const auto a = base + z * (grid + 1) + x;
+			const auto b = a + 1;
+			const auto c = a + grid + 1;
+			const auto d = c + 1;
+			mesh.indices.insert(mesh.indices.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	addCube({}, 1.f);
+	std::mt19937 random{5};
+	std::uniform_real_distribution<float> position{-extent, extent};
+	std::uniform_real_distribution<float> size{0.05f, 0.4f};
+	for (std::uint32_t n{}; n < cubes; n++)
+	{
+		const auto x = position(random);
+		const auto z = position(random);
+		const auto scale = size(random);
+		addCube({x, height(x, z) + scale, z}, scale);
+	}
+	return mesh;
+}
+
+// One ray per pixel through CameraManager's view, rows of 8 pixels next to
+// each other so consecutive rays are neighbours:
+auto MakeCameraRays(const CameraManager& camera, std::uint32_t width,
+					std::uint32_t height) -> std::vector<DXRRay>
+{
+	std::vector<DXRRay> rays{};
+	rays.reserve(std::size_t{width} * height);
+	for (std::uint32_t y{}; y < height; y++)
+	{
+		for (std::uint32_t x{}; x < width; x++)
+		{
+			const glm::vec2 ndc{
+				(static_cast<float>(x) + 0.5f) / static_cast<float>(width) *
+						2.f -
+					1.f,
+				1.f - (static_cast<float>(y) + 0.5f) /
+						  static_cast<float>(height) * 2.f};
+			rays.push_back(MakeCameraRay(camera.GetViewMatrix(),
+										 camera.GetProjectionMatrix(), ndc));
+		}
+	}
+	return rays;
+}
+
+// Random origins above the ground, random directions: what diffuse bounces
+// look like to the traversal.
+auto MakeRandomRays(std::uint32_t count, float extent) -> std::vector<DXRRay>
+{
+	std::mt19937 random{17};
+	std::uniform_real_distribution<float> position{-extent, extent};
+	std::uniform_real_distribution<float> height{-1.5f, 2.f};
+	std::uniform_real_distribution<float> unit{0.f, 1.f};
+	std::vector<DXRRay> rays(count);
+	for (auto& ray : rays)
+	{
+		ray.origin = {position(random), height(random), position(random)};
+		const auto z = unit(random) * 2.f - 1.f;
+		const auto phi = unit(random) * 2.f * std::numbers::pi_v<float>;
+		const auto r = std::sqrt(1.f - z * z);
+		ray.direction = {r * std::cos(phi), r * std::sin(phi), z};
+	}
+	return rays;
+}
+
+auto GetSIMDName(DXRRaySIMD simd) -> const char*
+{
+	switch (simd)
+	{
+	case DXRRaySIMD::SSE:
+		return "sse";
+	case DXRRaySIMD::AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+} // namespace
+
+// Mrays/s for camera (coherent) and random (incoherent) rays, one at a time
+// and as sorted packet streams, per SIMD level and on the job system.
+// errors counts rays whose closest hit differs between kernels or query
+// paths, any hits that aren't hits and occlusion that disagrees with them,
+// and a centre-of-screen pick that misses the cube. referencediffs is
+// closest hits that differ from IntersectBvh's Möller-Trumbore test, which
+// can slip through shared edges.
+DXRBENCHMARK(RayQuery)
+{
+	std::uint64_t errors{};
+	constexpr std::uint32_t k_Grid{256};
+	const auto scene = MakeScene(k_Grid, 4096);
+	state.Report("triangles", static_cast<double>(scene.indices.size() / 3),
+				 "");
+
+	DXRJobSystem jobs{};
+	DXRBvh bvh{};
+	errors += !BuildBvh(scene, bvh, {}, &jobs);
+
+	CameraManager camera{};
+	camera.Update(0.5f);
+	const auto coherent = MakeCameraRays(camera, 640, 360);
+	const auto incoherent =
+		MakeRandomRays(static_cast<std::uint32_t>(coherent.size()),
+					   static_cast<float>(k_Grid) * 0.25f);
+	const auto rayCount = static_cast<double>(coherent.size());
+
+	// Reference results from the scalar kernels:
+	DXRRayScene reference{};
+	errors += !BuildRayScene(bvh, scene.vertices, scene.indices, reference,
+							 DXRRaySIMD::Scalar);
+	std::vector<DXRRayHit> coherentHits(coherent.size());
+	std::vector<DXRRayHit> incoherentHits(incoherent.size());
+	DXRRayStreamDesc single{};
+	single.packets = false;
+	state.Report("coherent/hits",
+				 TraceRays(reference, coherent, coherentHits, single), "");
+	state.Report("incoherent/hits",
+				 TraceRays(reference, incoherent, incoherentHits, single), "");
+
+	std::uint32_t referenceDiffs{};
+	for (std::size_t n{}; n < incoherent.size(); n += 64)
+	{
+		DXRRayHit hit{};
+		const auto hitBvh = IntersectBvh(bvh, scene.vertices, scene.indices,
+										 incoherent[n], hit);
+		referenceDiffs +=
+			hitBvh != (incoherentHits[n].triangle != ~0u) ||
+			(hitBvh && std::abs(hit.t - incoherentHits[n].t) > 1e-4f * hit.t);
+	}
+	state.Report("referencediffs", referenceDiffs, "");
+
+	const auto compare = [&](const std::vector<DXRRayHit>& hits,
+							 const std::vector<DXRRayHit>& expected) {
+		std::uint64_t diffs{};
+		for (std::size_t n{}; n < hits.size(); n++)
+		{
+			diffs += (hits[n].triangle != ~0u) !=
+						 (expected[n].triangle != ~0u) ||
+					 hits[n].t != expected[n].t;
+		}
+		return diffs;
+	};
+
+	const auto best = GetBestRaySIMD();
+	for (const auto simd :
+		 {DXRRaySIMD::Scalar, DXRRaySIMD::SSE, DXRRaySIMD::AVX2})
+	{
+		if (simd > best)
+			continue;
+		DXRRayScene rayScene{};
+		errors += !BuildRayScene(bvh, scene.vertices, scene.indices, rayScene,
+								 simd);
+		const std::string name = GetSIMDName(simd);
+		std::vector<DXRRayHit> hits(coherent.size());
+
+		DXRRayStreamDesc packets{};
+		for (const auto& [label, rays, expected] :
+			 {std::tuple{"coherent", &coherent, &coherentHits},
+			  std::tuple{"incoherent", &incoherent, &incoherentHits}})
+		{
+			state.Measure(
+				name + "/" + label + "/single", 3,
+				[&] { TraceRays(rayScene, *rays, hits, single); }, rayCount,
+				"rays");
+			errors += compare(hits, *expected);
+			state.Measure(
+				name + "/" + label + "/packets", 3,
+				[&] { TraceRays(rayScene, *rays, hits, packets); }, rayCount,
+				"rays");
+			errors += compare(hits, *expected);
+		}
+
+		// Shadow-ray style queries on the random rays:
+		DXRRayStreamDesc occlusion{};
+		occlusion.type = DXRRayQueryType::Occlusion;
+		occlusion.packets = false;
+		state.Measure(
+			name + "/incoherent/occlusion", 3,
+			[&] { TraceRays(rayScene, incoherent, hits, occlusion); },
+			rayCount, "rays");
+		for (std::size_t n{}; n < hits.size(); n++)
+		{
+			errors += (hits[n].triangle != ~0u) !=
+					  (incoherentHits[n].triangle != ~0u);
+		}
+		DXRRayStreamDesc anyHit{};
+		anyHit.type = DXRRayQueryType::AnyHit;
+		anyHit.packets = false;
+		TraceRays(rayScene, incoherent, hits, anyHit);
+		for (std::size_t n{}; n < hits.size(); n++)
+		{
+			const auto& expected = incoherentHits[n];
+			errors += (hits[n].triangle != ~0u) != (expected.triangle != ~0u) ||
+					  hits[n].t < expected.t;
+		}
+	}
+
+	// Batches on every core, the best kernels:
+	DXRRayScene rayScene{};
+	errors += !BuildRayScene(bvh, scene.vertices, scene.indices, rayScene);
+	std::vector<DXRRayHit> hits(coherent.size());
+	state.Report("threads", jobs.GetThreadCount(), "");
+	state.Measure(
+		"jobs/coherent/packets", 5,
+		[&] { TraceRays(rayScene, coherent, hits, {}, &jobs); }, rayCount,
+		"rays");
+	errors += compare(hits, coherentHits);
+	state.Measure(
+		"jobs/incoherent/single", 5,
+		[&] { TraceRays(rayScene, incoherent, hits, single, &jobs); },
+		rayCount, "rays");
+	errors += compare(hits, incoherentHits);
+
+	// Picking the cube in the middle of the screen, its triangles come right
+	// after the ground's:
+	DXRRayHit pick{};
+	const auto cubeFirst = k_Grid * k_Grid * 2;
+	const auto cubeTriangles =
+		static_cast<std::uint32_t>(GetCubeMesh().indices.size() / 3);
+	errors += !TraceRay(rayScene,
+						MakeCameraRay(camera.GetViewMatrix(),
+									  camera.GetProjectionMatrix(), {}),
+						DXRRayQueryType::ClosestHit, pick) ||
+			  pick.triangle < cubeFirst ||
+			  pick.triangle >= cubeFirst + cubeTriangles;
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
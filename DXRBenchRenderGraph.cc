@@ -0,0 +1,244 @@
+#include "DXRBenchmark.h"
+#include "DXRRenderGraph.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct GeneratedAccess
+{
+	std::uint32_t resource{};
+	DXRResourceState state{};
+	bool write{};
+};
+
+// A graph shaped like a big frame: every pass writes a new render target,
+// depth buffer or UAV, and reads a few of the recent ones in some read
+// state. Some outputs are never read (their passes get culled), every 50th
+// pass is a readback with side effects, the last one composites into the
+// imported back buffer.
+struct GeneratedGraph
+{
+	DXRRenderGraph graph{};
+	std::vector<std::vector<GeneratedAccess>> accesses{};
+
+	GeneratedGraph(std::uint32_t passCount, const DXRRenderGraphDesc& desc)
+		: graph(desc)
+	{
+		std::mt19937 random{7};
+		const DXRResourceState writeStates[]{
+			DXRResourceState::RenderTarget, DXRResourceState::UnorderedAccess,
+			DXRResourceState::DepthWrite, DXRResourceState::CopyDest};
+		const DXRResourceState readStates[]{
+			DXRResourceState::PixelShaderResource,
+			DXRResourceState::NonPixelShaderResource,
+			DXRResourceState::CopySource, DXRResourceState::IndirectArgument};
+		const std::uint64_t sizes[]{1 << 20, 4 << 20, 8 << 20, 33 << 20};
+
+		const auto backBuffer = graph.Import(
+			"backbuffer", DXRResourceState::Present, DXRResourceState::Present);
+		std::vector<DXRRenderGraphResource> recent{};
+		for (std::uint32_t p{}; p < passCount; p++)
+		{
+			const auto last = p + 1 == passCount;
+			const auto number = std::to_string(p);
+			const auto pass =
+				graph.AddPass(std::string{"pass"} + number, !last && p % 50 == 49);
+			accesses.emplace_back();
+			auto access = [&](DXRRenderGraphResource resource,
+							  DXRResourceState state, bool write) {
+				if (write)
+					graph.Write(pass, resource, state);
+				else
+					graph.Read(pass, resource, state);
+				accesses.back().push_back({resource.index, state, write});
+			};
+
+			for (std::uint32_t r{}; r < 1 + random() % 3 && !recent.empty();
+				 r++)
+			{
+				const auto resource =
+					recent[recent.size() - 1 - random() % std::min<std::size_t>(
+													   recent.size(), 12)];
+				// One state per resource and pass:
+				if (std::ranges::any_of(accesses.back(), [&](const auto& a) {
+						return a.resource == resource.index;
+					}))
+					continue;
+				if (random() % 8 == 0)
+				{
+					// Read-modify-write, like a blend or an in place blur:
+					access(resource, DXRResourceState::UnorderedAccess, false);
+					access(resource, DXRResourceState::UnorderedAccess, true);
+				}
+				else
+				{
+					access(resource, readStates[random() % 4], false);
+				}
+			}
+
+			if (last)
+			{
+				access(backBuffer, DXRResourceState::RenderTarget, true);
+				break;
+			}
+			const auto resource = graph.CreateTransient(std::string{"t"} + number,
+														sizes[random() % 4]);
+			access(resource, writeStates[random() % 4], true);
+			recent.push_back(resource);
+		}
+	}
+};
+
+// Replays the plan: every barrier has to start from the state the resource
+// is in, every access has to find it in the state it asked for, and
+// transient resources alive at the same time must not share memory.
+auto ValidatePlan(const GeneratedGraph& generated,
+				  const DXRRenderGraphPlan& plan) -> std::uint64_t
+{
+	const auto& graph = generated.graph;
+	std::uint64_t errors{};
+	std::vector<DXRResourceState> states(graph.GetResourceCount());
+	states[0] = DXRResourceState::Present;
+
+	const auto apply = [&](std::uint32_t begin, std::uint32_t count,
+						   std::uint32_t passIndex) {
+		for (auto i = begin; i < begin + count; i++)
+		{
+			const auto& barrier = plan.barriers[i];
+			const auto r = barrier.resource.index;
+			if (barrier.type == DXRRenderGraphBarrierType::Aliasing)
+			{
+				errors += plan.allocations[r].firstPass != passIndex;
+			}
+			else if (barrier.type == DXRRenderGraphBarrierType::Transition &&
+					 barrier.split != DXRRenderGraphBarrierSplit::Begin)
+			{
+				errors += states[r] != barrier.stateBefore;
+				states[r] = barrier.stateAfter;
+			}
+		}
+	};
+
+	for (std::uint32_t p{}; p < plan.passes.size(); p++)
+	{
+		const auto& pass = plan.passes[p];
+		for (std::uint32_t r{}; r < states.size(); r++)
+		{
+			if (plan.allocations[r].firstPass == p)
+				states[r] = plan.allocations[r].initialState;
+		}
+		apply(pass.barrierBegin, pass.barrierCount, p);
+		for (const auto& access : generated.accesses[pass.pass.index])
+		{
+			const auto current = static_cast<std::uint32_t>(states[access.resource]);
+			const auto wanted = static_cast<std::uint32_t>(access.state);
+			const auto ok = access.write ? current == wanted
+										 : (current & wanted) == wanted;
+			errors += !ok;
+		}
+	}
+	apply(plan.finalBarrierBegin, plan.finalBarrierCount,
+		  static_cast<std::uint32_t>(plan.passes.size()));
+	errors += states[0] != DXRResourceState::Present;
+
+	for (std::size_t a{}; a < plan.allocations.size(); a++)
+	{
+		const auto& x = plan.allocations[a];
+		if (!x.IsAllocated())
+			continue;
+		errors += x.offset + x.size > plan.heapSize;
+		for (auto b = a + 1; b < plan.allocations.size(); b++)
+		{
+			const auto& y = plan.allocations[b];
+			if (!y.IsAllocated())
+				continue;
+			const auto alive =
+				x.firstPass <= y.lastPass && y.firstPass <= x.lastPass;
+			const auto shared =
+				x.offset < y.offset + y.size && y.offset < x.offset + x.size;
+			errors += alive && shared;
+		}
+	}
+	return errors;
+}
+
+// FNV-1a of the plan dump, changes whenever the plan does:
+auto HashDump(const std::string& dump) -> std::uint32_t
+{
+	std::uint32_t hash{2166136261u};
+	for (const auto c : dump)
+	{
+		hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+	}
+	return hash;
+}
+} // namespace
+
+// Compile time of a 500 pass graph and what the plan looks like: culled
+// passes, barriers and ResourceBarrier() batches, transient heap against no
+// aliasing. errors (replaying the plan) has to stay 0.
+DXRBENCHMARK(RenderGraphCompile)
+{
+	constexpr std::uint32_t k_Passes{500};
+	for (const auto split : {false, true})
+	{
+		DXRRenderGraphDesc desc{};
+		desc.splitBarriers = split;
+		GeneratedGraph generated{k_Passes, desc};
+		DXRRenderGraphPlan plan{};
+		const std::string label = split ? "split" : "batched";
+		bool compiled{};
+		state.Measure(label + "/compile", 100,
+					  [&] { compiled = generated.graph.Compile(plan); },
+					  k_Passes, "passes");
+		if (!compiled)
+		{
+			state.Report(label + "/failed", 1.0, "");
+			continue;
+		}
+
+		std::uint64_t accesses{};
+		for (const auto& pass : plan.passes)
+		{
+			accesses += generated.accesses[pass.pass.index].size();
+		}
+		state.Report(label + "/passes", static_cast<double>(plan.passes.size()),
+					 "");
+		state.Report(label + "/culled", plan.culledPasses, "");
+		state.Report(label + "/accesses", static_cast<double>(accesses), "");
+		state.Report(label + "/barriers",
+					 static_cast<double>(plan.barriers.size()), "");
+		state.Report(label + "/batches", plan.GetBatchCount(), "");
+		state.Report(label + "/heap",
+					 static_cast<double>(plan.heapSize) / (1 << 20), "MiB");
+		state.Report(label + "/unaliased",
+					 static_cast<double>(plan.unaliasedSize) / (1 << 20),
+					 "MiB");
+		state.Report(label + "/errors",
+					 static_cast<double>(ValidatePlan(generated, plan)), "");
+		state.Report(label + "/hash",
+					 HashDump(DumpRenderGraphPlan(generated.graph, plan)), "");
+	}
+}
+
+// What the window renderer builds every frame: one pass into the back
+// buffer, the graph rebuilt and compiled from scratch.
+DXRBENCHMARK(RenderGraphFrame)
+{
+	DXRRenderGraph graph{};
+	DXRRenderGraphPlan plan{};
+	state.Measure("rebuild", 10000, [&] {
+		graph.Reset();
+		const auto backBuffer = graph.Import(
+			"backbuffer", DXRResourceState::Present, DXRResourceState::Present);
+		const auto scene = graph.AddPass("scene");
+		graph.Write(scene, backBuffer, DXRResourceState::RenderTarget);
+		graph.Compile(plan);
+	});
+	state.Report("barriers", static_cast<double>(plan.barriers.size()), "");
+	state.Report("batches", plan.GetBatchCount(), "");
+}
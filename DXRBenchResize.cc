@@ -0,0 +1,139 @@
+#include "DXRBenchmark.h"
+#include "DXRHeadlessRenderer.h"
+#include "DXRResizeCoalescer.h"
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+// Heights are derived from widths, a torn size (the width of one request
+// with the height of another) doesn't satisfy this:
+auto GetDragHeight(std::uint32_t width) -> std::uint32_t
+{
+	return width * 9 / 16 + 1;
+}
+} // namespace
+
+// Manual clock: a two second drag publishing a size every millisecond, a
+// frame every 16.6 ms. Counts resizes applied during the drag and checks the
+// final size lands once the drag stops. errors has to be 0.
+DXRBENCHMARK(ResizeCoalescing)
+{
+	constexpr std::int64_t k_Millisecond{1000000};
+	constexpr std::int64_t k_Frame{16666667};
+	std::uint64_t errors{};
+
+	const auto drag = [&](const DXRResizeDesc& desc) {
+		DXRManualClock clock{};
+		DXRResizeCoalescer resizes{clock, desc};
+		resizes.SetCurrent(640, GetDragHeight(640));
+		std::uint32_t width{640};
+		std::int64_t nextFrame{k_Frame};
+		DXRResizeSize size{};
+		for (std::int64_t ms{}; ms < 2000; ms++)
+		{
+			clock.now = ms * k_Millisecond;
+			width = 640 + static_cast<std::uint32_t>(ms / 2);
+			resizes.Publish(width, GetDragHeight(width));
+			// Minimized for a moment, must not get through:
+			if (ms == 1000)
+				resizes.Publish(0, 0);
+			if (clock.now >= nextFrame)
+			{
+				nextFrame += k_Frame;
+				if (resizes.Poll(size))
+					errors += !size.width ||
+							  size.height != GetDragHeight(size.width);
+			}
+		}
+		// Released, a few more frames:
+		for (int frame{}; frame < 60; frame++)
+		{
+			clock.now = nextFrame;
+			nextFrame += k_Frame;
+			if (resizes.Poll(size))
+				errors += size.height != GetDragHeight(size.width);
+		}
+		errors += size.width != width || resizes.IsPending();
+		return resizes.GetStats();
+	};
+
+	const auto everyFrame = drag({0.0, 0.0});
+	state.Report("published", static_cast<double>(everyFrame.published), "");
+	state.Report("applied/everyframe", static_cast<double>(everyFrame.applied),
+				 "");
+	const auto debounced = drag({});
+	state.Report("applied/debounced", static_cast<double>(debounced.applied),
+				 "");
+	// One per maxDelay during the drag and the final one:
+	errors += debounced.applied > 2000 / 250 + 2;
+	state.Report("errors", static_cast<double>(errors), "");
+}
+
+// A window thread firing thousands of resizes at the headless renderer while
+// it renders: frame times next to a steady run, resizes applied, and the
+// final size after the storm. errors counts torn sizes and a wrong final
+// size.
+DXRBENCHMARK(ResizeStorm)
+{
+	constexpr std::uint32_t k_Events{20000};
+	const auto cam = CameraManager::GetInstance();
+	std::uint64_t errors{};
+
+	DXRHeadlessRenderer renderer{640, GetDragHeight(640)};
+	const auto frame = [&] {
+		renderer.DispatchEvents();
+		renderer.Update(1.f / 60.f);
+		cam->Update(1.f / 60.f);
+		renderer.Render();
+		const auto rasterizer = renderer.GetRasterizer();
+		errors +=
+			rasterizer->GetHeight() != GetDragHeight(rasterizer->GetWidth());
+	};
+	frame();
+	state.Measure("steady", 50, frame);
+
+	std::atomic<bool> done{};
+	std::jthread window{[&] {
+		for (std::uint32_t n{}; n < k_Events; n++)
+		{
+			const auto width = 320 + n % 960;
+			renderer.OnResize(width, GetDragHeight(width));
+			// About a hundred per frame, a fast drag:
+			if (!(n % 16))
+				std::this_thread::sleep_for(std::chrono::microseconds{200});
+		}
+		renderer.OnResize(1000, GetDragHeight(1000));
+		done.store(true, std::memory_order_release);
+	}};
+	std::uint64_t frames{};
+	const auto start = GetPlatformTickValue();
+	while (!done.load(std::memory_order_acquire))
+	{
+		frame();
+		frames++;
+	}
+	const auto seconds =
+		static_cast<double>(GetPlatformTickValue() - start) /
+		static_cast<double>(GetPlatformTickFrequency());
+	window.join();
+	state.Report("storm/duration", seconds * 1e3, "ms");
+	if (frames)
+		state.Report("storm/frame", seconds * 1e6 / static_cast<double>(frames),
+					 "us");
+
+	// Settles within the debounce time:
+	for (int n{}; n < 100 && renderer.GetWidth() != 1000; n++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds{5});
+		frame();
+	}
+	errors += renderer.GetWidth() != 1000 ||
+			  renderer.GetRasterizer()->GetWidth() != 1000;
+
+	const auto stats = renderer.GetResizeStats();
+	state.Report("published", static_cast<double>(stats.published), "");
+	state.Report("applied", static_cast<double>(stats.applied), "");
+	state.Report("errors", static_cast<double>(errors), "");
+}
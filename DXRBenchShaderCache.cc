@@ -0,0 +1,257 @@
+#include "DXRBenchmark.h"
+#include "DXRShaderCache.h"
+#include "ShaderSources.h"
+
+#include <array>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+// Stands in for D3DCompile: deterministic bytecode from everything in the
+// desc, and some work per byte of source so a miss costs something.
+struct StubCompiler
+{
+	std::uint64_t calls{};
+
+	auto operator()(const DXRShaderDesc& desc, std::vector<unsigned char>& out)
+		-> bool
+	{
+		calls++;
+		std::uint32_t hash{2166136261u};
+		const auto add = [&](std::string_view text) {
+			for (const auto c : text)
+			{
+				hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+			}
+		};
+		for (int pass{}; pass < 64; pass++)
+		{
+			add(desc.source);
+		}
+		add(desc.entry);
+		add(desc.target);
+		for (const auto& define : desc.defines)
+		{
+			add(define.name);
+			add(define.value);
+		}
+		out.resize(2048 + desc.source.size());
+		for (auto& byte : out)
+		{
+			hash = (hash ^ (hash >> 15)) * 0x2C1B3C6Du;
+			byte = static_cast<unsigned char>(hash >> 24);
+		}
+		return true;
+	}
+};
+
+// The same two shaders in permutations, like a material system asks for
+// them:
+struct ShaderSet
+{
+	static inline constexpr std::size_t k_Permutations{32};
+
+	std::array<std::string, k_Permutations> values{};
+	std::array<DXRShaderDefine, k_Permutations> defines{};
+	std::vector<DXRShaderDesc> descs{};
+	// What a direct compile gives:
+	std::vector<std::vector<unsigned char>> expected{};
+
+	ShaderSet()
+	{
+		for (std::size_t n{}; n < k_Permutations; n++)
+		{
+			values[n] = std::to_string(n);
+			defines[n] = {"PERMUTATION", values[n]};
+			const std::span define{&defines[n], 1};
+			descs.push_back({vertexShader2DText, "main", "vs_5_0", define});
+			descs.push_back({pixelShader2DText, "main", "ps_5_0", define});
+		}
+		for (const auto& desc : descs)
+		{
+			StubCompiler{}(desc, expected.emplace_back());
+		}
+	}
+};
+
+auto GetDirectory(std::string_view name) -> std::string
+{
+	return (std::filesystem::temp_directory_path() / "DXRBenchShaderCache" /
+			name)
+		.string();
+}
+
+// Every shader of the set through the cache, counts the ones that don't
+// match a direct compile:
+auto LoadAll(DXRShaderCache& cache, StubCompiler& compiler,
+			 const ShaderSet& set) -> std::uint64_t
+{
+	std::uint64_t errors{};
+	for (std::size_t n{}; n < set.descs.size(); n++)
+	{
+		const auto bytecode = cache.GetOrCompile(set.descs[n], compiler);
+		errors += !bytecode || *bytecode != set.expected[n];
+	}
+	return errors;
+}
+
+auto ReportStats(DXRBenchmarkState& state, std::string_view label,
+				 const DXRShaderCache& cache, const StubCompiler& compiler)
+	-> void
+{
+	const auto stats = cache.GetStats();
+	const std::string prefix{label};
+	state.Report(prefix + "/memoryhits", static_cast<double>(stats.memoryHits),
+				 "");
+	state.Report(prefix + "/diskhits", static_cast<double>(stats.diskHits),
+				 "");
+	state.Report(prefix + "/misses", static_cast<double>(stats.misses), "");
+	state.Report(prefix + "/compiles", static_cast<double>(compiler.calls),
+				 "");
+	state.Report(prefix + "/corrupt", static_cast<double>(stats.corruptFiles),
+				 "");
+	state.Report(prefix + "/evictions", static_cast<double>(stats.evictions),
+				 "");
+}
+} // namespace
+
+// Startup with 64 shaders: a cold cache (compile + write), a warm process
+// (memory) and a restart (disk). Times are per shader set.
+DXRBENCHMARK(ShaderCacheStartup)
+{
+	const ShaderSet set{};
+	const auto items = static_cast<double>(set.descs.size());
+	std::uint64_t errors{};
+	std::filesystem::remove_all(GetDirectory(""));
+
+	DXRShaderCacheDesc desc{};
+	desc.salt = "stub 1";
+	std::uint32_t run{};
+	state.Measure(
+		"cold", 5,
+		[&] {
+			desc.directory = GetDirectory(std::to_string(run++));
+			DXRShaderCache cache{desc};
+			StubCompiler compiler{};
+			errors += LoadAll(cache, compiler, set);
+		},
+		items, "shaders");
+
+	desc.directory = GetDirectory("warm");
+	{
+		DXRShaderCache cache{desc};
+		StubCompiler compiler{};
+		errors += LoadAll(cache, compiler, set);
+		state.Measure(
+			"memory", 100, [&] { errors += LoadAll(cache, compiler, set); },
+			items, "shaders");
+		ReportStats(state, "memory", cache, compiler);
+	}
+
+	StubCompiler compiler{};
+	state.Measure(
+		"disk", 20,
+		[&] {
+			DXRShaderCache cache{desc};
+			errors += LoadAll(cache, compiler, set);
+		},
+		items, "shaders");
+	state.Report("disk/compiles", static_cast<double>(compiler.calls), "");
+
+	// The compiler alone, what every startup paid before:
+	StubCompiler direct{};
+	state.Measure(
+		"nocache", 5,
+		[&] {
+			for (const auto& shaderDesc : set.descs)
+			{
+				std::vector<unsigned char> bytecode{};
+				direct(shaderDesc, bytecode);
+			}
+		},
+		items, "shaders");
+
+	state.Report("errors", static_cast<double>(errors), "");
+	std::filesystem::remove_all(GetDirectory(""));
+}
+
+// Broken files, a new compiler version and a memory budget too small for
+// the set. errors has to stay 0, corrupt files are recompiled and rewritten.
+DXRBENCHMARK(ShaderCacheRobustness)
+{
+	const ShaderSet set{};
+	std::uint64_t errors{};
+	std::filesystem::remove_all(GetDirectory(""));
+
+	DXRShaderCacheDesc desc{};
+	desc.directory = GetDirectory("robust");
+	desc.salt = "stub 1";
+	std::vector<std::filesystem::path> paths{};
+	{
+		DXRShaderCache cache{desc};
+		StubCompiler compiler{};
+		errors += LoadAll(cache, compiler, set);
+		for (const auto& shaderDesc : set.descs)
+		{
+			paths.push_back(cache.GetFilePath(cache.GetKey(shaderDesc)));
+		}
+	}
+
+	// Flip a payload byte, a header byte, truncate one and empty one:
+	const auto damage = [&](const std::filesystem::path& path, long offset) {
+		const auto file = std::fopen(path.string().c_str(), "r+b");
+		if (!file)
+			return;
+		std::fseek(file, offset, SEEK_SET);
+		const auto c = std::fgetc(file);
+		std::fseek(file, offset, SEEK_SET);
+		std::fputc(c ^ 0x5A, file);
+		std::fclose(file);
+	};
+	damage(paths[0], 1000);
+	damage(paths[1], 4);
+	std::filesystem::resize_file(
+		paths[2], std::filesystem::file_size(paths[2]) - 1);
+	std::filesystem::resize_file(paths[3], 0);
+	{
+		DXRShaderCache cache{desc};
+		StubCompiler compiler{};
+		errors += LoadAll(cache, compiler, set);
+		errors += cache.GetStats().corruptFiles != 4 || compiler.calls != 4;
+		ReportStats(state, "corrupt", cache, compiler);
+	}
+	// Rewritten by the recompile:
+	{
+		DXRShaderCache cache{desc};
+		StubCompiler compiler{};
+		errors += LoadAll(cache, compiler, set);
+		errors += compiler.calls != 0;
+	}
+
+	// A new compiler, nothing of the old one's may come back:
+	desc.salt = "stub 2";
+	{
+		DXRShaderCache cache{desc};
+		StubCompiler compiler{};
+		errors += LoadAll(cache, compiler, set);
+		errors += compiler.calls != set.descs.size();
+		ReportStats(state, "salt", cache, compiler);
+	}
+
+	// A budget for eight shaders, cycling through all 64:
+	desc.memoryBudget = 8 * (2048 + std::string_view{pixelShader2DText}.size());
+	{
+		DXRShaderCache cache{desc};
+		StubCompiler compiler{};
+		for (int round{}; round < 4; round++)
+		{
+			errors += LoadAll(cache, compiler, set);
+		}
+		errors += cache.GetStats().memoryBytes > desc.memoryBudget;
+		ReportStats(state, "budget", cache, compiler);
+	}
+
+	state.Report("errors", static_cast<double>(errors), "");
+	std::filesystem::remove_all(GetDirectory(""));
+}
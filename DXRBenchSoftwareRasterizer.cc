@@ -0,0 +1,83 @@
+#include "DXRBenchmark.h"
+#include "DXRHeadlessRenderer.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+// The cube from LoadRenderingAssets at 1080p, 1..N rasterizer threads:
+DXRBENCHMARK(SoftwareRasterizerCube)
+{
+	const auto cam = CameraManager::GetInstance();
+	cam->SetAspectRatio(1920.f / 1080.f);
+	cam->Update(0.7f);
+
+	const auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (std::uint32_t threads{1}; threads <= maxThreads; threads *= 2)
+	{
+		DXRHeadlessRenderer renderer{1920, 1080, threads};
+		renderer.DispatchEvents();
+		renderer.Update(0.f);
+
+		const auto label = std::to_string(threads) + "threads";
+		state.Measure(label, 50, [&] { renderer.Render(); },
+					  1920.0 * 1080.0, "pixels");
+
+		if (threads == 1)
+		{
+			const auto& color = renderer.GetRasterizer()->GetColorBuffer();
+			const auto covered = std::count_if(
+				color.begin(), color.end(),
+				[](std::uint32_t c) { return (c >> 24) != 0; });
+			state.Report("coverage",
+						 100.0 * static_cast<double>(covered) /
+							 static_cast<double>(color.size()),
+						 "%");
+		}
+	}
+}
+
+// Many small triangles, stresses setup and binning rather than fill:
+DXRBENCHMARK(SoftwareRasterizerSmallTriangles)
+{
+	const auto cube = GetCubeMeshVertices();
+	std::vector<DXRVertex3D> vertices{};
+	constexpr std::uint32_t k_Grid{32};
+	for (std::uint32_t y{}; y < k_Grid; y++)
+	{
+		for (std::uint32_t x{}; x < k_Grid; x++)
+		{
+			for (auto v : cube)
+			{
+				v.x = v.x * 0.1f + (static_cast<float>(x) - k_Grid / 2.f) * 0.3f;
+				v.y = v.y * 0.1f + (static_cast<float>(y) - k_Grid / 2.f) * 0.3f;
+				vertices.push_back(v);
+			}
+		}
+	}
+
+	DXRImageRGBA8 texture{};
+	DecodeImageRGBA8(GetEmbeddedTextureData(), GetEmbeddedTextureSize(),
+					 texture);
+
+	DXRGraphicsConstants constants{};
+	constants.model = glm::mat4{1.f};
+	const auto cam = CameraManager::GetInstance();
+	cam->SetAspectRatio(1280.f / 720.f);
+	cam->Update(0.3f);
+	constants.view = cam->GetViewMatrix();
+	constants.projection = cam->GetProjectionMatrix();
+
+	DXRSoftwareRasterizer rasterizer{};
+	rasterizer.Resize(1280, 720);
+	const float clear[4]{};
+	state.Measure(
+		"draw", 50,
+		[&] {
+			rasterizer.Clear(clear);
+			rasterizer.SetTexture(&texture);
+			rasterizer.DrawInstanced(vertices, constants);
+			rasterizer.Execute();
+		},
+		static_cast<double>(vertices.size() / 3), "triangles");
+}
@@ -0,0 +1,75 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRTextureContainer.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+// Startup texture load, old path against the cooked one.
+// Both end with mip 0 in a pitch-aligned staging buffer, which is what the
+// D3D12 upload heap gets.
+DXRBENCHMARK(TextureContainerLoad)
+{
+	DXRImageRGBA8 image{};
+	if (!DecodeImageRGBA8(GetEmbeddedTextureData(), GetEmbeddedTextureSize(),
+						  image))
+		return;
+
+	std::vector<unsigned char> cooked{};
+	if (!CookTextureContainer({&image, 1}, cooked))
+		return;
+	const auto path =
+		(std::filesystem::temp_directory_path() / "DXRBenchTexture.dxrt")
+			.string();
+	if (!WriteTextureContainer(path.c_str(), cooked))
+		return;
+
+	const auto texels = static_cast<double>(image.width) * image.height;
+	const auto pitch = static_cast<std::size_t>(
+		(image.GetRowPitch() + DXRTextureContainer::k_PitchAlignment - 1) &
+		~std::size_t{DXRTextureContainer::k_PitchAlignment - 1});
+	std::vector<unsigned char> staging(pitch *
+									   static_cast<std::size_t>(image.height));
+
+	// Decode + row by row copy:
+	state.Measure(
+		"stb", 20,
+		[&] {
+			DXRImageRGBA8 decoded{};
+			DecodeImageRGBA8(GetEmbeddedTextureData(),
+							 GetEmbeddedTextureSize(), decoded);
+			for (int y{}; y < decoded.height; y++)
+			{
+				memcpy(staging.data() + static_cast<std::size_t>(y) * pitch,
+					   decoded.pixels.data() +
+						   static_cast<std::size_t>(y) * decoded.GetRowPitch(),
+					   decoded.GetRowPitch());
+			}
+		},
+		texels, "texels");
+
+	// Map + validate + one copy of the payload:
+	state.Measure(
+		"mapped", 20,
+		[&] {
+			DXRTextureContainer container{};
+			if (!container.Open(path.c_str()))
+				return;
+			memcpy(staging.data(), container.GetMipData(0),
+				   container.GetMip(0).size);
+		},
+		texels, "texels");
+
+	// Map + validate only, the part that's left on the critical path if the
+	// copy goes straight into the upload heap:
+	state.Measure("open", 200, [&] {
+		DXRTextureContainer container{};
+		container.Open(path.c_str());
+	});
+
+	state.Report("pngbytes", GetEmbeddedTextureSize(), "bytes");
+	state.Report("cookedbytes", static_cast<double>(cooked.size()), "bytes");
+
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,257 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRInstancePacker.h"
+#include "DXRJobSystem.h"
+#include "DXRRayTopLevel.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace
+{
+// Latitude/longitude sphere of radius 1, the denser of the two meshes:
+auto MakeSphere(std::uint32_t rings, std::uint32_t segments) -> DXRIndexedMesh
+{
+	DXRIndexedMesh mesh{};
+	const auto pi = std::numbers::pi_v<float>;
+	for (std::uint32_t ring{}; ring <= rings; ring++)
+	{
+		const auto theta =
+			static_cast<float>(ring) / static_cast<float>(rings) * pi;
+		for (std::uint32_t segment{}; segment <= segments; segment++)
+		{
+			const auto phi = static_cast<float>(segment) /
+							 static_cast<float>(segments) * 2.f * pi;
+			const glm::vec3 normal{std::sin(theta) * std::cos(phi),
+								   std::cos(theta),
+								   std::sin(theta) * std::sin(phi)};
+			mesh.vertices.push_back(DXRVertex3D{
+				normal.x, normal.y, normal.z, normal.x, normal.y, normal.z,
+				0.f, 0.f, 0xFFFFFFFF});
+		}
+	}
+	for (std::uint32_t ring{}; ring < rings; ring++)
+	{
+		for (std::uint32_t segment{}; segment < segments; segment++)
+		{
+			const auto a = ring * (segments + 1) + segment;
+			const auto b = a + 1;
+			const auto c = a + segments + 1;
+			const auto d = c + 1;
+			mesh.indices.insert(mesh.indices.end(), {a, b, c, b, d, c});
+		}
+	}
+	return mesh;
+}
+
+// Every instance circles its own centre like CameraManager::Update moves the
+// camera, sin and cos of an accumulated time, each with its own radius, speed
+// and phase, and spins around y while it does.
+struct MovingInstances
+{
+	std::vector<glm::vec3> centers{};
+	std::vector<glm::vec3> orbits{};
+	std::vector<DXRInstance> instances{};
+	std::vector<DXRInstanceData> packed{};
+	std::vector<std::uint32_t> meshes{};
+	float time{};
+
+	MovingInstances(std::uint32_t count, float extent)
+	{
+		std::mt19937 random{29};
+		std::uniform_real_distribution<float> position{-extent, extent};
+		std::uniform_real_distribution<float> radius{0.5f, 6.f};
+		std::uniform_real_distribution<float> speed{0.2f, 2.f};
+		std::uniform_real_distribution<float> phase{0.f, 6.2831853f};
+		std::uniform_real_distribution<float> scale{0.2f, 1.f};
+		for (std::uint32_t n{}; n < count; n++)
+		{
+			centers.push_back(
+				{position(random), position(random), position(random)});
+			// Radius, angular speed, phase:
+			orbits.push_back({radius(random), speed(random), phase(random)});
+			DXRInstance instance{};
+			instance.scale = scale(random);
+			instances.push_back(instance);
+			meshes.push_back(n % 4 ? 0u : 1u);
+		}
+		packed.resize(count);
+		Advance(0.f);
+	}
+
+	auto Advance(float dt) -> void
+	{
+		time += dt;
+		for (std::size_t n{}; n < instances.size(); n++)
+		{
+			const auto& orbit = orbits[n];
+			const auto angle = time * orbit.y + orbit.z;
+			instances[n].position =
+				centers[n] + glm::vec3{std::sin(angle) * orbit.x, 0.f,
+									   std::cos(angle) * orbit.x};
+			instances[n].rotation =
+				glm::angleAxis(angle, glm::vec3{0.f, 1.f, 0.f});
+		}
+		PackInstances(instances, packed);
+	}
+};
+
+auto MakeRays(std::uint32_t count, float extent) -> std::vector<DXRRay>
+{
+	std::mt19937 random{31};
+	std::uniform_real_distribution<float> position{-extent, extent};
+	std::uniform_real_distribution<float> unit{-1.f, 1.f};
+	std::vector<DXRRay> rays(count);
+	for (auto& ray : rays)
+	{
+		ray.origin = {position(random), position(random), position(random)};
+		glm::vec3 direction{};
+		do
+		{
+			direction = {unit(random), unit(random), unit(random)};
+		} while (glm::dot(direction, direction) < 1e-4f);
+		ray.direction = glm::normalize(direction);
+	}
+	return rays;
+}
+
+// Every instance's mesh, no top level:
+auto TraceBruteForce(std::span<const DXRRayScene> meshes,
+					 const MovingInstances& moving, const DXRRay& ray,
+					 DXRRayHit& hit) -> bool
+{
+	hit = {};
+	for (std::size_t n{}; n < moving.packed.size(); n++)
+	{
+		const auto& rows = moving.packed[n].transform;
+		const glm::mat3 linear{rows[0][0], rows[1][0], rows[2][0],
+							   rows[0][1], rows[1][1], rows[2][1],
+							   rows[0][2], rows[1][2], rows[2][2]};
+		const glm::vec3 translation{rows[0][3], rows[1][3], rows[2][3]};
+		// Rounded the way DXRRayTopLevel does it, hits compare exactly:
+		const auto inverse = glm::inverse(linear);
+		const auto inverseTranslation = -(inverse * translation);
+		DXRRay objectRay{};
+		for (int row{}; row < 3; row++)
+		{
+			const glm::vec3 inverseRow{inverse[0][row], inverse[1][row],
+									   inverse[2][row]};
+			objectRay.origin[row] =
+				glm::dot(inverseRow, ray.origin) + inverseTranslation[row];
+			objectRay.direction[row] = glm::dot(inverseRow, ray.direction);
+		}
+		objectRay.tMax = hit.triangle != ~0u ? hit.t : ray.tMax;
+		DXRRayHit candidate{};
+		if (TraceRay(meshes[moving.meshes[n]], objectRay,
+					 DXRRayQueryType::ClosestHit, candidate))
+		{
+			hit = candidate;
+			hit.instance = static_cast<std::uint32_t>(n);
+		}
+	}
+	return hit.triangle != ~0u;
+}
+} // namespace
+
+// 10k to 100k moving instances of the cube and a sphere. Bottom levels are
+// built once; the top level is updated every frame either only by refits,
+// only by rebuilds, or by the SAH degradation heuristic. Reports the update
+// time per frame (instance packing included, also reported on its own), how
+// often it rebuilt, the SAH cost the tree ends up at and what that does to
+// ray throughput. errors counts top level hits that differ from testing
+// every instance.
+DXRBENCHMARK(TopLevel)
+{
+	std::uint64_t errors{};
+	DXRJobSystem jobs{};
+	state.Report("threads", jobs.GetThreadCount(), "");
+
+	const auto sphere = MakeSphere(24, 48);
+	std::vector<DXRRayScene> meshes(2);
+	state.Measure(
+		"blas", 1,
+		[&] {
+			for (const auto* mesh : {&GetCubeMesh(), &sphere})
+			{
+				DXRBvh bvh{};
+				errors += !BuildBvh(*mesh, bvh, {}, &jobs);
+				const auto index = mesh == &sphere ? 1u : 0u;
+				errors += !BuildRayScene(bvh, mesh->vertices, mesh->indices,
+										 meshes[index]);
+			}
+		},
+		static_cast<double>(GetCubeMesh().indices.size() / 3 +
+							sphere.indices.size() / 3),
+		"tris");
+
+	constexpr std::uint32_t k_Frames{30};
+	constexpr float k_FrameTime{1.f / 30.f};
+	struct Policy
+	{
+		const char* name{};
+		float rebuildThreshold{};
+	};
+	for (const auto count : {10000u, 30000u, 100000u})
+	{
+		// Same density for every count, one instance per 4x4x4 units:
+		const auto extent = std::cbrt(static_cast<float>(count) * 64.f) * 0.5f;
+		const auto rays = MakeRays(16384, extent);
+		const auto prefix = std::to_string(count / 1000) + "k/";
+		{
+			MovingInstances moving{count, extent};
+			state.Measure(
+				prefix + "pack", 5, [&] { moving.Advance(k_FrameTime); },
+				count, "instances");
+		}
+
+		for (const auto& policy :
+			 {Policy{"refit", std::numeric_limits<float>::infinity()},
+			  Policy{"rebuild", 0.f}, Policy{"adaptive", 1.3f}})
+		{
+			const auto label = prefix + policy.name;
+			MovingInstances moving{count, extent};
+			DXRRayTopLevelDesc desc{};
+			desc.rebuildThreshold = policy.rebuildThreshold;
+			DXRRayTopLevel topLevel{desc};
+			topLevel.Update(meshes, moving.packed, moving.meshes, &jobs);
+			const auto initialCost = topLevel.GetStats().sahCost;
+			state.Measure(
+				label + "/frame", k_Frames,
+				[&] {
+					moving.Advance(k_FrameTime);
+					topLevel.Update(meshes, moving.packed, moving.meshes,
+									&jobs);
+				},
+				count, "instances");
+			const auto& stats = topLevel.GetStats();
+			state.Report(label + "/rebuilds", stats.rebuilds - 1, "");
+			state.Report(label + "/sahratio", stats.sahCost / initialCost,
+						 "x");
+
+			std::vector<DXRRayHit> hits(rays.size());
+			state.Measure(
+				label + "/rays", 3,
+				[&] { topLevel.TraceRays(rays, hits, {}, &jobs); },
+				static_cast<double>(rays.size()), "rays");
+
+			if (std::string_view{policy.name} != "adaptive")
+				continue;
+			for (std::size_t n{}; n < rays.size(); n += 128)
+			{
+				DXRRayHit expected{};
+				TraceBruteForce(meshes, moving, rays[n], expected);
+				errors += hits[n].triangle != expected.triangle ||
+						  hits[n].instance != expected.instance ||
+						  hits[n].t != expected.t;
+			}
+		}
+	}
+
+	state.Report("errors", static_cast<double>(errors), "");
+}
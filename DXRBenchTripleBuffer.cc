@@ -0,0 +1,172 @@
+#include "DXRBenchmark.h"
+#include "CameraManager.h"
+#include "DXRTripleBuffer.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+// Every field derived from one counter, so a snapshot mixing two publishes
+// is easy to spot:
+auto MakeSnapshot(std::uint64_t n) -> DXRCameraMatrices
+{
+	// Floats are exact up to 2^24:
+	const auto value = static_cast<float>(n & 0xFFFFFF);
+	DXRCameraMatrices snapshot{};
+	snapshot.projection = glm::mat4{value};
+	snapshot.view = glm::mat4{value};
+	snapshot.position = glm::vec3{value};
+	snapshot.forward = glm::vec3{value};
+	snapshot.right = glm::vec3{value};
+	snapshot.up = glm::vec3{value};
+	snapshot.updateNumber = n;
+	return snapshot;
+}
+
+auto IsTorn(const DXRCameraMatrices& snapshot) -> bool
+{
+	const auto value = static_cast<float>(snapshot.updateNumber & 0xFFFFFF);
+	for (int c{}; c < 4; c++)
+	{
+		for (int r{}; r < 4; r++)
+		{
+			const auto expected = c == r ? value : 0.f;
+			if (snapshot.projection[c][r] != expected ||
+				snapshot.view[c][r] != expected)
+				return true;
+		}
+	}
+	return snapshot.position != glm::vec3{value} ||
+		   snapshot.forward != glm::vec3{value} ||
+		   snapshot.right != glm::vec3{value} ||
+		   snapshot.up != glm::vec3{value};
+}
+
+struct TripleBufferChannel
+{
+	DXRTripleBuffer<DXRCameraMatrices> buffer{MakeSnapshot(0)};
+
+	auto Publish(std::uint64_t n) -> void
+	{
+		buffer.GetWriteBuffer() = MakeSnapshot(n);
+		buffer.Publish();
+	}
+
+	auto Read() -> DXRCameraMatrices
+	{
+		return buffer.Acquire();
+	}
+};
+
+// What the renderers used before: libatomic guards it with a lock.
+struct AtomicChannel
+{
+	std::atomic<DXRCameraMatrices> value{MakeSnapshot(0)};
+
+	auto Publish(std::uint64_t n) -> void
+	{
+		value.store(MakeSnapshot(n));
+	}
+
+	auto Read() -> DXRCameraMatrices
+	{
+		return value.load();
+	}
+};
+
+struct MutexChannel
+{
+	std::mutex mutex{};
+	DXRCameraMatrices value{MakeSnapshot(0)};
+
+	auto Publish(std::uint64_t n) -> void
+	{
+		const auto snapshot = MakeSnapshot(n);
+		std::lock_guard lock{mutex};
+		value = snapshot;
+	}
+
+	auto Read() -> DXRCameraMatrices
+	{
+		std::lock_guard lock{mutex};
+		return value;
+	}
+};
+
+// A producer thread publishes as fast as it can while this thread reads.
+// torn counts reads that mixed two publishes, backwards counts reads older
+// than a previous read. Both have to stay 0.
+template <typename Channel>
+auto MeasureContention(DXRBenchmarkState& state, const std::string& label)
+	-> void
+{
+	constexpr std::uint64_t k_Reads{2000000};
+	Channel channel{};
+	std::atomic<std::uint64_t> published{};
+	std::uint64_t torn{};
+	std::uint64_t backwards{};
+	std::uint64_t distinct{};
+	{
+		std::jthread producer{[&](std::stop_token stop) {
+			std::uint64_t n{};
+			while (!stop.stop_requested())
+			{
+				channel.Publish(++n);
+				published.store(n, std::memory_order_relaxed);
+			}
+		}};
+
+		std::uint64_t last{};
+		state.Measure(
+			label + "/read", k_Reads,
+			[&] {
+				const auto snapshot = channel.Read();
+				torn += IsTorn(snapshot);
+				backwards += snapshot.updateNumber < last;
+				distinct += snapshot.updateNumber != last;
+				last = snapshot.updateNumber;
+			},
+			1.0, "reads");
+	}
+	state.Report(label + "/publishes",
+				 static_cast<double>(published.load()), "");
+	state.Report(label + "/distinct", static_cast<double>(distinct), "");
+	state.Report(label + "/torn", static_cast<double>(torn), "");
+	state.Report(label + "/backwards", static_cast<double>(backwards), "");
+}
+} // namespace
+
+// DXRTripleBuffer against the std::atomic<DXRCameraMatrices> it replaced and
+// a plain mutex, one producer and one consumer hammering the same snapshot.
+DXRBENCHMARK(SnapshotContention)
+{
+	MeasureContention<TripleBufferChannel>(state, "triplebuffer");
+	MeasureContention<AtomicChannel>(state, "atomic");
+	MeasureContention<MutexChannel>(state, "mutex");
+}
+
+// The real thing: CameraManager::Update() on its own thread like main.cc's
+// update worker, the render thread acquiring snapshots.
+DXRBENCHMARK(CameraSnapshot)
+{
+	const auto cam = CameraManager::GetInstance();
+	std::uint64_t backwards{};
+	std::uint64_t last{};
+	{
+		std::jthread updater{[cam](std::stop_token stop) {
+			while (!stop.stop_requested())
+			{
+				cam->Update(1.f / 1000.f);
+			}
+		}};
+		state.Measure("acquire", 1000000, [&] {
+			const auto& snapshot = cam->AcquireSnapshot();
+			backwards += snapshot.updateNumber < last;
+			last = snapshot.updateNumber;
+		});
+	}
+	state.Report("backwards", static_cast<double>(backwards), "");
+}
@@ -0,0 +1,117 @@
+#include "DXRBenchmark.h"
+#include "DXRUploadRing.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Upload sizes of a streaming workload: mostly small buffers, now and then
+// a texture:
+auto NextUploadSize(std::uint32_t& seed) -> std::uint64_t
+{
+	seed = seed * 1664525u + 1013904223u;
+	if ((seed >> 24) < 8)
+		return 256ull * 1024 + (seed & 0xFFFF) * 16;
+	return 64 + (seed >> 16) % 4096;
+}
+
+struct LiveRange
+{
+	std::uint64_t fenceValue{};
+	std::uint64_t begin{};
+	std::uint64_t end{};
+};
+} // namespace
+
+// 8MB ring, 16 uploads per batch, the fake GPU runs 1, 2 and 4 batches
+// behind.
+// overlaps counts allocations that hit memory the GPU could still be reading,
+// it has to stay 0.
+DXRBENCHMARK(UploadRing)
+{
+	constexpr std::uint64_t k_Capacity{8ull << 20};
+	constexpr int k_Batches{20000};
+	constexpr int k_UploadsPerBatch{16};
+
+	for (const auto latency : {1u, 2u, 4u})
+	{
+		DXRUploadRing ring{k_Capacity};
+		DXRBenchGPUQueue fence{latency};
+		std::uint32_t seed{1};
+		std::uint64_t overlaps{};
+		std::vector<LiveRange> live{};
+
+		const auto label = std::to_string(latency) + "behind";
+		state.Measure(
+			label, 1,
+			[&] {
+				for (int batch{}; batch < k_Batches; batch++)
+				{
+					std::vector<LiveRange> pending{};
+					for (int n{}; n < k_UploadsPerBatch; n++)
+					{
+						const auto size = NextUploadSize(seed);
+						std::uint64_t offset{};
+						if (!ring.Allocate(fence, size, 256, offset))
+							continue;
+
+						std::erase_if(live, [&](const LiveRange& range) {
+							return range.fenceValue <= fence.GetCompletedValue();
+						});
+						for (const auto& range : live)
+						{
+							overlaps += offset < range.end &&
+										range.begin < offset + size;
+						}
+						pending.push_back({0, offset, offset + size});
+					}
+					const auto value = fence.Signal();
+					ring.Submit(value);
+					for (auto& range : pending)
+					{
+						range.fenceValue = value;
+						live.push_back(range);
+					}
+				}
+			},
+			k_Batches * k_UploadsPerBatch, "allocations");
+		state.Report(label + "/stalls",
+					 static_cast<double>(ring.GetStallCount()), "");
+		state.Report(label + "/overflows",
+					 static_cast<double>(ring.GetOverflowCount()), "");
+		state.Report(label + "/overlaps", static_cast<double>(overlaps), "");
+	}
+}
+
+// The overflow path: a request larger than the ring fails without waiting,
+// so the caller goes to a dedicated buffer right away.
+DXRBENCHMARK(UploadRingOverflow)
+{
+	DXRUploadRing ring{1ull << 20};
+	DXRBenchGPUQueue fence{};
+	std::uint64_t offset{};
+	const auto fits = ring.Allocate(fence, 2ull << 20, 256, offset);
+	state.Report("toolarge/allocated", fits ? 1.0 : 0.0, "");
+	state.Report("toolarge/waits", static_cast<double>(fence.GetWaitCount()), "");
+
+	// A batch that fills the ring before it is submitted can't wait for
+	// itself either:
+	for (int n{}; n < 4; n++)
+	{
+		ring.Allocate(fence, 256ull * 1024, 256, offset);
+	}
+	const auto unsubmitted = ring.Allocate(fence, 256ull * 1024, 256, offset);
+	state.Report("unsubmitted/allocated", unsubmitted ? 1.0 : 0.0, "");
+	state.Report("overflows", static_cast<double>(ring.GetOverflowCount()),
+				 "");
+
+	DXRDeferredRelease<std::unique_ptr<int>> release{};
+	release.Add(std::make_unique<int>(1));
+	release.Submit(fence.Signal());
+	release.Retire(fence.GetSignaledValue());
+	state.Report("released/remaining", static_cast<double>(release.GetCount()),
+				 "");
+}
@@ -0,0 +1,135 @@
+#include "DXRBenchmark.h"
+#include "DXRAssets.h"
+#include "DXRVertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace
+{
+// Scattered positions in a 100 unit box, random directions (not just the
+// easy axis aligned ones) and UVs in [0, 1]:
+auto MakeRandomVertices(std::size_t count) -> std::vector<DXRVertex3D>
+{
+	std::mt19937 random{7};
+	std::uniform_real_distribution<float> position{-40.f, 60.f};
+	std::uniform_real_distribution<float> unit{0.f, 1.f};
+	std::normal_distribution<float> gaussian{};
+	std::vector<DXRVertex3D> vertices(count);
+	for (auto& vertex : vertices)
+	{
+		const auto n = glm::normalize(
+			glm::vec3{gaussian(random), gaussian(random), gaussian(random)});
+		vertex = {position(random), position(random), position(random),
+				  n.x, n.y, n.z, unit(random), unit(random), 0xFF00FFFF};
+	}
+	return vertices;
+}
+
+// Largest errors of the round trip, relative to what DXRVertexQuantizer.h
+// promises. Every "bound" ratio has to stay <= 1:
+auto ReportErrors(DXRBenchmarkState& state, const std::string& label,
+				  std::span<const DXRVertex3D> vertices) -> void
+{
+	DXRQuantizedVertices quantized{};
+	QuantizeVertices(vertices, quantized);
+
+	float positionError{};
+	float normalDegrees{};
+	float uvError{};
+	std::uint64_t colorMismatches{};
+	for (std::size_t n{}; n < vertices.size(); n++)
+	{
+		const auto& in = vertices[n];
+		const auto out = DequantizeVertex(quantized.vertices[n],
+										  quantized.offset, quantized.scale);
+		positionError = std::max({positionError, std::abs(out.x - in.x),
+								  std::abs(out.y - in.y),
+								  std::abs(out.z - in.z)});
+		const auto d = glm::dot(glm::normalize(glm::vec3{in.nx, in.ny, in.nz}),
+								glm::vec3{out.nx, out.ny, out.nz});
+		normalDegrees = std::max(
+			normalDegrees, glm::degrees(std::acos(std::clamp(d, -1.f, 1.f))));
+		uvError = std::max(
+			{uvError, std::abs(out.u - in.u), std::abs(out.v - in.v)});
+		colorMismatches += out.col != in.col;
+	}
+	// Half a quantization step, plus the float rounding of the dequantize:
+	const auto magnitude = std::max({std::abs(quantized.offset.x),
+									 std::abs(quantized.offset.y),
+									 std::abs(quantized.offset.z)}) +
+						   quantized.scale;
+	const auto positionBound =
+		quantized.scale / 65535.f * 0.5f +
+		4.f * std::numeric_limits<float>::epsilon() * magnitude;
+	state.Report(label + "/position/maxerror", positionError, "");
+	state.Report(label + "/position/bound", positionError / positionBound, "");
+	state.Report(label + "/normal/maxerror", normalDegrees, "degrees");
+	state.Report(label + "/normal/bound", normalDegrees / 0.7f, "");
+	state.Report(label + "/uv/maxerror", uvError, "");
+	state.Report(label + "/uv/bound", uvError * 4096.f, "");
+	state.Report(label + "/color/mismatches",
+				 static_cast<double>(colorMismatches), "");
+}
+} // namespace
+
+// Round trip errors against the documented bounds, for random vertices and
+// the cube the renderers draw.
+DXRBENCHMARK(VertexQuantizerError)
+{
+	const auto vertices = MakeRandomVertices(1 << 18);
+	ReportErrors(state, "random", vertices);
+	ReportErrors(state, "cube", GetCubeMesh().vertices);
+
+	DXRQuantizedVertices quantized{};
+	state.Measure(
+		"encode", 5, [&] { QuantizeVertices(vertices, quantized); },
+		static_cast<double>(vertices.size()), "vertices");
+}
+
+// What the input assembler has to read: bytes per vertex, and a position
+// fetch pass over 4M vertices of either layout (well past the caches, so
+// this is mostly memory bandwidth).
+DXRBENCHMARK(VertexQuantizerBandwidth)
+{
+	state.Report("full/bytespervertex", sizeof(DXRVertex3D), "bytes");
+	state.Report("quantized/bytespervertex", sizeof(DXRVertexQuantized),
+				 "bytes");
+
+	const auto vertices = MakeRandomVertices(1 << 22);
+	DXRQuantizedVertices quantized{};
+	QuantizeVertices(vertices, quantized);
+	const auto count = static_cast<double>(vertices.size());
+
+	volatile float sink{};
+	state.Measure(
+		"full/fetch", 10,
+		[&] {
+			glm::vec3 sum{};
+			for (const auto& vertex : vertices)
+			{
+				sum += glm::vec3{vertex.x, vertex.y, vertex.z};
+			}
+			sink = sum.x + sum.y + sum.z;
+		},
+		count, "vertices");
+	state.Measure(
+		"quantized/fetch", 10,
+		[&] {
+			glm::vec3 sum{};
+			for (const auto& vertex : quantized.vertices)
+			{
+				sum += glm::vec3{vertex.x, vertex.y, vertex.z};
+			}
+			sink = sum.x + sum.y + sum.z;
+		},
+		count, "vertices");
+	(void)sink;
+
+	state.Report("full/megabytes", count * sizeof(DXRVertex3D) / 1e6, "MB");
+	state.Report("quantized/megabytes",
+				 count * sizeof(DXRVertexQuantized) / 1e6, "MB");
+}
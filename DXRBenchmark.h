@@ -0,0 +1,235 @@
+#pragma once
+
+#include "DXRFenceEvent.h"
+#include "DXRPlatform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Tiny benchmark harness for the headless DXRBench executable.
+// Every DXRBench*.cc file registers its benchmarks with DXRBENCHMARK(name),
+// DXRBenchMain.cc runs them. Output is one "name/label: value unit" line per
+// result, so CI can diff runs between commits. Values reported as "errors"
+// (or ".../errors") are correctness checks, DXRBench exits with 1 unless
+// they all are 0.
+struct DXRBenchmarkState
+{
+	inline DXRBenchmarkState(std::string_view name) : m_name(name)
+	{
+	}
+
+	// Runs fn() `iterations` times (after one warm-up call) and reports the
+	// average time. `items` is how much work one call does, it is reported
+	// as a throughput next to the time.
+	// Returns seconds per iteration.
+	template <typename F>
+	inline auto Measure(std::string_view label, std::uint64_t iterations,
+						F&& fn, double items = 0.0,
+						std::string_view itemUnit = "items") -> double
+	{
+		fn();
+		const auto start = GetPlatformTickValue();
+		for (std::uint64_t n{}; n < iterations; n++)
+		{
+			fn();
+		}
+		const auto ticks = GetPlatformTickValue() - start;
+		const auto seconds = static_cast<double>(ticks) /
+							 static_cast<double>(GetPlatformTickFrequency()) /
+							 static_cast<double>(iterations ? iterations : 1);
+		Report(label, seconds * 1e6, "us");
+		if (items > 0.0 && seconds > 0.0)
+		{
+			std::printf("%.*s/%.*s: %.3f M%.*s/s\n",
+						static_cast<int>(m_name.size()), m_name.data(),
+						static_cast<int>(label.size()), label.data(),
+						items / seconds / 1e6,
+						static_cast<int>(itemUnit.size()), itemUnit.data());
+		}
+		return seconds;
+	}
+
+	// Reports a value that isn't a time (quality, sizes, ratios...):
+	inline auto Report(std::string_view label, double value,
+					   std::string_view unit) -> void
+	{
+		if (label == "errors" || label.ends_with("/errors"))
+		{
+			m_errors += value;
+		}
+		std::printf("%.*s/%.*s: %.3f %.*s\n", static_cast<int>(m_name.size()),
+					m_name.data(), static_cast<int>(label.size()),
+					label.data(), value, static_cast<int>(unit.size()),
+					unit.data());
+	}
+
+	// Sum of every "errors" value reported so far:
+	inline auto GetErrors() const -> double
+	{
+		return m_errors;
+	}
+
+  private:
+	std::string_view m_name{};
+	double m_errors{};
+};
+
+using DXRBenchmarkFunction = void (*)(DXRBenchmarkState&);
+
+struct DXRBenchmarkEntry
+{
+	std::string_view name{};
+	DXRBenchmarkFunction function{};
+};
+
+inline auto GetRegisteredBenchmarks() -> std::vector<DXRBenchmarkEntry>&
+{
+	static std::vector<DXRBenchmarkEntry> benchmarks{};
+	return benchmarks;
+}
+
+struct DXRBenchmarkRegistrar
+{
+	inline DXRBenchmarkRegistrar(std::string_view name,
+								 DXRBenchmarkFunction function)
+	{
+		GetRegisteredBenchmarks().push_back({name, function});
+	}
+};
+
+// Stands in for a command queue + fence, the Queue DXRFramePacer,
+// DXRUploadRing and DXRDescriptorAllocator take. Signal(value) ends a
+// submit. With a latency, a submit completes `latency` submits after it was
+// made and Wait() completes it on the spot, so allocator tests run the same
+// every time. With latency 0, the work queued with Execute() runs on a "GPU"
+// thread that just sleeps, and the fence is signaled once everything before
+// it has run, for pacing measurements.
+struct DXRBenchGPUQueue : DXRNonCopyable
+{
+	inline DXRBenchGPUQueue(std::uint64_t latency = 2) : m_latency(latency)
+	{
+		if (!m_latency)
+			m_thread =
+				std::jthread{[this](std::stop_token stop) { Run(stop); }};
+	}
+
+	inline ~DXRBenchGPUQueue()
+	{
+		if (!m_thread.joinable())
+			return;
+		m_thread.request_stop();
+		m_condition.notify_all();
+	}
+
+	// GPU time of the next submit, GPU thread only:
+	inline auto Execute(std::chrono::microseconds work) -> void
+	{
+		m_pendingWork += work;
+	}
+
+	inline auto Signal(std::uint64_t value) -> void
+	{
+		m_signaled = value;
+		if (m_latency)
+		{
+			if (value > m_latency)
+				Complete(value - m_latency);
+			return;
+		}
+		{
+			std::lock_guard lock{m_mutex};
+			m_submissions.push_back({m_pendingWork, value});
+		}
+		m_pendingWork = {};
+		m_condition.notify_one();
+	}
+
+	// Signals the value after the last one, for callers without a pacer:
+	inline auto Signal() -> std::uint64_t
+	{
+		Signal(m_signaled + 1);
+		return m_signaled;
+	}
+
+	inline auto GetCompletedValue() -> std::uint64_t
+	{
+		return m_fence.GetCompletedValue();
+	}
+
+	inline auto Wait(std::uint64_t value) -> void
+	{
+		m_waits++;
+		if (m_latency)
+			Complete(value);
+		else
+			m_fence.Wait(value);
+	}
+
+	inline auto GetSignaledValue() const -> std::uint64_t
+	{
+		return m_signaled;
+	}
+
+	inline auto GetWaitCount() const -> std::uint64_t
+	{
+		return m_waits;
+	}
+
+  private:
+	struct Submission
+	{
+		std::chrono::microseconds work{};
+		std::uint64_t value{};
+	};
+
+	inline auto Complete(std::uint64_t value) -> void
+	{
+		m_fence.Signal(std::max(m_fence.GetCompletedValue(), value));
+	}
+
+	inline auto Run(std::stop_token stop) -> void
+	{
+		for (;;)
+		{
+			Submission submission{};
+			{
+				std::unique_lock lock{m_mutex};
+				m_condition.wait(lock, [&] {
+					return stop.stop_requested() || !m_submissions.empty();
+				});
+				if (m_submissions.empty())
+					return;
+				submission = m_submissions.front();
+				m_submissions.pop_front();
+			}
+			if (submission.work.count() > 0)
+				std::this_thread::sleep_for(submission.work);
+			m_fence.Signal(submission.value);
+		}
+	}
+
+	std::uint64_t m_latency{};
+	std::uint64_t m_signaled{};
+	std::uint64_t m_waits{};
+	DXRFenceEvent m_fence{};
+	std::chrono::microseconds m_pendingWork{};
+	std::mutex m_mutex{};
+	std::condition_variable m_condition{};
+	std::deque<Submission> m_submissions{};
+	// Last, joined before what it uses goes away:
+	std::jthread m_thread{};
+};
+
+#define DXRBENCHMARK(name)                                                     \
+	static auto DXRBenchmark_##name(DXRBenchmarkState& state)->void;           \
+	static DXRBenchmarkRegistrar g_DXRBenchmarkRegistrar_##name{               \
+		#name, DXRBenchmark_##name};                                           \
+	static auto DXRBenchmark_##name(DXRBenchmarkState& state)->void
@@ -0,0 +1,1117 @@
+#include "DXRBlockCompression.h"
+#include "DXRJobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace
+{
+// Blocks per thread below which splitting isn't worth it:
+constexpr std::size_t k_ParallelMinBlocks{4096};
+
+// 4x4 texels, RGBA8 each:
+using Block = std::array<std::array<int, 4>, 16>;
+
+auto FetchBlock(const DXRImageRGBA8& image, std::uint32_t bx, std::uint32_t by)
+	-> Block
+{
+	Block block{};
+	for (int n{}; n < 16; n++)
+	{
+		const auto x = std::min(static_cast<int>(bx) * 4 + (n & 3),
+								image.width - 1);
+		const auto y = std::min(static_cast<int>(by) * 4 + (n >> 2),
+								image.height - 1);
+		const auto texel = image.pixels.data() +
+						   static_cast<std::size_t>(y) * image.GetRowPitch() +
+						   static_cast<std::size_t>(x) * 4;
+		for (int c{}; c < 4; c++)
+		{
+			block[static_cast<std::size_t>(n)][static_cast<std::size_t>(c)] =
+				texel[c];
+		}
+	}
+	return block;
+}
+
+auto StoreBlock(const Block& block, DXRImageRGBA8& image, std::uint32_t bx,
+				std::uint32_t by) -> void
+{
+	for (int n{}; n < 16; n++)
+	{
+		const auto x = static_cast<int>(bx) * 4 + (n & 3);
+		const auto y = static_cast<int>(by) * 4 + (n >> 2);
+		if (x >= image.width || y >= image.height)
+			continue;
+
+		const auto texel = image.pixels.data() +
+						   static_cast<std::size_t>(y) * image.GetRowPitch() +
+						   static_cast<std::size_t>(x) * 4;
+		for (int c{}; c < 4; c++)
+		{
+			texel[c] = static_cast<unsigned char>(
+				block[static_cast<std::size_t>(n)][static_cast<std::size_t>(c)]);
+		}
+	}
+}
+
+auto Square(int v) -> int
+{
+	return v * v;
+}
+
+// Principal axis fit:
+
+struct Line
+{
+	float mean[4]{};
+	float axis[4]{};
+	float minT{};
+	float maxT{};
+};
+
+// Fits a line through the texels selected by mask (bit n = texel n), over
+// the first `channels` channels:
+auto FitLine(const Block& block, std::uint32_t mask, int channels) -> Line
+{
+	Line line{};
+	int count{};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!(mask & (1u << n)))
+			continue;
+		count++;
+		for (int c{}; c < channels; c++)
+		{
+			line.mean[c] += static_cast<float>(block[n][static_cast<std::size_t>(c)]);
+		}
+	}
+	if (!count)
+		return line;
+	for (int c{}; c < channels; c++)
+	{
+		line.mean[c] /= static_cast<float>(count);
+	}
+
+	float covariance[4][4]{};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!(mask & (1u << n)))
+			continue;
+		float d[4]{};
+		for (int c{}; c < channels; c++)
+		{
+			d[c] = static_cast<float>(block[n][static_cast<std::size_t>(c)]) -
+				   line.mean[c];
+		}
+		for (int i{}; i < channels; i++)
+		{
+			for (int j{}; j < channels; j++)
+			{
+				covariance[i][j] += d[i] * d[j];
+			}
+		}
+	}
+
+	// Power iteration, starting from the largest diagonal:
+	int largest{};
+	for (int c{1}; c < channels; c++)
+	{
+		if (covariance[c][c] > covariance[largest][largest])
+			largest = c;
+	}
+	float axis[4]{};
+	for (int c{}; c < channels; c++)
+	{
+		axis[c] = covariance[largest][c];
+	}
+	for (int iteration{}; iteration < 8; iteration++)
+	{
+		float next[4]{};
+		float length{};
+		for (int i{}; i < channels; i++)
+		{
+			for (int j{}; j < channels; j++)
+			{
+				next[i] += covariance[i][j] * axis[j];
+			}
+			length = std::max(length, std::abs(next[i]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int c{}; c < channels; c++)
+		{
+			axis[c] = next[c] / length;
+		}
+	}
+	float length{};
+	for (int c{}; c < channels; c++)
+	{
+		length += axis[c] * axis[c];
+	}
+	length = std::sqrt(length);
+	for (int c{}; c < channels; c++)
+	{
+		line.axis[c] = length > 1e-6f ? axis[c] / length : 0.f;
+	}
+
+	line.minT = std::numeric_limits<float>::max();
+	line.maxT = std::numeric_limits<float>::lowest();
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!(mask & (1u << n)))
+			continue;
+		float t{};
+		for (int c{}; c < channels; c++)
+		{
+			t += (static_cast<float>(block[n][static_cast<std::size_t>(c)]) -
+				  line.mean[c]) *
+				 line.axis[c];
+		}
+		line.minT = std::min(line.minT, t);
+		line.maxT = std::max(line.maxT, t);
+	}
+	return line;
+}
+
+// Squared distance of the selected texels to their fitted line, how well a
+// two endpoint palette can do at best:
+auto LineError(const Block& block, std::uint32_t mask, const Line& line,
+			   int channels) -> float
+{
+	float error{};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!(mask & (1u << n)))
+			continue;
+		float d[4]{};
+		float t{};
+		for (int c{}; c < channels; c++)
+		{
+			d[c] = static_cast<float>(block[n][static_cast<std::size_t>(c)]) -
+				   line.mean[c];
+			t += d[c] * line.axis[c];
+		}
+		for (int c{}; c < channels; c++)
+		{
+			const auto r = d[c] - t * line.axis[c];
+			error += r * r;
+		}
+	}
+	return error;
+}
+
+auto LineEndpoint(const Line& line, float t, int c) -> float
+{
+	return std::clamp(line.mean[c] + line.axis[c] * t, 0.f, 255.f);
+}
+
+// Least squares endpoints for fixed indices:
+// Minimizes sum((1 - w_n) * e0 + w_n * e1 - x_n)^2 per channel. Returns
+// false if every selected texel uses the same weight.
+auto SolveEndpoints(const Block& block, std::uint32_t mask,
+					const std::array<float, 16>& weights, int channels,
+					float e0[4], float e1[4]) -> bool
+{
+	float aa{}, ab{}, bb{};
+	float ax[4]{}, bx[4]{};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!(mask & (1u << n)))
+			continue;
+		const auto w = weights[n];
+		const auto a = 1.f - w;
+		aa += a * a;
+		ab += a * w;
+		bb += w * w;
+		for (int c{}; c < channels; c++)
+		{
+			const auto x =
+				static_cast<float>(block[n][static_cast<std::size_t>(c)]);
+			ax[c] += a * x;
+			bx[c] += w * x;
+		}
+	}
+	const auto det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f)
+		return false;
+
+	for (int c{}; c < channels; c++)
+	{
+		e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+		e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+	}
+	return true;
+}
+
+// BC1 / BC3 color:
+
+auto Pack565(const float color[3]) -> std::uint32_t
+{
+	const auto r = static_cast<std::uint32_t>(color[0] * 31.f / 255.f + 0.5f);
+	const auto g = static_cast<std::uint32_t>(color[1] * 63.f / 255.f + 0.5f);
+	const auto b = static_cast<std::uint32_t>(color[2] * 31.f / 255.f + 0.5f);
+	return (r << 11) | (g << 5) | b;
+}
+
+auto Unpack565(std::uint32_t packed, int out[3]) -> void
+{
+	const auto r = static_cast<int>((packed >> 11) & 31);
+	const auto g = static_cast<int>((packed >> 5) & 63);
+	const auto b = static_cast<int>(packed & 31);
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// Palette for two 565 endpoints, index 3 is transparent black in three
+// color mode:
+auto GetColorPalette(std::uint32_t c0, std::uint32_t c1, bool fourColor,
+					 int palette[4][4]) -> void
+{
+	Unpack565(c0, palette[0]);
+	Unpack565(c1, palette[1]);
+	palette[0][3] = 255;
+	palette[1][3] = 255;
+	for (int c{}; c < 3; c++)
+	{
+		if (fourColor)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = fourColor ? 255 : 0;
+}
+
+struct ColorBlock
+{
+	std::uint32_t c0{};
+	std::uint32_t c1{};
+	std::uint32_t indices{};
+	int error{std::numeric_limits<int>::max()};
+};
+
+// Assigns indices for fixed endpoints, ordering them so the decoder picks
+// the intended mode:
+auto EvaluateColorBlock(const Block& block, std::uint32_t opaqueMask,
+						std::uint32_t c0, std::uint32_t c1, bool threeColor)
+	-> ColorBlock
+{
+	ColorBlock out{};
+	// Four color mode needs c0 > c1, three color mode c0 <= c1:
+	if (threeColor ? c0 > c1 : c0 < c1)
+	{
+		std::swap(c0, c1);
+	}
+	out.c0 = c0;
+	out.c1 = c1;
+	out.error = 0;
+
+	const auto fourColor = c0 > c1;
+	int palette[4][4]{};
+	GetColorPalette(c0, c1, fourColor, palette);
+	// Equal endpoints decode as three color mode, stay off index 3:
+	const auto usable = fourColor ? 4 : 3;
+
+	for (std::size_t n{}; n < 16; n++)
+	{
+		std::uint32_t index{3};
+		if (opaqueMask & (1u << n))
+		{
+			auto best = std::numeric_limits<int>::max();
+			for (int i{}; i < usable; i++)
+			{
+				int error{};
+				for (std::size_t c{}; c < 3; c++)
+				{
+					error += Square(block[n][c] - palette[i][c]);
+				}
+				if (error < best)
+				{
+					best = error;
+					index = static_cast<std::uint32_t>(i);
+				}
+			}
+			out.error += best;
+		}
+		out.indices |= index << (n * 2);
+	}
+	return out;
+}
+
+// Index -> position between c0 and c1:
+auto GetColorWeight(std::uint32_t index, bool fourColor) -> float
+{
+	constexpr float k_FourColor[4]{0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+	constexpr float k_ThreeColor[4]{0.f, 1.f, 0.5f, 0.f};
+	return fourColor ? k_FourColor[index] : k_ThreeColor[index];
+}
+
+// threeColor: BC1 blocks with transparent texels. BC3 color blocks are
+// always decoded in four color mode:
+auto EncodeColorBlock(const Block& block, bool allowTransparent,
+					  DXRBCQuality quality, unsigned char out[8]) -> void
+{
+	std::uint32_t opaqueMask{};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!allowTransparent || block[n][3] >= 128)
+			opaqueMask |= 1u << n;
+	}
+	const auto threeColor = opaqueMask != 0xFFFF;
+
+	ColorBlock best{};
+	if (opaqueMask)
+	{
+		const auto line = FitLine(block, opaqueMask, 3);
+		float e0[3]{};
+		float e1[3]{};
+		for (int c{}; c < 3; c++)
+		{
+			e0[c] = LineEndpoint(line, line.maxT, c);
+			e1[c] = LineEndpoint(line, line.minT, c);
+		}
+		best = EvaluateColorBlock(block, opaqueMask, Pack565(e0), Pack565(e1),
+								  threeColor);
+
+		const auto iterations = quality == DXRBCQuality::Fast     ? 0
+								: quality == DXRBCQuality::Normal ? 1
+																  : 4;
+		for (int iteration{}; iteration < iterations && best.error > 0;
+			 iteration++)
+		{
+			const auto fourColor = best.c0 > best.c1;
+			std::array<float, 16> weights{};
+			for (std::size_t n{}; n < 16; n++)
+			{
+				weights[n] =
+					GetColorWeight((best.indices >> (n * 2)) & 3, fourColor);
+			}
+			float r0[4]{};
+			float r1[4]{};
+			if (!SolveEndpoints(block, opaqueMask, weights, 3, r0, r1))
+				break;
+
+			const auto refined = EvaluateColorBlock(
+				block, opaqueMask, Pack565(r0), Pack565(r1), threeColor);
+			if (refined.error >= best.error)
+				break;
+			best = refined;
+		}
+	}
+	else
+	{
+		// Everything transparent:
+		best.c0 = 0;
+		best.c1 = 0;
+		best.indices = 0xFFFFFFFF;
+	}
+
+	out[0] = static_cast<unsigned char>(best.c0 & 0xFF);
+	out[1] = static_cast<unsigned char>(best.c0 >> 8);
+	out[2] = static_cast<unsigned char>(best.c1 & 0xFF);
+	out[3] = static_cast<unsigned char>(best.c1 >> 8);
+	for (std::uint32_t n{}; n < 4; n++)
+	{
+		out[4 + n] = static_cast<unsigned char>((best.indices >> (n * 8)) & 0xFF);
+	}
+}
+
+auto DecodeColorBlock(const unsigned char in[8], bool forceFourColor,
+					  Block& block) -> void
+{
+	const auto c0 = static_cast<std::uint32_t>(in[0] | (in[1] << 8));
+	const auto c1 = static_cast<std::uint32_t>(in[2] | (in[3] << 8));
+	const auto indices = static_cast<std::uint32_t>(in[4]) |
+						 (static_cast<std::uint32_t>(in[5]) << 8) |
+						 (static_cast<std::uint32_t>(in[6]) << 16) |
+						 (static_cast<std::uint32_t>(in[7]) << 24);
+	int palette[4][4]{};
+	GetColorPalette(c0, c1, forceFourColor || c0 > c1, palette);
+	for (std::size_t n{}; n < 16; n++)
+	{
+		const auto index = (indices >> (n * 2)) & 3;
+		for (std::size_t c{}; c < 4; c++)
+		{
+			block[n][c] = palette[index][c];
+		}
+	}
+}
+
+// BC3 alpha:
+
+auto GetAlphaPalette(int a0, int a1, int palette[8]) -> void
+{
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int i{1}; i < 7; i++)
+		{
+			palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+	}
+	else
+	{
+		for (int i{1}; i < 5; i++)
+		{
+			palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+auto EncodeAlphaBlock(const Block& block, unsigned char out[8]) -> void
+{
+	int a0{};
+	int a1{255};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		a0 = std::max(a0, block[n][3]);
+		a1 = std::min(a1, block[n][3]);
+	}
+
+	int palette[8]{};
+	GetAlphaPalette(a0, a1, palette);
+	std::uint64_t indices{};
+	if (a0 != a1)
+	{
+		for (std::size_t n{}; n < 16; n++)
+		{
+			std::uint64_t index{};
+			auto best = std::numeric_limits<int>::max();
+			for (int i{}; i < 8; i++)
+			{
+				const auto error = std::abs(block[n][3] - palette[i]);
+				if (error < best)
+				{
+					best = error;
+					index = static_cast<std::uint64_t>(i);
+				}
+			}
+			indices |= index << (n * 3);
+		}
+	}
+
+	out[0] = static_cast<unsigned char>(a0);
+	out[1] = static_cast<unsigned char>(a1);
+	for (std::uint32_t n{}; n < 6; n++)
+	{
+		out[2 + n] = static_cast<unsigned char>((indices >> (n * 8)) & 0xFF);
+	}
+}
+
+auto DecodeAlphaBlock(const unsigned char in[8], Block& block) -> void
+{
+	int palette[8]{};
+	GetAlphaPalette(in[0], in[1], palette);
+	std::uint64_t indices{};
+	for (std::uint32_t n{}; n < 6; n++)
+	{
+		indices |= static_cast<std::uint64_t>(in[2 + n]) << (n * 8);
+	}
+	for (std::size_t n{}; n < 16; n++)
+	{
+		block[n][3] = palette[(indices >> (n * 3)) & 7];
+	}
+}
+
+// BC7:
+
+// 128 bit little endian bit stream:
+struct BitStream
+{
+	unsigned char bytes[16]{};
+	std::uint32_t position{};
+
+	inline auto Write(std::uint32_t value, std::uint32_t bits) -> void
+	{
+		for (std::uint32_t n{}; n < bits; n++, position++)
+		{
+			if (value & (1u << n))
+				bytes[position >> 3] |= static_cast<unsigned char>(
+					1u << (position & 7));
+		}
+	}
+
+	inline auto Read(std::uint32_t bits) -> std::uint32_t
+	{
+		std::uint32_t value{};
+		for (std::uint32_t n{}; n < bits; n++, position++)
+		{
+			value |= static_cast<std::uint32_t>(
+						 (bytes[position >> 3] >> (position & 7)) & 1)
+					 << n;
+		}
+		return value;
+	}
+};
+
+constexpr int k_BC7Weights2[4]{0, 21, 43, 64};
+constexpr int k_BC7Weights3[8]{0, 9, 18, 27, 37, 46, 55, 64};
+constexpr int k_BC7Weights4[16]{0,	4,	9,	13, 17, 21, 26, 30,
+								34, 38, 43, 47, 51, 55, 60, 64};
+
+auto GetBC7Weights(std::uint32_t indexBits) -> const int*
+{
+	return indexBits == 2	? k_BC7Weights2
+		   : indexBits == 3 ? k_BC7Weights3
+							: k_BC7Weights4;
+}
+
+auto BC7Interpolate(int e0, int e1, int weight) -> int
+{
+	return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// Two subset partitions, bit n set = texel n belongs to subset 1:
+constexpr std::uint16_t k_BC7Partitions2[64]{
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+// Anchor texel of subset 1, its index drops the top bit:
+constexpr std::uint8_t k_BC7Anchors2[64]{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 2,	8,	2,	2,	8,	8,	15, 2,	8,	2,	2,	8,	8,	2,	2,
+	15, 15, 6,	8,	2,	8,	15, 15, 2,	8,	2,	2,	2,	15, 15, 6,
+	6,	2,	6,	8,	15, 15, 2,	2,	15, 15, 15, 15, 15, 2,	2,	15,
+};
+
+// One encoded subset: quantized endpoints (with p-bits already applied)
+// and per texel indices.
+struct BC7Subset
+{
+	// Stored bits per channel, p-bit per endpoint:
+	int q0[4]{};
+	int q1[4]{};
+	int p0{};
+	int p1{};
+	// Unquantized 8 bit endpoints:
+	int e0[4]{};
+	int e1[4]{};
+};
+
+struct BC7Candidate
+{
+	int mode{};
+	int partition{};
+	BC7Subset subsets[2]{};
+	std::uint32_t indices[16]{};
+	int error{std::numeric_limits<int>::max()};
+};
+
+// Quantizes one endpoint to `bits` + p-bit and expands it back:
+auto QuantizeBC7Endpoint(const float value[4], int channels, int bits, int p,
+						 int q[4], int e[4]) -> void
+{
+	const auto total = bits + 1;
+	const auto maxValue = (1 << bits) - 1;
+	for (int c{}; c < channels; c++)
+	{
+		// Value in [0, 2^total - 1], with the p-bit fixed as the lowest bit:
+		const auto scaled =
+			value[c] * static_cast<float>((1 << total) - 1) / 255.f;
+		q[c] = std::clamp(
+			static_cast<int>(std::floor((scaled - static_cast<float>(p)) / 2.f +
+										0.5f)),
+			0, maxValue);
+		const auto v = (q[c] << 1) | p;
+		e[c] = (v << (8 - total)) | (v >> (2 * total - 8));
+	}
+	for (int c{channels}; c < 4; c++)
+	{
+		q[c] = 0;
+		e[c] = 255;
+	}
+}
+
+// Picks the closest palette entry for every texel in the subset, returns
+// the squared error:
+auto AssignBC7Indices(const Block& block, std::uint32_t mask,
+					  const BC7Subset& subset, std::uint32_t indexBits,
+					  std::uint32_t indices[16]) -> int
+{
+	const auto weights = GetBC7Weights(indexBits);
+	const auto count = 1 << indexBits;
+	int palette[16][4]{};
+	for (int i{}; i < count; i++)
+	{
+		for (int c{}; c < 4; c++)
+		{
+			palette[i][c] =
+				BC7Interpolate(subset.e0[c], subset.e1[c], weights[i]);
+		}
+	}
+
+	int total{};
+	for (std::size_t n{}; n < 16; n++)
+	{
+		if (!(mask & (1u << n)))
+			continue;
+		auto best = std::numeric_limits<int>::max();
+		for (int i{}; i < count; i++)
+		{
+			int error{};
+			for (std::size_t c{}; c < 4; c++)
+			{
+				error += Square(block[n][c] - palette[i][c]);
+			}
+			if (error < best)
+			{
+				best = error;
+				indices[n] = static_cast<std::uint32_t>(i);
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+// Endpoint fit + p-bit choice + refinement for one subset:
+// mode 6: 7 bit RGBA, p-bit per endpoint, 4 bit indices.
+// mode 1: 6 bit RGB, one shared p-bit, 3 bit indices.
+auto EncodeBC7Subset(const Block& block, std::uint32_t mask, int mode,
+					 DXRBCQuality quality, BC7Subset& subset,
+					 std::uint32_t indices[16]) -> int
+{
+	const auto channels = mode == 6 ? 4 : 3;
+	const auto bits = mode == 6 ? 7 : 6;
+	const std::uint32_t indexBits = mode == 6 ? 4 : 3;
+	const auto sharedPBit = mode == 1;
+
+	const auto line = FitLine(block, mask, channels);
+	float e0[4]{};
+	float e1[4]{};
+	for (int c{}; c < channels; c++)
+	{
+		e0[c] = LineEndpoint(line, line.minT, c);
+		e1[c] = LineEndpoint(line, line.maxT, c);
+	}
+
+	const auto tryEndpoints = [&](const float f0[4], const float f1[4],
+								  BC7Subset& bestSubset,
+								  std::uint32_t bestIndices[16],
+								  int bestError) -> int {
+		// Fast only tries p-bits of zero and one:
+		const auto combinations =
+			quality == DXRBCQuality::Fast || sharedPBit ? 2 : 4;
+		for (int combination{}; combination < combinations; combination++)
+		{
+			BC7Subset candidate{};
+			candidate.p0 = combination & 1;
+			candidate.p1 = sharedPBit || quality == DXRBCQuality::Fast
+							   ? candidate.p0
+							   : combination >> 1;
+			QuantizeBC7Endpoint(f0, channels, bits, candidate.p0, candidate.q0,
+								candidate.e0);
+			QuantizeBC7Endpoint(f1, channels, bits, candidate.p1, candidate.q1,
+								candidate.e1);
+			std::uint32_t candidateIndices[16]{};
+			const auto error = AssignBC7Indices(block, mask, candidate,
+												indexBits, candidateIndices);
+			if (error < bestError)
+			{
+				bestError = error;
+				bestSubset = candidate;
+				// The other subset's texels share the array:
+				for (std::size_t n{}; n < 16; n++)
+				{
+					if (mask & (1u << n))
+						bestIndices[n] = candidateIndices[n];
+				}
+			}
+		}
+		return bestError;
+	};
+
+	auto error = tryEndpoints(e0, e1, subset, indices,
+							  std::numeric_limits<int>::max());
+
+	const auto iterations = quality == DXRBCQuality::Fast     ? 0
+							: quality == DXRBCQuality::Normal ? 1
+															  : 3;
+	const auto weights = GetBC7Weights(indexBits);
+	for (int iteration{}; iteration < iterations && error > 0; iteration++)
+	{
+		std::array<float, 16> w{};
+		for (std::size_t n{}; n < 16; n++)
+		{
+			w[n] = static_cast<float>(weights[indices[n]]) / 64.f;
+		}
+		float r0[4]{};
+		float r1[4]{};
+		if (!SolveEndpoints(block, mask, w, channels, r0, r1))
+			break;
+
+		const auto refined = tryEndpoints(r0, r1, subset, indices, error);
+		if (refined >= error)
+			break;
+		error = refined;
+	}
+	return error;
+}
+
+auto EncodeBC7Mode6(const Block& block, DXRBCQuality quality) -> BC7Candidate
+{
+	BC7Candidate candidate{};
+	candidate.mode = 6;
+	candidate.error = EncodeBC7Subset(block, 0xFFFF, 6, quality,
+									  candidate.subsets[0], candidate.indices);
+	return candidate;
+}
+
+auto EncodeBC7Mode1(const Block& block, int partition, DXRBCQuality quality)
+	-> BC7Candidate
+{
+	BC7Candidate candidate{};
+	candidate.mode = 1;
+	candidate.partition = partition;
+	const std::uint32_t mask1 = k_BC7Partitions2[partition];
+	const auto mask0 = ~mask1 & 0xFFFF;
+	candidate.error =
+		EncodeBC7Subset(block, mask0, 1, quality, candidate.subsets[0],
+						candidate.indices) +
+		EncodeBC7Subset(block, mask1, 1, quality, candidate.subsets[1],
+						candidate.indices);
+	return candidate;
+}
+
+auto PackBC7(BC7Candidate candidate, unsigned char out[16]) -> void
+{
+	const auto subsets = candidate.mode == 1 ? 2 : 1;
+	const std::uint32_t indexBits = candidate.mode == 6 ? 4 : 3;
+	const auto channels = candidate.mode == 6 ? 4 : 3;
+	const std::uint32_t bits = candidate.mode == 6 ? 7 : 6;
+	const auto maxIndex = (1u << indexBits) - 1;
+	const std::uint32_t mask1 =
+		candidate.mode == 1 ? k_BC7Partitions2[candidate.partition] : 0;
+
+	// The anchor texel of every subset has an implicit zero top bit, swap
+	// endpoints and flip indices where that isn't the case:
+	for (int s{}; s < subsets; s++)
+	{
+		const std::uint32_t anchor =
+			s == 0 ? 0 : k_BC7Anchors2[candidate.partition];
+		if (!(candidate.indices[anchor] & (1u << (indexBits - 1))))
+			continue;
+
+		auto& subset = candidate.subsets[s];
+		std::swap(subset.q0, subset.q1);
+		std::swap(subset.e0, subset.e1);
+		std::swap(subset.p0, subset.p1);
+		for (std::uint32_t n{}; n < 16; n++)
+		{
+			const auto inSubset = ((mask1 >> n) & 1) == static_cast<std::uint32_t>(s);
+			if (inSubset)
+				candidate.indices[n] = maxIndex - candidate.indices[n];
+		}
+	}
+
+	BitStream stream{};
+	stream.Write(1u << candidate.mode, static_cast<std::uint32_t>(candidate.mode) + 1);
+	if (candidate.mode == 1)
+	{
+		stream.Write(static_cast<std::uint32_t>(candidate.partition), 6);
+	}
+	for (int c{}; c < channels; c++)
+	{
+		for (int s{}; s < subsets; s++)
+		{
+			stream.Write(static_cast<std::uint32_t>(candidate.subsets[s].q0[c]),
+						 bits);
+			stream.Write(static_cast<std::uint32_t>(candidate.subsets[s].q1[c]),
+						 bits);
+		}
+	}
+	if (candidate.mode == 6)
+	{
+		stream.Write(static_cast<std::uint32_t>(candidate.subsets[0].p0), 1);
+		stream.Write(static_cast<std::uint32_t>(candidate.subsets[0].p1), 1);
+	}
+	else
+	{
+		stream.Write(static_cast<std::uint32_t>(candidate.subsets[0].p0), 1);
+		stream.Write(static_cast<std::uint32_t>(candidate.subsets[1].p0), 1);
+	}
+	for (std::uint32_t n{}; n < 16; n++)
+	{
+		const auto anchor =
+			n == 0 ||
+			(candidate.mode == 1 && n == k_BC7Anchors2[candidate.partition]);
+		stream.Write(candidate.indices[n], anchor ? indexBits - 1 : indexBits);
+	}
+	memcpy(out, stream.bytes, 16);
+}
+
+auto EncodeBC7Block(const Block& block, DXRBCQuality quality,
+					unsigned char out[16]) -> void
+{
+	auto best = EncodeBC7Mode6(block, quality);
+
+	auto opaque = true;
+	for (std::size_t n{}; n < 16; n++)
+	{
+		opaque = opaque && block[n][3] == 255;
+	}
+
+	// Mode 1 has no alpha, only worth it for opaque blocks that one line
+	// can't represent well:
+	if (quality == DXRBCQuality::High && opaque && best.error > 16 * 4)
+	{
+		// Rank partitions by how well two lines fit, encode the best few:
+		constexpr int k_Candidates{4};
+		std::array<std::pair<float, int>, 64> ranked{};
+		for (int partition{}; partition < 64; partition++)
+		{
+			const std::uint32_t mask1 = k_BC7Partitions2[partition];
+			const auto mask0 = ~mask1 & 0xFFFF;
+			ranked[static_cast<std::size_t>(partition)] = {
+				LineError(block, mask0, FitLine(block, mask0, 3), 3) +
+					LineError(block, mask1, FitLine(block, mask1, 3), 3),
+				partition};
+		}
+		std::partial_sort(ranked.begin(), ranked.begin() + k_Candidates,
+						  ranked.end());
+		for (int n{}; n < k_Candidates; n++)
+		{
+			const auto candidate = EncodeBC7Mode1(
+				block, ranked[static_cast<std::size_t>(n)].second, quality);
+			if (candidate.error < best.error)
+				best = candidate;
+		}
+	}
+
+	PackBC7(best, out);
+}
+
+auto DecodeBC7Block(const unsigned char in[16], Block& block) -> void
+{
+	BitStream stream{};
+	memcpy(stream.bytes, in, 16);
+
+	int mode{};
+	while (mode < 8 && !stream.Read(1))
+	{
+		mode++;
+	}
+	if (mode != 1 && mode != 6)
+	{
+		block = {};
+		return;
+	}
+
+	const auto subsets = mode == 1 ? 2 : 1;
+	const std::uint32_t indexBits = mode == 6 ? 4 : 3;
+	const auto channels = mode == 6 ? 4 : 3;
+	const std::uint32_t bits = mode == 6 ? 7 : 6;
+	const auto partition = mode == 1 ? static_cast<int>(stream.Read(6)) : 0;
+	const std::uint32_t mask1 = mode == 1 ? k_BC7Partitions2[partition] : 0;
+
+	int q[2][2][4]{};
+	for (int c{}; c < channels; c++)
+	{
+		for (int s{}; s < subsets; s++)
+		{
+			q[s][0][c] = static_cast<int>(stream.Read(bits));
+			q[s][1][c] = static_cast<int>(stream.Read(bits));
+		}
+	}
+	int p[2][2]{};
+	if (mode == 6)
+	{
+		p[0][0] = static_cast<int>(stream.Read(1));
+		p[0][1] = static_cast<int>(stream.Read(1));
+	}
+	else
+	{
+		p[0][0] = p[0][1] = static_cast<int>(stream.Read(1));
+		p[1][0] = p[1][1] = static_cast<int>(stream.Read(1));
+	}
+
+	int e[2][2][4]{};
+	const auto total = static_cast<int>(bits) + 1;
+	for (int s{}; s < subsets; s++)
+	{
+		for (int k{}; k < 2; k++)
+		{
+			for (int c{}; c < 4; c++)
+			{
+				if (c >= channels)
+				{
+					e[s][k][c] = 255;
+					continue;
+				}
+				const auto v = (q[s][k][c] << 1) | p[s][k];
+				e[s][k][c] = (v << (8 - total)) | (v >> (2 * total - 8));
+			}
+		}
+	}
+
+	const auto weights = GetBC7Weights(indexBits);
+	for (std::uint32_t n{}; n < 16; n++)
+	{
+		const auto anchor =
+			n == 0 || (mode == 1 && n == k_BC7Anchors2[partition]);
+		const auto index = stream.Read(anchor ? indexBits - 1 : indexBits);
+		const auto s = (mask1 >> n) & 1;
+		for (std::size_t c{}; c < 4; c++)
+		{
+			block[n][c] = BC7Interpolate(e[s][0][c], e[s][1][c], weights[index]);
+		}
+	}
+}
+
+auto IsBlockCompressed(DXRTextureFormat format) -> bool
+{
+	return format == DXRTextureFormat::BC1Unorm ||
+		   format == DXRTextureFormat::BC3Unorm ||
+		   format == DXRTextureFormat::BC7Unorm;
+}
+} // namespace
+
+auto EncodeBlockCompressed(const DXRImageRGBA8& image, DXRCompressedImage& out,
+						   const DXRBCEncodeDesc& desc) -> bool
+{
+	if (image.width <= 0 || image.height <= 0 ||
+		!IsBlockCompressed(desc.format))
+		return false;
+
+	out.format = desc.format;
+	out.width = image.width;
+	out.height = image.height;
+	const auto blocksWide = out.GetBlocksWide();
+	const auto blocksHigh = out.GetBlocksHigh();
+	const auto bytesPerBlock = GetTextureFormatInfo(desc.format).bytesPerBlock;
+	out.blocks.resize(out.GetRowPitch() * blocksHigh);
+
+	auto threads = desc.threadCount;
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	if (static_cast<std::size_t>(blocksWide) * blocksHigh < k_ParallelMinBlocks)
+	{
+		threads = 1;
+	}
+
+	DXRParallelRows(blocksHigh, threads, desc.jobs, [&](std::uint32_t begin, std::uint32_t end) {
+		for (auto by = begin; by < end; by++)
+		{
+			for (std::uint32_t bx{}; bx < blocksWide; bx++)
+			{
+				const auto block = FetchBlock(image, bx, by);
+				const auto dst = out.blocks.data() + by * out.GetRowPitch() +
+								 static_cast<std::size_t>(bx) * bytesPerBlock;
+				switch (desc.format)
+				{
+				case DXRTextureFormat::BC1Unorm:
+					EncodeColorBlock(block, true, desc.quality, dst);
+					break;
+				case DXRTextureFormat::BC3Unorm:
+					EncodeAlphaBlock(block, dst);
+					EncodeColorBlock(block, false, desc.quality, dst + 8);
+					break;
+				default:
+					EncodeBC7Block(block, desc.quality, dst);
+					break;
+				}
+			}
+		}
+	});
+	return true;
+}
+
+auto EncodeBlockCompressedMips(std::span<const DXRImageRGBA8> mips,
+							   std::vector<DXRCompressedImage>& out,
+							   const DXRBCEncodeDesc& desc) -> bool
+{
+	out.resize(mips.size());
+	for (std::size_t n{}; n < mips.size(); n++)
+	{
+		if (!EncodeBlockCompressed(mips[n], out[n], desc))
+			return false;
+	}
+	return true;
+}
+
+auto DecodeBlockCompressed(const DXRCompressedImage& image, DXRImageRGBA8& out)
+	-> bool
+{
+	if (image.width <= 0 || image.height <= 0 ||
+		!IsBlockCompressed(image.format) ||
+		image.blocks.size() < image.GetRowPitch() * image.GetBlocksHigh())
+		return false;
+
+	out.width = image.width;
+	out.height = image.height;
+	out.pixels.resize(out.GetRowPitch() * static_cast<std::size_t>(out.height));
+
+	const auto bytesPerBlock = GetTextureFormatInfo(image.format).bytesPerBlock;
+	for (std::uint32_t by{}; by < image.GetBlocksHigh(); by++)
+	{
+		for (std::uint32_t bx{}; bx < image.GetBlocksWide(); bx++)
+		{
+			const auto src = image.blocks.data() + by * image.GetRowPitch() +
+							 static_cast<std::size_t>(bx) * bytesPerBlock;
+			Block block{};
+			switch (image.format)
+			{
+			case DXRTextureFormat::BC1Unorm:
+				DecodeColorBlock(src, false, block);
+				break;
+			case DXRTextureFormat::BC3Unorm:
+				DecodeColorBlock(src + 8, true, block);
+				DecodeAlphaBlock(src, block);
+				break;
+			default:
+				DecodeBC7Block(src, block);
+				break;
+			}
+			StoreBlock(block, out, bx, by);
+		}
+	}
+	return true;
+}
+
+auto ComputePSNR(const DXRImageRGBA8& a, const DXRImageRGBA8& b,
+				 bool withAlpha) -> double
+{
+	if (a.width != b.width || a.height != b.height || a.pixels.empty())
+		return 0.0;
+
+	double sum{};
+	std::size_t count{};
+	for (std::size_t n{}; n < a.pixels.size(); n++)
+	{
+		if (!withAlpha && (n & 3) == 3)
+			continue;
+		const auto d = static_cast<double>(a.pixels[n]) -
+					   static_cast<double>(b.pixels[n]);
+		sum += d * d;
+		count++;
+	}
+	if (sum == 0.0)
+		return std::numeric_limits<double>::infinity();
+
+	const auto mse = sum / static_cast<double>(count);
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
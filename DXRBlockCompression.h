@@ -0,0 +1,57 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRAssets.h"
+
+#include <span>
+#include <vector>
+
+struct DXRJobSystem;
+
+// BCn encoder for the asset import path, plus a CPU decoder to verify it:
+//   BC1: RGB 5:6:5 endpoints, 2 bit indices, 1 bit alpha (alpha < 128 is
+//        encoded as the transparent index).
+//   BC3: BC1 color block + 8 bit alpha endpoints with 3 bit indices.
+//   BC7: mode 6 (one RGBA subset, 7 bit endpoints + p-bits, 4 bit indices)
+//        for every block, High also tries mode 1 (two RGB subsets, 64
+//        partitions) on opaque blocks and keeps whichever is closer.
+// The decoder handles BC1, BC3 and the BC7 modes the encoder emits, other
+// BC7 modes decode to transparent black.
+// Partial blocks at the right/bottom edge repeat the last texel.
+enum struct DXRBCQuality
+{
+	// Principal axis endpoints, no refinement:
+	Fast,
+	// + least squares endpoint refinement, p-bit search:
+	Normal,
+	// + more refinement, BC7 mode 1 partition search:
+	High,
+};
+
+struct DXRBCEncodeDesc
+{
+	DXRTextureFormat format{DXRTextureFormat::BC7Unorm};
+	DXRBCQuality quality{DXRBCQuality::Normal};
+	// 0 uses every core, small images always run on the calling thread:
+	std::uint32_t threadCount{};
+	// Block rows run on its threads if set, else on threads started per
+	// image:
+	DXRJobSystem* jobs{};
+};
+
+// Returns false for empty images or formats that aren't BCn:
+auto EncodeBlockCompressed(const DXRImageRGBA8& image, DXRCompressedImage& out,
+						   const DXRBCEncodeDesc& desc = {}) -> bool;
+
+// Every mip of a chain (DXRMipGenerator.h), same format for all of them:
+auto EncodeBlockCompressedMips(std::span<const DXRImageRGBA8> mips,
+							   std::vector<DXRCompressedImage>& out,
+							   const DXRBCEncodeDesc& desc = {}) -> bool;
+
+auto DecodeBlockCompressed(const DXRCompressedImage& image,
+						   DXRImageRGBA8& out) -> bool;
+
+// Peak signal to noise ratio in dB over RGB (and alpha if asked).
+// Identical images return +inf:
+auto ComputePSNR(const DXRImageRGBA8& a, const DXRImageRGBA8& b,
+				 bool withAlpha = false) -> double;
@@ -0,0 +1,556 @@
+#include "DXRBvh.h"
+#include "DXRJobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+struct Bounds
+{
+	glm::vec3 min{std::numeric_limits<float>::max()};
+	glm::vec3 max{-std::numeric_limits<float>::max()};
+
+	auto Grow(const glm::vec3& point) -> void
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	auto Grow(const Bounds& other) -> void
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	// Half the surface area is enough for SAH ratios:
+	auto GetHalfArea() const -> float
+	{
+		const auto extent = max - min;
+		if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f)
+			return 0.f;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+};
+
+auto GetHalfArea(const DXRBvhNode& node) -> float
+{
+	return Bounds{node.boundsMin, node.boundsMax}.GetHalfArea();
+}
+
+auto GetPosition(const DXRVertex3D& vertex) -> glm::vec3
+{
+	return {vertex.x, vertex.y, vertex.z};
+}
+
+// A primitive's bounds, moved around by the partitions so every pass reads
+// its range front to back:
+struct PrimitiveRef
+{
+	glm::vec3 min{};
+	// What ends up in DXRBvh::primitives:
+	std::uint32_t index{};
+	glm::vec3 max{};
+
+	auto GetCentroid() const -> glm::vec3
+	{
+		return (min + max) * 0.5f;
+	}
+};
+
+struct Bin
+{
+	Bounds bounds{};
+	std::uint32_t count{};
+};
+
+using Bins = std::array<std::array<Bin, DXRBvhBuildDesc::k_MaxBins>, 3>;
+
+// Median splits from here on take at most 32 more levels:
+constexpr std::uint32_t k_SahDepth{DXRBvh::k_MaxDepth - 32};
+
+struct Builder
+{
+	const DXRBvhBuildDesc& desc;
+	DXRJobSystem* jobs{};
+	std::uint32_t binCount{};
+	// Partitioned in place, leaves are ranges of it:
+	std::vector<PrimitiveRef> primitives{};
+	// 2n - 1 nodes, every subtree owns a range big enough for the worst
+	// case, the unused rest stays as gaps until Compact():
+	std::vector<DXRBvhNode> nodes{};
+
+	auto IsParallel(std::size_t count) const -> bool
+	{
+		return jobs && count >= desc.parallelThreshold;
+	}
+
+	auto ComputeBounds(std::size_t begin, std::size_t end, Bounds& node,
+					   Bounds& centroid) const -> void
+	{
+		const auto reduce = [&](std::size_t first, std::size_t last,
+								Bounds& outNode, Bounds& outCentroid) {
+			for (auto n = first; n < last; n++)
+			{
+				const auto& primitive = primitives[n];
+				outNode.Grow(Bounds{primitive.min, primitive.max});
+				outCentroid.Grow(primitive.GetCentroid());
+			}
+		};
+		if (!IsParallel(end - begin))
+		{
+			reduce(begin, end, node, centroid);
+			return;
+		}
+		// Min and max are exact, the merge order doesn't matter:
+		std::mutex mutex{};
+		jobs->ParallelFor(begin, end, 1024,
+						  [&](std::size_t first, std::size_t last) {
+							  Bounds localNode{};
+							  Bounds localCentroid{};
+							  reduce(first, last, localNode, localCentroid);
+							  std::lock_guard lock{mutex};
+							  node.Grow(localNode);
+							  centroid.Grow(localCentroid);
+						  });
+	}
+
+	auto GetBin(const glm::vec3& centroid, const Bounds& centroidBounds,
+				const glm::vec3& scale, int axis) const -> std::uint32_t
+	{
+		const auto bin = static_cast<std::uint32_t>(
+			(centroid[axis] - centroidBounds.min[axis]) * scale[axis]);
+		return std::min(bin, binCount - 1);
+	}
+
+	auto FillBins(std::size_t begin, std::size_t end,
+				  const Bounds& centroidBounds, const glm::vec3& scale,
+				  Bins& bins) const -> void
+	{
+		const auto fill = [&](std::size_t first, std::size_t last,
+							  Bins& out) {
+			for (auto n = first; n < last; n++)
+			{
+				const auto& primitive = primitives[n];
+				const auto centroid = primitive.GetCentroid();
+				for (int axis{}; axis < 3; axis++)
+				{
+					if (scale[axis] <= 0.f)
+						continue;
+					const auto b =
+						GetBin(centroid, centroidBounds, scale, axis);
+					auto& bin = out[static_cast<std::size_t>(axis)][b];
+					bin.bounds.Grow(Bounds{primitive.min, primitive.max});
+					bin.count++;
+				}
+			}
+		};
+		for (auto& axisBins : bins)
+		{
+			std::fill_n(axisBins.begin(), binCount, Bin{});
+		}
+		if (!IsParallel(end - begin))
+		{
+			fill(begin, end, bins);
+			return;
+		}
+		std::mutex mutex{};
+		jobs->ParallelFor(begin, end, 1024,
+						  [&](std::size_t first, std::size_t last) {
+							  Bins local{};
+							  fill(first, last, local);
+							  std::lock_guard lock{mutex};
+							  for (std::size_t axis{}; axis < 3; axis++)
+							  {
+								  for (std::uint32_t b{}; b < binCount; b++)
+								  {
+									  bins[axis][b].bounds.Grow(
+										  local[axis][b].bounds);
+									  bins[axis][b].count +=
+										  local[axis][b].count;
+								  }
+							  }
+						  });
+	}
+
+	// node is the first index of the subtree's range, next the first one
+	// its descendants may use. bins is scratch space, one per thread:
+	auto Build(std::uint32_t node, std::uint32_t begin, std::uint32_t end,
+			   std::uint32_t next, std::uint32_t depth, Bins& bins) -> void
+	{
+		const auto count = end - begin;
+		Bounds nodeBounds{};
+		Bounds centroidBounds{};
+		ComputeBounds(begin, end, nodeBounds, centroidBounds);
+		auto& entry = nodes[node];
+		entry.boundsMin = nodeBounds.min;
+		entry.boundsMax = nodeBounds.max;
+		entry.leftOrFirst = begin;
+		entry.count = count;
+		if (count == 1)
+			return;
+
+		// Costs relative to this node's area, the leaf is one test per
+		// triangle:
+		const auto leafCost = desc.intersectionCost * static_cast<float>(count);
+		auto bestCost = std::numeric_limits<float>::max();
+		int bestAxis{-1};
+		std::uint32_t bestSplit{};
+
+		const auto extent = centroidBounds.max - centroidBounds.min;
+		glm::vec3 scale{};
+		for (int axis{}; axis < 3; axis++)
+		{
+			scale[axis] = extent[axis] > 0.f
+							  ? static_cast<float>(binCount) / extent[axis]
+							  : 0.f;
+		}
+		const auto area = nodeBounds.GetHalfArea();
+		// Past k_SahDepth only median splits, whatever the SAH would do the
+		// tree stays within DXRBvh::k_MaxDepth levels:
+		const auto sah = depth < k_SahDepth;
+		if (sah && area > 0.f &&
+			(scale.x > 0.f || scale.y > 0.f || scale.z > 0.f))
+		{
+			FillBins(begin, end, centroidBounds, scale, bins);
+			for (int axis{}; axis < 3; axis++)
+			{
+				if (scale[axis] <= 0.f)
+					continue;
+				const auto& axisBins = bins[static_cast<std::size_t>(axis)];
+				// Right side areas and counts, swept from the back:
+				std::array<float, DXRBvhBuildDesc::k_MaxBins> rightCost{};
+				Bounds right{};
+				std::uint32_t rightCount{};
+				for (auto b = binCount - 1; b > 0; b--)
+				{
+					right.Grow(axisBins[b].bounds);
+					rightCount += axisBins[b].count;
+					rightCost[b] =
+						right.GetHalfArea() * static_cast<float>(rightCount);
+				}
+				Bounds left{};
+				std::uint32_t leftCount{};
+				for (std::uint32_t b{1}; b < binCount; b++)
+				{
+					left.Grow(axisBins[b - 1].bounds);
+					leftCount += axisBins[b - 1].count;
+					if (!leftCount || leftCount == count)
+						continue;
+					const auto leftCost =
+						left.GetHalfArea() * static_cast<float>(leftCount);
+					const auto cost = desc.traversalCost +
+									  desc.intersectionCost *
+										  (leftCost + rightCost[b]) / area;
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b;
+					}
+				}
+			}
+		}
+
+		if (count <= desc.maxLeafSize &&
+			(!sah || bestAxis < 0 || leafCost <= bestCost))
+			return;
+
+		auto mid = begin + count / 2;
+		if (!sah)
+		{
+			const auto axis = extent.x > extent.y
+								  ? (extent.x > extent.z ? 0 : 2)
+								  : (extent.y > extent.z ? 1 : 2);
+			std::nth_element(primitives.begin() + begin,
+							 primitives.begin() + mid,
+							 primitives.begin() + end,
+							 [&](const PrimitiveRef& a, const PrimitiveRef& b) {
+								 return a.GetCentroid()[axis] <
+										b.GetCentroid()[axis];
+							 });
+		}
+		else if (bestAxis >= 0)
+		{
+			const auto split = std::partition(
+				primitives.begin() + begin, primitives.begin() + end,
+				[&](const PrimitiveRef& primitive) {
+					return GetBin(primitive.GetCentroid(), centroidBounds,
+								  scale, bestAxis) < bestSplit;
+				});
+			mid = static_cast<std::uint32_t>(split - primitives.begin());
+		}
+		// No split (every centroid in one spot) or a bin boundary that
+		// rounding left empty: halves in whatever order they are in:
+		if (mid == begin || mid == end)
+			mid = begin + count / 2;
+
+		const auto left = next;
+		entry.leftOrFirst = left;
+		entry.count = 0;
+		// A subtree of n triangles has at most 2n - 2 descendants:
+		const auto leftNext = next + 2;
+		const auto rightNext = next + 2 * (mid - begin);
+		if (IsParallel(count))
+		{
+			DXRJobCounter counter{};
+			jobs->Run(
+				[&] {
+					auto jobBins = std::make_unique<Bins>();
+					Build(left, begin, mid, leftNext, depth + 1, *jobBins);
+				},
+				&counter);
+			Build(left + 1, mid, end, rightNext, depth + 1, bins);
+			jobs->Wait(counter);
+			return;
+		}
+		Build(left, begin, mid, leftNext, depth + 1, bins);
+		Build(left + 1, mid, end, rightNext, depth + 1, bins);
+	}
+
+	// Depth first, without the gaps:
+	auto Compact(std::vector<DXRBvhNode>& out) const -> void
+	{
+		out.clear();
+		out.reserve(nodes.size());
+		out.push_back(nodes[0]);
+		// Old index, new index:
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{0, 0}};
+		while (!stack.empty())
+		{
+			const auto [from, to] = stack.back();
+			stack.pop_back();
+			if (nodes[from].IsLeaf())
+				continue;
+			const auto left = nodes[from].leftOrFirst;
+			const auto newLeft = static_cast<std::uint32_t>(out.size());
+			out[to].leftOrFirst = newLeft;
+			out.push_back(nodes[left]);
+			out.push_back(nodes[left + 1]);
+			stack.emplace_back(left + 1, newLeft + 1);
+			stack.emplace_back(left, newLeft);
+		}
+	}
+};
+
+auto Build(std::vector<PrimitiveRef> primitives, DXRBvh& out,
+		   const DXRBvhBuildDesc& desc, DXRJobSystem* jobs) -> void
+{
+	const auto count = static_cast<std::uint32_t>(primitives.size());
+	if (!count)
+		return;
+
+	Builder builder{desc, jobs};
+	builder.binCount =
+		std::clamp(desc.binCount, 2u, DXRBvhBuildDesc::k_MaxBins);
+	builder.primitives = std::move(primitives);
+	builder.nodes.resize(std::size_t{count} * 2 - 1);
+	auto bins = std::make_unique<Bins>();
+	builder.Build(0, 0, count, 1, 1, *bins);
+
+	builder.Compact(out.nodes);
+	out.primitives.resize(count);
+	for (std::uint32_t n{}; n < count; n++)
+	{
+		out.primitives[n] = builder.primitives[n].index;
+	}
+}
+
+auto IntersectTriangle(const glm::vec3& v0, const glm::vec3& v1,
+					   const glm::vec3& v2, const DXRRay& ray, float tMax,
+					   DXRRayHit& hit) -> bool
+{
+	// Möller-Trumbore:
+	const auto edge1 = v1 - v0;
+	const auto edge2 = v2 - v0;
+	const auto p = glm::cross(ray.direction, edge2);
+	const auto determinant = glm::dot(edge1, p);
+	if (std::abs(determinant) < 1e-12f)
+		return false;
+	const auto inverse = 1.f / determinant;
+	const auto s = ray.origin - v0;
+	const auto u = glm::dot(s, p) * inverse;
+	if (u < 0.f || u > 1.f)
+		return false;
+	const auto q = glm::cross(s, edge1);
+	const auto v = glm::dot(ray.direction, q) * inverse;
+	if (v < 0.f || u + v > 1.f)
+		return false;
+	const auto t = glm::dot(edge2, q) * inverse;
+	if (t < ray.tMin || t >= tMax)
+		return false;
+	hit.t = t;
+	hit.u = u;
+	hit.v = v;
+	return true;
+}
+} // namespace
+
+auto BuildBvh(std::span<const DXRVertex3D> vertices,
+			  std::span<const std::uint32_t> indices, DXRBvh& out,
+			  const DXRBvhBuildDesc& desc, DXRJobSystem* jobs) -> bool
+{
+	out = {};
+	if (indices.size() % 3)
+		return false;
+	if (std::any_of(indices.begin(), indices.end(), [&](std::uint32_t index) {
+			return index >= vertices.size();
+		}))
+		return false;
+	const auto triangles = static_cast<std::uint32_t>(indices.size() / 3);
+	std::vector<PrimitiveRef> primitives(triangles);
+	for (std::uint32_t triangle{}; triangle < triangles; triangle++)
+	{
+		Bounds bounds{};
+		for (std::uint32_t corner{}; corner < 3; corner++)
+		{
+			bounds.Grow(GetPosition(vertices[indices[triangle * 3 + corner]]));
+		}
+		primitives[triangle] = {bounds.min, triangle, bounds.max};
+	}
+	Build(std::move(primitives), out, desc, jobs);
+	return true;
+}
+
+auto BuildBvh(std::span<const DXRBvhBounds> bounds, DXRBvh& out,
+			  const DXRBvhBuildDesc& desc, DXRJobSystem* jobs) -> bool
+{
+	out = {};
+	if (std::any_of(bounds.begin(), bounds.end(), [](const DXRBvhBounds& box) {
+			return !glm::all(glm::lessThanEqual(box.min, box.max));
+		}))
+		return false;
+	std::vector<PrimitiveRef> primitives(bounds.size());
+	for (std::size_t n{}; n < bounds.size(); n++)
+	{
+		primitives[n] = {bounds[n].min, static_cast<std::uint32_t>(n),
+						 bounds[n].max};
+	}
+	Build(std::move(primitives), out, desc, jobs);
+	return true;
+}
+
+auto GetBvhStats(const DXRBvh& bvh, const DXRBvhBuildDesc& desc) -> DXRBvhStats
+{
+	DXRBvhStats stats{};
+	if (bvh.nodes.empty())
+		return stats;
+	const auto rootArea = GetHalfArea(bvh.nodes[0]);
+	float cost{};
+	// Node, depth:
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{0, 1}};
+	while (!stack.empty())
+	{
+		const auto [index, depth] = stack.back();
+		stack.pop_back();
+		const auto& node = bvh.nodes[index];
+		stats.nodes++;
+		stats.depth = std::max(stats.depth, depth);
+		const auto area = GetHalfArea(node);
+		if (node.IsLeaf())
+		{
+			stats.leaves++;
+			stats.largestLeaf = std::max(stats.largestLeaf, node.count);
+			cost +=
+				desc.intersectionCost * static_cast<float>(node.count) * area;
+			continue;
+		}
+		cost += desc.traversalCost * area;
+		stack.emplace_back(node.leftOrFirst, depth + 1);
+		stack.emplace_back(node.leftOrFirst + 1, depth + 1);
+	}
+	stats.sahCost = rootArea > 0.f ? cost / rootArea : 0.f;
+	return stats;
+}
+
+auto ValidateBvh(const DXRBvh& bvh, std::span<const DXRVertex3D> vertices,
+				 std::span<const std::uint32_t> indices) -> bool
+{
+	const auto triangles = indices.size() / 3;
+	if (bvh.nodes.empty())
+		return !triangles && bvh.primitives.empty();
+	if (bvh.primitives.size() != triangles)
+		return false;
+
+	std::vector<std::uint8_t> seen(triangles);
+	const auto contains = [](const DXRBvhNode& node, const glm::vec3& min,
+							 const glm::vec3& max) {
+		return glm::all(glm::lessThanEqual(node.boundsMin, min)) &&
+			   glm::all(glm::greaterThanEqual(node.boundsMax, max));
+	};
+	std::vector<std::uint32_t> stack{0};
+	std::uint32_t visited{};
+	while (!stack.empty())
+	{
+		const auto index = stack.back();
+		stack.pop_back();
+		if (++visited > bvh.nodes.size())
+			return false;
+		const auto& node = bvh.nodes[index];
+		if (node.IsLeaf())
+		{
+			if (std::size_t{node.leftOrFirst} + node.count > triangles)
+				return false;
+			for (auto n = node.leftOrFirst; n < node.leftOrFirst + node.count;
+				 n++)
+			{
+				const auto triangle = bvh.primitives[n];
+				if (triangle >= triangles || seen[triangle]++)
+					return false;
+				for (std::size_t corner{}; corner < 3; corner++)
+				{
+					const auto position =
+						GetPosition(vertices[indices[triangle * 3 + corner]]);
+					if (!contains(node, position, position))
+						return false;
+				}
+			}
+			continue;
+		}
+		// Children come after their parent, no cycles:
+		const auto left = node.leftOrFirst;
+		if (left <= index || std::size_t{left} + 1 >= bvh.nodes.size())
+			return false;
+		for (const auto child : {left, left + 1})
+		{
+			if (!contains(node, bvh.nodes[child].boundsMin,
+						  bvh.nodes[child].boundsMax))
+				return false;
+			stack.push_back(child);
+		}
+	}
+	return std::all_of(seen.begin(), seen.end(),
+					   [](std::uint8_t count) { return count == 1; });
+}
+
+auto IntersectBvh(const DXRBvh& bvh, std::span<const DXRVertex3D> vertices,
+				  std::span<const std::uint32_t> indices, const DXRRay& ray,
+				  DXRRayHit& hit) -> bool
+{
+	hit = {};
+	TraverseBvh(
+		bvh, ray.origin, 1.f / ray.direction, ray.tMin, ray.tMax, 1.f,
+		[&](const DXRBvhNode& leaf, float& closest) {
+			for (auto n = leaf.leftOrFirst; n < leaf.leftOrFirst + leaf.count;
+				 n++)
+			{
+				const auto triangle = bvh.primitives[n];
+				const auto* corners = &indices[std::size_t{triangle} * 3];
+				DXRRayHit candidate{};
+				if (IntersectTriangle(GetPosition(vertices[corners[0]]),
+									  GetPosition(vertices[corners[1]]),
+									  GetPosition(vertices[corners[2]]), ray,
+									  closest, candidate))
+				{
+					closest = candidate.t;
+					hit = candidate;
+					hit.triangle = triangle;
+				}
+			}
+			return false;
+		});
+	return hit.triangle != ~0u;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+
+struct DXRJobSystem;
+
+// 32 bytes, two to a cache line. Children of a node are always next to each
+// other, so one index finds both:
+struct DXRBvhNode
+{
+	glm::vec3 boundsMin{};
+	// Leaf: first entry in DXRBvh::primitives. Interior: left child, the
+	// right one is leftOrFirst + 1:
+	std::uint32_t leftOrFirst{};
+	glm::vec3 boundsMax{};
+	// Triangles in the leaf, 0 for interior nodes:
+	std::uint32_t count{};
+
+	inline auto IsLeaf() const -> bool
+	{
+		return count != 0;
+	}
+};
+static_assert(sizeof(DXRBvhNode) == 32);
+
+// Node 0 is the root. Leaves point into primitives, which holds triangle
+// numbers (index / 3), or bounds indices for trees over bounds, in leaf
+// order:
+struct DXRBvh
+{
+	// Levels, root and leaves included:
+	static inline constexpr std::uint32_t k_MaxDepth{64};
+	// Box exits are scaled up by 1 + 2 * gamma(3) so rounding in the slab
+	// test can't miss a box the watertight triangle test would hit (Ize,
+	// "Robust BVH Ray Traversal", 2013):
+	static inline constexpr float k_RobustExitScale{1.00000036f};
+
+	std::vector<DXRBvhNode> nodes{};
+	std::vector<std::uint32_t> primitives{};
+};
+
+struct DXRBvhBounds
+{
+	glm::vec3 min{};
+	glm::vec3 max{};
+};
+
+struct DXRBvhBuildDesc
+{
+	static inline constexpr std::uint32_t k_MaxBins{32};
+
+	// SAH candidates per axis are the boundaries between bins, at most
+	// k_MaxBins:
+	std::uint32_t binCount{16};
+	// Leaves bigger than this are split even if the SAH says otherwise:
+	std::uint32_t maxLeafSize{8};
+	// SAH costs of visiting a node and of testing a triangle:
+	float traversalCost{1.f};
+	float intersectionCost{1.f};
+	// Ranges with this many triangles or more are binned in parallel and
+	// their children built as separate jobs:
+	std::uint32_t parallelThreshold{4096};
+};
+
+struct DXRBvhStats
+{
+	std::uint32_t nodes{};
+	std::uint32_t leaves{};
+	std::uint32_t depth{};
+	std::uint32_t largestLeaf{};
+	// Expected cost of a random ray hitting the root, in desc's units:
+	//   traversalCost * SA(interior) / SA(root) summed over interior nodes
+	// + intersectionCost * count * SA(leaf) / SA(root) summed over leaves.
+	float sahCost{};
+};
+
+struct DXRRay
+{
+	glm::vec3 origin{};
+	glm::vec3 direction{};
+	float tMin{};
+	float tMax{1e30f};
+};
+
+struct DXRRayHit
+{
+	float t{};
+	// Barycentrics of the second and third vertex:
+	float u{};
+	float v{};
+	std::uint32_t triangle{~0u};
+	// Which instance of a DXRRayTopLevel was hit, ~0u for single meshes:
+	std::uint32_t instance{~0u};
+};
+
+// Binned SAH (Wald, "On fast Construction of SAH-based Bounding Volume
+// Hierarchies", 2007) over the triangles of an index buffer. With jobs, the
+// top levels bin in parallel and subtrees build on the job threads; the
+// result is the same either way, nodes end up in depth first order.
+// Returns false if indices isn't whole triangles or references a missing
+// vertex:
+auto BuildBvh(std::span<const DXRVertex3D> vertices,
+			  std::span<const std::uint32_t> indices, DXRBvh& out,
+			  const DXRBvhBuildDesc& desc = {}, DXRJobSystem* jobs = nullptr)
+	-> bool;
+
+inline auto BuildBvh(const DXRIndexedMesh& mesh, DXRBvh& out,
+					 const DXRBvhBuildDesc& desc = {},
+					 DXRJobSystem* jobs = nullptr) -> bool
+{
+	return BuildBvh(mesh.vertices, mesh.indices, out, desc, jobs);
+}
+
+// Same over arbitrary boxes, e.g. the instances of a top level structure.
+// Returns false for inverted bounds:
+auto BuildBvh(std::span<const DXRBvhBounds> bounds, DXRBvh& out,
+			  const DXRBvhBuildDesc& desc = {}, DXRJobSystem* jobs = nullptr)
+	-> bool;
+
+auto GetBvhStats(const DXRBvh& bvh, const DXRBvhBuildDesc& desc = {})
+	-> DXRBvhStats;
+
+// Every triangle in exactly one leaf, children inside their parents, leaves
+// around their triangles:
+auto ValidateBvh(const DXRBvh& bvh, std::span<const DXRVertex3D> vertices,
+				 std::span<const std::uint32_t> indices) -> bool;
+
+// Slab test for a ray through origin with 1 / direction inverseDirection:
+// the distance it enters node at, or tMax if it misses node before tMax.
+// The exit is scaled by exitScale, DXRBvh::k_RobustExitScale for traversals
+// with a watertight triangle test:
+inline auto IntersectBvhBounds(const DXRBvhNode& node, const glm::vec3& origin,
+							   const glm::vec3& inverseDirection, float tMin,
+							   float tMax, float exitScale = 1.f) -> float
+{
+	const auto t0 = (node.boundsMin - origin) * inverseDirection;
+	const auto t1 = (node.boundsMax - origin) * inverseDirection;
+	const auto tNear = glm::min(t0, t1);
+	const auto tFar = glm::max(t0, t1);
+	const auto entry = std::max({tNear.x, tNear.y, tNear.z, tMin});
+	const auto exit =
+		std::min(std::min({tFar.x, tFar.y, tFar.z}) * exitScale, tMax);
+	return entry <= exit ? entry : tMax;
+}
+
+// Depth first walk over the nodes IntersectBvhBounds() says the ray enters,
+// nearer child first. visitLeaf(leaf, closest) tests a leaf's primitives,
+// lowers closest (tMax to start with) to the hits it finds and returns true
+// to end the walk early, e.g. for any hit queries:
+template <typename F>
+inline auto TraverseBvh(const DXRBvh& bvh, const glm::vec3& origin,
+						const glm::vec3& inverseDirection, float tMin,
+						float tMax, float exitScale, F&& visitLeaf) -> void
+{
+	auto closest = tMax;
+	if (bvh.nodes.empty() ||
+		IntersectBvhBounds(bvh.nodes[0], origin, inverseDirection, tMin,
+						   closest, exitScale) >= closest)
+		return;
+
+	// One entry per level at most:
+	std::array<std::uint32_t, DXRBvh::k_MaxDepth> stack{};
+	std::size_t size{};
+	auto index = std::uint32_t{};
+	for (;;)
+	{
+		const auto& node = bvh.nodes[index];
+		if (node.IsLeaf())
+		{
+			if (visitLeaf(node, closest))
+				return;
+		}
+		else
+		{
+			// Nearer child first, the farther one waits on the stack:
+			auto first = node.leftOrFirst;
+			auto second = first + 1;
+			auto firstT =
+				IntersectBvhBounds(bvh.nodes[first], origin, inverseDirection,
+								   tMin, closest, exitScale);
+			auto secondT =
+				IntersectBvhBounds(bvh.nodes[second], origin, inverseDirection,
+								   tMin, closest, exitScale);
+			if (secondT < firstT)
+			{
+				std::swap(first, second);
+				std::swap(firstT, secondT);
+			}
+			if (firstT < closest)
+			{
+				if (secondT < closest)
+					stack[size++] = second;
+				index = first;
+				continue;
+			}
+		}
+		if (!size)
+			break;
+		index = stack[--size];
+	}
+}
+
+// Closest hit in [ray.tMin, ray.tMax), one ray at a time. The reference for
+// DXR and the faster traversals:
+auto IntersectBvh(const DXRBvh& bvh, std::span<const DXRVertex3D> vertices,
+				  std::span<const std::uint32_t> indices, const DXRRay& ray,
+				  DXRRayHit& hit) -> bool;
@@ -0,0 +1,31 @@
+#include "DXRCPUFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+auto CPUSupportsAVX2() -> bool
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+	int info[4]{};
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// OSXSAVE, AVX, FMA, and the OS saves YMM registers:
+	__cpuid(info, 1);
+	const auto ecx = info[2];
+	if (!(ecx & (1 << 27)) || !(ecx & (1 << 28)) || !(ecx & (1 << 12)))
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// What the CPU this runs on can do, for the kernel selectors that pick SIMD
+// code at runtime.
+
+// AVX2 and FMA, and the OS saves YMM registers. false off x86:
+auto CPUSupportsAVX2() -> bool;
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <utility>
 
 #define THREAD_MARKER(x)
 
+#define DXRASSERT(x) assert(x)
+
 struct DXRNonCopyable
 {
 	DXRNonCopyable() = default;
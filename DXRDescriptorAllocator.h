@@ -0,0 +1,204 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRangeAllocator.h"
+#include "DXRUploadRing.h"
+
+#include <utility>
+#include <vector>
+
+// A range of descriptors in a heap. index is what a bindless shader indexes
+// the heap with:
+struct DXRDescriptorAllocation
+{
+	std::uint32_t index{~0u};
+	std::uint32_t count{};
+	// DXRRangeAllocator's block, Free() needs it:
+	std::uint32_t block{~0u};
+
+	inline auto IsValid() const -> bool
+	{
+		return index != ~0u;
+	}
+};
+
+// Descriptor slots [0, capacity) of a heap, long lived views come and go in
+// any order: DXRRangeAllocator counting descriptors.
+struct DXRDescriptorFreeList
+{
+	inline DXRDescriptorFreeList(std::uint32_t capacity = 0)
+	{
+		Reset(capacity);
+	}
+
+	// Forgets every allocation:
+	inline auto Reset(std::uint32_t capacity) -> void
+	{
+		m_ranges.Reset(capacity);
+	}
+
+	// Invalid if there is no free range of count descriptors:
+	inline auto Allocate(std::uint32_t count) -> DXRDescriptorAllocation
+	{
+		const auto range = m_ranges.Allocate(count);
+		if (!range.IsValid())
+			return {};
+		return {static_cast<std::uint32_t>(range.offset), count, range.block};
+	}
+
+	inline auto Free(const DXRDescriptorAllocation& allocation) -> void
+	{
+		if (allocation.IsValid())
+			m_ranges.Free(
+				{allocation.index, allocation.count, allocation.block});
+	}
+
+	inline auto GetCapacity() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_ranges.GetCapacity());
+	}
+
+	inline auto GetUsedCount() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_ranges.GetUsedSize());
+	}
+
+	// Free ranges and the largest of them:
+	inline auto GetFreeRanges(std::uint32_t& largest) const -> std::uint32_t
+	{
+		std::uint64_t size{};
+		const auto ranges = m_ranges.GetFreeRanges(size);
+		largest = static_cast<std::uint32_t>(size);
+		return ranges;
+	}
+
+	// For fuzzing:
+	inline auto Validate() const -> bool
+	{
+		return m_ranges.Validate();
+	}
+
+  private:
+	DXRRangeAllocator m_ranges{};
+};
+
+struct DXRDescriptorAllocatorDesc
+{
+	// Long lived views (textures, buffers, render targets), by index:
+	std::uint32_t persistentCount{};
+	// Per frame tables, right after the persistent ones:
+	std::uint32_t transientCount{};
+};
+
+// One descriptor heap split in two: a DXRDescriptorFreeList for long lived
+// views and a ring for the tables a frame builds and forgets. Both follow
+// DXRUploadRing's Submit()/Retire() protocol on the frame fence: transient
+// ranges come back once their frame retired, and Free()d persistent ranges
+// only after the frames that could still read them retired.
+// The heap is NumDescriptors = GetCapacity(), indices are heap offsets.
+struct DXRDescriptorAllocator
+{
+	inline DXRDescriptorAllocator(const DXRDescriptorAllocatorDesc& desc = {})
+	{
+		Reset(desc);
+	}
+
+	// Forgets every allocation, only call while the queue is idle or when the
+	// heap was recreated:
+	inline auto Reset(const DXRDescriptorAllocatorDesc& desc) -> void
+	{
+		m_persistent.Reset(desc.persistentCount);
+		m_transient.Reset(desc.transientCount);
+		m_transientBase = desc.persistentCount;
+		m_pendingFrees.clear();
+		m_submittedFrees.clear();
+	}
+
+	inline auto GetCapacity() const -> std::uint32_t
+	{
+		return m_transientBase +
+			   static_cast<std::uint32_t>(m_transient.GetCapacity());
+	}
+
+	inline auto AllocatePersistent(std::uint32_t count)
+		-> DXRDescriptorAllocation
+	{
+		return m_persistent.Allocate(count);
+	}
+
+	// Reused after the next Submit()'s fence value completed:
+	inline auto Free(const DXRDescriptorAllocation& allocation) -> void
+	{
+		if (allocation.IsValid())
+			m_pendingFrees.push_back(allocation);
+	}
+
+	// count contiguous descriptors for this frame, false if the ring is full
+	// right now:
+	inline auto AllocateTransient(std::uint32_t count, std::uint32_t& index)
+		-> bool
+	{
+		std::uint64_t offset{};
+		if (!m_transient.Allocate(count, 1, offset))
+			return false;
+		index = m_transientBase + static_cast<std::uint32_t>(offset);
+		return true;
+	}
+
+	// Same, retiring and waiting on the queue when the ring is full:
+	template <typename Queue>
+	inline auto AllocateTransient(Queue& queue, std::uint32_t count,
+								  std::uint32_t& index) -> bool
+	{
+		std::uint64_t offset{};
+		if (!m_transient.Allocate(queue, count, 1, offset))
+			return false;
+		index = m_transientBase + static_cast<std::uint32_t>(offset);
+		return true;
+	}
+
+	inline auto Submit(std::uint64_t fenceValue) -> void
+	{
+		m_transient.Submit(fenceValue);
+		for (const auto& allocation : m_pendingFrees)
+		{
+			m_submittedFrees.emplace_back(fenceValue, allocation);
+		}
+		m_pendingFrees.clear();
+	}
+
+	inline auto Retire(std::uint64_t completedValue) -> void
+	{
+		m_transient.Retire(completedValue);
+		std::erase_if(m_submittedFrees, [&](const auto& entry) {
+			if (entry.first > completedValue)
+				return false;
+			m_persistent.Free(entry.second);
+			return true;
+		});
+	}
+
+	inline auto GetPersistent() const -> const DXRDescriptorFreeList&
+	{
+		return m_persistent;
+	}
+
+	inline auto GetTransient() const -> const DXRUploadRing&
+	{
+		return m_transient;
+	}
+
+	// Freed, waiting for their fence:
+	inline auto GetRetiringCount() const -> std::size_t
+	{
+		return m_pendingFrees.size() + m_submittedFrees.size();
+	}
+
+  private:
+	DXRDescriptorFreeList m_persistent{};
+	DXRUploadRing m_transient{};
+	std::uint32_t m_transientBase{};
+	std::vector<DXRDescriptorAllocation> m_pendingFrees{};
+	std::vector<std::pair<std::uint64_t, DXRDescriptorAllocation>>
+		m_submittedFrees{};
+};
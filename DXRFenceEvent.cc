@@ -0,0 +1,103 @@
+#include "DXRFenceEvent.h"
+#include "DXRPlatform.h"
+
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static auto FutexWait(std::atomic<std::uint32_t>* word, std::uint32_t expected,
+					  const ::timespec* timeout) -> void
+{
+	::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word),
+			  FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+static auto FutexWakeAll(std::atomic<std::uint32_t>* word) -> void
+{
+	::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word),
+			  FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#else
+#include <chrono>
+#endif
+
+DXRFenceEvent::DXRFenceEvent(std::uint64_t initialValue)
+	: m_completedValue(initialValue)
+{
+}
+
+DXRFenceEvent::~DXRFenceEvent()
+{
+}
+
+auto DXRFenceEvent::Signal(std::uint64_t value) -> void
+{
+#ifndef __linux__
+	std::lock_guard<std::mutex> lock{m_mutex};
+#endif
+	// Never go backwards, same as a D3D12 fence:
+	auto current = m_completedValue.load(std::memory_order_relaxed);
+	while (current < value &&
+		   !m_completedValue.compare_exchange_weak(current, value,
+												   std::memory_order_release,
+												   std::memory_order_relaxed))
+	{
+	}
+
+#ifdef __linux__
+	m_signalCount.fetch_add(1, std::memory_order_release);
+	FutexWakeAll(&m_signalCount);
+#else
+	m_condition.notify_all();
+#endif
+}
+
+auto DXRFenceEvent::Wait(std::uint64_t value) -> void
+{
+#ifdef __linux__
+	while (GetCompletedValue() < value)
+	{
+		const auto count = m_signalCount.load(std::memory_order_acquire);
+		if (GetCompletedValue() >= value)
+			break;
+		FutexWait(&m_signalCount, count, nullptr);
+	}
+#else
+	std::unique_lock<std::mutex> lock{m_mutex};
+	m_condition.wait(lock, [&] { return GetCompletedValue() >= value; });
+#endif
+}
+
+auto DXRFenceEvent::WaitFor(std::uint64_t value, float seconds) -> bool
+{
+#ifdef __linux__
+	const auto frequency = GetPlatformTickFrequency();
+	const auto deadline =
+		GetPlatformTickValue() +
+		static_cast<std::intptr_t>(static_cast<double>(seconds) *
+								   static_cast<double>(frequency));
+	while (GetCompletedValue() < value)
+	{
+		const auto count = m_signalCount.load(std::memory_order_acquire);
+		if (GetCompletedValue() >= value)
+			break;
+
+		const auto remaining = deadline - GetPlatformTickValue();
+		if (remaining <= 0)
+			return false;
+
+		// PosixPlatform ticks are nanoseconds:
+		::timespec timeout{};
+		timeout.tv_sec = static_cast<::time_t>(remaining / frequency);
+		timeout.tv_nsec = static_cast<long>(remaining % frequency);
+		FutexWait(&m_signalCount, count, &timeout);
+	}
+	return true;
+#else
+	std::unique_lock<std::mutex> lock{m_mutex};
+	return m_condition.wait_for(lock, std::chrono::duration<float>(seconds),
+								[&] { return GetCompletedValue() >= value; });
+#endif
+}
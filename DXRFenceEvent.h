@@ -0,0 +1,46 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <atomic>
+
+#ifndef __linux__
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// CPU side fence, same semantics as ID3D12Fence + an event handle:
+// The value only ever increases, waiters block until it reaches theirs.
+// Backed by a futex on Linux, a condition variable everywhere else.
+struct DXRFenceEvent : DXRNonCopyable
+{
+	DXRFenceEvent(std::uint64_t initialValue = 0);
+	~DXRFenceEvent();
+
+	// Sets the completed value and wakes all waiters:
+	auto Signal(std::uint64_t value) -> void;
+
+	// Blocks until the completed value is >= value:
+	auto Wait(std::uint64_t value) -> void;
+
+	// Same as Wait(), gives up after the timeout.
+	// Returns false on timeout:
+	auto WaitFor(std::uint64_t value, float seconds) -> bool;
+
+	inline auto GetCompletedValue() const -> std::uint64_t
+	{
+		return m_completedValue.load(std::memory_order_acquire);
+	}
+
+  private:
+	std::atomic<std::uint64_t> m_completedValue{};
+
+#ifdef __linux__
+	// Futexes are 32 bit, so waiters sleep on a signal counter instead of
+	// the value itself:
+	std::atomic<std::uint32_t> m_signalCount{};
+#else
+	std::mutex m_mutex{};
+	std::condition_variable m_condition{};
+#endif
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRPlatform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Fixed rate simulation ticks on top of a clock (Fiedler, "Fix Your
+// Timestep!"): WaitForNextTick() sleeps until the next tick is due, Step()
+// runs every due tick with the same dt and returns how far the clock already
+// is into the next one. Tick n is due at start + (n + 1) * dt and produces the
+// state for that time, so a renderer that shows the state one tick late can
+// blend the last two states by (now - GetTickTime()) / dt and never has to
+// extrapolate.
+//
+// Waiting sleeps until wakeUpSlack before the deadline (sleeps overshoot by
+// the OS timer resolution) and spins the rest.
+//
+// The clock type is anything with:
+//   auto Now() -> std::int64_t;                // ticks
+//   auto GetFrequency() -> std::int64_t;       // ticks per second
+//   auto Sleep(std::int64_t ticks) -> void;    // may oversleep
+//   auto Spin() -> void;                       // one busy wait step
+// DXRPlatformClock is the real one, DXRManualClock makes runs reproducible.
+struct DXRFixedTimestepDesc
+{
+	double tickRate{120.0};
+	// Seconds before a deadline sleeping stops and spinning takes over:
+	double wakeUpSlack{0.002};
+	// Ticks one Step() runs at most, after a longer stall the missed time is
+	// dropped instead of caught up:
+	std::uint32_t maxTicksPerStep{8};
+};
+
+// Seconds, since the last ResetStats():
+struct DXRFixedTimestepStats
+{
+	std::uint64_t ticks{};
+	std::uint64_t droppedTicks{};
+	// How late WaitForNextTick() returned, over the waits that had to wait:
+	std::uint64_t waits{};
+	double jitterSum{};
+	double jitterMax{};
+	// Time spent in the tick callbacks, sleeping and spinning:
+	double tickTime{};
+	double sleepTime{};
+	double spinTime{};
+	double elapsed{};
+
+	inline auto GetJitterMean() const -> double
+	{
+		return waits ? jitterSum / static_cast<double>(waits) : 0.0;
+	}
+
+	// Share of the elapsed time the thread kept a core busy (ticks and
+	// spinning), 1 for the old busy loop:
+	inline auto GetBusyFraction() const -> double
+	{
+		return elapsed > 0.0 ? (tickTime + spinTime) / elapsed : 0.0;
+	}
+};
+
+template <typename Clock> struct DXRFixedTimestep
+{
+	inline DXRFixedTimestep(Clock& clock, const DXRFixedTimestepDesc& desc = {})
+		: m_clock(clock), m_desc(desc)
+	{
+		DXRASSERT(desc.tickRate > 0.0);
+		const auto frequency = static_cast<double>(m_clock.GetFrequency());
+		m_tickDuration =
+			std::max<std::int64_t>(1, static_cast<std::int64_t>(
+										  frequency / desc.tickRate + 0.5));
+		m_wakeUpSlack = static_cast<std::int64_t>(desc.wakeUpSlack * frequency);
+		Reset();
+	}
+
+	// Starts the timeline over at the clock's current time:
+	inline auto Reset() -> void
+	{
+		m_start = m_clock.Now();
+		m_nextTick = m_start + m_tickDuration;
+		m_tickTime = m_start;
+		ResetStats();
+	}
+
+	inline auto ResetStats() -> void
+	{
+		m_stats = {};
+		m_statsStart = m_clock.Now();
+	}
+
+	// Blocks until the next tick is due, returns right away if it already
+	// is:
+	inline auto WaitForNextTick() -> void
+	{
+		auto now = m_clock.Now();
+		if (now >= m_nextTick)
+			return;
+
+		if (m_nextTick - now > m_wakeUpSlack)
+		{
+			m_clock.Sleep(m_nextTick - now - m_wakeUpSlack);
+			const auto woke = m_clock.Now();
+			m_stats.sleepTime += ToSeconds(woke - now);
+			now = woke;
+		}
+		const auto spinStart = now;
+		while (now < m_nextTick)
+		{
+			m_clock.Spin();
+			now = m_clock.Now();
+		}
+		m_stats.spinTime += ToSeconds(now - spinStart);
+
+		const auto jitter = ToSeconds(now - m_nextTick);
+		m_stats.waits++;
+		m_stats.jitterSum += jitter;
+		m_stats.jitterMax = std::max(m_stats.jitterMax, jitter);
+	}
+
+	// Runs tick(dt) for every tick that is due. Returns the interpolation
+	// factor: how far (0 to 1) the clock is past the last tick towards the
+	// next one.
+	template <typename Tick> inline auto Step(Tick&& tick) -> float
+	{
+		const auto now = m_clock.Now();
+		const auto dt = GetDeltaTime();
+		std::uint32_t count{};
+		while (now >= m_nextTick && count < m_desc.maxTicksPerStep)
+		{
+			m_tickTime = m_nextTick;
+			const auto tickStart = m_clock.Now();
+			tick(dt);
+			m_stats.tickTime += ToSeconds(m_clock.Now() - tickStart);
+			m_stats.ticks++;
+			m_nextTick += m_tickDuration;
+			count++;
+		}
+		if (now >= m_nextTick)
+		{
+			// Too far behind, skip ahead to the tick after now:
+			const auto dropped = (now - m_nextTick) / m_tickDuration + 1;
+			m_nextTick += dropped * m_tickDuration;
+			m_stats.droppedTicks += static_cast<std::uint64_t>(dropped);
+		}
+		m_stats.elapsed = ToSeconds(m_clock.Now() - m_statsStart);
+		return GetAlpha(now);
+	}
+
+	// GetAlpha() for the clock's current time:
+	inline auto GetAlpha(std::int64_t now) const -> float
+	{
+		const auto last = m_nextTick - m_tickDuration;
+		return std::clamp(static_cast<float>(now - last) /
+							  static_cast<float>(m_tickDuration),
+						  0.f, 1.f);
+	}
+
+	// The time the state of the tick being run (or the last one) stands
+	// for, in clock ticks:
+	inline auto GetTickTime() const -> std::int64_t
+	{
+		return m_tickTime;
+	}
+
+	// Clock ticks per simulation tick:
+	inline auto GetTickDuration() const -> std::int64_t
+	{
+		return m_tickDuration;
+	}
+
+	inline auto GetDeltaTime() const -> float
+	{
+		return static_cast<float>(ToSeconds(m_tickDuration));
+	}
+
+	inline auto GetStats() const -> const DXRFixedTimestepStats&
+	{
+		return m_stats;
+	}
+
+  private:
+	inline auto ToSeconds(std::int64_t ticks) const -> double
+	{
+		return static_cast<double>(ticks) /
+			   static_cast<double>(m_clock.GetFrequency());
+	}
+
+	Clock& m_clock;
+	DXRFixedTimestepDesc m_desc{};
+	std::int64_t m_tickDuration{};
+	std::int64_t m_wakeUpSlack{};
+	std::int64_t m_start{};
+	// Due time of the next tick, and the time of the last one run:
+	std::int64_t m_nextTick{};
+	std::int64_t m_tickTime{};
+	DXRFixedTimestepStats m_stats{};
+	std::int64_t m_statsStart{};
+};
+
+// GetPlatformTickValue() and the OS scheduler:
+struct DXRPlatformClock
+{
+	inline auto Now() -> std::int64_t
+	{
+		return static_cast<std::int64_t>(GetPlatformTickValue());
+	}
+
+	inline auto GetFrequency() -> std::int64_t
+	{
+		return static_cast<std::int64_t>(GetPlatformTickFrequency());
+	}
+
+	inline auto Sleep(std::int64_t ticks) -> void
+	{
+		std::this_thread::sleep_for(std::chrono::nanoseconds{
+			ticks * 1000000000 / GetFrequency()});
+	}
+
+	inline auto Spin() -> void
+	{
+		std::this_thread::yield();
+	}
+};
+
+// Time only moves when it is told to, in nanoseconds. Sleep() overshoots by
+// `oversleep` to stand in for the OS timer, Spin() advances by `spinStep`.
+struct DXRManualClock
+{
+	std::int64_t now{};
+	std::int64_t oversleep{};
+	std::int64_t spinStep{1000};
+
+	inline auto Now() -> std::int64_t
+	{
+		return now;
+	}
+
+	inline auto GetFrequency() -> std::int64_t
+	{
+		return 1000000000;
+	}
+
+	inline auto Sleep(std::int64_t ticks) -> void
+	{
+		now += ticks + oversleep;
+	}
+
+	inline auto Spin() -> void
+	{
+		now += spinStep;
+	}
+
+	inline auto Advance(std::int64_t ticks) -> void
+	{
+		now += ticks;
+	}
+};
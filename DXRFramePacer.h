@@ -0,0 +1,117 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <algorithm>
+#include <array>
+
+// N-frames-in-flight pacing on top of one monotonic fence.
+// Every frame slot remembers the fence value that was signaled after its
+// commands, BeginFrame() only waits if that slot's previous frame is still on
+// the GPU. So the CPU records frame N+1 while the GPU runs frame N.
+//
+// The queue type is anything with:
+//   auto Signal(std::uint64_t value) -> void;  // after the frame's work
+//   auto GetCompletedValue() -> std::uint64_t;
+//   auto Wait(std::uint64_t value) -> void;    // block until completed
+// DXRWindowRenderer adapts m_d3dCommandQueue/m_d3dFence to it, benchmarks use
+// a mock queue.
+struct DXRFramePacer
+{
+	static inline constexpr std::uint32_t k_MaxFramesInFlight{8};
+	static inline constexpr std::uint32_t k_DefaultFramesInFlight{2};
+
+	inline DXRFramePacer(std::uint32_t framesInFlight = k_DefaultFramesInFlight)
+	{
+		SetFramesInFlight(framesInFlight);
+	}
+
+	// Only change this while the queue is idle (after Flush()):
+	inline auto SetFramesInFlight(std::uint32_t framesInFlight) -> void
+	{
+		m_framesInFlight =
+			std::clamp(framesInFlight, 1u, k_MaxFramesInFlight);
+		m_slot = 0;
+	}
+
+	inline auto GetFramesInFlight() const -> std::uint32_t
+	{
+		return m_framesInFlight;
+	}
+
+	// Call when the fence was (re)created and starts from zero again:
+	inline auto Reset() -> void
+	{
+		m_slotFenceValues = {};
+		m_lastSignaledValue = 0;
+		m_slot = 0;
+	}
+
+	// Waits until the slot for the next frame is free and returns it.
+	// Per-frame resources (command allocators, upload memory...) are indexed
+	// by this.
+	template <typename Queue>
+	inline auto BeginFrame(Queue& queue) -> std::uint32_t
+	{
+		const auto value = m_slotFenceValues[m_slot];
+		if (queue.GetCompletedValue() < value)
+		{
+			m_stalls++;
+			queue.Wait(value);
+		}
+		return m_slot;
+	}
+
+	// Signals the fence for the frame recorded since BeginFrame() and moves
+	// on to the next slot:
+	template <typename Queue> inline auto EndFrame(Queue& queue) -> void
+	{
+		m_slotFenceValues[m_slot] = Signal(queue);
+		m_slot = (m_slot + 1) % m_framesInFlight;
+		m_frames++;
+	}
+
+	// Signals a new fence value without ending a frame:
+	template <typename Queue>
+	inline auto Signal(Queue& queue) -> std::uint64_t
+	{
+		queue.Signal(++m_lastSignaledValue);
+		return m_lastSignaledValue;
+	}
+
+	// Waits for everything submitted so far:
+	template <typename Queue> inline auto Flush(Queue& queue) -> void
+	{
+		queue.Wait(Signal(queue));
+	}
+
+	inline auto GetCurrentSlot() const -> std::uint32_t
+	{
+		return m_slot;
+	}
+
+	inline auto GetLastSignaledValue() const -> std::uint64_t
+	{
+		return m_lastSignaledValue;
+	}
+
+	// How many BeginFrame() calls had to block on the GPU:
+	inline auto GetStallCount() const -> std::uint64_t
+	{
+		return m_stalls;
+	}
+
+	inline auto GetFrameCount() const -> std::uint64_t
+	{
+		return m_frames;
+	}
+
+  private:
+	std::uint32_t m_framesInFlight{k_DefaultFramesInFlight};
+	std::uint32_t m_slot{};
+	std::array<std::uint64_t, k_MaxFramesInFlight> m_slotFenceValues{};
+	std::uint64_t m_lastSignaledValue{};
+
+	std::uint64_t m_stalls{};
+	std::uint64_t m_frames{};
+};
@@ -0,0 +1,328 @@
+#include "DXRGpuHeapAllocator.h"
+
+#include <algorithm>
+
+namespace
+{
+auto AlignUp(std::uint64_t value, std::uint64_t alignment) -> std::uint64_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+DXRGpuHeapAllocator::DXRGpuHeapAllocator(const DXRGpuHeapAllocatorDesc& desc)
+	: m_desc(desc)
+{
+	DXRASSERT(!(desc.heapSize % k_MsaaAlignment));
+}
+
+auto DXRGpuHeapAllocator::Reset() -> void
+{
+	m_heaps.clear();
+	for (auto& pool : m_pools)
+	{
+		pool.clear();
+	}
+	m_released.clear();
+	m_stats = {};
+}
+
+auto DXRGpuHeapAllocator::Allocate(std::uint64_t size, std::uint64_t alignment,
+								   DXRGpuMemoryType type, DXRGpuHeapKind kind)
+	-> DXRGpuAllocation
+{
+	DXRASSERT(alignment && !(alignment & (alignment - 1)));
+	if (!size)
+		return {};
+	alignment = std::max(alignment, k_DefaultAlignment);
+	size = AlignUp(size, k_DefaultAlignment);
+
+	DXRGpuHeapInfo info{};
+	info.alignment =
+		alignment > k_DefaultAlignment ? k_MsaaAlignment : k_DefaultAlignment;
+	info.type = type;
+	info.kind = kind;
+	const auto pool = GetPool(type, kind, alignment);
+
+	if (size > m_desc.dedicatedThreshold || size > m_desc.heapSize ||
+		alignment > k_MsaaAlignment)
+	{
+		info.size = AlignUp(size, info.alignment);
+		info.dedicated = true;
+		const auto heap = CreateHeap(pool, info);
+		if (heap == ~0u)
+			return {};
+		const auto allocation = AllocateIn(heap, size, alignment);
+		DXRASSERT(allocation.IsValid());
+		return allocation;
+	}
+
+	// First fit in creation order, the oldest heaps fill up and the newest
+	// ones empty out and go away:
+	for (const auto heap : m_pools[pool])
+	{
+		const auto allocation = AllocateIn(heap, size, alignment);
+		if (allocation.IsValid())
+			return allocation;
+	}
+	info.size = m_desc.heapSize;
+	const auto heap = CreateHeap(pool, info);
+	if (heap == ~0u)
+		return {};
+	const auto allocation = AllocateIn(heap, size, alignment);
+	DXRASSERT(allocation.IsValid());
+	return allocation;
+}
+
+auto DXRGpuHeapAllocator::Free(const DXRGpuAllocation& allocation) -> void
+{
+	if (!allocation.IsValid())
+		return;
+	DXRASSERT(allocation.heap < m_heaps.size());
+	auto& heap = m_heaps[allocation.heap];
+	DXRASSERT(heap.info.live);
+	heap.ranges.Free({allocation.offset, allocation.size, allocation.block});
+	m_stats.usedBytes -= allocation.size;
+	m_stats.allocations--;
+	if (!heap.ranges.IsEmpty())
+		return;
+	if (heap.info.dedicated)
+	{
+		ReleaseHeap(allocation.heap);
+		return;
+	}
+	const auto& pool =
+		m_pools[GetPool(heap.info.type, heap.info.kind, heap.info.alignment)];
+	const auto empty = std::count_if(pool.begin(), pool.end(), [&](auto index) {
+		return m_heaps[index].ranges.IsEmpty();
+	});
+	if (static_cast<std::uint64_t>(empty) > m_desc.keepEmptyHeaps)
+		ReleaseHeap(allocation.heap);
+}
+
+auto DXRGpuHeapAllocator::CollectReleasedHeaps(
+	std::vector<std::uint32_t>& heaps) -> void
+{
+	heaps.insert(heaps.end(), m_released.begin(), m_released.end());
+	m_released.clear();
+}
+
+auto DXRGpuHeapAllocator::SetBudget(std::uint64_t budget) -> void
+{
+	// Heaps over a lowered budget stay, only new ones fail:
+	m_desc.budget = budget;
+}
+
+auto DXRGpuHeapAllocator::GetStats() const -> DXRGpuHeapAllocatorStats
+{
+	return m_stats;
+}
+
+auto DXRGpuHeapAllocator::GetFragmentation() const -> double
+{
+	std::uint64_t freeBytes{};
+	std::uint64_t largest{};
+	for (const auto& pool : m_pools)
+	{
+		for (const auto index : pool)
+		{
+			const auto& ranges = m_heaps[index].ranges;
+			std::uint64_t heapLargest{};
+			ranges.GetFreeRanges(heapLargest);
+			freeBytes += ranges.GetCapacity() - ranges.GetUsedSize();
+			largest = std::max(largest, heapLargest);
+		}
+	}
+	if (!freeBytes)
+		return 0.0;
+	return 1.0 - static_cast<double>(largest) / static_cast<double>(freeBytes);
+}
+
+auto DXRGpuHeapAllocator::PlanDefragmentation(std::uint64_t maxBytes,
+											  std::vector<DXRGpuMove>& moves)
+	-> void
+{
+	enum : std::uint8_t
+	{
+		Untouched,
+		Drained,
+		Target,
+	};
+	std::vector<std::uint8_t> states(m_heaps.size(), Untouched);
+	std::uint64_t planned{};
+	std::vector<DXRGpuAllocation> from{};
+
+	for (const auto& pool : m_pools)
+	{
+		// Less than half used, emptiest first:
+		std::vector<std::uint32_t> candidates{};
+		for (const auto index : pool)
+		{
+			const auto& ranges = m_heaps[index].ranges;
+			if (!ranges.IsEmpty() &&
+				ranges.GetUsedSize() * 2 < ranges.GetCapacity())
+				candidates.push_back(index);
+		}
+		std::stable_sort(candidates.begin(), candidates.end(),
+						 [&](auto a, auto b) {
+							 return m_heaps[a].ranges.GetUsedSize() <
+									m_heaps[b].ranges.GetUsedSize();
+						 });
+
+		for (const auto candidate : candidates)
+		{
+			auto& heap = m_heaps[candidate];
+			// Heaps that took moves stay, their allocations would move twice:
+			if (states[candidate] != Untouched)
+				continue;
+			const auto used = heap.ranges.GetUsedSize();
+			if (planned + used > maxBytes)
+				continue;
+
+			from.clear();
+			heap.ranges.ForEachAllocation([&](const DXRRange& range) {
+				from.push_back(
+					{candidate, range.offset, range.size, range.block});
+			});
+			states[candidate] = Drained;
+			const auto first = moves.size();
+			bool fits{true};
+			for (const auto& allocation : from)
+			{
+				DXRGpuAllocation to{};
+				for (const auto index : pool)
+				{
+					if (states[index] == Drained ||
+						m_heaps[index].ranges.IsEmpty())
+						continue;
+					to = AllocateIn(index, allocation.size,
+									heap.info.alignment);
+					if (to.IsValid())
+						break;
+				}
+				if (!to.IsValid())
+				{
+					fits = false;
+					break;
+				}
+				moves.push_back({allocation, to});
+			}
+			if (!fits)
+			{
+				// All or nothing, a half drained heap frees nothing:
+				for (auto move = first; move < moves.size(); move++)
+				{
+					Free(moves[move].to);
+				}
+				moves.resize(first);
+				states[candidate] = Untouched;
+				continue;
+			}
+			for (auto move = first; move < moves.size(); move++)
+			{
+				states[moves[move].to.heap] = Target;
+			}
+			planned += used;
+		}
+	}
+}
+
+auto DXRGpuHeapAllocator::Validate() const -> bool
+{
+	DXRGpuHeapAllocatorStats totals{};
+	for (std::uint32_t index{}; index < m_heaps.size(); index++)
+	{
+		const auto& heap = m_heaps[index];
+		if (!heap.info.live)
+		{
+			if (heap.ranges.GetCapacity())
+				return false;
+			continue;
+		}
+		if (!heap.ranges.Validate() ||
+			heap.ranges.GetCapacity() != heap.info.size)
+			return false;
+		const auto& pool = m_pools[GetPool(heap.info.type, heap.info.kind,
+										   heap.info.alignment)];
+		const bool pooled =
+			std::find(pool.begin(), pool.end(), index) != pool.end();
+		if (pooled == heap.info.dedicated)
+			return false;
+		bool aligned{true};
+		heap.ranges.ForEachAllocation([&](const DXRRange& range) {
+			aligned = aligned && !(range.offset % k_DefaultAlignment);
+		});
+		if (!aligned)
+			return false;
+		totals.heapBytes += heap.info.size;
+		totals.usedBytes += heap.ranges.GetUsedSize();
+		totals.heaps++;
+		totals.allocations += heap.ranges.GetAllocationCount();
+	}
+	return totals.heapBytes == m_stats.heapBytes &&
+		   totals.usedBytes == m_stats.usedBytes &&
+		   totals.heaps == m_stats.heaps &&
+		   totals.allocations == m_stats.allocations &&
+		   m_stats.heapsCreated == m_heaps.size() &&
+		   m_stats.heapsCreated - m_stats.heapsReleased == m_stats.heaps;
+}
+
+auto DXRGpuHeapAllocator::GetPool(DXRGpuMemoryType type, DXRGpuHeapKind kind,
+								  std::uint64_t alignment) -> std::size_t
+{
+	const auto index =
+		static_cast<std::size_t>(type) *
+			static_cast<std::size_t>(DXRGpuHeapKind::Count) +
+		static_cast<std::size_t>(kind);
+	return index * 2 + (alignment > k_DefaultAlignment ? 1 : 0);
+}
+
+auto DXRGpuHeapAllocator::CreateHeap(std::size_t pool,
+									 const DXRGpuHeapInfo& info)
+	-> std::uint32_t
+{
+	if (m_desc.budget && m_stats.heapBytes + info.size > m_desc.budget)
+	{
+		m_stats.budgetFailures++;
+		return ~0u;
+	}
+	const auto index = static_cast<std::uint32_t>(m_heaps.size());
+	auto& heap = m_heaps.emplace_back();
+	heap.info = info;
+	heap.info.live = true;
+	heap.ranges.Reset(info.size, k_DefaultAlignment);
+	if (!info.dedicated)
+		m_pools[pool].push_back(index);
+	m_stats.heapBytes += info.size;
+	m_stats.heaps++;
+	m_stats.heapsCreated++;
+	return index;
+}
+
+auto DXRGpuHeapAllocator::ReleaseHeap(std::uint32_t heap) -> void
+{
+	auto& entry = m_heaps[heap];
+	DXRASSERT(entry.info.live && entry.ranges.IsEmpty());
+	if (!entry.info.dedicated)
+		std::erase(m_pools[GetPool(entry.info.type, entry.info.kind,
+								   entry.info.alignment)],
+				   heap);
+	entry.info.live = false;
+	entry.ranges.Reset(0, k_DefaultAlignment);
+	m_stats.heapBytes -= entry.info.size;
+	m_stats.heaps--;
+	m_stats.heapsReleased++;
+	m_released.push_back(heap);
+}
+
+auto DXRGpuHeapAllocator::AllocateIn(std::uint32_t heap, std::uint64_t size,
+									 std::uint64_t alignment)
+	-> DXRGpuAllocation
+{
+	const auto range = m_heaps[heap].ranges.Allocate(size, alignment);
+	if (!range.IsValid())
+		return {};
+	m_stats.usedBytes += range.size;
+	m_stats.allocations++;
+	return {heap, range.offset, range.size, range.block};
+}
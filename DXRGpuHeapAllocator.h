@@ -0,0 +1,186 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRangeAllocator.h"
+
+#include <array>
+#include <vector>
+
+enum struct DXRGpuMemoryType : std::uint8_t
+{
+	// D3D12_HEAP_TYPE_DEFAULT, _UPLOAD, _READBACK:
+	Default,
+	Upload,
+	Readback,
+	Count,
+};
+
+// Heap tier 1 hardware can't mix these in one heap, so every kind gets
+// heaps of its own (D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, _NON_RT_DS_TEXTURES,
+// _RT_DS_TEXTURES):
+enum struct DXRGpuHeapKind : std::uint8_t
+{
+	Buffer,
+	Texture,
+	RenderTarget,
+	Count,
+};
+
+struct DXRGpuHeapAllocatorDesc
+{
+	// Size of the heaps resources are placed in:
+	std::uint64_t heapSize{64ull << 20};
+	// Resources bigger than this get a heap of their own:
+	std::uint64_t dedicatedThreshold{16ull << 20};
+	// Bytes of heaps that may exist at once, 0 for no limit. The renderer
+	// sets DXGI's QueryVideoMemoryInfo() budget:
+	std::uint64_t budget{};
+	// Empty heaps a pool keeps for the next allocations instead of
+	// releasing them:
+	std::uint32_t keepEmptyHeaps{1};
+};
+
+struct DXRGpuAllocation
+{
+	std::uint32_t heap{~0u};
+	std::uint64_t offset{};
+	std::uint64_t size{};
+	// The heap's DXRRangeAllocator block:
+	std::uint32_t block{~0u};
+
+	inline auto IsValid() const -> bool
+	{
+		return heap != ~0u;
+	}
+};
+
+// What the caller creates a heap with:
+struct DXRGpuHeapInfo
+{
+	std::uint64_t size{};
+	// k_DefaultAlignment or k_MsaaAlignment, the heap's and the most any
+	// placement in it needs:
+	std::uint64_t alignment{};
+	DXRGpuMemoryType type{};
+	DXRGpuHeapKind kind{};
+	bool dedicated{};
+	// False once released:
+	bool live{};
+};
+
+struct DXRGpuHeapAllocatorStats
+{
+	// Bytes of live heaps, what the OS and driver see:
+	std::uint64_t heapBytes{};
+	// Bytes handed out, including the rounding to 64KB:
+	std::uint64_t usedBytes{};
+	std::uint32_t heaps{};
+	std::uint32_t allocations{};
+	std::uint64_t heapsCreated{};
+	std::uint64_t heapsReleased{};
+	// Allocations that would have gone over the budget:
+	std::uint64_t budgetFailures{};
+};
+
+// One planned defragmentation move, `to` is allocated already:
+struct DXRGpuMove
+{
+	DXRGpuAllocation from{};
+	DXRGpuAllocation to{};
+};
+
+// Placed resource sub-allocation: big heaps per pool (memory type, heap
+// kind, alignment class), carved up by one DXRRangeAllocator each. No D3D in
+// here, so it runs and replays traces anywhere; the renderer creates an
+// ID3D12Heap for every heap index that comes back new (GetHeapInfo()) and
+// places resources at the returned offsets.
+// Deterministic: heaps are searched in creation order and indices never get
+// reused, the same calls give the same heaps and offsets.
+struct DXRGpuHeapAllocator : DXRNonCopyable
+{
+	// D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT and
+	// D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT:
+	static inline constexpr std::uint64_t k_DefaultAlignment{64ull << 10};
+	static inline constexpr std::uint64_t k_MsaaAlignment{4ull << 20};
+
+	DXRGpuHeapAllocator(const DXRGpuHeapAllocatorDesc& desc = {});
+
+	// Releases every heap and forgets every allocation (device lost):
+	auto Reset() -> void;
+
+	// size and alignment from GetResourceAllocationInfo(). Invalid if a new
+	// heap would go over the budget:
+	auto Allocate(std::uint64_t size, std::uint64_t alignment,
+				  DXRGpuMemoryType type, DXRGpuHeapKind kind)
+		-> DXRGpuAllocation;
+
+	// Only once the GPU is done with the resource placed there:
+	auto Free(const DXRGpuAllocation& allocation) -> void;
+
+	// Heap indices handed out so far, released ones included:
+	inline auto GetHeapCount() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_heaps.size());
+	}
+
+	inline auto GetHeapInfo(std::uint32_t heap) const -> const DXRGpuHeapInfo&
+	{
+		return m_heaps[heap].info;
+	}
+
+	// Heaps released since the last call, the caller destroys them:
+	auto CollectReleasedHeaps(std::vector<std::uint32_t>& heaps) -> void;
+
+	auto SetBudget(std::uint64_t budget) -> void;
+
+	inline auto GetBudget() const -> std::uint64_t
+	{
+		return m_desc.budget;
+	}
+
+	auto GetStats() const -> DXRGpuHeapAllocatorStats;
+
+	// 1 - largest free range / free bytes over the shared heaps, 0 when all
+	// free space is one range:
+	auto GetFragmentation() const -> double;
+
+	// Defragmentation hook: plans moving every allocation out of the least
+	// used shared heaps into free space of the fuller ones of their pool, up
+	// to maxBytes. A heap is only drained if all of it fits. The caller
+	// copies each `from` to `to`, points its resources at `to`, and Free()s
+	// `from` once the copies retired, which releases the drained heaps:
+	auto PlanDefragmentation(std::uint64_t maxBytes,
+							 std::vector<DXRGpuMove>& moves) -> void;
+
+	// Every heap's DXRRangeAllocator::Validate() and the totals:
+	auto Validate() const -> bool;
+
+  private:
+	static inline constexpr std::size_t k_PoolCount{
+		static_cast<std::size_t>(DXRGpuMemoryType::Count) *
+		static_cast<std::size_t>(DXRGpuHeapKind::Count) * 2};
+
+	struct Heap
+	{
+		DXRGpuHeapInfo info{};
+		DXRRangeAllocator ranges{};
+	};
+
+	static auto GetPool(DXRGpuMemoryType type, DXRGpuHeapKind kind,
+						std::uint64_t alignment) -> std::size_t;
+
+	// Invalid if over budget:
+	auto CreateHeap(std::size_t pool, const DXRGpuHeapInfo& info)
+		-> std::uint32_t;
+	auto ReleaseHeap(std::uint32_t heap) -> void;
+	// Invalid if it doesn't fit:
+	auto AllocateIn(std::uint32_t heap, std::uint64_t size,
+					std::uint64_t alignment) -> DXRGpuAllocation;
+
+	DXRGpuHeapAllocatorDesc m_desc{};
+	std::vector<Heap> m_heaps{};
+	// Live shared heaps of each pool, in creation order:
+	std::array<std::vector<std::uint32_t>, k_PoolCount> m_pools{};
+	std::vector<std::uint32_t> m_released{};
+	DXRGpuHeapAllocatorStats m_stats{};
+};
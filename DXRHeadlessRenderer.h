@@ -0,0 +1,276 @@
+#pragma once
+
+#include "DXRPlatform.h"
+#include "DXRAssets.h"
+#include "DXRFenceEvent.h"
+#include "DXRFixedTimestep.h"
+#include "DXRInstancePacker.h"
+#include "DXRObjectLifetime.h"
+#include "DXRResizeCoalescer.h"
+#include "DXRRenderTypes.h"
+#include "DXRSoftwareRasterizer.h"
+#include "HeadlessWindow.h"
+#include "CameraManager.h"
+
+#include <cassert>
+#include <memory>
+#include <span>
+#include <vector>
+
+// DXRRenderer without a window or a GPU:
+// Same event -> resize -> update -> render flow, driven by a HeadlessWindow,
+// frames are drawn by DXRSoftwareRasterizer.
+// This is what benchmarks and servers run, so keep it in step with
+// DXRRenderer and DXRWindowRenderer::Update/SubmitD3D12.
+struct DXRHeadlessRenderer
+{
+	inline DXRHeadlessRenderer(std::uint32_t w = 640, std::uint32_t h = 480,
+							   std::uint32_t rasterizerThreads = 0,
+							   const DXRResizeDesc& resize = {})
+		: m_resizes(m_clock, resize)
+	{
+		m_rasterizer = std::make_unique<DXRSoftwareRasterizer>(rasterizerThreads);
+		assert(m_rasterizer);
+
+		m_window = std::make_unique<HeadlessWindow>();
+		assert(m_window);
+
+		m_window->SetUserData(this);
+		m_window->SetSize(w, h);
+
+		if (!m_window->Create())
+		{
+			// Something bad, real bad.
+			assert(0);
+		}
+	}
+
+	inline ~DXRHeadlessRenderer()
+	{
+	}
+
+	inline auto Destroy() -> void
+	{
+		m_rasterizer.reset();
+		m_window.reset();
+	}
+
+	inline auto IsValid() -> bool
+	{
+		if (!m_window || !m_rasterizer)
+		{
+			return false;
+		}
+
+		if (!m_window->IsValid())
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	inline auto GetWindow() -> HeadlessWindow*
+	{
+		return m_window.get();
+	}
+
+	// Same as W32Window::DispatchMessagesThisThread():
+	// Will return false if a Close event was received.
+	inline auto DispatchEvents() -> bool
+	{
+		if (!IsValid())
+			return false;
+
+		HeadlessWindow::Event event{};
+		while (m_window->PollEvent(event))
+		{
+			switch (event.type)
+			{
+			case HeadlessWindow::EventType::Resize:
+				OnResize(event.width, event.height);
+				break;
+			case HeadlessWindow::EventType::Close:
+				Destroy();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Same as DXRWindowRenderer::OnResize(), any thread:
+	inline auto OnResize(std::uint32_t w, std::uint32_t h) -> void
+	{
+		if (w == 0 || h == 0)
+			return;
+		m_resizes.Publish(w, h);
+		auto cam = CameraManager::GetInstance();
+		cam->SetAspectRatio(static_cast<float>(w) / static_cast<float>(h));
+	}
+
+	// Same as DXRWindowRenderer::ApplyResize(), the rasterizer finished the
+	// last frame so there is nothing to wait for:
+	inline auto ApplyResize() -> void
+	{
+		DXRResizeSize size{};
+		if (!m_resizes.Poll(size))
+			return;
+		m_width = size.width;
+		m_height = size.height;
+		m_objects.Invalidate(HeadlessObject::Size);
+	}
+
+	inline auto Update(float dt) -> void
+	{
+		(void)dt;
+	}
+
+	// Cube instances drawn by Render(), one identity instance by default:
+	inline auto SetInstances(std::span<const DXRInstance> instances) -> void
+	{
+		m_instances.assign(instances.begin(), instances.end());
+	}
+
+	// Same as DXRWindowRenderer::LoadRenderingAssets():
+	inline auto LoadRenderingAssets() -> bool
+	{
+		if (m_texture.pixels.empty())
+		{
+			if (!LoadDefaultTextureRGBA8(m_texture))
+				return false;
+		}
+		return true;
+	}
+
+	// Same as DXRWindowRenderer::ReloadRenderingAssets():
+	inline auto ReloadRenderingAssets() -> void
+	{
+		m_texture = {};
+		m_objects.Invalidate(HeadlessObject::Texture);
+	}
+
+	// Same as DXRWindowRenderer::ValidateAndCreateObjects(), without the
+	// device objects nothing but the framebuffer and the texture:
+	inline auto ValidateAndCreateObjects() -> bool
+	{
+		return m_objects.Rebuild([this](HeadlessObject object) {
+			switch (object)
+			{
+			case HeadlessObject::Size:
+				return true;
+			case HeadlessObject::Framebuffer:
+				m_rasterizer->Resize(m_width, m_height);
+				return true;
+			case HeadlessObject::Texture:
+				return LoadRenderingAssets();
+			case HeadlessObject::Count:
+				break;
+			}
+			return false;
+		});
+	}
+
+	// Records the same frame SubmitD3D12 does, rasterizes it, then retires
+	// the frame on the fence:
+	inline auto Render() -> bool
+	{
+		if (!IsValid())
+			return false;
+
+		ApplyResize();
+		if (!m_objects.IsClean() && !ValidateAndCreateObjects())
+			return false;
+
+		const auto& matrices = CameraManager::GetInstance()->AcquireSnapshot();
+		m_frameConstants.projection = matrices.projection;
+		m_frameConstants.view = matrices.view;
+		m_frameConstants.model = glm::mat4{1.f};
+
+		m_rasterizer->Clear(k_ClearColor, 1.f);
+		m_rasterizer->SetTexture(&m_texture);
+		const auto& mesh = GetCubeMesh();
+		m_packedInstances.resize(m_instances.size());
+		PackInstances(m_instances, m_packedInstances);
+		m_rasterizer->DrawIndexedInstanced(mesh.vertices, mesh.indices,
+										   m_packedInstances, m_frameConstants);
+		m_rasterizer->Execute();
+
+		m_frameFence.Signal(++m_frameNumber);
+		return true;
+	}
+
+	inline auto GetRasterizer() -> DXRSoftwareRasterizer*
+	{
+		return m_rasterizer.get();
+	}
+
+	inline auto GetFrameConstants() const -> const DXRGraphicsConstants&
+	{
+		return m_frameConstants;
+	}
+
+	inline auto GetFrameFence() -> DXRFenceEvent&
+	{
+		return m_frameFence;
+	}
+
+	inline auto GetFrameNumber() const -> std::uint64_t
+	{
+		return m_frameNumber;
+	}
+
+	inline auto GetWidth() const -> std::uint32_t
+	{
+		return m_width;
+	}
+
+	inline auto GetHeight() const -> std::uint32_t
+	{
+		return m_height;
+	}
+
+	inline auto GetResizeStats() const -> DXRResizeStats
+	{
+		return m_resizes.GetStats();
+	}
+
+	// Objects created by ValidateAndCreateObjects() so far:
+	inline auto GetRebuildCount() const -> std::uint64_t
+	{
+		return m_objects.GetRebuildCount();
+	}
+
+  private:
+	// Clear color, same as DXRWindowRenderer:
+	static inline constexpr float k_ClearColor[]{0.0f, 0.0f, 0.0f, 0.0f};
+
+	// Same as DXRWindowRenderer::D3D12Object:
+	enum struct HeadlessObject : std::uint32_t
+	{
+		// Nothing to create, OnResize() invalidates it:
+		Size,
+		Framebuffer,
+		Texture,
+		Count,
+	};
+
+	DXRPlatformClock m_clock{};
+	DXRResizeCoalescer<DXRPlatformClock> m_resizes;
+
+	std::unique_ptr<HeadlessWindow> m_window{};
+	std::unique_ptr<DXRSoftwareRasterizer> m_rasterizer{};
+	DXRImageRGBA8 m_texture{};
+	std::vector<DXRInstance> m_instances{DXRInstance{}};
+	std::vector<DXRInstanceData> m_packedInstances{};
+	std::uint32_t m_width{}, m_height{};
+	DXRObjectLifetime<HeadlessObject> m_objects = [] {
+		DXRObjectLifetime<HeadlessObject> objects{};
+		objects.DependsOn(HeadlessObject::Framebuffer, {HeadlessObject::Size});
+		return objects;
+	}();
+
+	DXRGraphicsConstants m_frameConstants{};
+
+	DXRFenceEvent m_frameFence{};
+	std::uint64_t m_frameNumber{};
+};
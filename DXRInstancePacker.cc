@@ -0,0 +1,134 @@
+#include "DXRInstancePacker.h"
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define DXRINSTANCEPACKERSSE
+#include <emmintrin.h>
+#endif
+
+static_assert(offsetof(DXRInstance, scale) == offsetof(DXRInstance, position) +
+												  3 * sizeof(float),
+			  "PackInstances loads position and scale as one float4");
+static_assert(offsetof(DXRInstance, rotation) == 4 * sizeof(float),
+			  "PackInstances loads rotation as one float4");
+static_assert(offsetof(DXRQuat, x) == 0 && offsetof(DXRQuat, w) == 12,
+			  "PackInstances expects glm's default x, y, z, w quaternions");
+
+namespace
+{
+auto PackInstance(const DXRInstance& instance, DXRInstanceData& out) -> void
+{
+	const auto x = instance.rotation.x;
+	const auto y = instance.rotation.y;
+	const auto z = instance.rotation.z;
+	const auto w = instance.rotation.w;
+	const auto s = instance.scale;
+	// Same operation order as the SSE path, so both give the same bits:
+	out.transform[0][0] = (1.f - 2.f * (y * y + z * z)) * s;
+	out.transform[0][1] = (2.f * (x * y - w * z)) * s;
+	out.transform[0][2] = (2.f * (x * z + w * y)) * s;
+	out.transform[0][3] = instance.position.x;
+	out.transform[1][0] = (2.f * (x * y + w * z)) * s;
+	out.transform[1][1] = (1.f - 2.f * (x * x + z * z)) * s;
+	out.transform[1][2] = (2.f * (y * z - w * x)) * s;
+	out.transform[1][3] = instance.position.y;
+	out.transform[2][0] = (2.f * (x * z - w * y)) * s;
+	out.transform[2][1] = (2.f * (y * z + w * x)) * s;
+	out.transform[2][2] = (1.f - 2.f * (x * x + y * y)) * s;
+	out.transform[2][3] = instance.position.z;
+	out.color = instance.color;
+	out.reserved[0] = 0;
+	out.reserved[1] = 0;
+	out.reserved[2] = 0;
+}
+} // namespace
+
+auto PackInstancesScalar(std::span<const DXRInstance> instances,
+						 std::span<DXRInstanceData> out) -> void
+{
+	DXRASSERT(out.size() >= instances.size());
+	for (std::size_t n{}; n < instances.size(); n++)
+	{
+		PackInstance(instances[n], out[n]);
+	}
+}
+
+auto PackInstances(std::span<const DXRInstance> instances,
+				   std::span<DXRInstanceData> out) -> void
+{
+	DXRASSERT(out.size() >= instances.size());
+	std::size_t n{};
+#ifdef DXRINSTANCEPACKERSSE
+	// Plain stores: upload heaps are write-combined, so full sequential
+	// writes combine anyway, and cached memory (the software path) is read
+	// back right after:
+	const auto store = [](DXRInstanceData& dst, std::size_t row,
+						  __m128 value) {
+		_mm_storeu_ps(reinterpret_cast<float*>(&dst) + row * 4, value);
+	};
+
+	const auto one = _mm_set1_ps(1.f);
+	const auto two = _mm_set1_ps(2.f);
+	for (; n + 4 <= instances.size(); n += 4)
+	{
+		const auto* const in = &instances[n];
+		auto px = _mm_loadu_ps(&in[0].position.x);
+		auto py = _mm_loadu_ps(&in[1].position.x);
+		auto pz = _mm_loadu_ps(&in[2].position.x);
+		auto s = _mm_loadu_ps(&in[3].position.x);
+		_MM_TRANSPOSE4_PS(px, py, pz, s);
+		auto x = _mm_loadu_ps(&in[0].rotation.x);
+		auto y = _mm_loadu_ps(&in[1].rotation.x);
+		auto z = _mm_loadu_ps(&in[2].rotation.x);
+		auto w = _mm_loadu_ps(&in[3].rotation.x);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		const auto xx = _mm_mul_ps(x, x);
+		const auto yy = _mm_mul_ps(y, y);
+		const auto zz = _mm_mul_ps(z, z);
+		const auto xy = _mm_mul_ps(x, y);
+		const auto xz = _mm_mul_ps(x, z);
+		const auto yz = _mm_mul_ps(y, z);
+		const auto wx = _mm_mul_ps(w, x);
+		const auto wy = _mm_mul_ps(w, y);
+		const auto wz = _mm_mul_ps(w, z);
+		const auto diagonal = [&](__m128 a, __m128 b) {
+			return _mm_mul_ps(
+				_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(a, b))), s);
+		};
+		const auto sum = [&](__m128 a, __m128 b) {
+			return _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(a, b)), s);
+		};
+		const auto difference = [&](__m128 a, __m128 b) {
+			return _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(a, b)), s);
+		};
+
+		// Columns of four instances' rows, transposed back into rows:
+		__m128 rows[3][4]{
+			{diagonal(yy, zz), difference(xy, wz), sum(xz, wy), px},
+			{sum(xy, wz), diagonal(xx, zz), difference(yz, wx), py},
+			{difference(xz, wy), sum(yz, wx), diagonal(xx, yy), pz},
+		};
+		for (std::size_t row{}; row < 3; row++)
+		{
+			auto& r = rows[row];
+			_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+			for (std::size_t k{}; k < 4; k++)
+			{
+				store(out[n + k], row, r[k]);
+			}
+		}
+		for (std::size_t k{}; k < 4; k++)
+		{
+			store(out[n + k], 3,
+				  _mm_castsi128_ps(_mm_cvtsi32_si128(
+					  static_cast<int>(in[k].color))));
+		}
+	}
+#endif
+	for (; n < instances.size(); n++)
+	{
+		PackInstance(instances[n], out[n]);
+	}
+}
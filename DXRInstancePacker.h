@@ -0,0 +1,32 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <span>
+
+// One object drawn with a shared mesh, what game code fills in:
+struct DXRInstance
+{
+	glm::vec3 position{};
+	float scale{1.f};
+	// Has to be normalized:
+	DXRQuat rotation{1.f, 0.f, 0.f, 0.f};
+	// R8G8B8A8_UNORM, multiplied with the vertex color:
+	std::uint32_t color{0xFFFFFFFF};
+};
+
+// DXRInstance to DXRInstanceData (what the vertex shader reads from its
+// structured buffer): the quaternion, scale and position become the rows of
+// a 3x4 affine transform.
+// out needs room for instances.size() entries. It can be write-combined
+// upload memory, every entry is written once, front to back, and nothing is
+// read back. With SSE four instances are transposed and converted at once.
+auto PackInstances(std::span<const DXRInstance> instances,
+				   std::span<DXRInstanceData> out) -> void;
+
+// Same results one instance at a time, the reference for the SIMD path:
+auto PackInstancesScalar(std::span<const DXRInstance> instances,
+						 std::span<DXRInstanceData> out) -> void;
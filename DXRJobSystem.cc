@@ -0,0 +1,382 @@
+#include "DXRJobSystem.h"
+
+struct DXRJob
+{
+	DXRJobFunction function{};
+	DXRJobCounter* signal{};
+	bool mainThread{};
+};
+
+// Chase-Lev deque after Lê et al., "Correct and Efficient Work-Stealing for
+// Weak Memory Models". Fixed size, Push() fails when full.
+// The owner thread calls Push() and Pop(), any thread Steal().
+struct DXRJobDeque
+{
+	inline DXRJobDeque(std::uint32_t capacity)
+		: m_mask(static_cast<std::int64_t>(capacity) - 1), m_buffer(capacity)
+	{
+		DXRASSERT(capacity && !(capacity & (capacity - 1)));
+	}
+
+	inline auto Push(DXRJob* job) -> bool
+	{
+		const auto bottom = m_bottom.load(std::memory_order_relaxed);
+		const auto top = m_top.load(std::memory_order_acquire);
+		if (bottom - top > m_mask)
+			return false;
+		GetSlot(bottom).store(job, std::memory_order_relaxed);
+		// Publishes the job to thieves, they load bottom with acquire:
+		m_bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	inline auto Pop() -> DXRJob*
+	{
+		// The store to bottom has to be visible before top is read, seq_cst
+		// instead of the paper's fence (ThreadSanitizer doesn't do fences):
+		const auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_seq_cst);
+		auto top = m_top.load(std::memory_order_seq_cst);
+		if (top > bottom)
+		{
+			// Empty:
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		auto job = GetSlot(bottom).load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			// The last one, a thief may be taking it right now:
+			if (!m_top.compare_exchange_strong(top, top + 1,
+											   std::memory_order_seq_cst,
+											   std::memory_order_relaxed))
+				job = nullptr;
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	inline auto Steal() -> DXRJob*
+	{
+		auto top = m_top.load(std::memory_order_seq_cst);
+		const auto bottom = m_bottom.load(std::memory_order_seq_cst);
+		if (top >= bottom)
+			return nullptr;
+		const auto job = GetSlot(top).load(std::memory_order_relaxed);
+		// Lost against the owner or another thief:
+		if (!m_top.compare_exchange_strong(top, top + 1,
+										   std::memory_order_seq_cst,
+										   std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+  private:
+	inline auto GetSlot(std::int64_t index) -> std::atomic<DXRJob*>&
+	{
+		return m_buffer[static_cast<std::size_t>(index & m_mask)];
+	}
+
+	// Owner and thieves each mostly touch their own end:
+	alignas(64) std::atomic<std::int64_t> m_top{};
+	alignas(64) std::atomic<std::int64_t> m_bottom{};
+	std::int64_t m_mask{};
+	std::vector<std::atomic<DXRJob*>> m_buffer{};
+};
+
+namespace
+{
+constexpr std::uint32_t k_NoThread{~0u};
+// Idle rounds a worker yields before it goes to sleep:
+constexpr std::uint32_t k_SpinCount{64};
+
+// Which system's deque the current thread owns, if any:
+thread_local const DXRJobSystem* t_jobSystem{};
+thread_local std::uint32_t t_threadIndex{k_NoThread};
+// Victim picking, xorshift:
+thread_local std::uint32_t t_random{0x9E3779B9u};
+
+auto NextRandom() -> std::uint32_t
+{
+	t_random ^= t_random << 13;
+	t_random ^= t_random >> 17;
+	t_random ^= t_random << 5;
+	return t_random;
+}
+} // namespace
+
+DXRJobSystem::DXRJobSystem(const DXRJobSystemDesc& desc)
+	: m_mainThread(std::this_thread::get_id())
+{
+	auto workerCount = desc.workerCount;
+	if (!workerCount)
+	{
+		const auto hardware = std::thread::hardware_concurrency();
+		workerCount = std::max(hardware, 2u) - 1;
+	}
+
+	for (std::uint32_t i{}; i <= workerCount; i++)
+	{
+		m_deques.push_back(std::make_unique<DXRJobDeque>(desc.dequeCapacity));
+	}
+
+	// The creating thread is the main thread and owns deque 0. Restored when
+	// this goes away, benchmarks stack systems:
+	m_previousSystem = t_jobSystem;
+	m_previousIndex = t_threadIndex;
+	t_jobSystem = this;
+	t_threadIndex = 0;
+
+	for (std::uint32_t i{1}; i <= workerCount; i++)
+	{
+		m_workers.emplace_back([this, i] { WorkerMain(i); });
+	}
+}
+
+DXRJobSystem::~DXRJobSystem()
+{
+	// They may still be queueing jobs for the workers:
+	m_dedicatedThreads.clear();
+	m_stop.store(true, std::memory_order_release);
+	m_wakeEpoch.fetch_add(1);
+	m_wakeEpoch.notify_all();
+	m_workers.clear();
+
+	// Whatever nobody waited for:
+	for (auto& deque : m_deques)
+	{
+		while (const auto job = deque->Pop())
+		{
+			delete job;
+		}
+	}
+	for (const auto job : m_injectionQueue)
+	{
+		delete job;
+	}
+	for (const auto job : m_mainThreadQueue)
+	{
+		delete job;
+	}
+
+	t_jobSystem = m_previousSystem;
+	t_threadIndex = m_previousIndex;
+}
+
+auto DXRJobSystem::Run(DXRJobFunction fn, DXRJobCounter* signal,
+					   DXRJobCounter* after) -> void
+{
+	if (signal)
+		signal->m_value.fetch_add(1, std::memory_order_relaxed);
+	Submit(new DXRJob{std::move(fn), signal, false}, after);
+}
+
+auto DXRJobSystem::RunOnMainThread(DXRJobFunction fn, DXRJobCounter* signal,
+								   DXRJobCounter* after) -> void
+{
+	if (signal)
+		signal->m_value.fetch_add(1, std::memory_order_relaxed);
+	Submit(new DXRJob{std::move(fn), signal, true}, after);
+}
+
+auto DXRJobSystem::RunCounted(DXRJobFunction fn, DXRJobCounter& signal)
+	-> void
+{
+	Submit(new DXRJob{std::move(fn), &signal, false}, nullptr);
+}
+
+auto DXRJobSystem::RunDedicated(DXRJobFunction fn, DXRJobCounter* signal)
+	-> void
+{
+	DXRASSERT(IsMainThread());
+	if (signal)
+		signal->m_value.fetch_add(1, std::memory_order_relaxed);
+	const auto job = new DXRJob{std::move(fn), signal, false};
+	m_dedicatedThreads.emplace_back([this, job] { Execute(job); });
+}
+
+auto DXRJobSystem::Wait(DXRJobCounter& counter) -> void
+{
+	const auto mainThread = IsMainThread();
+	while (!counter.IsDone())
+	{
+		if (const auto job = FindJob())
+		{
+			Execute(job);
+			continue;
+		}
+		if (mainThread && RunMainThreadJobs())
+			continue;
+		std::this_thread::yield();
+	}
+}
+
+auto DXRJobSystem::RunMainThreadJobs() -> std::uint32_t
+{
+	DXRASSERT(IsMainThread());
+	std::deque<DXRJob*> jobs{};
+	{
+		std::lock_guard lock{m_mainThreadMutex};
+		jobs.swap(m_mainThreadQueue);
+	}
+	// Jobs these queue run next time:
+	for (const auto job : jobs)
+	{
+		Execute(job);
+	}
+	return static_cast<std::uint32_t>(jobs.size());
+}
+
+auto DXRJobSystem::IsMainThread() const -> bool
+{
+	return std::this_thread::get_id() == m_mainThread;
+}
+
+auto DXRJobSystem::WorkerMain(std::uint32_t index) -> void
+{
+	t_jobSystem = this;
+	t_threadIndex = index;
+	t_random ^= index * 0x85EBCA6Bu;
+
+	std::uint32_t idle{};
+	while (!m_stop.load(std::memory_order_acquire))
+	{
+		if (const auto job = FindJob())
+		{
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+		if (++idle < k_SpinCount)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Anything pushed after the epoch was read changes it, so the wait
+		// below can't miss it:
+		const auto epoch = m_wakeEpoch.load();
+		if (const auto job = FindJob())
+		{
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+		m_sleepers.fetch_add(1);
+		if (!m_stop.load(std::memory_order_acquire))
+			m_wakeEpoch.wait(epoch);
+		m_sleepers.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+auto DXRJobSystem::Schedule(DXRJob* job) -> void
+{
+	if (job->mainThread)
+	{
+		std::lock_guard lock{m_mainThreadMutex};
+		m_mainThreadQueue.push_back(job);
+		return;
+	}
+
+	if (t_jobSystem == this)
+	{
+		// Full, nothing is lost by running it now:
+		if (!m_deques[t_threadIndex]->Push(job))
+		{
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard lock{m_injectionMutex};
+		m_injectionQueue.push_back(job);
+		m_injectionCount.fetch_add(1, std::memory_order_release);
+	}
+	Wake();
+}
+
+auto DXRJobSystem::Submit(DXRJob* job, DXRJobCounter* after) -> void
+{
+	if (after)
+	{
+		std::lock_guard lock{after->m_mutex};
+		if (after->m_value.load(std::memory_order_acquire))
+		{
+			// Finish() schedules it:
+			after->m_continuations.push_back(job);
+			return;
+		}
+	}
+	Schedule(job);
+}
+
+auto DXRJobSystem::FindJob() -> DXRJob*
+{
+	const auto self = t_jobSystem == this ? t_threadIndex : k_NoThread;
+	if (self != k_NoThread)
+	{
+		if (const auto job = m_deques[self]->Pop())
+			return job;
+	}
+
+	if (m_injectionCount.load(std::memory_order_acquire))
+	{
+		std::lock_guard lock{m_injectionMutex};
+		if (!m_injectionQueue.empty())
+		{
+			const auto job = m_injectionQueue.front();
+			m_injectionQueue.pop_front();
+			m_injectionCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	const auto count = GetThreadCount();
+	const auto start = NextRandom() % count;
+	for (std::uint32_t i{}; i < count; i++)
+	{
+		const auto victim = (start + i) % count;
+		if (victim == self)
+			continue;
+		if (const auto job = m_deques[victim]->Steal())
+		{
+			m_steals.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+auto DXRJobSystem::Execute(DXRJob* job) -> void
+{
+	job->function();
+	const auto signal = job->signal;
+	delete job;
+	if (signal)
+		Finish(*signal);
+}
+
+auto DXRJobSystem::Finish(DXRJobCounter& counter) -> void
+{
+	// Decremented under the lock, IsDone() takes it too so the counter stays
+	// alive until this let go of it:
+	std::vector<DXRJob*> ready{};
+	{
+		std::lock_guard lock{counter.m_mutex};
+		if (counter.m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(counter.m_continuations);
+	}
+	for (const auto job : ready)
+	{
+		Schedule(job);
+	}
+}
+
+auto DXRJobSystem::Wake() -> void
+{
+	m_wakeEpoch.fetch_add(1);
+	if (m_sleepers.load())
+		m_wakeEpoch.notify_one();
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct DXRJob;
+struct DXRJobDeque;
+
+using DXRJobFunction = std::move_only_function<void()>;
+
+// Counts unfinished jobs. Run() increments the counter it is given to signal
+// and the job decrements it when it returned, jobs can also be held back
+// until a counter is done. Has to outlive the jobs signaling it and Wait().
+struct DXRJobCounter : DXRNonCopyable
+{
+	inline auto IsDone() const -> bool
+	{
+		if (m_value.load(std::memory_order_acquire))
+			return false;
+		// The last job may still be releasing the continuations:
+		std::lock_guard lock{m_mutex};
+		return true;
+	}
+
+  private:
+	friend struct DXRJobSystem;
+
+	std::atomic<std::int32_t> m_value{};
+	mutable std::mutex m_mutex{};
+	// Jobs waiting for this counter to be done:
+	std::vector<DXRJob*> m_continuations{};
+};
+
+struct DXRJobSystemDesc
+{
+	// Worker threads besides the main thread, 0 for one per remaining
+	// hardware thread (at least one):
+	std::uint32_t workerCount{};
+	// Jobs a thread can have queued, more run right away. Power of two:
+	std::uint32_t dequeCapacity{4096};
+};
+
+// Work stealing job scheduler.
+// Every thread (the main thread, the one that created the system, and the
+// workers) owns a Chase-Lev deque: it pushes and pops jobs at the bottom, idle
+// threads steal from the top of the others, so fresh small jobs stay on the
+// core whose caches they share while old big ones spread out. Threads outside
+// the system queue into a shared injection queue instead.
+// Workers spin briefly when they run dry, then sleep until new work is
+// pushed. The main thread only runs jobs inside Wait() and
+// RunMainThreadJobs(); jobs that touch the window go through
+// RunOnMainThread() and run there. Loops that run for the whole program
+// get a thread of their own with RunDedicated().
+struct DXRJobSystem : DXRNonCopyable
+{
+	static inline auto GetInstance() -> DXRJobSystem*
+	{
+		return DXRSingleton<DXRJobSystem>::GetInstance();
+	}
+
+	DXRJobSystem(const DXRJobSystemDesc& desc = {});
+	~DXRJobSystem();
+
+	// Runs fn on any thread. signal (if any) counts it until it returned,
+	// after (if any) has to be done before it starts:
+	auto Run(DXRJobFunction fn, DXRJobCounter* signal = nullptr,
+			 DXRJobCounter* after = nullptr) -> void;
+
+	// Same, but fn runs on the main thread, in RunMainThreadJobs() or a
+	// Wait() there:
+	auto RunOnMainThread(DXRJobFunction fn, DXRJobCounter* signal = nullptr,
+						 DXRJobCounter* after = nullptr) -> void;
+
+	// Counts a job on signal ahead of the RunCounted() that queues it, for
+	// counters other threads can find (and Wait() on) before the job is
+	// queued. Any thread:
+	static inline auto AddPending(DXRJobCounter& signal) -> void
+	{
+		signal.m_value.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Run() for a job AddPending() already counted on signal:
+	auto RunCounted(DXRJobFunction fn, DXRJobCounter& signal) -> void;
+
+	// Runs fn on a thread of its own, for loops that don't return until told
+	// to (the update loop). It is never queued, so no Wait() can pick it up
+	// and it doesn't take a worker away from the other jobs. Its Run() calls
+	// go through the injection queue. signal (if any) counts it until it
+	// returned, the thread is joined when the system goes away. Main thread:
+	auto RunDedicated(DXRJobFunction fn, DXRJobCounter* signal = nullptr)
+		-> void;
+
+	// Runs other jobs until counter is done. Any thread:
+	auto Wait(DXRJobCounter& counter) -> void;
+
+	// Main thread, once per frame: runs the queued main thread jobs. Returns
+	// how many ran:
+	auto RunMainThreadJobs() -> std::uint32_t;
+
+	// fn(first, last) over [begin, end) in chunks of at least grain items.
+	// The calling thread runs chunks too and returns when all are done:
+	template <typename F>
+	inline auto ParallelFor(std::size_t begin, std::size_t end,
+							std::size_t grain, F&& fn) -> void
+	{
+		if (begin >= end)
+			return;
+		// A few chunks per thread are enough to balance uneven ones:
+		const auto count = end - begin;
+		const auto chunks = std::size_t{GetThreadCount()} * 4;
+		grain = std::max({grain, std::size_t{1}, (count + chunks - 1) / chunks});
+		if (count <= grain)
+		{
+			fn(begin, end);
+			return;
+		}
+
+		// Everything but the first chunk is up for stealing, this thread starts
+		// on that one right away:
+		DXRJobCounter counter{};
+		for (auto first = begin + grain; first < end; first += grain)
+		{
+			const auto last = std::min(first + grain, end);
+			Run([&fn, first, last] { fn(first, last); }, &counter);
+		}
+		fn(begin, begin + grain);
+		Wait(counter);
+	}
+
+	// Workers and the main thread:
+	inline auto GetThreadCount() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_deques.size());
+	}
+
+	auto IsMainThread() const -> bool;
+
+	// Jobs taken from another thread's deque, since creation:
+	inline auto GetStealCount() const -> std::uint64_t
+	{
+		return m_steals.load(std::memory_order_relaxed);
+	}
+
+  private:
+	auto WorkerMain(std::uint32_t index) -> void;
+	auto Schedule(DXRJob* job) -> void;
+	auto Submit(DXRJob* job, DXRJobCounter* after) -> void;
+	auto FindJob() -> DXRJob*;
+	auto Execute(DXRJob* job) -> void;
+	auto Finish(DXRJobCounter& counter) -> void;
+	auto Wake() -> void;
+
+	std::vector<std::unique_ptr<DXRJobDeque>> m_deques{};
+	std::thread::id m_mainThread{};
+	// What the main thread belonged to before this system:
+	const DXRJobSystem* m_previousSystem{};
+	std::uint32_t m_previousIndex{};
+
+	std::mutex m_injectionMutex{};
+	std::deque<DXRJob*> m_injectionQueue{};
+	std::atomic<std::uint32_t> m_injectionCount{};
+	std::mutex m_mainThreadMutex{};
+	std::deque<DXRJob*> m_mainThreadQueue{};
+
+	// Bumped on every push, sleeping workers wait for it to change:
+	std::atomic<std::uint32_t> m_wakeEpoch{};
+	std::atomic<std::uint32_t> m_sleepers{};
+	std::atomic<bool> m_stop{};
+	std::atomic<std::uint64_t> m_steals{};
+
+	// Last, so they are joined before anything they use goes away:
+	std::vector<std::jthread> m_dedicatedThreads{};
+	std::vector<std::jthread> m_workers{};
+};
+
+// fn(first, last) over the rows [0, rows) in one contiguous chunk per thread,
+// for work that also runs without a job system (the offline cooker): on jobs'
+// threads if there is one, else on threadCount - 1 threads started for the
+// call. The calling thread takes a chunk too and returns when all are done:
+template <typename T, typename F>
+inline auto DXRParallelRows(T rows, std::uint32_t threadCount,
+							DXRJobSystem* jobs, F&& fn) -> void
+{
+	const auto threads =
+		std::min(static_cast<T>(std::max(1u, threadCount)), rows);
+	if (threads <= 1)
+	{
+		fn(T{}, rows);
+		return;
+	}
+
+	const auto chunk = (rows + threads - 1) / threads;
+	if (jobs)
+	{
+		jobs->ParallelFor(0, static_cast<std::size_t>(rows),
+						  static_cast<std::size_t>(chunk),
+						  [&fn](std::size_t first, std::size_t last) {
+							  fn(static_cast<T>(first), static_cast<T>(last));
+						  });
+		return;
+	}
+
+	std::vector<std::jthread> workers{};
+	for (T k{1}; k < threads; k++)
+	{
+		const auto begin = std::min(rows, k * chunk);
+		const auto end = std::min(rows, begin + chunk);
+		workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+	}
+	fn(T{}, std::min(rows, chunk));
+}
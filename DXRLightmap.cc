@@ -0,0 +1,698 @@
+#include "DXRLightmap.h"
+#include "DXRJobSystem.h"
+#include "DXRPathTracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numbers>
+#include <unordered_map>
+
+namespace
+{
+struct Transform
+{
+	glm::mat3 linear{};
+	glm::vec3 translation{};
+	// Inverse transpose of linear, for normals:
+	glm::mat3 normal{};
+};
+
+auto GetTransform(const DXRInstanceData& instance) -> Transform
+{
+	// glm is column major, world = linear * local + translation:
+	const auto& rows = instance.transform;
+	Transform transform{};
+	transform.linear = {rows[0][0], rows[1][0], rows[2][0],
+						rows[0][1], rows[1][1], rows[2][1],
+						rows[0][2], rows[1][2], rows[2][2]};
+	transform.translation = {rows[0][3], rows[1][3], rows[2][3]};
+	transform.normal = glm::transpose(glm::inverse(transform.linear));
+	return transform;
+}
+
+// Positions that are bitwise the same are one point for chart growing,
+// whatever else their vertices disagree on:
+struct PositionKey
+{
+	std::uint32_t bits[3]{};
+
+	auto operator==(const PositionKey&) const -> bool = default;
+};
+
+struct PositionKeyHash
+{
+	auto operator()(const PositionKey& key) const -> std::size_t
+	{
+		return (std::size_t{key.bits[0]} * 73856093u) ^
+			   (std::size_t{key.bits[1]} * 19349663u) ^
+			   (std::size_t{key.bits[2]} * 83492791u);
+	}
+};
+
+struct Chart
+{
+	std::vector<std::uint32_t> triangles{};
+	// Plane the chart is projected onto, world space:
+	glm::vec3 tangent{};
+	glm::vec3 bitangent{};
+	// Bounds of the projection along tangent and bitangent, world units:
+	glm::vec2 min{};
+	glm::vec2 extent{};
+	// Placement in the atlas, texels, padding included:
+	std::uint32_t x{};
+	std::uint32_t y{};
+	std::uint32_t width{};
+	std::uint32_t height{};
+};
+
+auto GetRectSize(float extent, float scale, std::uint32_t padding)
+	-> std::uint32_t
+{
+	// One texel extra for texel centres, padding on both sides:
+	return static_cast<std::uint32_t>(std::ceil(extent * scale)) + 1 +
+		   padding * 2;
+}
+
+// Shelves of charts sorted by height, tallest first. Returns false if they
+// don't fit at scale:
+auto PackCharts(std::vector<Chart>& charts,
+				std::span<const std::uint32_t> order, float scale,
+				std::uint32_t resolution, std::uint32_t padding) -> bool
+{
+	std::uint32_t x{};
+	std::uint32_t y{};
+	std::uint32_t shelf{};
+	for (const auto index : order)
+	{
+		auto& chart = charts[index];
+		chart.width = GetRectSize(chart.extent.x, scale, padding);
+		chart.height = GetRectSize(chart.extent.y, scale, padding);
+		if (chart.width > resolution)
+			return false;
+		if (x + chart.width > resolution)
+		{
+			y += shelf;
+			x = 0;
+			shelf = 0;
+		}
+		if (y + chart.height > resolution)
+			return false;
+		chart.x = x;
+		chart.y = y;
+		x += chart.width;
+		shelf = std::max(shelf, chart.height);
+	}
+	return true;
+}
+
+auto Cross(const glm::vec2& a, const glm::vec2& b) -> float
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+// Nearest point on the triangle to p as barycentrics of b and c, and its
+// squared distance:
+auto GetNearestPoint(const glm::vec2 (&corners)[3], const glm::vec2& p,
+					 glm::vec2& barycentrics) -> float
+{
+	auto best = std::numeric_limits<float>::max();
+	for (std::uint32_t edge{}; edge < 3; edge++)
+	{
+		const auto from = corners[edge];
+		const auto to = corners[(edge + 1) % 3];
+		const auto direction = to - from;
+		const auto length = glm::dot(direction, direction);
+		const auto t =
+			length > 0.f
+				? std::clamp(glm::dot(p - from, direction) / length, 0.f, 1.f)
+				: 0.f;
+		const auto offset = from + direction * t - p;
+		const auto distance = glm::dot(offset, offset);
+		if (distance >= best)
+			continue;
+		best = distance;
+		float weights[3]{};
+		weights[edge] = 1.f - t;
+		weights[(edge + 1) % 3] = t;
+		barycentrics = {weights[1], weights[2]};
+	}
+	return best;
+}
+} // namespace
+
+auto UnwrapLightmap(const DXRIndexedMesh& mesh, const DXRInstanceData& instance,
+					const DXRLightmapDesc& desc, DXRLightmap& out) -> bool
+{
+	out = {};
+	const auto resolution = desc.resolution;
+	// Touched texels reach a texel past a chart, neighbours need one more:
+	const auto padding = std::max(desc.padding, 1u);
+	const auto triangleCount =
+		static_cast<std::uint32_t>(mesh.indices.size() / 3);
+	if (!resolution || !triangleCount)
+		return false;
+	for (const auto index : mesh.indices)
+	{
+		if (index >= mesh.vertices.size())
+			return false;
+	}
+
+	const auto transform = GetTransform(instance);
+	std::vector<glm::vec3> world(mesh.vertices.size());
+	std::unordered_map<PositionKey, std::uint32_t, PositionKeyHash> welded{};
+	std::vector<std::uint32_t> points(mesh.vertices.size());
+	for (std::size_t n{}; n < mesh.vertices.size(); n++)
+	{
+		const auto& vertex = mesh.vertices[n];
+		const glm::vec3 position{vertex.x, vertex.y, vertex.z};
+		world[n] = transform.linear * position + transform.translation;
+		PositionKey key{};
+		memcpy(key.bits, &position, sizeof key.bits);
+		const auto next = static_cast<std::uint32_t>(welded.size());
+		points[n] = welded.emplace(key, next).first->second;
+	}
+
+	// Face normals, turned to the side the vertex normals are on, that's
+	// the side that gets baked:
+	std::vector<glm::vec3> faceNormals(triangleCount);
+	for (std::uint32_t triangle{}; triangle < triangleCount; triangle++)
+	{
+		const auto* corner = &mesh.indices[triangle * 3];
+		auto normal = glm::cross(world[corner[1]] - world[corner[0]],
+								 world[corner[2]] - world[corner[0]]);
+		glm::vec3 vertexNormals{};
+		for (std::uint32_t n{}; n < 3; n++)
+		{
+			const auto& vertex = mesh.vertices[corner[n]];
+			vertexNormals +=
+				transform.normal * glm::vec3{vertex.nx, vertex.ny, vertex.nz};
+		}
+		if (glm::dot(normal, vertexNormals) < 0.f)
+			normal = -normal;
+		const auto length = glm::length(normal);
+		faceNormals[triangle] =
+			length > 0.f ? normal / length : glm::vec3{0.f, 0.f, 1.f};
+	}
+
+	// Triangles sharing an edge, edges sorted by their welded end points:
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> edges{};
+	edges.reserve(mesh.indices.size());
+	for (std::uint32_t triangle{}; triangle < triangleCount; triangle++)
+	{
+		for (std::uint32_t n{}; n < 3; n++)
+		{
+			const auto a = points[mesh.indices[triangle * 3 + n]];
+			const auto b = points[mesh.indices[triangle * 3 + (n + 1) % 3]];
+			if (a == b)
+				continue;
+			const auto key =
+				std::uint64_t{std::min(a, b)} << 32 | std::max(a, b);
+			edges.emplace_back(key, triangle);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	std::vector<std::vector<std::uint32_t>> neighbours(triangleCount);
+	for (std::size_t first{}; first < edges.size();)
+	{
+		auto last = first + 1;
+		while (last < edges.size() && edges[last].first == edges[first].first)
+			last++;
+		for (auto a = first; a < last; a++)
+		{
+			for (auto b = first; b < last; b++)
+			{
+				if (a != b)
+					neighbours[edges[a].second].push_back(edges[b].second);
+			}
+		}
+		first = last;
+	}
+
+	// Grow charts from the first triangle left over:
+	std::vector<Chart> charts{};
+	std::vector<std::uint32_t> chartOf(triangleCount, ~0u);
+	std::vector<std::uint32_t> open{};
+	for (std::uint32_t seed{}; seed < triangleCount; seed++)
+	{
+		if (chartOf[seed] != ~0u)
+			continue;
+		const auto chartIndex = static_cast<std::uint32_t>(charts.size());
+		auto& chart = charts.emplace_back();
+		chartOf[seed] = chartIndex;
+		open.push_back(seed);
+		while (!open.empty())
+		{
+			const auto triangle = open.back();
+			open.pop_back();
+			chart.triangles.push_back(triangle);
+			for (const auto neighbour : neighbours[triangle])
+			{
+				if (chartOf[neighbour] != ~0u ||
+					glm::dot(faceNormals[neighbour], faceNormals[seed]) <
+						desc.chartCosine)
+					continue;
+				chartOf[neighbour] = chartIndex;
+				open.push_back(neighbour);
+			}
+		}
+	}
+
+	// Project every chart onto the plane of its area weighted normal. The
+	// smallest bounding rectangle has a side along one of the chart's edges,
+	// the first few triangles' edges are tried:
+	float totalArea{};
+	for (auto& chart : charts)
+	{
+		glm::vec3 normal{};
+		for (const auto triangle : chart.triangles)
+		{
+			const auto* corner = &mesh.indices[triangle * 3];
+			const auto& p0 = world[corner[0]];
+			normal += faceNormals[triangle] *
+					  glm::length(glm::cross(world[corner[1]] - p0,
+											 world[corner[2]] - p0));
+		}
+		normal = glm::dot(normal, normal) > 0.f
+					 ? glm::normalize(normal)
+					 : faceNormals[chart.triangles[0]];
+
+		auto bestArea = std::numeric_limits<float>::max();
+		const auto candidates =
+			std::min<std::size_t>(chart.triangles.size(), 16);
+		for (std::size_t n{}; n < candidates * 3 + 1; n++)
+		{
+			glm::vec3 tangent{};
+			if (n < candidates * 3)
+			{
+				const auto* corner = &mesh.indices[chart.triangles[n / 3] * 3];
+				const auto edge =
+					world[corner[(n + 1) % 3]] - world[corner[n % 3]];
+				tangent = edge - normal * glm::dot(edge, normal);
+			}
+			else if (bestArea == std::numeric_limits<float>::max())
+			{
+				// Every edge degenerate, any tangent will do:
+				tangent = std::abs(normal.x) < 0.9f ? glm::vec3{1.f, 0.f, 0.f}
+													: glm::vec3{0.f, 1.f, 0.f};
+				tangent -= normal * glm::dot(tangent, normal);
+			}
+			if (glm::dot(tangent, tangent) <= 0.f)
+				continue;
+			tangent = glm::normalize(tangent);
+			const auto bitangent = glm::cross(normal, tangent);
+			auto min = glm::vec2{std::numeric_limits<float>::max()};
+			auto max = glm::vec2{-std::numeric_limits<float>::max()};
+			for (const auto triangle : chart.triangles)
+			{
+				for (std::uint32_t corner{}; corner < 3; corner++)
+				{
+					const auto& p = world[mesh.indices[triangle * 3 + corner]];
+					const glm::vec2 projected{glm::dot(p, tangent),
+											  glm::dot(p, bitangent)};
+					min = glm::min(min, projected);
+					max = glm::max(max, projected);
+				}
+			}
+			const auto extent = max - min;
+			const auto area = extent.x * extent.y;
+			if (area >= bestArea)
+				continue;
+			bestArea = area;
+			// Wider than tall, the shelves stay low:
+			if (extent.x >= extent.y)
+			{
+				chart.tangent = tangent;
+				chart.bitangent = bitangent;
+				chart.min = min;
+				chart.extent = extent;
+			}
+			else
+			{
+				chart.tangent = bitangent;
+				chart.bitangent = tangent;
+				chart.min = {min.y, min.x};
+				chart.extent = {extent.y, extent.x};
+			}
+		}
+		totalArea += chart.extent.x * chart.extent.y;
+	}
+	if (totalArea <= 0.f)
+		return false;
+
+	// Largest scale that packs: shrink from a guess until it fits, or grow
+	// until it doesn't, then bisect between the two:
+	std::vector<std::uint32_t> order(charts.size());
+	for (std::uint32_t n{}; n < order.size(); n++)
+	{
+		order[n] = n;
+	}
+	std::stable_sort(order.begin(), order.end(),
+					 [&](std::uint32_t a, std::uint32_t b) {
+						 return charts[a].extent.y > charts[b].extent.y;
+					 });
+	const auto fits = [&](float scale) {
+		return PackCharts(charts, order, scale, resolution, padding);
+	};
+	auto good = std::sqrt(0.8f * static_cast<float>(resolution) *
+						  static_cast<float>(resolution) / totalArea);
+	auto bad = good;
+	if (fits(good))
+	{
+		for (std::uint32_t n{}; n < 32 && fits(bad); n++)
+		{
+			good = bad;
+			bad *= 1.25f;
+		}
+	}
+	else
+	{
+		for (std::uint32_t n{}; n < 64 && !fits(good); n++)
+		{
+			bad = good;
+			good *= 0.8f;
+		}
+		if (!fits(good))
+			return false;
+	}
+	for (std::uint32_t n{}; n < 12; n++)
+	{
+		const auto middle = (good + bad) * 0.5f;
+		(fits(middle) ? good : bad) = middle;
+	}
+	fits(good);
+
+	out.resolution = resolution;
+	out.charts = static_cast<std::uint32_t>(charts.size());
+	out.texelsPerUnit = good;
+	const auto texels = std::size_t{resolution} * resolution;
+	out.coverage.assign(texels, DXRLightmap::k_Empty);
+	out.positions.assign(texels, {});
+	out.normals.assign(texels, {});
+	out.textureCoordinates.assign(texels, {});
+
+	// Per chart: copy its vertices with lightmap UVs, then bake positions
+	// into the texels whose centres its triangles cover and, second, into
+	// the ones they only touch:
+	std::vector<std::uint32_t> remap(mesh.vertices.size(), ~0u);
+	const auto invResolution = 1.f / static_cast<float>(resolution);
+	for (const auto& chart : charts)
+	{
+		const glm::vec2 origin{
+			static_cast<float>(chart.x + padding) + 0.5f,
+			static_cast<float>(chart.y + padding) + 0.5f};
+		for (const auto triangle : chart.triangles)
+		{
+			for (std::uint32_t corner{}; corner < 3; corner++)
+			{
+				const auto index = mesh.indices[triangle * 3 + corner];
+				if (remap[index] == ~0u)
+				{
+					const auto& p = world[index];
+					const auto texel =
+						(glm::vec2{glm::dot(p, chart.tangent),
+								   glm::dot(p, chart.bitangent)} -
+						 chart.min) *
+							good +
+						origin;
+					auto vertex = mesh.vertices[index];
+					vertex.u = texel.x * invResolution;
+					vertex.v = texel.y * invResolution;
+					remap[index] =
+						static_cast<std::uint32_t>(out.mesh.vertices.size());
+					out.mesh.vertices.push_back(vertex);
+				}
+				out.mesh.indices.push_back(remap[index]);
+			}
+		}
+
+		for (const auto pass : {DXRLightmap::k_Covered, DXRLightmap::k_Touched})
+		{
+			for (const auto triangle : chart.triangles)
+			{
+				const auto* corner = &mesh.indices[triangle * 3];
+				glm::vec2 corners[3]{};
+				for (std::uint32_t n{}; n < 3; n++)
+				{
+					const auto& vertex = out.mesh.vertices[remap[corner[n]]];
+					corners[n] = glm::vec2{vertex.u, vertex.v} *
+								 static_cast<float>(resolution);
+				}
+				const auto area =
+					Cross(corners[1] - corners[0], corners[2] - corners[0]);
+				if (pass == DXRLightmap::k_Covered && area == 0.f)
+					continue;
+				const auto min =
+					glm::min(corners[0], glm::min(corners[1], corners[2]));
+				const auto max =
+					glm::max(corners[0], glm::max(corners[1], corners[2]));
+				const auto x0 = static_cast<std::uint32_t>(
+					std::max(std::floor(min.x - 0.5f), 0.f));
+				const auto y0 = static_cast<std::uint32_t>(
+					std::max(std::floor(min.y - 0.5f), 0.f));
+				const auto x1 = std::min(
+					static_cast<std::uint32_t>(std::ceil(max.x + 0.5f)),
+					resolution);
+				const auto y1 = std::min(
+					static_cast<std::uint32_t>(std::ceil(max.y + 0.5f)),
+					resolution);
+				for (auto y = y0; y < y1; y++)
+				{
+					for (auto x = x0; x < x1; x++)
+					{
+						const auto texel = std::size_t{y} * resolution + x;
+						if (out.coverage[texel] != DXRLightmap::k_Empty)
+							continue;
+						const glm::vec2 centre{static_cast<float>(x) + 0.5f,
+											   static_cast<float>(y) + 0.5f};
+						glm::vec2 barycentrics{};
+						if (pass == DXRLightmap::k_Covered)
+						{
+							barycentrics = {
+								Cross(centre - corners[0],
+									  corners[2] - corners[0]) /
+									area,
+								Cross(corners[1] - corners[0],
+									  centre - corners[0]) /
+									area};
+							if (barycentrics.x < 0.f || barycentrics.y < 0.f ||
+								barycentrics.x + barycentrics.y > 1.f)
+								continue;
+						}
+						else if (GetNearestPoint(corners, centre,
+												 barycentrics) > 0.5f)
+						{
+							// Further than half a texel diagonal:
+							continue;
+						}
+						// A hair inside the triangle, edges can have UVs of
+						// exactly 1 that the border sampler turns black:
+						barycentrics =
+							barycentrics * 0.999f + glm::vec2{0.001f / 3.f};
+
+						const auto w1 = barycentrics.x;
+						const auto w2 = barycentrics.y;
+						const auto w0 = 1.f - w1 - w2;
+						const auto& a = mesh.vertices[corner[0]];
+						const auto& b = mesh.vertices[corner[1]];
+						const auto& c = mesh.vertices[corner[2]];
+						out.coverage[texel] = pass;
+						out.positions[texel] = world[corner[0]] * w0 +
+											   world[corner[1]] * w1 +
+											   world[corner[2]] * w2;
+						const auto normal =
+							transform.normal *
+							(glm::vec3{a.nx, a.ny, a.nz} * w0 +
+							 glm::vec3{b.nx, b.ny, b.nz} * w1 +
+							 glm::vec3{c.nx, c.ny, c.nz} * w2);
+						out.normals[texel] = glm::dot(normal, normal) > 0.f
+												 ? glm::normalize(normal)
+												 : faceNormals[triangle];
+						out.textureCoordinates[texel] = {
+							a.u * w0 + b.u * w1 + c.u * w2,
+							a.v * w0 + b.v * w1 + c.v * w2};
+					}
+				}
+			}
+		}
+		for (const auto triangle : chart.triangles)
+		{
+			for (std::uint32_t corner{}; corner < 3; corner++)
+			{
+				remap[mesh.indices[triangle * 3 + corner]] = ~0u;
+			}
+		}
+	}
+	return true;
+}
+
+auto BakeLightmap(const DXRRayTopLevel& scene, const DXRLightmapDesc& desc,
+				  DXRLightmap& lightmap, DXRJobSystem* jobs) -> std::uint64_t
+{
+	const auto resolution = lightmap.resolution;
+	const auto texels = std::size_t{resolution} * resolution;
+	auto& lighting = lightmap.lighting;
+	lighting.width = static_cast<int>(resolution);
+	lighting.height = static_cast<int>(resolution);
+	lighting.pixels.assign(texels * 4, 0.f);
+	if (lightmap.coverage.size() != texels)
+		return 0;
+
+	std::vector<std::uint32_t> baked{};
+	for (std::size_t texel{}; texel < texels; texel++)
+	{
+		if (lightmap.coverage[texel] != DXRLightmap::k_Empty)
+			baked.push_back(static_cast<std::uint32_t>(texel));
+	}
+
+	auto sunDirection = desc.sunDirection;
+	const auto sunOn =
+		glm::dot(desc.sunIrradiance, desc.sunIrradiance) > 0.f &&
+		glm::dot(sunDirection, sunDirection) > 0.f;
+	if (sunOn)
+		sunDirection = glm::normalize(sunDirection);
+	const auto samples = std::max(desc.aoSamples, 1u);
+	std::atomic<std::uint64_t> rays{};
+	const auto bake = [&](std::size_t first, std::size_t last) {
+		std::uint64_t chunkRays{};
+		for (auto n = first; n < last; n++)
+		{
+			const auto texel = baked[n];
+			const auto& position = lightmap.positions[texel];
+			const auto& normal = lightmap.normals[texel];
+			const auto scale =
+				std::max({1.f, std::abs(position.x), std::abs(position.y),
+						  std::abs(position.z)});
+			DXRRay ray{};
+			ray.origin = position + normal * (1e-4f * scale);
+			ray.tMax = desc.aoDistance;
+
+			// Roberts' R2 sequence, rotated by a hash of the texel so
+			// neighbours don't share their directions:
+			const auto seed = HashSample(texel);
+			const glm::vec2 rotation{ToUnitFloat(seed),
+									 ToUnitFloat(HashSample(seed))};
+			std::uint32_t unoccluded{};
+			for (std::uint32_t sample{}; sample < samples; sample++)
+			{
+				const auto k = static_cast<float>(sample);
+				const auto point =
+					glm::fract(rotation + k * glm::vec2{0.7548776662f,
+														0.5698402910f});
+				ray.direction = SampleCosineHemisphere(normal, point);
+				DXRRayHit hit{};
+				unoccluded +=
+					!scene.TraceRay(ray, DXRRayQueryType::Occlusion, hit);
+			}
+			chunkRays += samples;
+			const auto occlusion =
+				static_cast<float>(unoccluded) / static_cast<float>(samples);
+
+			// Irradiance over pi, cosine weighted visibility already is:
+			auto light = desc.skyRadiance * occlusion;
+			const auto cosine = glm::dot(normal, sunDirection);
+			if (sunOn && cosine > 0.f)
+			{
+				DXRRay shadow{};
+				shadow.origin = ray.origin;
+				shadow.direction = sunDirection;
+				DXRRayHit hit{};
+				if (!scene.TraceRay(shadow, DXRRayQueryType::Occlusion, hit))
+					light += desc.sunIrradiance *
+							 (cosine * std::numbers::inv_pi_v<float>);
+				chunkRays++;
+			}
+			const glm::vec4 value{light, occlusion};
+			memcpy(lighting.pixels.data() + std::size_t{texel} * 4, &value,
+				   sizeof value);
+		}
+		rays.fetch_add(chunkRays, std::memory_order_relaxed);
+	};
+	if (jobs)
+	{
+		jobs->ParallelFor(0, baked.size(), 64, bake);
+	}
+	else
+	{
+		bake(0, baked.size());
+	}
+
+	// Dilation: every empty texel next to a baked one copies it, edge
+	// neighbours before diagonal ones, one ring per pass:
+	constexpr int k_Neighbours[8][2]{{-1, 0}, {1, 0},  {0, -1}, {0, 1},
+									 {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+	const auto size = static_cast<int>(resolution);
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> filled{};
+	for (std::uint32_t pass{}; pass < std::max(desc.padding, 1u); pass++)
+	{
+		filled.clear();
+		for (int y{}; y < size; y++)
+		{
+			for (int x{}; x < size; x++)
+			{
+				const auto texel = static_cast<std::uint32_t>(y * size + x);
+				if (lightmap.coverage[texel] != DXRLightmap::k_Empty)
+					continue;
+				for (const auto& offset : k_Neighbours)
+				{
+					const auto nx = x + offset[0];
+					const auto ny = y + offset[1];
+					if (nx < 0 || ny < 0 || nx >= size || ny >= size)
+						continue;
+					const auto neighbour =
+						static_cast<std::uint32_t>(ny * size + nx);
+					if (lightmap.coverage[neighbour] == DXRLightmap::k_Empty)
+						continue;
+					filled.emplace_back(texel, neighbour);
+					break;
+				}
+			}
+		}
+		for (const auto& [texel, neighbour] : filled)
+		{
+			lightmap.coverage[texel] = DXRLightmap::k_Dilated;
+			lightmap.positions[texel] = lightmap.positions[neighbour];
+			lightmap.normals[texel] = lightmap.normals[neighbour];
+			lightmap.textureCoordinates[texel] =
+				lightmap.textureCoordinates[neighbour];
+			memcpy(lighting.pixels.data() + std::size_t{texel} * 4,
+				   lighting.pixels.data() + std::size_t{neighbour} * 4,
+				   sizeof(float) * 4);
+		}
+	}
+	return rays.load(std::memory_order_relaxed);
+}
+
+auto CompositeLightmap(const DXRLightmap& lightmap,
+					   const DXRImageRGBA8* texture, DXRImageRGBA8& out)
+	-> void
+{
+	const auto texels = std::size_t{lightmap.resolution} * lightmap.resolution;
+	out.width = static_cast<int>(lightmap.resolution);
+	out.height = static_cast<int>(lightmap.resolution);
+	out.pixels.assign(texels * 4, 0);
+	if (lightmap.coverage.size() != texels ||
+		lightmap.lighting.pixels.size() != texels * 4)
+		return;
+
+	const auto toUnorm = [](float v) -> unsigned char {
+		return static_cast<unsigned char>(std::clamp(v, 0.f, 1.f) * 255.f +
+										  0.5f);
+	};
+	for (std::size_t texel{}; texel < texels; texel++)
+	{
+		if (lightmap.coverage[texel] == DXRLightmap::k_Empty)
+			continue;
+		const auto& uv = lightmap.textureCoordinates[texel];
+		const auto albedo = SampleTexturePoint(texture, uv.x, uv.y);
+		const auto* light = lightmap.lighting.pixels.data() + texel * 4;
+		for (std::size_t channel{}; channel < 3; channel++)
+		{
+			out.pixels[texel * 4 + channel] =
+				toUnorm(albedo[static_cast<int>(channel)] * light[channel]);
+		}
+		out.pixels[texel * 4 + 3] = toUnorm(albedo.a);
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "DXRAssets.h"
+#include "DXRRayTopLevel.h"
+
+#include <span>
+#include <vector>
+
+struct DXRJobSystem;
+
+struct DXRLightmapDesc
+{
+	// Square atlas, texels per side:
+	std::uint32_t resolution{256};
+	// Texels left around every chart. The texels a triangle only touches
+	// are baked too, dilation fills the rest of the gap so point sampling
+	// never reads an empty texel where charts meet:
+	std::uint32_t padding{2};
+	// Neighbouring triangles join a chart while their normal is within this
+	// cosine of its first triangle's, about 25 degrees by default:
+	float chartCosine{0.9f};
+	// Cosine weighted rays per texel for ambient occlusion and sky light:
+	std::uint32_t aoSamples{64};
+	// Occluders further away than this don't darken, past it the sky is
+	// taken as visible:
+	float aoDistance{2.f};
+	// Same light as DXRPathTracerDesc, direct only, no bounces:
+	glm::vec3 skyRadiance{1.f};
+	glm::vec3 sunDirection{0.4f, 1.f, 0.3f};
+	glm::vec3 sunIrradiance{0.f};
+};
+
+// Lightmap of one placed mesh. Per texel arrays have resolution squared
+// entries in rows bottom-up, like DXRImages, so v = (y + 0.5) / resolution
+// addresses row y:
+struct DXRLightmap
+{
+	std::uint32_t resolution{};
+	std::uint32_t charts{};
+	// Lightmap texels per world unit, the same everywhere on the mesh:
+	float texelsPerUnit{};
+	// The baked mesh with u, v moved into the lightmap, vertices split where
+	// charts meet. Drawn with the instance transform it was unwrapped for:
+	DXRIndexedMesh mesh{};
+	// k_Empty, k_Covered where a triangle covers the texel's centre,
+	// k_Touched where it only overlaps the texel (baked at the nearest point
+	// on the triangle) and k_Dilated for texels filled from a neighbour:
+	std::vector<std::uint8_t> coverage{};
+	// Surface point and interpolated vertex normal, world space:
+	std::vector<glm::vec3> positions{};
+	std::vector<glm::vec3> normals{};
+	// Where the mesh's own UVs put the texel, for CompositeLightmap():
+	std::vector<glm::vec2> textureCoordinates{};
+	// From BakeLightmap(): rgb is irradiance over pi, what albedo is
+	// multiplied by for the light a diffuse surface sends back, a is ambient
+	// occlusion, 1 where nothing is in the way:
+	DXRImageRGBA32F lighting{};
+
+	static inline constexpr std::uint8_t k_Empty{0};
+	static inline constexpr std::uint8_t k_Covered{1};
+	static inline constexpr std::uint8_t k_Touched{2};
+	static inline constexpr std::uint8_t k_Dilated{3};
+};
+
+// Generates lightmap UVs for mesh placed by instance: neighbouring
+// triangles facing the same way are grown into charts, each chart is
+// projected onto its plane, turned to its smallest bounding rectangle and
+// shelf packed into the atlas at the largest scale that fits. Fills
+// everything but lighting. Returns false if nothing could be packed:
+auto UnwrapLightmap(const DXRIndexedMesh& mesh, const DXRInstanceData& instance,
+					const DXRLightmapDesc& desc, DXRLightmap& out) -> bool;
+
+// Ray traces ambient occlusion, sky light and the sun's direct light for
+// every texel UnwrapLightmap() found, against scene, which should hold the
+// mesh itself too. Texels are spread over the job threads with jobs, then
+// dilated padding times into the empty texels around the charts.
+// Returns the number of rays traced:
+auto BakeLightmap(const DXRRayTopLevel& scene, const DXRLightmapDesc& desc,
+				  DXRLightmap& lightmap, DXRJobSystem* jobs = nullptr)
+	-> std::uint64_t;
+
+// Texture times lighting at every texel, ready for the sampler path
+// pixelShader2DText and DXRSoftwareRasterizer already have: draw
+// lightmap.mesh with it bound to t0. Empty texels stay transparent black,
+// rows bottom-up like every texture:
+auto CompositeLightmap(const DXRLightmap& lightmap,
+					   const DXRImageRGBA8* texture, DXRImageRGBA8& out)
+	-> void;
@@ -0,0 +1,88 @@
+#include "DXRMappedFile.h"
+
+#ifdef _WIN32
+#include "W32Handle.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+DXRMappedFile::~DXRMappedFile()
+{
+	Close();
+}
+
+auto DXRMappedFile::Open(const char* path) -> bool
+{
+	Close();
+
+#ifdef _WIN32
+	// INVALID_HANDLE_VALUE isn't a constant expression, so the file handle
+	// can't be a W32Handle:
+	const auto file = ::CreateFileA(
+		path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	NTNamespace::LARGE_INTEGER size{};
+	W32Handle<nullptr> mapping{};
+	if (::GetFileSizeEx(file, &size) && size.QuadPart > 0)
+	{
+		mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0,
+									   nullptr);
+	}
+	::CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	// The view keeps the mapping alive:
+	const auto view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+		return false;
+
+	m_data = reinterpret_cast<const unsigned char*>(view);
+	m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+	const auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct ::stat st{};
+	if (::fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	const auto size = static_cast<std::size_t>(st.st_size);
+	const auto view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after close():
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	// We read it front to back once, on the upload:
+	::madvise(view, size, MADV_SEQUENTIAL);
+
+	m_data = reinterpret_cast<const unsigned char*>(view);
+	m_size = size;
+#endif
+	return true;
+}
+
+auto DXRMappedFile::Close() -> void
+{
+	if (!m_data)
+		return;
+
+#ifdef _WIN32
+	::UnmapViewOfFile(m_data);
+#else
+	::munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file:
+// Pages are faulted in on first touch, nothing gets copied up front.
+// mmap() on POSIX, CreateFileMapping()/MapViewOfFile() on Windows.
+struct DXRMappedFile : DXRNonCopyable
+{
+	DXRMappedFile() = default;
+	~DXRMappedFile();
+
+	// Maps the file at path, closes whatever was mapped before.
+	// Returns false if the file can't be opened or is empty:
+	auto Open(const char* path) -> bool;
+	auto Close() -> void;
+
+	inline auto IsValid() const -> bool
+	{
+		return m_data != nullptr;
+	}
+
+	inline auto GetData() const -> const unsigned char*
+	{
+		return m_data;
+	}
+
+	inline auto GetSize() const -> std::size_t
+	{
+		return m_size;
+	}
+
+  private:
+	const unsigned char* m_data{};
+	std::size_t m_size{};
+};
@@ -0,0 +1,412 @@
+#include "DXRMeshBuilder.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr std::uint32_t k_InvalidIndex{~0u};
+
+static_assert(sizeof(DXRVertex3D) == 9 * sizeof(std::uint32_t),
+			  "WeldVertices hashes DXRVertex3D as 9 words");
+
+// FNV-1a over the words, then a final avalanche so the low bits (the table
+// index) depend on everything:
+auto HashVertex(const DXRVertex3D& vertex) -> std::uint32_t
+{
+	std::uint32_t words[9]{};
+	memcpy(words, &vertex, sizeof vertex);
+	std::uint32_t hash{2166136261u};
+	for (const auto word : words)
+	{
+		hash = (hash ^ word) * 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x7FEB352Du;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+auto GetPosition(const DXRVertex3D& vertex) -> glm::vec3
+{
+	return {vertex.x, vertex.y, vertex.z};
+}
+
+// Tipsify's next fanning vertex: the candidate that has been in the cache
+// the longest but will still be there after its remaining triangles are
+// emitted. Falls back to recently used vertices (dead-end stack), then to
+// the next vertex in input order. k_InvalidIndex when everything is out.
+struct TipsifyState
+{
+	std::vector<std::uint32_t> liveTriangles{};
+	std::vector<std::uint32_t> cacheTime{};
+	std::vector<std::uint32_t> deadEnd{};
+	std::uint32_t timeStamp{};
+	std::size_t cursor{};
+};
+
+auto GetNextFanningVertex(TipsifyState& state,
+						  std::span<const std::uint32_t> candidates,
+						  std::uint32_t cacheSize) -> std::uint32_t
+{
+	auto best = k_InvalidIndex;
+	std::int64_t bestPriority{-1};
+	for (const auto v : candidates)
+	{
+		const auto live = state.liveTriangles[v];
+		if (!live)
+			continue;
+
+		const auto age = state.timeStamp - state.cacheTime[v];
+		const std::int64_t priority =
+			age + 2 * live <= cacheSize ? static_cast<std::int64_t>(age) : 0;
+		if (priority > bestPriority)
+		{
+			bestPriority = priority;
+			best = v;
+		}
+	}
+	if (best != k_InvalidIndex)
+		return best;
+
+	while (!state.deadEnd.empty())
+	{
+		const auto v = state.deadEnd.back();
+		state.deadEnd.pop_back();
+		if (state.liveTriangles[v])
+			return v;
+	}
+
+	for (; state.cursor < state.liveTriangles.size(); state.cursor++)
+	{
+		if (state.liveTriangles[state.cursor])
+			return static_cast<std::uint32_t>(state.cursor);
+	}
+	return k_InvalidIndex;
+}
+
+// Marks for every triangle whether the FIFO cache missed all three of its
+// vertices, and how many it missed:
+auto SimulateCache(std::span<const std::uint32_t> indices,
+				   std::size_t vertexCount, std::uint32_t cacheSize,
+				   std::vector<std::uint8_t>& triangleMisses) -> std::uint64_t
+{
+	std::vector<std::uint32_t> cacheTime(vertexCount, 0);
+	// Starts past the cache size so nothing is cached at first:
+	std::uint32_t timeStamp{cacheSize + 1};
+	std::uint64_t misses{};
+	triangleMisses.assign(indices.size() / 3, 0);
+	for (std::size_t n{}; n + 2 < indices.size(); n += 3)
+	{
+		for (std::size_t k{}; k < 3; k++)
+		{
+			const auto v = indices[n + k];
+			if (timeStamp - cacheTime[v] > cacheSize)
+			{
+				cacheTime[v] = timeStamp++;
+				triangleMisses[n / 3]++;
+				misses++;
+			}
+		}
+	}
+	return misses;
+}
+} // namespace
+
+auto WeldVertices(std::span<const DXRVertex3D> triangleList,
+				  DXRIndexedMesh& out) -> void
+{
+	out.vertices.clear();
+	out.indices.clear();
+	out.indices.reserve(triangleList.size());
+
+	// Open addressing, at most half full:
+	const auto tableSize =
+		std::bit_ceil(std::max<std::size_t>(triangleList.size() * 2, 16));
+	const auto mask = tableSize - 1;
+	std::vector<std::uint32_t> table(tableSize, k_InvalidIndex);
+
+	for (const auto& vertex : triangleList)
+	{
+		auto slot = static_cast<std::size_t>(HashVertex(vertex)) & mask;
+		while (true)
+		{
+			const auto existing = table[slot];
+			if (existing == k_InvalidIndex)
+			{
+				table[slot] = static_cast<std::uint32_t>(out.vertices.size());
+				out.indices.push_back(table[slot]);
+				out.vertices.push_back(vertex);
+				break;
+			}
+			if (!memcmp(&out.vertices[existing], &vertex, sizeof vertex))
+			{
+				out.indices.push_back(existing);
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+auto OptimizeVertexCache(std::span<std::uint32_t> indices,
+						 std::size_t vertexCount, std::uint32_t cacheSize)
+	-> void
+{
+	const auto triangleCount = indices.size() / 3;
+	if (!triangleCount || !vertexCount)
+		return;
+
+	// Triangles around every vertex:
+	TipsifyState state{};
+	state.liveTriangles.assign(vertexCount, 0);
+	for (std::size_t n{}; n < triangleCount * 3; n++)
+	{
+		state.liveTriangles[indices[n]]++;
+	}
+	std::vector<std::uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (std::size_t v{}; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + state.liveTriangles[v];
+	}
+	std::vector<std::uint32_t> adjacency(triangleCount * 3);
+	{
+		auto fill = adjacencyOffsets;
+		for (std::size_t n{}; n < triangleCount * 3; n++)
+		{
+			adjacency[fill[indices[n]]++] = static_cast<std::uint32_t>(n / 3);
+		}
+	}
+
+	state.cacheTime.assign(vertexCount, 0);
+	state.timeStamp = cacheSize + 1;
+	state.deadEnd.reserve(triangleCount * 3);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<std::uint32_t> output{};
+	output.reserve(triangleCount * 3);
+	std::vector<std::uint32_t> candidates{};
+
+	auto fanning = indices[0];
+	while (fanning != k_InvalidIndex)
+	{
+		candidates.clear();
+		for (auto a = adjacencyOffsets[fanning];
+			 a < adjacencyOffsets[fanning + 1]; a++)
+		{
+			const auto triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+
+			for (std::size_t k{}; k < 3; k++)
+			{
+				const auto v = indices[triangle * 3 + k];
+				output.push_back(v);
+				state.deadEnd.push_back(v);
+				candidates.push_back(v);
+				state.liveTriangles[v]--;
+				if (state.timeStamp - state.cacheTime[v] > cacheSize)
+				{
+					state.cacheTime[v] = state.timeStamp++;
+				}
+			}
+		}
+		fanning = GetNextFanningVertex(state, candidates, cacheSize);
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+auto OptimizeOverdraw(std::span<std::uint32_t> indices,
+					  std::span<const DXRVertex3D> vertices,
+					  std::uint32_t cacheSize, float threshold) -> void
+{
+	const auto triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Cluster starts: where the cache starts over (all three vertices
+	// missed), moving what follows costs the least there:
+	std::vector<std::uint8_t> triangleMisses{};
+	const auto baseMisses =
+		SimulateCache(indices, vertices.size(), cacheSize, triangleMisses);
+	std::vector<std::size_t> boundaries{};
+	for (std::size_t t{}; t < triangleCount; t++)
+	{
+		if (t == 0 || triangleMisses[t] == 3)
+			boundaries.push_back(t);
+	}
+
+	// Area weighted centroid and normal of every triangle:
+	std::vector<glm::vec3> centroids(triangleCount);
+	std::vector<glm::vec3> normals(triangleCount);
+	glm::vec3 meshCentroid{};
+	float meshArea{};
+	for (std::size_t t{}; t < triangleCount; t++)
+	{
+		const auto a = GetPosition(vertices[indices[t * 3 + 0]]);
+		const auto b = GetPosition(vertices[indices[t * 3 + 1]]);
+		const auto c = GetPosition(vertices[indices[t * 3 + 2]]);
+		normals[t] = glm::cross(b - a, c - a);
+		const auto area = glm::length(normals[t]);
+		centroids[t] = (a + b + c) * (area / 3.f);
+		meshCentroid += centroids[t];
+		meshArea += area;
+	}
+	if (meshArea > 0.f)
+	{
+		meshCentroid /= meshArea;
+	}
+
+	// Smaller clusters sort better but restart the cache more often. Start
+	// small and merge neighbours until the cost is within threshold:
+	std::vector<std::uint32_t> output(indices.size());
+	std::vector<std::size_t> clusters{};
+	std::vector<float> keys{};
+	std::vector<std::size_t> order{};
+	for (std::size_t minTriangles{8}; minTriangles < triangleCount;
+		 minTriangles *= 2)
+	{
+		clusters.clear();
+		for (const auto boundary : boundaries)
+		{
+			if (clusters.empty() || boundary - clusters.back() >= minTriangles)
+				clusters.push_back(boundary);
+		}
+		clusters.push_back(triangleCount);
+		const auto clusterCount = clusters.size() - 1;
+		if (clusterCount < 2)
+			break;
+
+		// Outward facing clusters first, they occlude the inward facing
+		// ones:
+		keys.assign(clusterCount, 0.f);
+		order.resize(clusterCount);
+		for (std::size_t c{}; c < clusterCount; c++)
+		{
+			glm::vec3 centroid{};
+			glm::vec3 normal{};
+			float area{};
+			for (auto t = clusters[c]; t < clusters[c + 1]; t++)
+			{
+				centroid += centroids[t];
+				normal += normals[t];
+				area += glm::length(normals[t]);
+			}
+			const auto length = glm::length(normal);
+			if (area > 0.f && length > 0.f)
+			{
+				keys[c] = glm::dot(centroid / area - meshCentroid,
+								   normal / length);
+			}
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(),
+						 [&](std::size_t a, std::size_t b) {
+							 return keys[a] > keys[b];
+						 });
+
+		auto out = output.begin();
+		for (const auto c : order)
+		{
+			out = std::copy(indices.begin() +
+								static_cast<std::ptrdiff_t>(clusters[c] * 3),
+							indices.begin() +
+								static_cast<std::ptrdiff_t>(clusters[c + 1] * 3),
+							out);
+		}
+
+		const auto misses =
+			SimulateCache(output, vertices.size(), cacheSize, triangleMisses);
+		if (static_cast<float>(misses) <=
+			threshold * static_cast<float>(baseMisses))
+		{
+			std::copy(output.begin(), output.end(), indices.begin());
+			return;
+		}
+	}
+	// No clustering is cheap enough, the cache order stays.
+}
+
+auto OptimizeVertexFetch(DXRIndexedMesh& mesh) -> void
+{
+	std::vector<std::uint32_t> remap(mesh.vertices.size(), k_InvalidIndex);
+	std::vector<DXRVertex3D> vertices{};
+	vertices.reserve(mesh.vertices.size());
+	for (auto& index : mesh.indices)
+	{
+		if (remap[index] == k_InvalidIndex)
+		{
+			remap[index] = static_cast<std::uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	// Unreferenced vertices are dropped:
+	mesh.vertices = std::move(vertices);
+}
+
+auto BuildIndexedMesh(std::span<const DXRVertex3D> triangleList,
+					  DXRIndexedMesh& out, const DXRMeshBuilderDesc& desc)
+	-> bool
+{
+	if (triangleList.size() % 3)
+		return false;
+
+	WeldVertices(triangleList, out);
+	if (desc.optimizeVertexCache)
+	{
+		OptimizeVertexCache(out.indices, out.vertices.size(), desc.cacheSize);
+		if (desc.optimizeOverdraw)
+		{
+			OptimizeOverdraw(out.indices, out.vertices, desc.cacheSize,
+							 desc.overdrawThreshold);
+		}
+	}
+	if (desc.optimizeVertexFetch)
+	{
+		OptimizeVertexFetch(out);
+	}
+	return true;
+}
+
+auto AnalyzeVertexCache(std::span<const std::uint32_t> indices,
+						std::size_t vertexCount, std::uint32_t cacheSize)
+	-> DXRVertexCacheStats
+{
+	DXRVertexCacheStats stats{};
+	if (indices.size() < 3 || !vertexCount)
+		return stats;
+
+	std::vector<std::uint8_t> triangleMisses{};
+	stats.misses = SimulateCache(indices, vertexCount, cacheSize, triangleMisses);
+	stats.acmr = static_cast<float>(stats.misses) /
+				 static_cast<float>(indices.size() / 3);
+	stats.atvr =
+		static_cast<float>(stats.misses) / static_cast<float>(vertexCount);
+	return stats;
+}
+
+auto PackIndices(const DXRIndexedMesh& mesh, std::vector<unsigned char>& out)
+	-> DXRIndexFormat
+{
+	const auto format = mesh.GetIndexFormat();
+	if (format == DXRIndexFormat::UInt16)
+	{
+		out.resize(mesh.indices.size() * sizeof(std::uint16_t));
+		for (std::size_t n{}; n < mesh.indices.size(); n++)
+		{
+			const auto index = static_cast<std::uint16_t>(mesh.indices[n]);
+			memcpy(out.data() + n * sizeof index, &index, sizeof index);
+		}
+	}
+	else
+	{
+		out.resize(mesh.indices.size() * sizeof(std::uint32_t));
+		memcpy(out.data(), mesh.indices.data(), out.size());
+	}
+	return format;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+
+#include <span>
+#include <vector>
+
+// Turns triangle soup into an indexed mesh that is cheap to draw:
+//   1. Weld: bitwise identical DXRVertex3Ds become one vertex.
+//   2. Vertex cache: Tipsify (Sander, Nehab, Barczak 2007) reorders
+//      triangles so shared vertices are still in the post-transform cache
+//      when they are reused.
+//   3. Overdraw: the cache friendly order is cut into clusters, clusters
+//      facing away from the mesh center go first so the depth test rejects
+//      more of what comes after. Clusters are merged until the cache cost
+//      stays within overdrawThreshold of step 2, otherwise step 2's order
+//      stays.
+//   4. Vertex fetch: vertices are renumbered in first use order.
+struct DXRMeshBuilderDesc
+{
+	// FIFO entries the optimizer plans for (and AnalyzeVertexCache()
+	// simulates), 16 is a safe guess for current GPUs:
+	std::uint32_t cacheSize{16};
+	bool optimizeVertexCache{true};
+	bool optimizeOverdraw{true};
+	// Allowed ACMR growth for overdraw, 1.05 = 5%:
+	float overdrawThreshold{1.05f};
+	bool optimizeVertexFetch{true};
+};
+
+// Post-transform cache efficiency of an index buffer:
+//   ACMR: vertices shaded per triangle, 3 unindexed, 0.5 at best for a
+//   regular grid.
+//   ATVR: vertices shaded per unique vertex, 1 is perfect.
+struct DXRVertexCacheStats
+{
+	float acmr{};
+	float atvr{};
+	std::uint64_t misses{};
+};
+
+// Triangle list in, indexed mesh out. Returns false if the vertex count
+// isn't a multiple of 3:
+auto BuildIndexedMesh(std::span<const DXRVertex3D> triangleList,
+					  DXRIndexedMesh& out, const DXRMeshBuilderDesc& desc = {})
+	-> bool;
+
+// Step 1 only, out.indices has one entry per input vertex:
+auto WeldVertices(std::span<const DXRVertex3D> triangleList,
+				  DXRIndexedMesh& out) -> void;
+
+// Step 2, in place:
+auto OptimizeVertexCache(std::span<std::uint32_t> indices,
+						 std::size_t vertexCount, std::uint32_t cacheSize = 16)
+	-> void;
+
+// Step 3, in place, expects the output of OptimizeVertexCache():
+auto OptimizeOverdraw(std::span<std::uint32_t> indices,
+					  std::span<const DXRVertex3D> vertices,
+					  std::uint32_t cacheSize = 16, float threshold = 1.05f)
+	-> void;
+
+// Step 4, in place:
+auto OptimizeVertexFetch(DXRIndexedMesh& mesh) -> void;
+
+// Simulates a FIFO cache of cacheSize entries:
+auto AnalyzeVertexCache(std::span<const std::uint32_t> indices,
+						std::size_t vertexCount, std::uint32_t cacheSize = 16)
+	-> DXRVertexCacheStats;
+
+// Index buffer contents in mesh.GetIndexFormat(), ready for the upload:
+auto PackIndices(const DXRIndexedMesh& mesh, std::vector<unsigned char>& out)
+	-> DXRIndexFormat;
@@ -0,0 +1,762 @@
+#include "DXRMipGenerator.h"
+#include "DXRCPUFeatures.h"
+#include "DXRJobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numbers>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define DXRMIPGENERATORSSE
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC emits AVX2 intrinsics without /arch:AVX2:
+#define DXRMIPGENERATORAVX2
+#else
+#define DXRMIPGENERATORAVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace
+{
+constexpr std::uint32_t k_MaxTaps{8};
+
+// Levels with fewer destination texels than this run on the calling thread,
+// spawning costs more than the work:
+constexpr std::size_t k_ParallelMinTexels{256 * 256};
+
+// Separable 2:1 filter, destination texel i reads source texels
+// 2i + first ... 2i + first + taps - 1:
+struct MipFilter
+{
+	int first{};
+	std::uint32_t taps{};
+	float weights[k_MaxTaps]{};
+};
+
+// Modified Bessel function of the first kind, order 0:
+auto BesselI0(double x) -> double
+{
+	double sum{1.0};
+	double term{1.0};
+	for (int k{1}; k < 32; k++)
+	{
+		const auto half = x / (2.0 * k);
+		term *= half * half;
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+auto MakeKaiserFilter() -> MipFilter
+{
+	// Support of 2 destination texels on each side, alpha = 4:
+	constexpr double k_Width{2.0};
+	constexpr double k_Alpha{4.0};
+
+	MipFilter filter{};
+	filter.first = -3;
+	filter.taps = 8;
+	double sum{};
+	double weights[k_MaxTaps]{};
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		// Distance from the destination texel center, in destination texels:
+		const auto x = (filter.first + static_cast<int>(t) - 0.5) / 2.0;
+		const auto sinc =
+			x == 0.0 ? 1.0
+					 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+		const auto r = x / k_Width;
+		const auto window =
+			BesselI0(k_Alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) /
+			BesselI0(k_Alpha);
+		weights[t] = sinc * window;
+		sum += weights[t];
+	}
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		filter.weights[t] = static_cast<float>(weights[t] / sum);
+	}
+	return filter;
+}
+
+auto GetMipFilter(DXRMipFilter type) -> const MipFilter&
+{
+	static const MipFilter box{0, 2, {0.5f, 0.5f}};
+	static const MipFilter kaiser{MakeKaiserFilter()};
+	return type == DXRMipFilter::Kaiser ? kaiser : box;
+}
+
+// RGBA8 <-> float conversion tables:
+struct MipColorTables
+{
+	// [0]: unorm, [1]: sRGB colors + unorm alpha.
+	// 512 entries each, colors first, then alpha, so a texel's channel c
+	// looks up byte + (c == 3 ? 256 : 0):
+	float toFloat[2][512]{};
+	// Linear [0, 1] quantized to 16 bits -> sRGB byte:
+	std::array<unsigned char, 65536> toSRGB{};
+};
+
+auto GetMipColorTables() -> const MipColorTables&
+{
+	static const auto tables = [] {
+		auto out = std::make_unique<MipColorTables>();
+		for (int n{}; n < 256; n++)
+		{
+			const auto unorm = static_cast<float>(n) / 255.f;
+			const auto linear =
+				unorm <= 0.04045f
+					? unorm / 12.92f
+					: std::pow((unorm + 0.055f) / 1.055f, 2.4f);
+			out->toFloat[0][n] = unorm;
+			out->toFloat[0][n + 256] = unorm;
+			out->toFloat[1][n] = linear;
+			out->toFloat[1][n + 256] = unorm;
+		}
+		for (std::size_t n{}; n < out->toSRGB.size(); n++)
+		{
+			const auto linear = static_cast<float>(n) / 65535.f;
+			const auto srgb =
+				linear <= 0.0031308f
+					? linear * 12.92f
+					: 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f;
+			out->toSRGB[n] = static_cast<unsigned char>(
+				std::clamp(srgb, 0.f, 1.f) * 255.f + 0.5f);
+		}
+		return out;
+	}();
+	return *tables;
+}
+
+// Destination texels [begin, end) whose taps never need clamping:
+auto GetInteriorRange(int srcWidth, int dstWidth, const MipFilter& filter,
+					  int& begin, int& end) -> void
+{
+	const auto taps = static_cast<int>(filter.taps);
+	begin = std::min(dstWidth, std::max(0, (-filter.first + 1) / 2));
+	// Last i with 2i + first + taps - 1 <= srcWidth - 1:
+	const auto last = srcWidth - filter.first - taps;
+	end = last < 0 ? begin
+				   : std::max(begin, std::min(dstWidth, last / 2 + 1));
+}
+
+struct MipKernels
+{
+	// Filters one float row (4 floats per texel) to half width:
+	void (*horizontal)(const float* src, int srcWidth, float* dst,
+					   int dstWidth, const MipFilter& filter){};
+	// dst[n] = sum(weights[t] * rows[t][n]):
+	void (*vertical)(const float* const* rows, const MipFilter& filter,
+					 float* dst, std::size_t count){};
+	void (*loadRGBA8)(const unsigned char* src, float* dst, int width,
+					  const float* table){};
+	// srgbTable is null for unorm:
+	void (*storeRGBA8)(const float* src, unsigned char* dst, int width,
+					   const unsigned char* srgbTable){};
+};
+
+// Scalar:
+
+auto HorizontalTexelScalar(const float* src, int srcWidth, float* dst, int i,
+						   const MipFilter& filter) -> void
+{
+	float acc[4]{};
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		const auto x = std::clamp(2 * i + filter.first + static_cast<int>(t),
+								  0, srcWidth - 1);
+		const auto texel = src + static_cast<std::size_t>(x) * 4;
+		for (int c{}; c < 4; c++)
+		{
+			acc[c] += filter.weights[t] * texel[c];
+		}
+	}
+	memcpy(dst + static_cast<std::size_t>(i) * 4, acc, sizeof acc);
+}
+
+auto HorizontalScalar(const float* src, int srcWidth, float* dst, int dstWidth,
+					  const MipFilter& filter) -> void
+{
+	for (int i{}; i < dstWidth; i++)
+	{
+		HorizontalTexelScalar(src, srcWidth, dst, i, filter);
+	}
+}
+
+auto VerticalScalar(const float* const* rows, const MipFilter& filter,
+					float* dst, std::size_t count) -> void
+{
+	for (std::size_t n{}; n < count; n++)
+	{
+		float acc{};
+		for (std::uint32_t t{}; t < filter.taps; t++)
+		{
+			acc += filter.weights[t] * rows[t][n];
+		}
+		dst[n] = acc;
+	}
+}
+
+auto LoadRGBA8Scalar(const unsigned char* src, float* dst, int width,
+					 const float* table) -> void
+{
+	const auto count = static_cast<std::size_t>(width) * 4;
+	for (std::size_t n{}; n < count; n++)
+	{
+		dst[n] = table[src[n] + ((n & 3) == 3 ? 256 : 0)];
+	}
+}
+
+auto StoreRGBA8Scalar(const float* src, unsigned char* dst, int width,
+					  const unsigned char* srgbTable) -> void
+{
+	const auto count = static_cast<std::size_t>(width) * 4;
+	for (std::size_t n{}; n < count; n++)
+	{
+		const auto v = std::clamp(src[n], 0.f, 1.f);
+		if (srgbTable && (n & 3) != 3)
+		{
+			dst[n] = srgbTable[static_cast<std::size_t>(v * 65535.f + 0.5f)];
+		}
+		else
+		{
+			dst[n] = static_cast<unsigned char>(v * 255.f + 0.5f);
+		}
+	}
+}
+
+#ifdef DXRMIPGENERATORSSE
+
+// SSE: one texel per __m128.
+
+auto HorizontalSSE(const float* src, int srcWidth, float* dst, int dstWidth,
+				   const MipFilter& filter) -> void
+{
+	int begin{};
+	int end{};
+	GetInteriorRange(srcWidth, dstWidth, filter, begin, end);
+
+	__m128 weights[k_MaxTaps];
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		weights[t] = _mm_set1_ps(filter.weights[t]);
+	}
+
+	for (int i{}; i < begin; i++)
+	{
+		HorizontalTexelScalar(src, srcWidth, dst, i, filter);
+	}
+	for (int i{begin}; i < end; i++)
+	{
+		const auto texels =
+			src + static_cast<std::ptrdiff_t>(2 * i + filter.first) * 4;
+		auto acc = _mm_mul_ps(weights[0], _mm_loadu_ps(texels));
+		for (std::uint32_t t{1}; t < filter.taps; t++)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(weights[t],
+											 _mm_loadu_ps(texels + t * 4)));
+		}
+		_mm_storeu_ps(dst + static_cast<std::size_t>(i) * 4, acc);
+	}
+	for (int i{end}; i < dstWidth; i++)
+	{
+		HorizontalTexelScalar(src, srcWidth, dst, i, filter);
+	}
+}
+
+auto VerticalSSE(const float* const* rows, const MipFilter& filter,
+				 float* dst, std::size_t count) -> void
+{
+	__m128 weights[k_MaxTaps];
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		weights[t] = _mm_set1_ps(filter.weights[t]);
+	}
+
+	std::size_t n{};
+	for (; n + 4 <= count; n += 4)
+	{
+		auto acc = _mm_mul_ps(weights[0], _mm_loadu_ps(rows[0] + n));
+		for (std::uint32_t t{1}; t < filter.taps; t++)
+		{
+			acc = _mm_add_ps(acc,
+							 _mm_mul_ps(weights[t], _mm_loadu_ps(rows[t] + n)));
+		}
+		_mm_storeu_ps(dst + n, acc);
+	}
+	if (n < count)
+	{
+		const float* tails[k_MaxTaps]{};
+		for (std::uint32_t t{}; t < filter.taps; t++)
+		{
+			tails[t] = rows[t] + n;
+		}
+		VerticalScalar(tails, filter, dst + n, count - n);
+	}
+}
+
+// Both store paths round like the scalar one, (v * 255 + 0.5) truncated.
+// No FMA anywhere (and no contraction, see CMakeLists.txt), every kernel
+// rounds each product and sum like the scalar code so their output matches
+// it exactly:
+auto StoreRGBA8SSE(const float* src, unsigned char* dst, int width,
+				   const unsigned char* srgbTable) -> void
+{
+	const auto zero = _mm_setzero_ps();
+	const auto one = _mm_set1_ps(1.f);
+	const auto half = _mm_set1_ps(0.5f);
+
+	if (srgbTable)
+	{
+		// Colors go through the table, alpha is plain unorm:
+		const auto scale = _mm_setr_ps(65535.f, 65535.f, 65535.f, 255.f);
+		for (int x{}; x < width; x++)
+		{
+			const auto v = _mm_min_ps(
+				_mm_max_ps(_mm_loadu_ps(src + static_cast<std::size_t>(x) * 4),
+						   zero),
+				one);
+			alignas(16) std::int32_t index[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(index),
+							_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale),
+														half)));
+			const auto out = dst + static_cast<std::size_t>(x) * 4;
+			out[0] = srgbTable[index[0]];
+			out[1] = srgbTable[index[1]];
+			out[2] = srgbTable[index[2]];
+			out[3] = static_cast<unsigned char>(index[3]);
+		}
+		return;
+	}
+
+	const auto scale = _mm_set1_ps(255.f);
+	const auto toInt = [&](const float* texel) {
+		const auto v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(texel), zero), one);
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+	};
+
+	int x{};
+	for (; x + 4 <= width; x += 4)
+	{
+		const auto texels = src + static_cast<std::size_t>(x) * 4;
+		const auto lo = _mm_packs_epi32(toInt(texels), toInt(texels + 4));
+		const auto hi = _mm_packs_epi32(toInt(texels + 8), toInt(texels + 12));
+		_mm_storeu_si128(
+			reinterpret_cast<__m128i*>(dst + static_cast<std::size_t>(x) * 4),
+			_mm_packus_epi16(lo, hi));
+	}
+	if (x < width)
+	{
+		StoreRGBA8Scalar(src + static_cast<std::size_t>(x) * 4,
+						 dst + static_cast<std::size_t>(x) * 4, width - x,
+						 nullptr);
+	}
+}
+
+// AVX2: two texels per __m256 horizontally, eight floats vertically.
+
+DXRMIPGENERATORAVX2 auto HorizontalAVX2(const float* src, int srcWidth,
+										float* dst, int dstWidth,
+										const MipFilter& filter) -> void
+{
+	int begin{};
+	int end{};
+	GetInteriorRange(srcWidth, dstWidth, filter, begin, end);
+
+	__m256 weights[k_MaxTaps];
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		weights[t] = _mm256_set1_ps(filter.weights[t]);
+	}
+
+	for (int i{}; i < begin; i++)
+	{
+		HorizontalTexelScalar(src, srcWidth, dst, i, filter);
+	}
+	int i{begin};
+	for (; i + 2 <= end; i += 2)
+	{
+		// Lane 0 is texel i, lane 1 texel i + 1, two source texels apart:
+		const auto texels =
+			src + static_cast<std::ptrdiff_t>(2 * i + filter.first) * 4;
+		auto acc = _mm256_setzero_ps();
+		for (std::uint32_t t{}; t < filter.taps; t++)
+		{
+			const auto v = _mm256_insertf128_ps(
+				_mm256_castps128_ps256(_mm_loadu_ps(texels + t * 4)),
+				_mm_loadu_ps(texels + t * 4 + 8), 1);
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(weights[t], v));
+		}
+		_mm256_storeu_ps(dst + static_cast<std::size_t>(i) * 4, acc);
+	}
+	for (; i < dstWidth; i++)
+	{
+		HorizontalTexelScalar(src, srcWidth, dst, i, filter);
+	}
+}
+
+DXRMIPGENERATORAVX2 auto VerticalAVX2(const float* const* rows,
+									  const MipFilter& filter, float* dst,
+									  std::size_t count) -> void
+{
+	__m256 weights[k_MaxTaps];
+	for (std::uint32_t t{}; t < filter.taps; t++)
+	{
+		weights[t] = _mm256_set1_ps(filter.weights[t]);
+	}
+
+	std::size_t n{};
+	for (; n + 8 <= count; n += 8)
+	{
+		auto acc = _mm256_mul_ps(weights[0], _mm256_loadu_ps(rows[0] + n));
+		for (std::uint32_t t{1}; t < filter.taps; t++)
+		{
+			acc = _mm256_add_ps(
+				acc, _mm256_mul_ps(weights[t], _mm256_loadu_ps(rows[t] + n)));
+		}
+		_mm256_storeu_ps(dst + n, acc);
+	}
+	if (n < count)
+	{
+		const float* tails[k_MaxTaps]{};
+		for (std::uint32_t t{}; t < filter.taps; t++)
+		{
+			tails[t] = rows[t] + n;
+		}
+		VerticalScalar(tails, filter, dst + n, count - n);
+	}
+}
+
+// Table lookups with a gather, two texels per iteration:
+DXRMIPGENERATORAVX2 auto LoadRGBA8AVX2(const unsigned char* src, float* dst,
+									   int width, const float* table) -> void
+{
+	const auto alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+	int x{};
+	for (; x + 2 <= width; x += 2)
+	{
+		const auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(
+			src + static_cast<std::size_t>(x) * 4));
+		const auto index =
+			_mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), alphaOffset);
+		_mm256_storeu_ps(dst + static_cast<std::size_t>(x) * 4,
+						 _mm256_i32gather_ps(table, index, 4));
+	}
+	if (x < width)
+	{
+		LoadRGBA8Scalar(src + static_cast<std::size_t>(x) * 4,
+						dst + static_cast<std::size_t>(x) * 4, width - x,
+						table);
+	}
+}
+
+// Eight texels per iteration, unorm only, sRGB uses the SSE path:
+DXRMIPGENERATORAVX2 auto StoreRGBA8AVX2(const float* src, unsigned char* dst,
+										int width,
+										const unsigned char* srgbTable) -> void
+{
+	if (srgbTable)
+	{
+		StoreRGBA8SSE(src, dst, width, srgbTable);
+		return;
+	}
+
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.f);
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto scale = _mm256_set1_ps(255.f);
+	// packs/packus work per 128 bit lane, this puts the texels back in order:
+	const auto order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	int x{};
+	for (; x + 8 <= width; x += 8)
+	{
+		const auto texels = src + static_cast<std::size_t>(x) * 4;
+		__m256i ints[4];
+		for (int k{}; k < 4; k++)
+		{
+			const auto v = _mm256_min_ps(
+				_mm256_max_ps(_mm256_loadu_ps(texels + k * 8), zero), one);
+			ints[k] = _mm256_cvttps_epi32(
+				_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+		}
+		const auto lo = _mm256_packs_epi32(ints[0], ints[1]);
+		const auto hi = _mm256_packs_epi32(ints[2], ints[3]);
+		const auto bytes = _mm256_permutevar8x32_epi32(
+			_mm256_packus_epi16(lo, hi), order);
+		_mm256_storeu_si256(
+			reinterpret_cast<__m256i*>(dst + static_cast<std::size_t>(x) * 4),
+			bytes);
+	}
+	if (x < width)
+	{
+		StoreRGBA8SSE(src + static_cast<std::size_t>(x) * 4,
+					  dst + static_cast<std::size_t>(x) * 4, width - x,
+					  nullptr);
+	}
+}
+#endif
+
+auto GetMipKernels(DXRMipSIMD simd) -> MipKernels
+{
+	const auto best = GetBestMipSIMD();
+	if (simd == DXRMipSIMD::Best || simd > best)
+	{
+		simd = best;
+	}
+
+	MipKernels kernels{HorizontalScalar, VerticalScalar, LoadRGBA8Scalar,
+					   StoreRGBA8Scalar};
+#ifdef DXRMIPGENERATORSSE
+	if (simd == DXRMipSIMD::SSE)
+	{
+		kernels.horizontal = HorizontalSSE;
+		kernels.vertical = VerticalSSE;
+		kernels.storeRGBA8 = StoreRGBA8SSE;
+	}
+	else if (simd == DXRMipSIMD::AVX2)
+	{
+		kernels.horizontal = HorizontalAVX2;
+		kernels.vertical = VerticalAVX2;
+		kernels.loadRGBA8 = LoadRGBA8AVX2;
+		kernels.storeRGBA8 = StoreRGBA8AVX2;
+	}
+#endif
+	return kernels;
+}
+
+// Rows in and out of the float pipeline:
+struct RGBA8Rows
+{
+	const MipKernels* kernels{};
+	const float* toFloat{};
+	const unsigned char* toSRGB{};
+
+	inline auto Load(const DXRImageRGBA8& image, int y, float* scratch) const
+		-> const float*
+	{
+		kernels->loadRGBA8(image.pixels.data() +
+							   static_cast<std::size_t>(y) * image.GetRowPitch(),
+						   scratch, image.width, toFloat);
+		return scratch;
+	}
+
+	inline auto Store(DXRImageRGBA8& image, int y, const float* row) const
+		-> void
+	{
+		kernels->storeRGBA8(row,
+							image.pixels.data() +
+								static_cast<std::size_t>(y) * image.GetRowPitch(),
+							image.width, toSRGB);
+	}
+};
+
+struct RGBA32FRows
+{
+	inline auto Load(const DXRImageRGBA32F& image, int y, float*) const
+		-> const float*
+	{
+		return image.pixels.data() + static_cast<std::size_t>(y) * 4 *
+										 static_cast<std::size_t>(image.width);
+	}
+
+	inline auto Store(DXRImageRGBA32F& image, int y, const float* row) const
+		-> void
+	{
+		memcpy(image.pixels.data() + static_cast<std::size_t>(y) * 4 *
+										 static_cast<std::size_t>(image.width),
+			   row, image.GetRowPitch());
+	}
+};
+
+template <typename Image, typename Rows>
+auto DownsampleLevel(const Image& src, Image& dst, const Rows& rows,
+					 const MipKernels& kernels, const DXRMipGeneratorDesc& desc)
+	-> void
+{
+	const auto& filter = GetMipFilter(desc.filter);
+	dst.width = std::max(1, src.width / 2);
+	dst.height = std::max(1, src.height / 2);
+	dst.pixels.resize(dst.GetRowPitch() / sizeof(dst.pixels[0]) *
+					  static_cast<std::size_t>(dst.height));
+
+	auto threads = desc.threadCount;
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	if (static_cast<std::size_t>(dst.width) *
+			static_cast<std::size_t>(dst.height) <
+		k_ParallelMinTexels)
+	{
+		threads = 1;
+	}
+
+	const auto rowFloats = static_cast<std::size_t>(dst.width) * 4;
+	DXRParallelRows(dst.height, threads, desc.jobs, [&](int begin, int end) {
+		// Horizontally filtered source rows, slot = source row % taps.
+		// The taps of one destination row are consecutive source rows, so
+		// they never evict each other:
+		std::vector<float> scratch(static_cast<std::size_t>(src.width) * 4);
+		std::vector<float> ring(rowFloats * filter.taps);
+		std::vector<float> out(rowFloats);
+		std::array<int, k_MaxTaps> ringRows{};
+		ringRows.fill(-1);
+
+		for (int y{begin}; y < end; y++)
+		{
+			const float* taps[k_MaxTaps]{};
+			for (std::uint32_t t{}; t < filter.taps; t++)
+			{
+				const auto sy =
+					std::clamp(2 * y + filter.first + static_cast<int>(t), 0,
+							   src.height - 1);
+				const auto slot = static_cast<std::size_t>(sy) % filter.taps;
+				const auto filtered = ring.data() + slot * rowFloats;
+				if (ringRows[slot] != sy)
+				{
+					kernels.horizontal(rows.Load(src, sy, scratch.data()),
+									   src.width, filtered, dst.width, filter);
+					ringRows[slot] = sy;
+				}
+				taps[t] = filtered;
+			}
+			kernels.vertical(taps, filter, out.data(), rowFloats);
+			rows.Store(dst, y, out.data());
+		}
+	});
+}
+
+template <typename Image>
+auto GenerateMipChain(const Image& base, std::vector<Image>& mips,
+					  const DXRMipGeneratorDesc& desc,
+					  void (*downsample)(const Image&, Image&,
+										 const DXRMipGeneratorDesc&)) -> bool
+{
+	if (base.width <= 0 || base.height <= 0)
+		return false;
+
+	auto count = GetFullMipCount(base.width, base.height);
+	if (desc.maxMips)
+	{
+		count = std::min(count, desc.maxMips);
+	}
+
+	mips.resize(count);
+	mips[0] = base;
+	for (std::uint32_t n{1}; n < count; n++)
+	{
+		downsample(mips[n - 1], mips[n], desc);
+	}
+	return true;
+}
+} // namespace
+
+auto GetBestMipSIMD() -> DXRMipSIMD
+{
+#ifdef DXRMIPGENERATORSSE
+	static const auto avx2 = CPUSupportsAVX2();
+	return avx2 ? DXRMipSIMD::AVX2 : DXRMipSIMD::SSE;
+#else
+	return DXRMipSIMD::Scalar;
+#endif
+}
+
+auto GetFullMipCount(int width, int height) -> std::uint32_t
+{
+	std::uint32_t count{1};
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		count++;
+	}
+	return count;
+}
+
+auto GenerateMipChainRGBA8(const DXRImageRGBA8& base,
+						   std::vector<DXRImageRGBA8>& mips,
+						   const DXRMipGeneratorDesc& desc) -> bool
+{
+	return GenerateMipChain(base, mips, desc, DownsampleRGBA8);
+}
+
+auto GenerateMipChainRGBA32F(const DXRImageRGBA32F& base,
+							 std::vector<DXRImageRGBA32F>& mips,
+							 const DXRMipGeneratorDesc& desc) -> bool
+{
+	return GenerateMipChain(base, mips, desc, DownsampleRGBA32F);
+}
+
+auto DownsampleRGBA8(const DXRImageRGBA8& src, DXRImageRGBA8& dst,
+					 const DXRMipGeneratorDesc& desc) -> void
+{
+	const auto kernels = GetMipKernels(desc.simd);
+	const auto& tables = GetMipColorTables();
+	RGBA8Rows rows{};
+	rows.kernels = &kernels;
+	rows.toFloat = tables.toFloat[desc.srgb ? 1 : 0];
+	rows.toSRGB = desc.srgb ? tables.toSRGB.data() : nullptr;
+	DownsampleLevel(src, dst, rows, kernels, desc);
+}
+
+auto DownsampleRGBA32F(const DXRImageRGBA32F& src, DXRImageRGBA32F& dst,
+					   const DXRMipGeneratorDesc& desc) -> void
+{
+	DownsampleLevel(src, dst, RGBA32FRows{}, GetMipKernels(desc.simd), desc);
+}
+
+auto ResampleRGBA8(const DXRImageRGBA8& src, int width, int height,
+				   DXRImageRGBA8& dst) -> void
+{
+	dst.width = width;
+	dst.height = height;
+	dst.pixels.resize(dst.GetRowPitch() * static_cast<std::size_t>(height));
+
+	// Texel centers map onto texel centers:
+	const auto scaleX =
+		static_cast<float>(src.width) / static_cast<float>(width);
+	const auto scaleY =
+		static_cast<float>(src.height) / static_cast<float>(height);
+	for (int y{}; y < height; y++)
+	{
+		const auto fy = std::clamp((static_cast<float>(y) + 0.5f) * scaleY - 0.5f,
+								   0.f, static_cast<float>(src.height - 1));
+		const auto y0 = static_cast<int>(fy);
+		const auto y1 = std::min(y0 + 1, src.height - 1);
+		const auto wy = fy - static_cast<float>(y0);
+		const auto row0 = src.pixels.data() +
+						  static_cast<std::size_t>(y0) * src.GetRowPitch();
+		const auto row1 = src.pixels.data() +
+						  static_cast<std::size_t>(y1) * src.GetRowPitch();
+		const auto out = dst.pixels.data() +
+						 static_cast<std::size_t>(y) * dst.GetRowPitch();
+		for (int x{}; x < width; x++)
+		{
+			const auto fx =
+				std::clamp((static_cast<float>(x) + 0.5f) * scaleX - 0.5f, 0.f,
+						   static_cast<float>(src.width - 1));
+			const auto x0 = static_cast<int>(fx);
+			const auto x1 = std::min(x0 + 1, src.width - 1);
+			const auto wx = fx - static_cast<float>(x0);
+			for (int c{}; c < 4; c++)
+			{
+				const auto top = static_cast<float>(row0[x0 * 4 + c]) * (1.f - wx) +
+								 static_cast<float>(row0[x1 * 4 + c]) * wx;
+				const auto bottom =
+					static_cast<float>(row1[x0 * 4 + c]) * (1.f - wx) +
+					static_cast<float>(row1[x1 * 4 + c]) * wx;
+				out[x * 4 + c] = static_cast<unsigned char>(
+					top * (1.f - wy) + bottom * wy + 0.5f);
+			}
+		}
+	}
+}
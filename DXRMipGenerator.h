@@ -0,0 +1,72 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRAssets.h"
+
+#include <vector>
+
+struct DXRJobSystem;
+
+// CPU mip chain generation for textures that get uploaded with every level.
+// Each level is a 2:1 separable downsample of the previous one:
+//   Box: 2 taps, what D3DX and most runtime generators do.
+//   Kaiser: 8 taps, windowed sinc (alpha 4), sharper minification without
+//   the box filter's aliasing.
+// Odd sizes round down, edges clamp. RGBA8 can be averaged in linear space
+// (srgb = true): color channels are decoded before and re-encoded after
+// filtering, alpha stays linear. Float images are always treated as linear.
+//
+// Rows are streamed: every thread keeps a small ring of horizontally filtered
+// rows, so there is no full size intermediate.
+enum struct DXRMipFilter
+{
+	Box,
+	Kaiser,
+};
+
+// Which kernels to use, Best picks AVX2 > SSE > scalar at runtime:
+enum struct DXRMipSIMD
+{
+	Scalar,
+	SSE,
+	AVX2,
+	Best,
+};
+
+struct DXRMipGeneratorDesc
+{
+	DXRMipFilter filter{DXRMipFilter::Box};
+	bool srgb{};
+	DXRMipSIMD simd{DXRMipSIMD::Best};
+	// 0 uses every core, small levels always run on the calling thread:
+	std::uint32_t threadCount{};
+	// Rows run on its threads if set, else on threads started per level:
+	DXRJobSystem* jobs{};
+	// 0 generates the full chain down to 1x1:
+	std::uint32_t maxMips{};
+};
+
+// Best kernels this CPU can run:
+auto GetBestMipSIMD() -> DXRMipSIMD;
+
+// Number of levels in a full chain (including the base):
+auto GetFullMipCount(int width, int height) -> std::uint32_t;
+
+// mips[0] is a copy of base, mips[n] is mips[n - 1] downsampled.
+// Returns false for empty images:
+auto GenerateMipChainRGBA8(const DXRImageRGBA8& base,
+						   std::vector<DXRImageRGBA8>& mips,
+						   const DXRMipGeneratorDesc& desc = {}) -> bool;
+auto GenerateMipChainRGBA32F(const DXRImageRGBA32F& base,
+							 std::vector<DXRImageRGBA32F>& mips,
+							 const DXRMipGeneratorDesc& desc = {}) -> bool;
+
+// One level only, dst gets sized to half of src:
+auto DownsampleRGBA8(const DXRImageRGBA8& src, DXRImageRGBA8& dst,
+					 const DXRMipGeneratorDesc& desc = {}) -> void;
+auto DownsampleRGBA32F(const DXRImageRGBA32F& src, DXRImageRGBA32F& dst,
+					   const DXRMipGeneratorDesc& desc = {}) -> void;
+
+// Bilinear resize, used to round sizes up to what block compression needs:
+auto ResampleRGBA8(const DXRImageRGBA8& src, int width, int height,
+				   DXRImageRGBA8& dst) -> void;
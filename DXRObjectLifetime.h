@@ -0,0 +1,109 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <array>
+#include <bit>
+#include <initializer_list>
+
+// Dirty tracking for objects built on top of each other (device, swap chain
+// sized targets, pipelines, assets):
+// Id is an enum with a Count entry, at most 64 objects. Every object names
+// the ones it is built from, which come before it in Id, so Id order is a
+// valid creation order. Each object is either ready or dirty. Everything
+// starts dirty; Invalidate() makes an object and everything built from it
+// (directly or not) dirty again; Rebuild() creates the dirty ones in order.
+// Objects can also stand for events that have nothing to create (the swap
+// chain being resized), invalidating one of those dirties exactly what
+// depends on it. A frame where nothing changed is one IsClean() check.
+template <typename Id> struct DXRObjectLifetime
+{
+	static inline constexpr auto k_Count{static_cast<std::uint32_t>(Id::Count)};
+	static_assert(k_Count <= 64);
+
+	static inline constexpr auto GetMask(Id object) -> std::uint64_t
+	{
+		return std::uint64_t{1} << static_cast<std::uint32_t>(object);
+	}
+
+	static inline constexpr std::uint64_t k_AllMask{
+		k_Count == 64 ? ~std::uint64_t{} : (std::uint64_t{1} << k_Count) - 1};
+
+	// Setup, before the first Rebuild():
+	inline auto DependsOn(Id object, std::initializer_list<Id> dependencies)
+		-> void
+	{
+		for (const auto dependency : dependencies)
+		{
+			DXRASSERT(dependency < object);
+			m_dependencies[static_cast<std::uint32_t>(object)] |=
+				GetMask(dependency);
+		}
+	}
+
+	inline auto Invalidate(Id object) -> void
+	{
+		m_dirty |= GetDependentMask(object);
+	}
+
+	inline auto InvalidateAll() -> void
+	{
+		m_dirty = k_AllMask;
+	}
+
+	// object and everything built from it:
+	inline auto GetDependentMask(Id object) const -> std::uint64_t
+	{
+		// Dependencies come first, one pass in order closes the set:
+		auto mask = GetMask(object);
+		for (auto n = static_cast<std::uint32_t>(object) + 1; n < k_Count; n++)
+		{
+			if (m_dependencies[n] & mask)
+				mask |= std::uint64_t{1} << n;
+		}
+		return mask;
+	}
+
+	inline auto IsClean() const -> bool
+	{
+		return !m_dirty;
+	}
+
+	inline auto IsDirty(Id object) const -> bool
+	{
+		return m_dirty & GetMask(object);
+	}
+
+	inline auto GetDirtyMask() const -> std::uint64_t
+	{
+		return m_dirty;
+	}
+
+	// create(Id) -> bool for the dirty objects in mask, in order. Stops at the
+	// first failure, that one and everything after it stay dirty. Returns
+	// true if nothing in mask is dirty anymore:
+	template <typename F>
+	inline auto Rebuild(F&& create, std::uint64_t mask = k_AllMask) -> bool
+	{
+		while (const auto pending = m_dirty & mask)
+		{
+			const auto n = static_cast<std::uint32_t>(std::countr_zero(pending));
+			if (!create(static_cast<Id>(n)))
+				return false;
+			m_dirty &= ~(std::uint64_t{1} << n);
+			m_rebuilds++;
+		}
+		return true;
+	}
+
+	// Objects created by Rebuild() so far:
+	inline auto GetRebuildCount() const -> std::uint64_t
+	{
+		return m_rebuilds;
+	}
+
+  private:
+	std::array<std::uint64_t, k_Count> m_dependencies{};
+	std::uint64_t m_dirty{k_AllMask};
+	std::uint64_t m_rebuilds{};
+};
@@ -0,0 +1,500 @@
+#include "DXRPathTracer.h"
+#include "DXRJobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numbers>
+#include <random>
+
+namespace
+{
+constexpr std::uint32_t k_BlueNoiseSize{64};
+constexpr std::uint32_t k_BlueNoiseMask{k_BlueNoiseSize - 1};
+
+// Ulichney, "Void-and-cluster method for dither array generation", 1993.
+// Ranks every texel of a tiling mask by the order it gets filled in, always
+// into the largest void of what is there, so any threshold of the result is
+// an evenly spread point set. Returns the ranks as [0, 1) thresholds:
+auto MakeBlueNoise() -> std::vector<float>
+{
+	constexpr auto size = k_BlueNoiseSize;
+	constexpr auto count = size * size;
+
+	// Toroidal Gaussian, sigma 1.5 like the paper:
+	std::vector<float> kernel(count);
+	for (std::uint32_t y{}; y < size; y++)
+	{
+		for (std::uint32_t x{}; x < size; x++)
+		{
+			const auto dx = static_cast<float>(std::min(x, size - x));
+			const auto dy = static_cast<float>(std::min(y, size - y));
+			kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / 4.5f);
+		}
+	}
+
+	// Energy of the points around every texel, how clustered it is:
+	std::vector<float> energy(count);
+	std::vector<std::uint8_t> points(count);
+	const auto set = [&](std::uint32_t texel, bool point) {
+		points[texel] = point;
+		const auto sign = point ? 1.f : -1.f;
+		const auto px = texel % size;
+		const auto py = texel / size;
+		for (std::uint32_t y{}; y < size; y++)
+		{
+			const auto row = ((y - py) & k_BlueNoiseMask) * size;
+			for (std::uint32_t x{}; x < size; x++)
+			{
+				energy[y * size + x] +=
+					sign * kernel[row + ((x - px) & k_BlueNoiseMask)];
+			}
+		}
+	};
+	const auto tightestCluster = [&] {
+		std::uint32_t best{};
+		auto bestEnergy = -std::numeric_limits<float>::max();
+		for (std::uint32_t n{}; n < count; n++)
+		{
+			if (points[n] && energy[n] > bestEnergy)
+			{
+				best = n;
+				bestEnergy = energy[n];
+			}
+		}
+		return best;
+	};
+	const auto largestVoid = [&] {
+		std::uint32_t best{};
+		auto bestEnergy = std::numeric_limits<float>::max();
+		for (std::uint32_t n{}; n < count; n++)
+		{
+			if (!points[n] && energy[n] < bestEnergy)
+			{
+				best = n;
+				bestEnergy = energy[n];
+			}
+		}
+		return best;
+	};
+
+	// A tenth of the texels at random, then moved from their tightest
+	// cluster to the largest void until that puts the point back:
+	constexpr auto initial = count / 10;
+	std::mt19937 random{1};
+	for (std::uint32_t placed{}; placed < initial;)
+	{
+		const auto texel = static_cast<std::uint32_t>(random() % count);
+		if (points[texel])
+			continue;
+		set(texel, true);
+		placed++;
+	}
+	for (std::uint32_t n{}; n < count; n++)
+	{
+		const auto cluster = tightestCluster();
+		set(cluster, false);
+		const auto hole = largestVoid();
+		set(hole, true);
+		if (hole == cluster)
+			break;
+	}
+
+	// Below the initial set by taking points out, tightest clusters get the
+	// highest ranks, above it by filling voids. Past half full the largest
+	// void is also the tightest cluster of empty texels, no third phase:
+	std::vector<std::uint32_t> ranks(count);
+	const auto prototype = points;
+	const auto prototypeEnergy = energy;
+	for (auto rank = initial; rank-- > 0;)
+	{
+		const auto cluster = tightestCluster();
+		set(cluster, false);
+		ranks[cluster] = rank;
+	}
+	points = prototype;
+	energy = prototypeEnergy;
+	for (auto rank = initial; rank < count; rank++)
+	{
+		const auto hole = largestVoid();
+		set(hole, true);
+		ranks[hole] = rank;
+	}
+
+	std::vector<float> mask(count);
+	for (std::uint32_t n{}; n < count; n++)
+	{
+		mask[n] = (static_cast<float>(ranks[n]) + 0.5f) /
+				  static_cast<float>(count);
+	}
+	return mask;
+}
+
+auto GetBlueNoise() -> const std::vector<float>&
+{
+	static const auto mask = MakeBlueNoise();
+	return mask;
+}
+
+auto Fraction(float x) -> float
+{
+	return x - std::floor(x);
+}
+
+auto GetLuminance(const glm::vec3& color) -> float
+{
+	return glm::dot(color, glm::vec3{0.2126f, 0.7152f, 0.0722f});
+}
+} // namespace
+
+DXRPathTracer::DXRPathTracer(const DXRPathTracerDesc& desc) : m_desc(desc)
+{
+	m_desc.tileSize = std::max(m_desc.tileSize, 1u);
+	if (glm::dot(m_desc.sunDirection, m_desc.sunDirection) > 0.f)
+		m_desc.sunDirection = glm::normalize(m_desc.sunDirection);
+	if (m_desc.sampler == DXRPathTracerSampler::BlueNoise)
+		GetBlueNoise();
+}
+
+auto DXRPathTracer::Resize(std::uint32_t width, std::uint32_t height) -> void
+{
+	m_width = width;
+	m_height = height;
+	m_tilesX = (width + m_desc.tileSize - 1) / m_desc.tileSize;
+	m_tilesY = (height + m_desc.tileSize - 1) / m_desc.tileSize;
+	m_sums.resize(std::size_t{width} * height);
+	m_luminanceSquares.resize(m_sums.size());
+	Reset();
+}
+
+auto DXRPathTracer::SetScene(const DXRRayTopLevel* topLevel,
+							 std::span<const DXRIndexedMesh> meshes,
+							 const DXRImageRGBA8* texture) -> void
+{
+	m_topLevel = topLevel;
+	m_meshes = meshes;
+	m_texture = texture;
+	Reset();
+}
+
+auto DXRPathTracer::SetCamera(const glm::mat4& view,
+							  const glm::mat4& projection) -> void
+{
+	m_view = view;
+	m_projection = projection;
+	Reset();
+}
+
+auto DXRPathTracer::Reset() -> void
+{
+	std::fill(m_sums.begin(), m_sums.end(), glm::vec4{});
+	std::fill(m_luminanceSquares.begin(), m_luminanceSquares.end(), 0.f);
+	m_samples = 0;
+}
+
+auto DXRPathTracer::RenderFrame(DXRJobSystem* jobs) -> void
+{
+	if (!m_topLevel || m_sums.empty())
+		return;
+	const auto tiles = std::size_t{m_tilesX} * m_tilesY;
+	const auto render = [&](std::size_t first, std::size_t last) {
+		for (auto tile = first; tile < last; tile++)
+		{
+			RenderTile(static_cast<std::uint32_t>(tile));
+		}
+	};
+	if (jobs)
+	{
+		jobs->ParallelFor(0, tiles, 1, render);
+	}
+	else
+	{
+		render(0, tiles);
+	}
+	m_samples++;
+}
+
+auto DXRPathTracer::RenderTile(std::uint32_t tile) -> void
+{
+	const auto minX = tile % m_tilesX * m_desc.tileSize;
+	const auto minY = tile / m_tilesX * m_desc.tileSize;
+	const auto maxX = std::min(minX + m_desc.tileSize, m_width);
+	const auto maxY = std::min(minY + m_desc.tileSize, m_height);
+	for (auto y = minY; y < maxY; y++)
+	{
+		for (auto x = minX; x < maxX; x++)
+		{
+			const auto sample = TracePath(x, y);
+			const auto index = std::size_t{y} * m_width + x;
+			const auto luminance = GetLuminance(sample);
+			m_sums[index] += sample;
+			m_luminanceSquares[index] += luminance * luminance;
+		}
+	}
+}
+
+auto DXRPathTracer::TracePath(std::uint32_t x, std::uint32_t y) const
+	-> glm::vec4
+{
+	const auto jitter =
+		m_desc.jitter ? GetSample(x, y, 0) : glm::vec2{0.5f, 0.5f};
+	const auto width = static_cast<float>(m_width);
+	const auto height = static_cast<float>(m_height);
+	const glm::vec2 ndc{
+		(static_cast<float>(x) + jitter.x) / width * 2.f - 1.f,
+		1.f - (static_cast<float>(y) + jitter.y) / height * 2.f};
+	auto ray = MakeCameraRay(m_view, m_projection, ndc);
+
+	// Camera rays that miss are the rasterizer's clear, transparent black:
+	DXRRayHit hit{};
+	if (!m_topLevel->TraceRay(ray, DXRRayQueryType::ClosestHit, hit))
+		return {};
+
+	const auto sunOn =
+		glm::dot(m_desc.sunIrradiance, m_desc.sunIrradiance) > 0.f;
+	glm::vec3 radiance{};
+	glm::vec3 throughput{1.f};
+	float alpha{};
+	for (std::uint32_t bounce{};; bounce++)
+	{
+		const auto surface = GetSurface(ray, hit);
+		if (bounce == 0)
+			alpha = surface.alpha;
+		// Far enough off the surface that rounding can't put the next ray
+		// behind it:
+		const auto& position = surface.position;
+		const auto scale =
+			std::max({1.f, std::abs(position.x), std::abs(position.y),
+					  std::abs(position.z)});
+		const auto origin = position + surface.normal * (1e-4f * scale);
+
+		if (sunOn)
+		{
+			const auto cosine = glm::dot(surface.normal, m_desc.sunDirection);
+			if (cosine > 0.f)
+			{
+				DXRRay shadow{};
+				shadow.origin = origin;
+				shadow.direction = m_desc.sunDirection;
+				DXRRayHit blocker{};
+				if (!m_topLevel->TraceRay(shadow, DXRRayQueryType::Occlusion,
+										  blocker))
+				{
+					radiance += throughput * surface.albedo *
+								m_desc.sunIrradiance *
+								(cosine * std::numbers::inv_pi_v<float>);
+				}
+			}
+		}
+		if (bounce == m_desc.maxBounces)
+			break;
+
+		// Lambertian albedo over the cosine weighted pdf is just albedo:
+		throughput *= surface.albedo;
+		if (bounce >= 2)
+		{
+			const auto survival = std::min(
+				std::max({throughput.x, throughput.y, throughput.z}), 1.f);
+			if (GetSample(x, y, 2 + bounce * 2).x >= survival)
+				break;
+			throughput /= survival;
+		}
+		if (throughput == glm::vec3{})
+			break;
+
+		ray = {};
+		ray.origin = origin;
+		ray.direction = SampleCosineHemisphere(
+			surface.normal, GetSample(x, y, 1 + bounce * 2));
+		if (!m_topLevel->TraceRay(ray, DXRRayQueryType::ClosestHit, hit))
+		{
+			radiance += throughput * m_desc.skyRadiance;
+			break;
+		}
+	}
+	return {radiance, alpha};
+}
+
+auto DXRPathTracer::GetSurface(const DXRRay& ray, const DXRRayHit& hit) const
+	-> Surface
+{
+	const auto& mesh = m_meshes[m_topLevel->GetInstanceMesh(hit.instance)];
+	const auto& a = mesh.vertices[mesh.indices[hit.triangle * 3 + 0]];
+	const auto& b = mesh.vertices[mesh.indices[hit.triangle * 3 + 1]];
+	const auto& c = mesh.vertices[mesh.indices[hit.triangle * 3 + 2]];
+	const auto w = 1.f - hit.u - hit.v;
+
+	Surface surface{};
+	surface.position = ray.origin + ray.direction * hit.t;
+	// Normals go through the inverse transpose, rows of objectFromWorld are
+	// its columns:
+	const auto objectNormal = glm::cross(glm::vec3{b.x, b.y, b.z} -
+											 glm::vec3{a.x, a.y, a.z},
+										 glm::vec3{c.x, c.y, c.z} -
+											 glm::vec3{a.x, a.y, a.z});
+	const auto rows = m_topLevel->GetObjectFromWorld(hit.instance);
+	auto normal = glm::normalize(glm::vec3{rows[0]} * objectNormal.x +
+								 glm::vec3{rows[1]} * objectNormal.y +
+								 glm::vec3{rows[2]} * objectNormal.z);
+	surface.normal = glm::dot(normal, ray.direction) > 0.f ? -normal : normal;
+
+	const auto texel =
+		SampleTexturePoint(m_texture, w * a.u + hit.u * b.u + hit.v * c.u,
+						   w * a.v + hit.u * b.v + hit.v * c.v);
+	surface.albedo = glm::vec3{texel} * texel.a;
+	surface.alpha = texel.a;
+	return surface;
+}
+
+auto DXRPathTracer::GetSample(std::uint32_t x, std::uint32_t y,
+							  std::uint32_t dimension) const -> glm::vec2
+{
+	if (m_desc.sampler == DXRPathTracerSampler::White)
+	{
+		const auto pixel = HashSample(HashSample(y * m_width + x) + m_desc.seed);
+		const auto seed = HashSample(HashSample(pixel + m_samples) + dimension);
+		return {ToUnitFloat(seed), ToUnitFloat(HashSample(seed))};
+	}
+
+	// Roberts' R2 sequence, the 2D generalization of the golden ratio: one
+	// step per frame from the mask's value, the mask shifted by the same
+	// sequence for every dimension so they don't correlate, and further for
+	// every seed:
+	constexpr float k_R2X{0.7548776662f};
+	constexpr float k_R2Y{0.5698402910f};
+	const auto& mask = GetBlueNoise();
+	const auto fetch = [&](std::uint32_t shift) {
+		const auto dx = static_cast<std::uint32_t>(
+			Fraction(0.5f + static_cast<float>(shift) * k_R2X) *
+			static_cast<float>(k_BlueNoiseSize));
+		const auto dy = static_cast<std::uint32_t>(
+			Fraction(0.5f + static_cast<float>(shift) * k_R2Y) *
+			static_cast<float>(k_BlueNoiseSize));
+		return mask[((y + dy) & k_BlueNoiseMask) * k_BlueNoiseSize +
+					((x + dx) & k_BlueNoiseMask)];
+	};
+	const auto shift = (m_desc.seed * 64 + dimension) * 2;
+	const auto frame = static_cast<float>(m_samples);
+	return {Fraction(fetch(shift) + frame * k_R2X),
+			Fraction(fetch(shift + 1) + frame * k_R2Y)};
+}
+
+auto DXRPathTracer::GetStats() const -> DXRPathTracerStats
+{
+	DXRPathTracerStats stats{};
+	stats.samples = m_samples;
+	if (m_samples < 2 || m_sums.empty())
+		return stats;
+
+	const auto n = static_cast<double>(m_samples);
+	double squaredErrors{};
+	double luminance{};
+	for (std::size_t pixel{}; pixel < m_sums.size(); pixel++)
+	{
+		const auto mean =
+			static_cast<double>(GetLuminance(glm::vec3{m_sums[pixel]})) / n;
+		const auto meanSquare =
+			static_cast<double>(m_luminanceSquares[pixel]) / n;
+		// Sample variance over n, the variance of the mean:
+		squaredErrors += std::max(0.0, meanSquare - mean * mean) / (n - 1.0);
+		luminance += mean;
+	}
+	const auto pixels = static_cast<double>(m_sums.size());
+	stats.noise = static_cast<float>(std::sqrt(squaredErrors / pixels));
+	stats.relativeNoise =
+		luminance > 0.0
+			? static_cast<float>(stats.noise / (luminance / pixels))
+			: 0.f;
+	return stats;
+}
+
+auto DXRPathTracer::Resolve(DXRImageRGBA32F& out) const -> void
+{
+	out.width = static_cast<int>(m_width);
+	out.height = static_cast<int>(m_height);
+	out.pixels.resize(m_sums.size() * 4);
+	const auto scale = m_samples ? 1.f / static_cast<float>(m_samples) : 0.f;
+	for (std::uint32_t y{}; y < m_height; y++)
+	{
+		const auto row = (std::size_t{m_height} - 1 - y) * m_width;
+		for (std::uint32_t x{}; x < m_width; x++)
+		{
+			const auto mean = m_sums[std::size_t{y} * m_width + x] * scale;
+			memcpy(out.pixels.data() + (row + x) * 4, &mean, sizeof mean);
+		}
+	}
+}
+
+auto CompareImages(const DXRImageRGBA32F& a, const DXRImageRGBA32F& b,
+				   float threshold) -> DXRImageDifference
+{
+	DXRImageDifference difference{};
+	const auto pixels = static_cast<std::size_t>(a.width) *
+						static_cast<std::size_t>(std::max(a.height, 0));
+	// Different sizes differ everywhere:
+	if (a.width != b.width || a.height != b.height ||
+		a.pixels.size() < pixels * 4 || b.pixels.size() < pixels * 4)
+	{
+		difference.rmse = std::numeric_limits<float>::infinity();
+		difference.maxError = std::numeric_limits<float>::infinity();
+		const auto otherPixels =
+			static_cast<std::size_t>(b.width) *
+			static_cast<std::size_t>(std::max(b.height, 0));
+		difference.differingPixels = std::max(pixels, otherPixels);
+		return difference;
+	}
+
+	double squaredErrors{};
+	for (std::size_t pixel{}; pixel < pixels; pixel++)
+	{
+		auto pixelError = 0.f;
+		for (std::size_t channel{}; channel < 3; channel++)
+		{
+			const auto error = std::abs(a.pixels[pixel * 4 + channel] -
+										b.pixels[pixel * 4 + channel]);
+			squaredErrors += static_cast<double>(error) * error;
+			pixelError = std::max(pixelError, error);
+		}
+		difference.maxError = std::max(difference.maxError, pixelError);
+		difference.differingPixels += pixelError > threshold;
+	}
+	const auto meanSquare =
+		pixels ? squaredErrors / static_cast<double>(pixels * 3) : 0.0;
+	difference.rmse = static_cast<float>(std::sqrt(meanSquare));
+	difference.psnr = meanSquare > 0.0
+						  ? static_cast<float>(-10.0 * std::log10(meanSquare))
+						  : std::numeric_limits<float>::infinity();
+	return difference;
+}
+
+auto HashSample(std::uint32_t x) -> std::uint32_t
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+auto ToUnitFloat(std::uint32_t bits) -> float
+{
+	return static_cast<float>(bits >> 8) * (1.f / 16777216.f);
+}
+
+auto SampleCosineHemisphere(const glm::vec3& normal, const glm::vec2& sample)
+	-> glm::vec3
+{
+	const auto sign = std::copysign(1.f, normal.z);
+	const auto a = -1.f / (sign + normal.z);
+	const auto b = normal.x * normal.y * a;
+	const glm::vec3 tangent{1.f + sign * normal.x * normal.x * a, sign * b,
+							-sign * normal.x};
+	const glm::vec3 bitangent{b, sign + normal.y * normal.y * a, -normal.y};
+	const auto radius = std::sqrt(sample.x);
+	const auto phi = 2.f * std::numbers::pi_v<float> * sample.y;
+	return tangent * (radius * std::cos(phi)) +
+		   bitangent * (radius * std::sin(phi)) +
+		   normal * std::sqrt(std::max(0.f, 1.f - sample.x));
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "DXRAssets.h"
+#include "DXRRayTopLevel.h"
+
+#include <span>
+#include <vector>
+
+struct DXRJobSystem;
+
+// Where the random numbers of a path come from:
+enum struct DXRPathTracerSampler
+{
+	// Each pixel looks up a 64x64 void-and-cluster blue noise mask (shifted
+	// per dimension) and walks an R2 sequence from there, one step per frame.
+	// Neighbouring pixels get different samples, so what error is left is
+	// high frequency, and every pixel's own samples are stratified:
+	BlueNoise,
+	// Independent random numbers per pixel, frame and dimension, the baseline
+	// to compare against:
+	White,
+};
+
+struct DXRPathTracerDesc
+{
+	// Square tiles, the unit the job threads pick up:
+	std::uint32_t tileSize{16};
+	// Diffuse bounces after the camera hit, from the third on paths are
+	// ended by Russian roulette:
+	std::uint32_t maxBounces{4};
+	DXRPathTracerSampler sampler{DXRPathTracerSampler::BlueNoise};
+	// Tracers with different seeds draw different samples, a reference
+	// image shouldn't share them with what it is compared to:
+	std::uint32_t seed{};
+	// Camera rays anywhere inside their pixel (antialiasing). Off they go
+	// through pixel centres where the rasterizer samples, for comparing
+	// against it texel for texel:
+	bool jitter{true};
+	// Uniform sky radiance, what every path that escapes sees. Without a sun
+	// a convex mesh converges to exactly its texture, the unlit raster image:
+	glm::vec3 skyRadiance{1.f};
+	// Towards the sun, which is sampled directly with shadow rays. Zero
+	// irradiance turns it off:
+	glm::vec3 sunDirection{0.4f, 1.f, 0.3f};
+	glm::vec3 sunIrradiance{0.f};
+};
+
+struct DXRPathTracerStats
+{
+	// Frames accumulated so far, samples per pixel:
+	std::uint32_t samples{};
+	// Root mean square over the pixels of the standard error of their mean
+	// luminance, an estimate of the noise left in Resolve()'s image. 0 until
+	// two samples are in:
+	float noise{};
+	// noise over the image's mean luminance:
+	float relativeNoise{};
+};
+
+// Differences of two images of the same size, rgb only:
+struct DXRImageDifference
+{
+	float rmse{};
+	// Against a peak of 1, infinite for identical images:
+	float psnr{};
+	float maxError{};
+	// Pixels where any channel differs by more than the threshold passed
+	// to CompareImages():
+	std::uint64_t differingPixels{};
+};
+
+// Progressive path tracer, the ground truth for what DXRSoftwareRasterizer
+// and the GPU draw: same meshes, instances, texture and CameraManager
+// matrices, but lit by a sky (and optionally a sun) through diffuse
+// interreflection. Every RenderFrame() adds one sample per pixel to the
+// accumulation buffer, tiles of the image render in parallel on the job
+// system. Changing the scene, camera or size starts over.
+// Surfaces are Lambertian with pixelShader2DText's texel as albedo (point
+// sampled, transparent black border, rgb times alpha as the blend would put
+// it over black) and are lit from both sides like the rasterizer's cull none.
+// Texels are used as they are, no sRGB decode, the same values the raster
+// pipeline writes.
+struct DXRPathTracer : DXRNonCopyable
+{
+	DXRPathTracer(const DXRPathTracerDesc& desc = {});
+
+	auto Resize(std::uint32_t width, std::uint32_t height) -> void;
+
+	// topLevel's instances of meshes (the ones its DXRRayScenes were built
+	// from, for UVs), textured with texture. Everything has to stay alive
+	// while frames render:
+	auto SetScene(const DXRRayTopLevel* topLevel,
+				  std::span<const DXRIndexedMesh> meshes,
+				  const DXRImageRGBA8* texture) -> void;
+
+	// view and projection as CameraManager keeps them (transposed for HLSL):
+	auto SetCamera(const glm::mat4& view, const glm::mat4& projection) -> void;
+
+	// Drops the accumulated samples:
+	auto Reset() -> void;
+
+	// One more sample per pixel. With jobs, tiles are spread over the job
+	// threads and the calling thread helps:
+	auto RenderFrame(DXRJobSystem* jobs = nullptr) -> void;
+
+	auto GetStats() const -> DXRPathTracerStats;
+
+	// Mean of the accumulated samples, linear, rows bottom-up like every
+	// DXRImage. Alpha is the coverage the rasterizer would write, texel alpha
+	// where a surface was hit and 0 over the background:
+	auto Resolve(DXRImageRGBA32F& out) const -> void;
+
+	inline auto GetWidth() const -> std::uint32_t
+	{
+		return m_width;
+	}
+
+	inline auto GetHeight() const -> std::uint32_t
+	{
+		return m_height;
+	}
+
+  private:
+	// Surface under a camera or bounce ray:
+	struct Surface
+	{
+		glm::vec3 position{};
+		// Geometric, facing the ray:
+		glm::vec3 normal{};
+		glm::vec3 albedo{};
+		float alpha{};
+	};
+
+	auto RenderTile(std::uint32_t tile) -> void;
+	// Radiance and coverage of one path through pixel x, y (top-down):
+	auto TracePath(std::uint32_t x, std::uint32_t y) const -> glm::vec4;
+	auto GetSurface(const DXRRay& ray, const DXRRayHit& hit) const -> Surface;
+	auto GetSample(std::uint32_t x, std::uint32_t y, std::uint32_t dimension)
+		const -> glm::vec2;
+
+	DXRPathTracerDesc m_desc{};
+	std::uint32_t m_width{}, m_height{};
+	std::uint32_t m_tilesX{}, m_tilesY{};
+	const DXRRayTopLevel* m_topLevel{};
+	std::span<const DXRIndexedMesh> m_meshes{};
+	const DXRImageRGBA8* m_texture{};
+	glm::mat4 m_view{1.f};
+	glm::mat4 m_projection{1.f};
+
+	// Sums per pixel, top-down: radiance and coverage, and squared
+	// luminance for the noise estimate:
+	std::vector<glm::vec4> m_sums{};
+	std::vector<float> m_luminanceSquares{};
+	std::uint32_t m_samples{};
+};
+
+// Pixel differences for golden image tests:
+auto CompareImages(const DXRImageRGBA32F& a, const DXRImageRGBA32F& b,
+				   float threshold = 1.f / 255.f) -> DXRImageDifference;
+
+// Sampling the tracer and DXRLightmap share.
+// Wellons' lowbias32, for random numbers per pixel, texel or sample index:
+auto HashSample(std::uint32_t x) -> std::uint32_t;
+
+// The top 24 bits of bits as a float in [0, 1):
+auto ToUnitFloat(std::uint32_t bits) -> float;
+
+// Cosine weighted direction around the unit vector normal for a sample in
+// [0, 1)^2, basis from Duff et al., "Building an Orthonormal Basis,
+// Revisited", 2017:
+auto SampleCosineHemisphere(const glm::vec3& normal, const glm::vec2& sample)
+	-> glm::vec3;
@@ -0,0 +1,362 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRJobSystem.h"
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum struct DXRBlendMode : std::uint8_t
+{
+	Opaque,
+	// src * srcAlpha + dst * (1 - srcAlpha), alpha kept from src:
+	Alpha,
+	Additive,
+	Premultiplied,
+};
+
+enum struct DXRCullMode : std::uint8_t
+{
+	None,
+	Front,
+	Back,
+};
+
+enum struct DXRFillMode : std::uint8_t
+{
+	Solid,
+	Wireframe,
+};
+
+enum struct DXRDepthMode : std::uint8_t
+{
+	Off,
+	// Less, no writes:
+	Test,
+	// Less:
+	TestWrite,
+	// After a depth prepass:
+	Equal,
+};
+
+enum struct DXRVertexLayout : std::uint8_t
+{
+	// Vertex pulling or a fullscreen triangle:
+	None,
+	Vertex3D,
+	Quantized,
+};
+
+enum struct DXRPrimitiveType : std::uint8_t
+{
+	Triangle,
+	Line,
+	Point,
+};
+
+// The values are DXGI_FORMAT's so the renderer can cast them:
+enum struct DXRPipelineFormat : std::uint8_t
+{
+	Unknown = 0,
+	RGBA16Float = 10,
+	RGB10A2Unorm = 24,
+	RGBA8Unorm = 28,
+	RGBA8UnormSRGB = 29,
+	D32Float = 40,
+	R32Float = 41,
+	D24UnormS8Uint = 45,
+	BGRA8Unorm = 87,
+};
+
+// Everything a graphics pipeline is made of, small enough to hash and
+// compare as four words. Shaders are DXRShaderCache keys, so pipelines built
+// from the same bytecode share a key whatever source string produced it.
+// Zero the whole thing before filling it in ({} does), the padding is
+// hashed too:
+struct DXRPipelineKey
+{
+	static inline constexpr std::uint32_t k_MaxRenderTargets{4};
+
+	std::uint64_t vertexShader{};
+	std::uint64_t pixelShader{};
+	std::array<DXRPipelineFormat, k_MaxRenderTargets> renderTargetFormats{};
+	DXRPipelineFormat depthFormat{};
+	std::uint8_t renderTargetCount{};
+	std::uint8_t sampleCount{1};
+	DXRBlendMode blend{};
+	DXRCullMode cull{};
+	DXRFillMode fill{};
+	DXRDepthMode depth{};
+	DXRVertexLayout vertexLayout{};
+	DXRPrimitiveType primitive{};
+	std::uint8_t reserved[3]{};
+
+	auto operator==(const DXRPipelineKey&) const -> bool = default;
+};
+static_assert(sizeof(DXRPipelineKey) == 32);
+
+inline auto GetPipelineKeyHash(const DXRPipelineKey& key) -> std::uint64_t
+{
+	std::uint64_t words[4]{};
+	memcpy(words, &key, sizeof key);
+	std::uint64_t hash{0x9E3779B97F4A7C15ull};
+	for (const auto word : words)
+	{
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+	hash *= 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+struct DXRPipelineHandle
+{
+	std::uint32_t index{~0u};
+
+	inline auto IsValid() const -> bool
+	{
+		return index != ~0u;
+	}
+};
+
+struct DXRPipelineRegistryStats
+{
+	std::uint64_t requests{};
+	// Requests for a key that was already known:
+	std::uint64_t shared{};
+	std::uint64_t created{};
+	std::uint64_t failed{};
+};
+
+// One pipeline object per distinct key:
+// Request() hashes the key and returns the existing handle, or adds one and
+// starts creating it on the job system (inline without one). Get() is
+// lock-free and returns null until creation finished, render code can skip
+// the draw or Wait() for it. Handles stay valid until Clear().
+// Factory is duck typed:
+//   using Pipeline = ...;
+//   // Called on worker threads, several at once:
+//   auto Create(const DXRPipelineKey& key, Pipeline& out) -> bool;
+template <typename Factory> struct DXRPipelineRegistry : DXRNonCopyable
+{
+	using Pipeline = typename Factory::Pipeline;
+
+	// Entries live in chunks that never move, so Get() needs no lock:
+	static inline constexpr std::uint32_t k_ChunkSize{256};
+	static inline constexpr std::uint32_t k_MaxChunks{256};
+
+	inline DXRPipelineRegistry(Factory factory, DXRJobSystem* jobs = nullptr)
+		: m_factory(std::move(factory)), m_jobs(jobs)
+	{
+	}
+
+	inline ~DXRPipelineRegistry()
+	{
+		WaitAll();
+	}
+
+	inline auto Request(const DXRPipelineKey& key) -> DXRPipelineHandle
+	{
+		const auto hash = GetPipelineKeyHash(key);
+		Entry* created{};
+		DXRPipelineHandle handle{};
+		{
+			std::lock_guard lock{m_mutex};
+			m_stats.requests++;
+			auto slot = FindSlot(key, hash);
+			if (m_table[slot])
+			{
+				m_stats.shared++;
+				return {m_table[slot] - 1};
+			}
+			if (m_count == k_ChunkSize * k_MaxChunks)
+				return {};
+
+			handle.index = m_count++;
+			if (!(handle.index % k_ChunkSize))
+				m_chunks[handle.index / k_ChunkSize] =
+					std::make_unique<Entry[]>(k_ChunkSize);
+			created = &GetEntry(handle);
+			created->key = key;
+			created->hash = hash;
+			m_table[slot] = handle.index + 1;
+			// Counted before the lock goes, a Request() that finds the entry
+			// next must not Wait() on a counter that is still done:
+			if (m_jobs)
+				DXRJobSystem::AddPending(created->done);
+			// At most half full, probe sequences stay short:
+			if (m_count * 2 > m_table.size())
+				Rehash();
+		}
+
+		if (m_jobs)
+			m_jobs->RunCounted([this, created] { Create(*created); },
+							   created->done);
+		else
+			Create(*created);
+		return handle;
+	}
+
+	// Null while it is created and if that failed:
+	inline auto Get(DXRPipelineHandle handle) const -> const Pipeline*
+	{
+		if (!handle.IsValid())
+			return nullptr;
+		const auto& entry = GetEntry(handle);
+		if (entry.state.load(std::memory_order_acquire) != k_Ready)
+			return nullptr;
+		return &entry.pipeline;
+	}
+
+	// Runs other jobs until the pipeline is created. Without a job system it
+	// yields while another thread's Request() creates it. Any thread:
+	inline auto Wait(DXRPipelineHandle handle) -> const Pipeline*
+	{
+		if (!handle.IsValid())
+			return nullptr;
+		auto& entry = GetEntry(handle);
+		if (m_jobs)
+			m_jobs->Wait(entry.done);
+		else
+		{
+			// Another thread's Request() is creating it inline:
+			while (entry.state.load(std::memory_order_acquire) == k_Pending)
+			{
+				std::this_thread::yield();
+			}
+		}
+		return Get(handle);
+	}
+
+	inline auto WaitAll() -> void
+	{
+		if (!m_jobs)
+			return;
+		const auto count = GetCount();
+		for (std::uint32_t index{}; index < count; index++)
+		{
+			m_jobs->Wait(GetEntry({index}).done);
+		}
+	}
+
+	// Waits for everything in flight and destroys all pipelines (device
+	// lost):
+	inline auto Clear() -> void
+	{
+		WaitAll();
+		std::lock_guard lock{m_mutex};
+		for (auto& chunk : m_chunks)
+		{
+			chunk.reset();
+		}
+		m_table.assign(64, 0);
+		m_count = 0;
+	}
+
+	inline auto GetKey(DXRPipelineHandle handle) const -> const DXRPipelineKey&
+	{
+		return GetEntry(handle).key;
+	}
+
+	inline auto GetCount() const -> std::uint32_t
+	{
+		std::lock_guard lock{m_mutex};
+		return m_count;
+	}
+
+	inline auto GetStats() const -> DXRPipelineRegistryStats
+	{
+		std::lock_guard lock{m_mutex};
+		return m_stats;
+	}
+
+	inline auto GetFactory() -> Factory&
+	{
+		return m_factory;
+	}
+
+  private:
+	static inline constexpr std::uint8_t k_Pending{0};
+	static inline constexpr std::uint8_t k_Ready{1};
+	static inline constexpr std::uint8_t k_Failed{2};
+
+	struct Entry
+	{
+		DXRPipelineKey key{};
+		std::uint64_t hash{};
+		Pipeline pipeline{};
+		std::atomic<std::uint8_t> state{};
+		// Signaled by the creation job:
+		DXRJobCounter done{};
+	};
+
+	inline auto GetEntry(DXRPipelineHandle handle) const -> Entry&
+	{
+		DXRASSERT(handle.index < k_ChunkSize * k_MaxChunks);
+		return m_chunks[handle.index / k_ChunkSize][handle.index % k_ChunkSize];
+	}
+
+	// The slot holding key, or the empty one it goes into. Caller holds
+	// m_mutex:
+	inline auto FindSlot(const DXRPipelineKey& key, std::uint64_t hash) const
+		-> std::size_t
+	{
+		const auto mask = m_table.size() - 1;
+		auto slot = static_cast<std::size_t>(hash) & mask;
+		while (m_table[slot])
+		{
+			const auto& entry = GetEntry({m_table[slot] - 1});
+			if (entry.hash == hash && entry.key == key)
+				break;
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	inline auto Rehash() -> void
+	{
+		std::vector<std::uint32_t> table(m_table.size() * 2);
+		const auto mask = table.size() - 1;
+		for (const auto index : m_table)
+		{
+			if (!index)
+				continue;
+			auto slot = static_cast<std::size_t>(GetEntry({index - 1}).hash) &
+						mask;
+			while (table[slot])
+			{
+				slot = (slot + 1) & mask;
+			}
+			table[slot] = index;
+		}
+		m_table.swap(table);
+	}
+
+	inline auto Create(Entry& entry) -> void
+	{
+		const auto created = m_factory.Create(entry.key, entry.pipeline);
+		entry.state.store(created ? k_Ready : k_Failed,
+						  std::memory_order_release);
+		std::lock_guard lock{m_mutex};
+		if (created)
+			m_stats.created++;
+		else
+			m_stats.failed++;
+	}
+
+	Factory m_factory;
+	DXRJobSystem* m_jobs{};
+
+	mutable std::mutex m_mutex{};
+	std::array<std::unique_ptr<Entry[]>, k_MaxChunks> m_chunks{};
+	std::uint32_t m_count{};
+	// Open addressing, entry index + 1, 0 is empty. Power of two:
+	std::vector<std::uint32_t> m_table = std::vector<std::uint32_t>(64);
+	DXRPipelineRegistryStats m_stats{};
+};
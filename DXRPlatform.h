@@ -0,0 +1,13 @@
+#pragma once
+
+/*
+	Picks the platform layer.
+	Code that only needs the clock (camera, pacing, assets) should include
+	this instead of W32Platform.h so it also builds headless.
+*/
+
+#ifdef _WIN32
+#include "W32Platform.h"
+#else
+#include "PosixPlatform.h"
+#endif
@@ -0,0 +1,338 @@
+#include "DXRRangeAllocator.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+auto AlignUp(std::uint64_t value, std::uint64_t alignment) -> std::uint64_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+DXRRangeAllocator::DXRRangeAllocator(std::uint64_t capacity,
+									 std::uint64_t granularity)
+{
+	Reset(capacity, granularity);
+}
+
+auto DXRRangeAllocator::Reset(std::uint64_t capacity, std::uint64_t granularity)
+	-> void
+{
+	DXRASSERT(granularity && !(granularity & (granularity - 1)));
+	m_granularity = granularity;
+	m_capacity = capacity & ~(granularity - 1);
+	m_used = 0;
+	m_allocations = 0;
+	m_blocks.clear();
+	m_unusedBlocks.clear();
+	m_firstLevel = 0;
+	m_secondLevel = {};
+	for (auto& heads : m_heads)
+	{
+		heads.fill(k_None);
+	}
+	if (!m_capacity)
+		return;
+	m_blocks.push_back({0, m_capacity});
+	Insert(0);
+}
+
+auto DXRRangeAllocator::Allocate(std::uint64_t size, std::uint64_t alignment)
+	-> DXRRange
+{
+	DXRASSERT(alignment && !(alignment & (alignment - 1)));
+	alignment = std::max(alignment, m_granularity);
+	if (!size || size > m_capacity - m_used)
+		return {};
+	size = AlignUp(size, m_granularity);
+
+	// Offsets are multiples of granularity, aligning one wastes at most
+	// this much:
+	const auto search = size + alignment - m_granularity;
+	if (search < size)
+		return {};
+	const auto fits = [&](std::uint32_t block) {
+		const auto& entry = m_blocks[block];
+		const auto padding = AlignUp(entry.offset, alignment) - entry.offset;
+		return entry.size >= padding + size;
+	};
+
+	auto block = FindFree(MapRoundUp(search));
+	if (block == k_None)
+	{
+		// Nearly full, or a big alignment: blocks in the classes between size
+		// and the rounded up search may still fit, worth a walk before
+		// failing:
+		const auto last = Map(search);
+		auto [first, second] = Map(size);
+		while (block == k_None &&
+			   (first < last.first ||
+				(first == last.first && second <= last.second)))
+		{
+			for (block = m_heads[first][second]; block != k_None;
+				 block = m_blocks[block].nextFree)
+			{
+				if (fits(block))
+					break;
+			}
+			if (++second == k_SecondLevelCount)
+			{
+				first++;
+				second = 0;
+			}
+		}
+		if (block == k_None)
+			return {};
+	}
+	DXRASSERT(fits(block));
+	Remove(block);
+
+	const auto padding =
+		AlignUp(m_blocks[block].offset, alignment) - m_blocks[block].offset;
+	if (padding)
+	{
+		// The front stays free:
+		const auto aligned = Split(block, padding);
+		Insert(block);
+		block = aligned;
+	}
+	if (m_blocks[block].size > size)
+	{
+		const auto rest = Split(block, size);
+		Insert(rest);
+	}
+
+	auto& entry = m_blocks[block];
+	entry.free = false;
+	m_used += size;
+	m_allocations++;
+	return {entry.offset, size, block};
+}
+
+auto DXRRangeAllocator::Free(const DXRRange& range) -> void
+{
+	if (!range.IsValid())
+		return;
+	auto block = range.block;
+	DXRASSERT(block < m_blocks.size());
+	DXRASSERT(!m_blocks[block].free);
+	DXRASSERT(m_blocks[block].offset == range.offset);
+	m_used -= m_blocks[block].size;
+	m_allocations--;
+
+	const auto previous = m_blocks[block].previous;
+	if (previous != k_None && m_blocks[previous].free)
+	{
+		Remove(previous);
+		Merge(previous, block);
+		block = previous;
+	}
+	const auto next = m_blocks[block].next;
+	if (next != k_None && m_blocks[next].free)
+	{
+		Remove(next);
+		Merge(block, next);
+	}
+	Insert(block);
+}
+
+auto DXRRangeAllocator::GetFreeRanges(std::uint64_t& largest) const
+	-> std::uint32_t
+{
+	std::uint32_t ranges{};
+	largest = 0;
+	for (auto block = GetFirstBlock(); block != k_None;
+		 block = m_blocks[block].next)
+	{
+		if (m_blocks[block].free)
+		{
+			ranges++;
+			largest = std::max(largest, m_blocks[block].size);
+		}
+	}
+	return ranges;
+}
+
+auto DXRRangeAllocator::Validate() const -> bool
+{
+	std::uint64_t offset{};
+	std::uint64_t used{};
+	std::uint32_t allocations{};
+	std::uint32_t freeBlocks{};
+	auto previous = k_None;
+	for (auto block = GetFirstBlock(); block != k_None;
+		 block = m_blocks[block].next)
+	{
+		const auto& entry = m_blocks[block];
+		if (entry.offset != offset || !entry.size ||
+			entry.previous != previous || entry.offset % m_granularity ||
+			entry.size % m_granularity)
+			return false;
+		if (entry.free)
+		{
+			if (previous != k_None && m_blocks[previous].free)
+				return false;
+			freeBlocks++;
+		}
+		else
+		{
+			used += entry.size;
+			allocations++;
+		}
+		offset += entry.size;
+		previous = block;
+	}
+	if (offset != m_capacity || used != m_used ||
+		allocations != m_allocations)
+		return false;
+
+	std::uint32_t listed{};
+	for (std::uint32_t first{}; first < k_FirstLevelCount; first++)
+	{
+		for (std::uint32_t second{}; second < k_SecondLevelCount; second++)
+		{
+			const auto head = m_heads[first][second];
+			const bool bit = m_secondLevel[first] & (1u << second);
+			if (bit != (head != k_None))
+				return false;
+			for (auto block = head; block != k_None;
+				 block = m_blocks[block].nextFree)
+			{
+				const auto& entry = m_blocks[block];
+				const auto sizeClass = Map(entry.size);
+				if (!entry.free || sizeClass.first != first ||
+					sizeClass.second != second)
+					return false;
+				listed++;
+			}
+		}
+		const bool bit = m_firstLevel & (std::uint64_t{1} << first);
+		if (bit != (m_secondLevel[first] != 0))
+			return false;
+	}
+	return listed == freeBlocks;
+}
+
+auto DXRRangeAllocator::Map(std::uint64_t size) -> SizeClass
+{
+	if (size < k_SecondLevelCount)
+		return {0, static_cast<std::uint32_t>(size)};
+	const auto top = static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+	return {top - k_SecondLevelBits + 1,
+			static_cast<std::uint32_t>(size >> (top - k_SecondLevelBits)) -
+				k_SecondLevelCount};
+}
+
+auto DXRRangeAllocator::MapRoundUp(std::uint64_t size) -> SizeClass
+{
+	if (size < k_SecondLevelCount)
+		return {0, static_cast<std::uint32_t>(size)};
+	const auto top = static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+	const auto rounded =
+		size + (std::uint64_t{1} << (top - k_SecondLevelBits)) - 1;
+	if (rounded < size)
+		return {k_FirstLevelCount, 0};
+	return Map(rounded);
+}
+
+auto DXRRangeAllocator::FindFree(SizeClass sizeClass) const -> std::uint32_t
+{
+	auto [first, second] = sizeClass;
+	if (first >= k_FirstLevelCount)
+		return k_None;
+	auto secondMap = m_secondLevel[first] & (~0u << second);
+	if (!secondMap)
+	{
+		const auto firstMap =
+			first + 1 < k_FirstLevelCount
+				? m_firstLevel & (~std::uint64_t{} << (first + 1))
+				: 0;
+		if (!firstMap)
+			return k_None;
+		first = static_cast<std::uint32_t>(std::countr_zero(firstMap));
+		secondMap = m_secondLevel[first];
+	}
+	second = static_cast<std::uint32_t>(std::countr_zero(secondMap));
+	return m_heads[first][second];
+}
+
+auto DXRRangeAllocator::Insert(std::uint32_t block) -> void
+{
+	auto& entry = m_blocks[block];
+	const auto [first, second] = Map(entry.size);
+	auto& head = m_heads[first][second];
+	entry.free = true;
+	entry.previousFree = k_None;
+	entry.nextFree = head;
+	if (head != k_None)
+		m_blocks[head].previousFree = block;
+	head = block;
+	m_secondLevel[first] |= 1u << second;
+	m_firstLevel |= std::uint64_t{1} << first;
+}
+
+auto DXRRangeAllocator::Remove(std::uint32_t block) -> void
+{
+	auto& entry = m_blocks[block];
+	const auto [first, second] = Map(entry.size);
+	if (entry.previousFree != k_None)
+		m_blocks[entry.previousFree].nextFree = entry.nextFree;
+	else
+		m_heads[first][second] = entry.nextFree;
+	if (entry.nextFree != k_None)
+		m_blocks[entry.nextFree].previousFree = entry.previousFree;
+	entry.previousFree = k_None;
+	entry.nextFree = k_None;
+	entry.free = false;
+	if (m_heads[first][second] == k_None)
+	{
+		m_secondLevel[first] &= ~(1u << second);
+		if (!m_secondLevel[first])
+			m_firstLevel &= ~(std::uint64_t{1} << first);
+	}
+}
+
+auto DXRRangeAllocator::Split(std::uint32_t block, std::uint64_t size)
+	-> std::uint32_t
+{
+	// Before taking references, NewBlock() may grow m_blocks:
+	const auto rest = NewBlock();
+	auto& front = m_blocks[block];
+	auto& back = m_blocks[rest];
+	DXRASSERT(front.size > size);
+	back.offset = front.offset + size;
+	back.size = front.size - size;
+	back.previous = block;
+	back.next = front.next;
+	if (front.next != k_None)
+		m_blocks[front.next].previous = rest;
+	front.next = rest;
+	front.size = size;
+	return rest;
+}
+
+auto DXRRangeAllocator::Merge(std::uint32_t block, std::uint32_t next) -> void
+{
+	auto& entry = m_blocks[block];
+	const auto& absorbed = m_blocks[next];
+	entry.size += absorbed.size;
+	entry.next = absorbed.next;
+	if (absorbed.next != k_None)
+		m_blocks[absorbed.next].previous = block;
+	m_blocks[next] = {};
+	m_unusedBlocks.push_back(next);
+}
+
+auto DXRRangeAllocator::NewBlock() -> std::uint32_t
+{
+	if (!m_unusedBlocks.empty())
+	{
+		const auto block = m_unusedBlocks.back();
+		m_unusedBlocks.pop_back();
+		return block;
+	}
+	m_blocks.emplace_back();
+	return static_cast<std::uint32_t>(m_blocks.size() - 1);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <array>
+#include <vector>
+
+struct DXRRange
+{
+	std::uint64_t offset{};
+	std::uint64_t size{};
+	// DXRRangeAllocator's block, Free() needs it:
+	std::uint32_t block{~0u};
+
+	inline auto IsValid() const -> bool
+	{
+		return block != ~0u;
+	}
+};
+
+// Two-level segregated fit (Masmano et al., "TLSF: a New Dynamic Memory
+// Allocator for Real-Time Systems") over [0, capacity):
+// Free ranges sit in lists by size class, a power of two split into
+// k_SecondLevelCount. Two bitmaps find the first non-empty list big enough,
+// so Allocate() and Free() are O(1) whatever the fragmentation. Freed ranges
+// merge with free neighbours right away. Only offsets are handed out, what
+// they point into (a descriptor heap, a GPU heap) lives with the caller.
+// Same inputs, same offsets: nothing depends on addresses or time.
+struct DXRRangeAllocator
+{
+	static inline constexpr std::uint32_t k_SecondLevelBits{4};
+	static inline constexpr std::uint32_t k_SecondLevelCount{
+		1u << k_SecondLevelBits};
+	static inline constexpr std::uint32_t k_FirstLevelCount{64};
+	static inline constexpr std::uint32_t k_None{~0u};
+
+	// Sizes and offsets are multiples of granularity (a power of two):
+	DXRRangeAllocator(std::uint64_t capacity = 0,
+					  std::uint64_t granularity = 1);
+
+	// Forgets every allocation:
+	auto Reset(std::uint64_t capacity, std::uint64_t granularity = 1) -> void;
+
+	// alignment is a power of two, below granularity it is granularity.
+	// Invalid if there is no free range that fits:
+	auto Allocate(std::uint64_t size, std::uint64_t alignment = 1) -> DXRRange;
+
+	auto Free(const DXRRange& range) -> void;
+
+	inline auto GetCapacity() const -> std::uint64_t
+	{
+		return m_capacity;
+	}
+
+	inline auto GetGranularity() const -> std::uint64_t
+	{
+		return m_granularity;
+	}
+
+	// Including the rounding up to granularity:
+	inline auto GetUsedSize() const -> std::uint64_t
+	{
+		return m_used;
+	}
+
+	inline auto GetAllocationCount() const -> std::uint32_t
+	{
+		return m_allocations;
+	}
+
+	inline auto IsEmpty() const -> bool
+	{
+		return !m_allocations;
+	}
+
+	// Free ranges and the largest of them, by walking every block:
+	auto GetFreeRanges(std::uint64_t& largest) const -> std::uint32_t;
+
+	// Allocated ranges in offset order:
+	template <typename F> inline auto ForEachAllocation(F&& f) const -> void
+	{
+		for (auto block = GetFirstBlock(); block != k_None;
+			 block = m_blocks[block].next)
+		{
+			const auto& entry = m_blocks[block];
+			if (!entry.free)
+				f(DXRRange{entry.offset, entry.size, block});
+		}
+	}
+
+	// Checks every invariant, for fuzzing: blocks tile [0, capacity), no two
+	// free neighbours, every free block in the list of its size class and
+	// the bitmaps matching the lists:
+	auto Validate() const -> bool;
+
+  private:
+	struct Block
+	{
+		std::uint64_t offset{};
+		std::uint64_t size{};
+		// Neighbours by offset:
+		std::uint32_t previous{k_None};
+		std::uint32_t next{k_None};
+		// In the size class list, while free:
+		std::uint32_t previousFree{k_None};
+		std::uint32_t nextFree{k_None};
+		bool free{};
+	};
+
+	struct SizeClass
+	{
+		std::uint32_t first{};
+		std::uint32_t second{};
+	};
+
+	// The class size is in:
+	static auto Map(std::uint64_t size) -> SizeClass;
+	// The first class whose every block fits size:
+	static auto MapRoundUp(std::uint64_t size) -> SizeClass;
+
+	auto FindFree(SizeClass sizeClass) const -> std::uint32_t;
+	auto Insert(std::uint32_t block) -> void;
+	auto Remove(std::uint32_t block) -> void;
+	// Splits size off the front of block, the rest becomes a new block right
+	// after it, not in any list yet:
+	auto Split(std::uint32_t block, std::uint64_t size) -> std::uint32_t;
+	// next is right after block and goes away:
+	auto Merge(std::uint32_t block, std::uint32_t next) -> void;
+	auto NewBlock() -> std::uint32_t;
+
+	inline auto GetFirstBlock() const -> std::uint32_t
+	{
+		// Block 0 starts at offset 0 and stays there, merges only ever grow
+		// it:
+		return m_blocks.empty() ? k_None : 0;
+	}
+
+	std::uint64_t m_capacity{};
+	std::uint64_t m_granularity{1};
+	std::uint64_t m_used{};
+	std::uint32_t m_allocations{};
+	std::vector<Block> m_blocks{};
+	std::vector<std::uint32_t> m_unusedBlocks{};
+
+	std::uint64_t m_firstLevel{};
+	std::array<std::uint32_t, k_FirstLevelCount> m_secondLevel{};
+	std::array<std::array<std::uint32_t, k_SecondLevelCount>, k_FirstLevelCount>
+		m_heads{};
+};
@@ -0,0 +1,826 @@
+#include "DXRRayQuery.h"
+#include "DXRCPUFeatures.h"
+#include "DXRJobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define DXRRAYQUERYSSE
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC emits AVX2 intrinsics without /arch:AVX2:
+#define DXRRAYQUERYAVX2
+#define DXRRAYQUERYAVX2FLATTEN
+#else
+#define DXRRAYQUERYAVX2 __attribute__((target("avx2,fma")))
+// The traversal templates get inlined into these, and the AVX2 kernels into
+// the templates, otherwise every node test would be a call:
+#define DXRRAYQUERYAVX2FLATTEN __attribute__((target("avx2,fma"), flatten))
+#endif
+#endif
+
+namespace
+{
+constexpr auto k_Infinity = std::numeric_limits<float>::infinity();
+
+// Box exits get the slack the watertight triangle test needs:
+constexpr float k_ExitScale{DXRBvh::k_RobustExitScale};
+
+// A DXRRay prepared for traversal:
+struct RayData
+{
+	glm::vec3 origin{};
+	float tMin{};
+	// No component is zero, flat directions get a tiny one instead so slabs
+	// never compute 0 * inf:
+	glm::vec3 inverseDirection{};
+	float tMax{};
+	// Which bounds the ray enters through per axis, 0 = min, 1 = max:
+	std::uint32_t nearSide[3]{};
+	// Watertight test: kz is the dominant axis, the triangle is sheared
+	// into a space where the ray runs along it:
+	int kx{};
+	int ky{};
+	int kz{};
+	glm::vec3 shear{};
+};
+
+auto MakeRayData(const DXRRay& ray) -> RayData
+{
+	RayData out{};
+	out.origin = ray.origin;
+	out.tMin = ray.tMin;
+	out.tMax = ray.tMax;
+	const auto& direction = ray.direction;
+	for (int axis{}; axis < 3; axis++)
+	{
+		auto d = direction[axis];
+		if (std::abs(d) < 1e-20f)
+			d = std::copysign(1e-20f, d);
+		out.inverseDirection[axis] = 1.f / d;
+		out.nearSide[axis] = d < 0.f ? 1 : 0;
+	}
+
+	const auto size = glm::abs(direction);
+	out.kz = size.x > size.y ? (size.x > size.z ? 0 : 2)
+							 : (size.y > size.z ? 1 : 2);
+	// No direction, no hits:
+	if (direction[out.kz] == 0.f)
+	{
+		out.tMax = -k_Infinity;
+		return out;
+	}
+	out.kx = (out.kz + 1) % 3;
+	out.ky = (out.kx + 1) % 3;
+	// Keeps the winding, so both sides give the same signs:
+	if (direction[out.kz] < 0.f)
+		std::swap(out.kx, out.ky);
+	out.shear = {direction[out.kx] / direction[out.kz],
+				 direction[out.ky] / direction[out.kz],
+				 1.f / direction[out.kz]};
+	return out;
+}
+
+auto IntersectTriangle(const RayData& ray, const DXRRayTriangle& triangle,
+					   float tMax, bool barycentrics, DXRRayHit& hit) -> bool
+{
+	const auto a = triangle.v0 - ray.origin;
+	const auto b = triangle.v1 - ray.origin;
+	const auto c = triangle.v2 - ray.origin;
+	const auto ax = a[ray.kx] - ray.shear.x * a[ray.kz];
+	const auto ay = a[ray.ky] - ray.shear.y * a[ray.kz];
+	const auto bx = b[ray.kx] - ray.shear.x * b[ray.kz];
+	const auto by = b[ray.ky] - ray.shear.y * b[ray.kz];
+	const auto cx = c[ray.kx] - ray.shear.x * c[ray.kz];
+	const auto cy = c[ray.ky] - ray.shear.y * c[ray.kz];
+
+	// Scaled barycentrics, the edge functions of the 2D triangle:
+	auto u = cx * by - cy * bx;
+	auto v = ax * cy - ay * cx;
+	auto w = bx * ay - by * ax;
+	// Exactly on an edge in float, doubles decide which side:
+	if (u == 0.f || v == 0.f || w == 0.f)
+	{
+		u = static_cast<float>(static_cast<double>(cx) * by -
+							   static_cast<double>(cy) * bx);
+		v = static_cast<float>(static_cast<double>(ax) * cy -
+							   static_cast<double>(ay) * cx);
+		w = static_cast<float>(static_cast<double>(bx) * ay -
+							   static_cast<double>(by) * ax);
+	}
+	if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f))
+		return false;
+	const auto determinant = u + v + w;
+	if (determinant == 0.f)
+		return false;
+
+	const auto az = ray.shear.z * a[ray.kz];
+	const auto bz = ray.shear.z * b[ray.kz];
+	const auto cz = ray.shear.z * c[ray.kz];
+	const auto inverse = 1.f / determinant;
+	const auto t = (u * az + v * bz + w * cz) * inverse;
+	if (!(t >= ray.tMin && t < tMax))
+		return false;
+	hit.t = t;
+	hit.u = barycentrics ? v * inverse : 0.f;
+	hit.v = barycentrics ? w * inverse : 0.f;
+	hit.triangle = triangle.triangle;
+	return true;
+}
+
+// Single ray against every slot of a node. Writes the entry distances and
+// returns a bit per slot the ray enters before tMax:
+template <std::uint32_t Width>
+auto IntersectChildrenScalar(const DXRWideBvhNode<Width>& node,
+							 const RayData& ray, float tMax, float* distances)
+	-> std::uint32_t
+{
+	std::uint32_t mask{};
+	for (std::uint32_t slot{}; slot < Width; slot++)
+	{
+		auto tNear = ray.tMin;
+		auto tFar = k_Infinity;
+		for (int axis{}; axis < 3; axis++)
+		{
+			const auto& bounds = node.bounds[axis];
+			const auto side = ray.nearSide[axis];
+			tNear = std::max(tNear, (bounds[side][slot] - ray.origin[axis]) *
+										ray.inverseDirection[axis]);
+			tFar = std::min(tFar, (bounds[1 - side][slot] - ray.origin[axis]) *
+									  ray.inverseDirection[axis]);
+		}
+		tFar = std::min(tFar * k_ExitScale, tMax);
+		distances[slot] = tNear;
+		mask |= (tNear <= tFar ? 1u : 0u) << slot;
+	}
+	return mask;
+}
+
+// Rays of a packet, one per lane. Unused and finished lanes have
+// tMax = -inf and never enter a box:
+struct PacketData
+{
+	alignas(32) float origin[3][DXRRayScene::k_PacketSize]{};
+	alignas(32) float inverseDirection[3][DXRRayScene::k_PacketSize]{};
+	alignas(32) float tMin[DXRRayScene::k_PacketSize]{};
+	alignas(32) float tMax[DXRRayScene::k_PacketSize]{};
+	RayData rays[DXRRayScene::k_PacketSize]{};
+
+	auto SetRay(std::uint32_t lane, const DXRRay& ray) -> void
+	{
+		auto& data = rays[lane];
+		data = MakeRayData(ray);
+		for (std::size_t axis{}; axis < 3; axis++)
+		{
+			origin[axis][lane] = data.origin[static_cast<int>(axis)];
+			inverseDirection[axis][lane] =
+				data.inverseDirection[static_cast<int>(axis)];
+		}
+		tMin[lane] = data.tMin;
+		tMax[lane] = data.tMax;
+	}
+
+	auto Clear() -> void
+	{
+		std::fill(std::begin(tMax), std::end(tMax), -k_Infinity);
+	}
+};
+
+// Every lane against one box, {minX, maxX, minY, maxY, minZ, maxZ}. Writes
+// the entry distances and returns a bit per lane that enters it:
+auto IntersectPacketScalar(const PacketData& packet, const float* box,
+						   float* distances) -> std::uint32_t
+{
+	std::uint32_t mask{};
+	for (std::uint32_t lane{}; lane < DXRRayScene::k_PacketSize; lane++)
+	{
+		auto tNear = packet.tMin[lane];
+		auto tFar = k_Infinity;
+		for (std::size_t axis{}; axis < 3; axis++)
+		{
+			const auto t0 = (box[axis * 2] - packet.origin[axis][lane]) *
+							packet.inverseDirection[axis][lane];
+			const auto t1 = (box[axis * 2 + 1] - packet.origin[axis][lane]) *
+							packet.inverseDirection[axis][lane];
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+		}
+		tFar = std::min(tFar * k_ExitScale, packet.tMax[lane]);
+		distances[lane] = tNear;
+		mask |= (tNear <= tFar ? 1u : 0u) << lane;
+	}
+	return mask;
+}
+
+#ifdef DXRRAYQUERYSSE
+auto IntersectChildrenSSE(const DXRWideBvhNode<4>& node, const RayData& ray,
+						  float tMax, float* distances) -> std::uint32_t
+{
+	auto tNear = _mm_set1_ps(ray.tMin);
+	auto tFar = _mm_set1_ps(tMax);
+	for (int axis{}; axis < 3; axis++)
+	{
+		const auto& bounds = node.bounds[axis];
+		const auto side = ray.nearSide[axis];
+		const auto origin = _mm_set1_ps(ray.origin[axis]);
+		const auto inverse = _mm_set1_ps(ray.inverseDirection[axis]);
+		tNear = _mm_max_ps(
+			tNear,
+			_mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[side]), origin), inverse));
+		const auto exit = _mm_mul_ps(
+			_mm_sub_ps(_mm_load_ps(bounds[1 - side]), origin), inverse);
+		tFar = _mm_min_ps(tFar, _mm_mul_ps(exit, _mm_set1_ps(k_ExitScale)));
+	}
+	_mm_store_ps(distances, tNear);
+	return static_cast<std::uint32_t>(
+		_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+}
+
+// Two halves of four lanes:
+auto IntersectPacketSSE(const PacketData& packet, const float* box,
+						float* distances) -> std::uint32_t
+{
+	std::uint32_t mask{};
+	for (std::size_t half{}; half < DXRRayScene::k_PacketSize; half += 4)
+	{
+		auto tNear = _mm_load_ps(packet.tMin + half);
+		auto tFar = _mm_set1_ps(k_Infinity);
+		for (std::size_t axis{}; axis < 3; axis++)
+		{
+			const auto origin = _mm_load_ps(packet.origin[axis] + half);
+			const auto inverse =
+				_mm_load_ps(packet.inverseDirection[axis] + half);
+			const auto t0 = _mm_mul_ps(
+				_mm_sub_ps(_mm_set1_ps(box[axis * 2]), origin), inverse);
+			const auto t1 = _mm_mul_ps(
+				_mm_sub_ps(_mm_set1_ps(box[axis * 2 + 1]), origin), inverse);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+			tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+		}
+		tFar = _mm_min_ps(_mm_mul_ps(tFar, _mm_set1_ps(k_ExitScale)),
+						  _mm_load_ps(packet.tMax + half));
+		_mm_store_ps(distances + half, tNear);
+		mask |= static_cast<std::uint32_t>(
+					_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)))
+				<< half;
+	}
+	return mask;
+}
+
+DXRRAYQUERYAVX2 auto IntersectChildrenAVX2(const DXRWideBvhNode<8>& node,
+										   const RayData& ray, float tMax,
+										   float* distances) -> std::uint32_t
+{
+	auto tNear = _mm256_set1_ps(ray.tMin);
+	auto tFar = _mm256_set1_ps(tMax);
+	const auto exitScale = _mm256_set1_ps(k_ExitScale);
+	for (int axis{}; axis < 3; axis++)
+	{
+		const auto& bounds = node.bounds[axis];
+		const auto side = ray.nearSide[axis];
+		const auto origin = _mm256_set1_ps(ray.origin[axis]);
+		const auto inverse = _mm256_set1_ps(ray.inverseDirection[axis]);
+		tNear = _mm256_max_ps(
+			tNear, _mm256_mul_ps(
+					   _mm256_sub_ps(_mm256_load_ps(bounds[side]), origin),
+					   inverse));
+		tFar = _mm256_min_ps(
+			tFar,
+			_mm256_mul_ps(
+				_mm256_mul_ps(
+					_mm256_sub_ps(_mm256_load_ps(bounds[1 - side]), origin),
+					inverse),
+				exitScale));
+	}
+	_mm256_store_ps(distances, tNear);
+	return static_cast<std::uint32_t>(
+		_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+}
+
+DXRRAYQUERYAVX2 auto IntersectPacketAVX2(const PacketData& packet,
+										 const float* box, float* distances)
+	-> std::uint32_t
+{
+	auto tNear = _mm256_load_ps(packet.tMin);
+	auto tFar = _mm256_set1_ps(k_Infinity);
+	for (std::size_t axis{}; axis < 3; axis++)
+	{
+		const auto origin = _mm256_load_ps(packet.origin[axis]);
+		const auto inverse = _mm256_load_ps(packet.inverseDirection[axis]);
+		const auto t0 = _mm256_mul_ps(
+			_mm256_sub_ps(_mm256_set1_ps(box[axis * 2]), origin), inverse);
+		const auto t1 = _mm256_mul_ps(
+			_mm256_sub_ps(_mm256_set1_ps(box[axis * 2 + 1]), origin),
+			inverse);
+		tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+		tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+	}
+	tFar = _mm256_min_ps(_mm256_mul_ps(tFar, _mm256_set1_ps(k_ExitScale)),
+						 _mm256_load_ps(packet.tMax));
+	_mm256_store_ps(distances, tNear);
+	return static_cast<std::uint32_t>(
+		_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+}
+#endif
+
+// A wide node's slot waiting to be visited. count != 0 for leaves, mask is
+// the packet lanes that entered it:
+struct StackEntry
+{
+	std::uint32_t child{};
+	std::uint32_t count{};
+	float t{};
+	std::uint32_t mask{};
+};
+
+// Every popped node pushes at most Width - 1 more entries than it took:
+template <std::uint32_t Width>
+constexpr std::size_t k_StackSize{DXRBvh::k_MaxDepth * (Width - 1) + 1};
+
+// Pushes the slots in mask farthest first, so the nearest pops next:
+template <std::uint32_t Width>
+auto PushSorted(const DXRWideBvhNode<Width>& node, std::uint32_t mask,
+				const float* distances, const std::uint32_t* laneMasks,
+				StackEntry* stack, std::size_t& size) -> void
+{
+	std::uint32_t slots[Width]{};
+	std::uint32_t count{};
+	while (mask)
+	{
+		const auto slot = static_cast<std::uint32_t>(std::countr_zero(mask));
+		mask &= mask - 1;
+		auto n = count++;
+		for (; n && distances[slots[n - 1]] < distances[slot]; n--)
+		{
+			slots[n] = slots[n - 1];
+		}
+		slots[n] = slot;
+	}
+	for (std::uint32_t n{}; n < count; n++)
+	{
+		const auto slot = slots[n];
+		stack[size++] = {node.child[slot], node.count[slot], distances[slot],
+						 laneMasks ? laneMasks[slot] : 0u};
+	}
+}
+
+template <std::uint32_t Width, auto IntersectChildren>
+auto TraceRayWide(const std::vector<DXRWideBvhNode<Width>>& nodes,
+				  const DXRRayTriangle* triangles, const RayData& ray,
+				  DXRRayQueryType type, DXRRayHit& hit) -> bool
+{
+	hit = {};
+	auto closest = ray.tMax;
+	if (nodes.empty() || !(ray.tMin < closest))
+		return false;
+	const auto barycentrics = type != DXRRayQueryType::Occlusion;
+
+	std::array<StackEntry, k_StackSize<Width>> stack{};
+	std::size_t size{};
+	stack[size++] = {0, 0, ray.tMin, 0};
+	while (size)
+	{
+		const auto entry = stack[--size];
+		// Something nearer was found since it was pushed:
+		if (entry.t >= closest)
+			continue;
+		if (entry.count)
+		{
+			for (auto n = entry.child; n < entry.child + entry.count; n++)
+			{
+				if (!IntersectTriangle(ray, triangles[n], closest,
+									   barycentrics, hit))
+					continue;
+				if (type != DXRRayQueryType::ClosestHit)
+					return true;
+				closest = hit.t;
+			}
+			continue;
+		}
+		const auto& node = nodes[entry.child];
+		alignas(32) float distances[Width];
+		const auto mask = IntersectChildren(node, ray, closest, distances);
+		PushSorted(node, mask, distances, nullptr, stack.data(), size);
+	}
+	return hit.triangle != ~0u;
+}
+
+template <std::uint32_t Width, auto IntersectPacket>
+auto TracePacketWide(const std::vector<DXRWideBvhNode<Width>>& nodes,
+					 const DXRRayTriangle* triangles, PacketData& packet,
+					 DXRRayQueryType type, DXRRayHit* hits) -> std::uint32_t
+{
+	for (std::uint32_t lane{}; lane < DXRRayScene::k_PacketSize; lane++)
+	{
+		hits[lane] = {};
+	}
+	if (nodes.empty())
+		return 0;
+	const auto barycentrics = type != DXRRayQueryType::Occlusion;
+
+	std::uint32_t alive{};
+	for (std::uint32_t lane{}; lane < DXRRayScene::k_PacketSize; lane++)
+	{
+		alive |= (packet.tMin[lane] < packet.tMax[lane] ? 1u : 0u) << lane;
+	}
+	std::uint32_t hitMask{};
+	std::array<StackEntry, k_StackSize<Width>> stack{};
+	std::size_t size{};
+	stack[size++] = {0, 0, -k_Infinity, alive};
+	while (size && alive)
+	{
+		const auto entry = stack[--size];
+		auto mask = entry.mask & alive;
+		// Skip it if every lane found something nearer since it was pushed,
+		// entry.t is the nearest entry of its lanes:
+		auto farthest = -k_Infinity;
+		for (auto bits = mask; bits; bits &= bits - 1)
+		{
+			farthest = std::max(farthest, packet.tMax[std::countr_zero(bits)]);
+		}
+		if (entry.t >= farthest)
+			continue;
+
+		if (entry.count)
+		{
+			for (auto n = entry.child; n < entry.child + entry.count && mask;
+				 n++)
+			{
+				for (auto bits = mask; bits; bits &= bits - 1)
+				{
+					const auto lane =
+						static_cast<std::uint32_t>(std::countr_zero(bits));
+					if (!IntersectTriangle(packet.rays[lane], triangles[n],
+										   packet.tMax[lane], barycentrics,
+										   hits[lane]))
+						continue;
+					hitMask |= 1u << lane;
+					packet.tMax[lane] = hits[lane].t;
+					if (type == DXRRayQueryType::ClosestHit)
+						continue;
+					// Done, the lane drops out of every box test:
+					packet.tMax[lane] = -k_Infinity;
+					alive &= ~(1u << lane);
+					mask &= ~(1u << lane);
+				}
+			}
+			continue;
+		}
+
+		const auto& node = nodes[entry.child];
+		alignas(32) float laneDistances[DXRRayScene::k_PacketSize];
+		float distances[Width]{};
+		std::uint32_t laneMasks[Width]{};
+		std::uint32_t slotMask{};
+		for (std::uint32_t slot{}; slot < Width; slot++)
+		{
+			if (node.child[slot] == ~0u)
+				continue;
+			const float box[6]{
+				node.bounds[0][0][slot], node.bounds[0][1][slot],
+				node.bounds[1][0][slot], node.bounds[1][1][slot],
+				node.bounds[2][0][slot], node.bounds[2][1][slot]};
+			const auto lanes =
+				IntersectPacket(packet, box, laneDistances) & mask;
+			if (!lanes)
+				continue;
+			auto nearest = k_Infinity;
+			for (auto bits = lanes; bits; bits &= bits - 1)
+			{
+				nearest = std::min(nearest,
+								   laneDistances[std::countr_zero(bits)]);
+			}
+			distances[slot] = nearest;
+			laneMasks[slot] = lanes;
+			slotMask |= 1u << slot;
+		}
+		PushSorted(node, slotMask, distances, laneMasks, stack.data(), size);
+	}
+	return hitMask;
+}
+
+#ifdef DXRRAYQUERYSSE
+DXRRAYQUERYAVX2FLATTEN auto TraceRayAVX2(const DXRRayScene& scene,
+										 const RayData& ray,
+										 DXRRayQueryType type, DXRRayHit& hit)
+	-> bool
+{
+	return TraceRayWide<8, IntersectChildrenAVX2>(
+		scene.nodes8, scene.triangles.data(), ray, type, hit);
+}
+
+DXRRAYQUERYAVX2FLATTEN auto TracePacketAVX2(const DXRRayScene& scene,
+											PacketData& packet,
+											DXRRayQueryType type,
+											DXRRayHit* hits) -> std::uint32_t
+{
+	return TracePacketWide<8, IntersectPacketAVX2>(
+		scene.nodes8, scene.triangles.data(), packet, type, hits);
+}
+#endif
+
+auto TraceRayData(const DXRRayScene& scene, const RayData& ray,
+				  DXRRayQueryType type, DXRRayHit& hit) -> bool
+{
+	switch (scene.simd)
+	{
+#ifdef DXRRAYQUERYSSE
+	case DXRRaySIMD::AVX2:
+		return TraceRayAVX2(scene, ray, type, hit);
+	case DXRRaySIMD::SSE:
+		return TraceRayWide<4, IntersectChildrenSSE>(
+			scene.nodes4, scene.triangles.data(), ray, type, hit);
+#endif
+	default:
+		return TraceRayWide<4, IntersectChildrenScalar<4>>(
+			scene.nodes4, scene.triangles.data(), ray, type, hit);
+	}
+}
+
+auto TracePacket(const DXRRayScene& scene, PacketData& packet,
+				 DXRRayQueryType type, DXRRayHit* hits) -> std::uint32_t
+{
+	switch (scene.simd)
+	{
+#ifdef DXRRAYQUERYSSE
+	case DXRRaySIMD::AVX2:
+		return TracePacketAVX2(scene, packet, type, hits);
+	case DXRRaySIMD::SSE:
+		return TracePacketWide<4, IntersectPacketSSE>(
+			scene.nodes4, scene.triangles.data(), packet, type, hits);
+#endif
+	default:
+		return TracePacketWide<4, IntersectPacketScalar>(
+			scene.nodes4, scene.triangles.data(), packet, type, hits);
+	}
+}
+
+template <std::uint32_t Width>
+auto Collapse(const DXRBvh& bvh, std::vector<DXRWideBvhNode<Width>>& out)
+	-> void
+{
+	const auto halfArea = [&](std::uint32_t index) {
+		const auto extent =
+			bvh.nodes[index].boundsMax - bvh.nodes[index].boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	};
+
+	out.clear();
+	out.emplace_back();
+	// Binary node, the wide node it becomes:
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{0, 0}};
+	while (!stack.empty())
+	{
+		const auto [from, to] = stack.back();
+		stack.pop_back();
+
+		std::array<std::uint32_t, Width> slots{};
+		std::uint32_t used{};
+		if (bvh.nodes[from].IsLeaf())
+		{
+			// Only a root can be a leaf here:
+			slots[used++] = from;
+		}
+		else
+		{
+			slots[used++] = bvh.nodes[from].leftOrFirst;
+			slots[used++] = bvh.nodes[from].leftOrFirst + 1;
+		}
+		while (used < Width)
+		{
+			// Open the biggest interior slot, its children are the most
+			// likely to be visited:
+			std::uint32_t best{Width};
+			auto bestArea = -1.f;
+			for (std::uint32_t slot{}; slot < used; slot++)
+			{
+				if (bvh.nodes[slots[slot]].IsLeaf())
+					continue;
+				const auto area = halfArea(slots[slot]);
+				if (area > bestArea)
+				{
+					best = slot;
+					bestArea = area;
+				}
+			}
+			if (best == Width)
+				break;
+			const auto left = bvh.nodes[slots[best]].leftOrFirst;
+			slots[best] = left;
+			slots[used++] = left + 1;
+		}
+
+		DXRWideBvhNode<Width> node{};
+		for (std::uint32_t slot{}; slot < Width; slot++)
+		{
+			for (std::size_t axis{}; axis < 3; axis++)
+			{
+				node.bounds[axis][0][slot] = k_Infinity;
+				node.bounds[axis][1][slot] = -k_Infinity;
+			}
+			node.child[slot] = ~0u;
+		}
+		for (std::uint32_t slot{}; slot < used; slot++)
+		{
+			const auto& source = bvh.nodes[slots[slot]];
+			for (int axis{}; axis < 3; axis++)
+			{
+				const auto index = static_cast<std::size_t>(axis);
+				node.bounds[index][0][slot] = source.boundsMin[axis];
+				node.bounds[index][1][slot] = source.boundsMax[axis];
+			}
+			if (source.IsLeaf())
+			{
+				node.child[slot] = source.leftOrFirst;
+				node.count[slot] = source.count;
+				continue;
+			}
+			node.child[slot] = static_cast<std::uint32_t>(out.size());
+			out.emplace_back();
+			stack.emplace_back(slots[slot], node.child[slot]);
+		}
+		out[to] = node;
+	}
+}
+} // namespace
+
+auto GetBestRaySIMD() -> DXRRaySIMD
+{
+#ifdef DXRRAYQUERYSSE
+	static const auto avx2 = CPUSupportsAVX2();
+	return avx2 ? DXRRaySIMD::AVX2 : DXRRaySIMD::SSE;
+#else
+	return DXRRaySIMD::Scalar;
+#endif
+}
+
+auto BuildRayScene(const DXRBvh& bvh, std::span<const DXRVertex3D> vertices,
+				   std::span<const std::uint32_t> indices, DXRRayScene& out,
+				   DXRRaySIMD simd) -> bool
+{
+	out = {};
+	const auto best = GetBestRaySIMD();
+	out.simd = simd == DXRRaySIMD::Best || simd > best ? best : simd;
+
+	const auto triangles = indices.size() / 3;
+	if (indices.size() % 3 || bvh.primitives.size() != triangles ||
+		bvh.nodes.empty() != !triangles)
+		return false;
+	if (std::any_of(indices.begin(), indices.end(), [&](std::uint32_t index) {
+			return index >= vertices.size();
+		}))
+		return false;
+	if (!triangles)
+		return true;
+
+	out.bounds = {bvh.nodes[0].boundsMin, bvh.nodes[0].boundsMax};
+	out.triangles.resize(triangles);
+	for (std::size_t n{}; n < triangles; n++)
+	{
+		const auto triangle = bvh.primitives[n];
+		if (triangle >= triangles)
+			return false;
+		const auto position = [&](std::size_t corner) {
+			const auto& vertex = vertices[indices[triangle * 3 + corner]];
+			return glm::vec3{vertex.x, vertex.y, vertex.z};
+		};
+		out.triangles[n] = {position(0), triangle, position(1), position(2)};
+	}
+	if (out.simd == DXRRaySIMD::AVX2)
+	{
+		Collapse(bvh, out.nodes8);
+	}
+	else
+	{
+		Collapse(bvh, out.nodes4);
+	}
+	return true;
+}
+
+auto TraceRay(const DXRRayScene& scene, const DXRRay& ray,
+			  DXRRayQueryType type, DXRRayHit& hit) -> bool
+{
+	return TraceRayData(scene, MakeRayData(ray), type, hit);
+}
+
+auto TraceRayPacket(const DXRRayScene& scene, std::span<const DXRRay> rays,
+					DXRRayQueryType type, std::span<DXRRayHit> hits)
+	-> std::uint32_t
+{
+	const auto count = std::min<std::size_t>(
+		{rays.size(), hits.size(), DXRRayScene::k_PacketSize});
+	PacketData packet{};
+	packet.Clear();
+	for (std::uint32_t lane{}; lane < count; lane++)
+	{
+		packet.SetRay(lane, rays[lane]);
+	}
+	DXRRayHit packetHits[DXRRayScene::k_PacketSize]{};
+	const auto mask = TracePacket(scene, packet, type, packetHits);
+	std::copy_n(packetHits, count, hits.begin());
+	return mask;
+}
+
+auto TraceRays(const DXRRayScene& scene, std::span<const DXRRay> rays,
+			   std::span<DXRRayHit> hits, const DXRRayStreamDesc& desc,
+			   DXRJobSystem* jobs) -> std::uint32_t
+{
+	const auto count = std::min(rays.size(), hits.size());
+	std::atomic<std::uint32_t> total{};
+	const auto trace = [&](std::size_t first, std::size_t last) {
+		std::uint32_t chunkHits{};
+		if (!desc.packets)
+		{
+			for (auto n = first; n < last; n++)
+			{
+				chunkHits += TraceRayData(scene, MakeRayData(rays[n]),
+										  desc.type, hits[n]);
+			}
+			total.fetch_add(chunkHits, std::memory_order_relaxed);
+			return;
+		}
+
+		// Counting sort by direction octant, keeping the order within one:
+		// neighbours in the stream are usually neighbours on screen, and a
+		// packet's rays all enter boxes on the same sides.
+		const auto octant = [&](std::size_t n) {
+			const auto& direction = rays[n].direction;
+			return (direction.x < 0.f ? 1u : 0u) |
+				   (direction.y < 0.f ? 2u : 0u) |
+				   (direction.z < 0.f ? 4u : 0u);
+		};
+		std::array<std::uint32_t, 9> offsets{};
+		for (auto n = first; n < last; n++)
+		{
+			offsets[octant(n) + 1]++;
+		}
+		for (std::size_t n{1}; n < offsets.size(); n++)
+		{
+			offsets[n] += offsets[n - 1];
+		}
+		std::vector<std::uint32_t> order(last - first);
+		auto cursor = offsets;
+		for (auto n = first; n < last; n++)
+		{
+			order[cursor[octant(n)]++] = static_cast<std::uint32_t>(n);
+		}
+
+		PacketData packet{};
+		DXRRayHit packetHits[DXRRayScene::k_PacketSize]{};
+		for (std::size_t bucket{}; bucket < 8; bucket++)
+		{
+			for (auto begin = offsets[bucket]; begin < offsets[bucket + 1];
+				 begin += DXRRayScene::k_PacketSize)
+			{
+				const auto end = std::min(begin + DXRRayScene::k_PacketSize,
+										  offsets[bucket + 1]);
+				packet.Clear();
+				for (auto n = begin; n < end; n++)
+				{
+					packet.SetRay(n - begin, rays[order[n]]);
+				}
+				chunkHits += static_cast<std::uint32_t>(std::popcount(
+					TracePacket(scene, packet, desc.type, packetHits)));
+				for (auto n = begin; n < end; n++)
+				{
+					hits[order[n]] = packetHits[n - begin];
+				}
+			}
+		}
+		total.fetch_add(chunkHits, std::memory_order_relaxed);
+	};
+	if (jobs)
+	{
+		jobs->ParallelFor(0, count, std::max(desc.grain, 1u), trace);
+	}
+	else
+	{
+		trace(0, count);
+	}
+	return total.load(std::memory_order_relaxed);
+}
+
+auto MakeCameraRay(const glm::mat4& view, const glm::mat4& projection,
+				   const glm::vec2& ndc) -> DXRRay
+{
+	// Back to glm's column major, clip depth is [0, 1] (perspectiveRH_ZO):
+	const auto inverse =
+		glm::inverse(glm::transpose(projection) * glm::transpose(view));
+	const auto unproject = [&](float depth) {
+		const auto point = inverse * glm::vec4{ndc, depth, 1.f};
+		return glm::vec3{point} / point.w;
+	};
+	const auto nearPoint = unproject(0.f);
+	const auto farPoint = unproject(1.f);
+	DXRRay ray{};
+	ray.origin = nearPoint;
+	ray.direction = glm::normalize(farPoint - nearPoint);
+	ray.tMax = glm::length(farPoint - nearPoint);
+	return ray;
+}
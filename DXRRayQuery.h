@@ -0,0 +1,123 @@
+#pragma once
+
+#include "DXRBvh.h"
+
+#include <span>
+#include <vector>
+
+struct DXRJobSystem;
+
+// Which traversal kernels to use, Best picks AVX2 > SSE > scalar at runtime.
+// AVX2 scenes get 8 wide nodes, the others 4 wide:
+enum struct DXRRaySIMD
+{
+	Scalar,
+	SSE,
+	AVX2,
+	Best,
+};
+
+// A node with up to Width children, bounds stored per axis so one load
+// covers all of them. Unused slots have child ~0u and inverted bounds, no ray
+// ever enters them:
+template <std::uint32_t Width>
+struct alignas(32) DXRWideBvhNode
+{
+	// [axis][0 = min, 1 = max][slot]:
+	float bounds[3][2][Width];
+	// Interior child: node index. Leaf child: first entry in
+	// DXRRayScene::triangles:
+	std::uint32_t child[Width];
+	// Triangles of a leaf child, 0 for interior children:
+	std::uint32_t count[Width];
+};
+static_assert(sizeof(DXRWideBvhNode<4>) == 128);
+static_assert(sizeof(DXRWideBvhNode<8>) == 256);
+
+// Triangles are copied in leaf order, a leaf is one contiguous read:
+struct DXRRayTriangle
+{
+	glm::vec3 v0{};
+	// Index / 3 in the source mesh:
+	std::uint32_t triangle{};
+	glm::vec3 v1{};
+	glm::vec3 v2{};
+};
+
+// A DXRBvh collapsed for the CPU ray queries below. Node 0 is the root:
+struct DXRRayScene
+{
+	// Rays TraceRayPacket() takes at once, one per AVX lane:
+	static inline constexpr std::uint32_t k_PacketSize{8};
+
+	// Never Best, the kernels the scene was built for:
+	DXRRaySIMD simd{DXRRaySIMD::Scalar};
+	// Only the one simd uses is filled:
+	std::vector<DXRWideBvhNode<4>> nodes4{};
+	std::vector<DXRWideBvhNode<8>> nodes8{};
+	std::vector<DXRRayTriangle> triangles{};
+	// Around every triangle, what a DXRRayTopLevel places:
+	DXRBvhBounds bounds{};
+};
+
+enum struct DXRRayQueryType
+{
+	// The nearest hit in [tMin, tMax):
+	ClosestHit,
+	// Whichever hit traversal finds first, with t and barycentrics. Cheaper
+	// when any surface along the ray will do:
+	AnyHit,
+	// Whether anything is in [tMin, tMax), only hit.triangle is filled in:
+	Occlusion,
+};
+
+struct DXRRayStreamDesc
+{
+	DXRRayQueryType type{DXRRayQueryType::ClosestHit};
+	// Sort each chunk by direction octant and trace it in packets, otherwise
+	// one ray at a time:
+	bool packets{true};
+	// Rays per job:
+	std::uint32_t grain{1024};
+};
+
+// Best kernels this CPU can run:
+auto GetBestRaySIMD() -> DXRRaySIMD;
+
+// Collapses bvh, built by BuildBvh() over vertices and indices, into wide
+// nodes for simd: every node adopts grandchildren, biggest surface area
+// first, until its slots are full. Returns false if bvh doesn't belong to
+// the mesh:
+auto BuildRayScene(const DXRBvh& bvh, std::span<const DXRVertex3D> vertices,
+				   std::span<const std::uint32_t> indices, DXRRayScene& out,
+				   DXRRaySIMD simd = DXRRaySIMD::Best) -> bool;
+
+// All queries intersect triangles watertight (Woop, Benthin, Wald,
+// "Watertight Ray/Triangle Intersection", 2013): rays through a shared edge
+// or vertex never slip between the triangles, and both sides count.
+
+// One ray, the node's children are tested against it with one SIMD op each
+// axis. Returns whether it hit:
+auto TraceRay(const DXRRayScene& scene, const DXRRay& ray,
+			  DXRRayQueryType type, DXRRayHit& hit) -> bool;
+
+// Up to DXRRayScene::k_PacketSize rays traversed together: every node is
+// fetched once for the packet and a child is tested against all its rays at
+// once. Pays off for coherent rays (camera, shadow rays to one light),
+// incoherent packets visit nodes only some of their rays need.
+// Returns a bit per ray that hit:
+auto TraceRayPacket(const DXRRayScene& scene, std::span<const DXRRay> rays,
+					DXRRayQueryType type, std::span<DXRRayHit> hits)
+	-> std::uint32_t;
+
+// hits[n] for rays[n]. With jobs, chunks of desc.grain rays are traced in
+// parallel and the calling thread helps. Returns how many rays hit:
+auto TraceRays(const DXRRayScene& scene, std::span<const DXRRay> rays,
+			   std::span<DXRRayHit> hits, const DXRRayStreamDesc& desc = {},
+			   DXRJobSystem* jobs = nullptr) -> std::uint32_t;
+
+// The ray under a point on screen, for picking. ndc in [-1, 1] with y up,
+// view and projection as CameraManager keeps them (transposed for HLSL).
+// Starts on the near plane, tMax is the far plane:
+auto MakeCameraRay(const glm::mat4& view, const glm::mat4& projection,
+				   const glm::vec2& ndc) -> DXRRay;
@@ -0,0 +1,237 @@
+#include "DXRRayTopLevel.h"
+#include "DXRJobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+auto GetHalfArea(const glm::vec3& min, const glm::vec3& max) -> float
+{
+	const auto extent = max - min;
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+} // namespace
+
+DXRRayTopLevel::DXRRayTopLevel(const DXRRayTopLevelDesc& desc) : m_desc(desc)
+{
+}
+
+auto DXRRayTopLevel::Update(std::span<const DXRRayScene> meshes,
+							std::span<const DXRInstanceData> instances,
+							std::span<const std::uint32_t> instanceMeshes,
+							DXRJobSystem* jobs) -> DXRRayTopLevelUpdate
+{
+	DXRASSERT(instanceMeshes.empty() ||
+			  instanceMeshes.size() == instances.size());
+	m_meshes = meshes;
+
+	auto rebuild = m_desc.rebuildThreshold <= 0.f ||
+				   m_instances.size() != instances.size() ||
+				   m_bvh.nodes.empty();
+	m_instances.resize(instances.size());
+	m_bounds.resize(instances.size());
+	std::atomic<bool> meshesChanged{};
+	const auto transform = [&](std::size_t first, std::size_t last) {
+		auto changed = false;
+		for (auto n = first; n < last; n++)
+		{
+			const auto mesh = instanceMeshes.empty() ? 0u : instanceMeshes[n];
+			DXRASSERT(mesh < meshes.size());
+			const auto& rows = instances[n].transform;
+			// glm is column major, world = linear * local + translation:
+			const glm::mat3 linear{rows[0][0], rows[1][0], rows[2][0],
+								   rows[0][1], rows[1][1], rows[2][1],
+								   rows[0][2], rows[1][2], rows[2][2]};
+			const glm::vec3 translation{rows[0][3], rows[1][3], rows[2][3]};
+
+			// Arvo, "Transforming Axis-Aligned Bounding Boxes", 1990:
+			const auto& local = meshes[mesh].bounds;
+			const auto center =
+				linear * ((local.min + local.max) * 0.5f) + translation;
+			const auto halfExtent = (local.max - local.min) * 0.5f;
+			glm::vec3 extent{};
+			for (int row{}; row < 3; row++)
+			{
+				for (int column{}; column < 3; column++)
+				{
+					extent[row] +=
+						std::abs(linear[column][row]) * halfExtent[column];
+				}
+			}
+			m_bounds[n] = {center - extent, center + extent};
+
+			auto& instance = m_instances[n];
+			changed |= instance.mesh != mesh;
+			instance.mesh = mesh;
+			const auto inverse = glm::inverse(linear);
+			const auto inverseTranslation = -(inverse * translation);
+			for (int row{}; row < 3; row++)
+			{
+				instance.objectFromWorld[row] = {
+					inverse[0][row], inverse[1][row], inverse[2][row],
+					inverseTranslation[row]};
+			}
+		}
+		if (changed)
+			meshesChanged.store(true, std::memory_order_relaxed);
+	};
+	if (jobs)
+	{
+		jobs->ParallelFor(0, instances.size(), 1024, transform);
+	}
+	else
+	{
+		transform(0, instances.size());
+	}
+	rebuild |= meshesChanged.load(std::memory_order_relaxed);
+
+	if (!rebuild)
+	{
+		// Only the top levels split into jobs, enough for a few per thread:
+		m_parallelDepth =
+			jobs && instances.size() >= m_desc.build.parallelThreshold
+				? static_cast<std::uint32_t>(
+					  std::bit_width(jobs->GetThreadCount())) +
+					  2
+				: 0;
+		const auto cost = Refit(0, 0, jobs);
+		const auto rootArea =
+			GetHalfArea(m_bvh.nodes[0].boundsMin, m_bvh.nodes[0].boundsMax);
+		m_stats.sahCost = rootArea > 0.f ? cost / rootArea : 0.f;
+		m_stats.refits++;
+		if (m_stats.sahCost <=
+			m_stats.rebuildSahCost * m_desc.rebuildThreshold)
+			return DXRRayTopLevelUpdate::Refit;
+	}
+
+	BuildBvh(m_bounds, m_bvh, m_desc.build, jobs);
+	m_stats.sahCost = GetBvhStats(m_bvh, m_desc.build).sahCost;
+	m_stats.rebuildSahCost = m_stats.sahCost;
+	m_stats.rebuilds++;
+	return DXRRayTopLevelUpdate::Rebuild;
+}
+
+auto DXRRayTopLevel::Refit(std::uint32_t index, std::uint32_t depth,
+						   DXRJobSystem* jobs) -> float
+{
+	auto& node = m_bvh.nodes[index];
+	if (node.IsLeaf())
+	{
+		auto min = glm::vec3{std::numeric_limits<float>::max()};
+		auto max = glm::vec3{-std::numeric_limits<float>::max()};
+		for (auto n = node.leftOrFirst; n < node.leftOrFirst + node.count; n++)
+		{
+			const auto& bounds = m_bounds[m_bvh.primitives[n]];
+			min = glm::min(min, bounds.min);
+			max = glm::max(max, bounds.max);
+		}
+		node.boundsMin = min;
+		node.boundsMax = max;
+		return m_desc.build.intersectionCost * static_cast<float>(node.count) *
+			   GetHalfArea(min, max);
+	}
+
+	const auto left = node.leftOrFirst;
+	float leftCost{};
+	float rightCost{};
+	if (depth < m_parallelDepth)
+	{
+		DXRJobCounter counter{};
+		jobs->Run([&] { leftCost = Refit(left, depth + 1, jobs); }, &counter);
+		rightCost = Refit(left + 1, depth + 1, jobs);
+		jobs->Wait(counter);
+	}
+	else
+	{
+		leftCost = Refit(left, depth + 1, jobs);
+		rightCost = Refit(left + 1, depth + 1, jobs);
+	}
+	const auto& leftNode = m_bvh.nodes[left];
+	const auto& rightNode = m_bvh.nodes[left + 1];
+	node.boundsMin = glm::min(leftNode.boundsMin, rightNode.boundsMin);
+	node.boundsMax = glm::max(leftNode.boundsMax, rightNode.boundsMax);
+	return m_desc.build.traversalCost *
+			   GetHalfArea(node.boundsMin, node.boundsMax) +
+		   leftCost + rightCost;
+}
+
+auto DXRRayTopLevel::TraceRay(const DXRRay& ray, DXRRayQueryType type,
+							  DXRRayHit& hit) const -> bool
+{
+	hit = {};
+	if (m_bvh.nodes.empty())
+		return false;
+	glm::vec3 inverseDirection{};
+	for (int axis{}; axis < 3; axis++)
+	{
+		auto d = ray.direction[axis];
+		if (std::abs(d) < 1e-20f)
+			d = std::copysign(1e-20f, d);
+		inverseDirection[axis] = 1.f / d;
+	}
+	// Same slack on box exits as the bottom levels:
+	TraverseBvh(
+		m_bvh, ray.origin, inverseDirection, ray.tMin, ray.tMax,
+		DXRBvh::k_RobustExitScale,
+		[&](const DXRBvhNode& leaf, float& closest) {
+			for (auto n = leaf.leftOrFirst; n < leaf.leftOrFirst + leaf.count;
+				 n++)
+			{
+				const auto instanceIndex = m_bvh.primitives[n];
+				const auto& instance = m_instances[instanceIndex];
+				const auto& rows = instance.objectFromWorld;
+				DXRRay objectRay{};
+				for (int row{}; row < 3; row++)
+				{
+					const glm::vec3 linear{rows[row]};
+					objectRay.origin[row] =
+						glm::dot(linear, ray.origin) + rows[row].w;
+					objectRay.direction[row] = glm::dot(linear, ray.direction);
+				}
+				objectRay.tMin = ray.tMin;
+				objectRay.tMax = closest;
+				DXRRayHit candidate{};
+				if (!::TraceRay(m_meshes[instance.mesh], objectRay, type,
+								candidate))
+					continue;
+				hit = candidate;
+				hit.instance = instanceIndex;
+				if (type != DXRRayQueryType::ClosestHit)
+					return true;
+				closest = candidate.t;
+			}
+			return false;
+		});
+	return hit.triangle != ~0u;
+}
+
+auto DXRRayTopLevel::TraceRays(std::span<const DXRRay> rays,
+							   std::span<DXRRayHit> hits,
+							   const DXRRayStreamDesc& desc,
+							   DXRJobSystem* jobs) const -> std::uint32_t
+{
+	const auto count = std::min(rays.size(), hits.size());
+	std::atomic<std::uint32_t> total{};
+	const auto trace = [&](std::size_t first, std::size_t last) {
+		std::uint32_t chunkHits{};
+		for (auto n = first; n < last; n++)
+		{
+			chunkHits += TraceRay(rays[n], desc.type, hits[n]);
+		}
+		total.fetch_add(chunkHits, std::memory_order_relaxed);
+	};
+	if (jobs)
+	{
+		jobs->ParallelFor(0, count, std::max(desc.grain, 1u), trace);
+	}
+	else
+	{
+		trace(0, count);
+	}
+	return total.load(std::memory_order_relaxed);
+}
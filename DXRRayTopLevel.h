@@ -0,0 +1,115 @@
+#pragma once
+
+#include "DXRRayQuery.h"
+
+#include <span>
+#include <vector>
+
+struct DXRRayTopLevelDesc
+{
+	// A top level leaf costs a bottom level traversal per instance, small
+	// leaves pay off:
+	DXRBvhBuildDesc build{.maxLeafSize = 2, .intersectionCost = 4.f};
+	// Refit while the tree's SAH cost stays below this multiple of its cost
+	// right after the last rebuild, rebuild once it gets past. 0 rebuilds on
+	// every update, infinity only refits:
+	float rebuildThreshold{1.3f};
+};
+
+enum struct DXRRayTopLevelUpdate
+{
+	Rebuild,
+	Refit,
+};
+
+struct DXRRayTopLevelStats
+{
+	std::uint32_t rebuilds{};
+	std::uint32_t refits{};
+	// Of the tree as it is now, and right after the last rebuild
+	// (DXRBvhStats::sahCost):
+	float sahCost{};
+	float rebuildSahCost{};
+};
+
+// Two level acceleration structure for the CPU ray queries, the same split
+// as DXR's: bottom levels are DXRRayScenes, one per mesh and built once, the
+// top level is a BVH over the world bounds of their instances.
+// Update() runs every frame with the new transforms. Moving instances only
+// need the top level's bounds refitted, which keeps the topology and is
+// linear in the node count; the tree gets worse as instances wander away
+// from their neighbours though, so once its measured SAH cost has degraded
+// too far it is rebuilt instead.
+struct DXRRayTopLevel : DXRNonCopyable
+{
+	DXRRayTopLevel(const DXRRayTopLevelDesc& desc = {});
+
+	// instances[n] places meshes[instanceMeshes[n]], or meshes[0] for all of
+	// them if instanceMeshes is empty. meshes have to stay alive until the
+	// next Update(). Rebuilds when the instances changed in number or mesh,
+	// otherwise refits and decides by the result. With jobs the transforms,
+	// refit and rebuild run on the job threads:
+	auto Update(std::span<const DXRRayScene> meshes,
+				std::span<const DXRInstanceData> instances,
+				std::span<const std::uint32_t> instanceMeshes = {},
+				DXRJobSystem* jobs = nullptr) -> DXRRayTopLevelUpdate;
+
+	inline auto GetStats() const -> const DXRRayTopLevelStats&
+	{
+		return m_stats;
+	}
+
+	// Leaves hold instance numbers:
+	inline auto GetBvh() const -> const DXRBvh&
+	{
+		return m_bvh;
+	}
+
+	// What instance places as of the last Update(), the mesh and its world to
+	// object transform (rows of a 3x4 affine), for turning hits into surface
+	// attributes:
+	inline auto GetInstanceMesh(std::uint32_t instance) const -> std::uint32_t
+	{
+		return m_instances[instance].mesh;
+	}
+
+	inline auto GetObjectFromWorld(std::uint32_t instance) const
+		-> std::span<const glm::vec4, 3>
+	{
+		return m_instances[instance].objectFromWorld;
+	}
+
+	// Like the DXRRayScene queries, ray in world space. hit.instance is the
+	// instance, hit.triangle the triangle of its mesh. t is the same in world
+	// and object space, rays are transformed without normalizing:
+	auto TraceRay(const DXRRay& ray, DXRRayQueryType type,
+				  DXRRayHit& hit) const -> bool;
+
+	// One ray at a time (desc.packets doesn't apply), chunks of desc.grain
+	// rays in parallel with jobs. Returns how many rays hit:
+	auto TraceRays(std::span<const DXRRay> rays, std::span<DXRRayHit> hits,
+				   const DXRRayStreamDesc& desc = {},
+				   DXRJobSystem* jobs = nullptr) const -> std::uint32_t;
+
+  private:
+	// World to object space, rows of a 3x4 affine transform:
+	struct Instance
+	{
+		glm::vec4 objectFromWorld[3]{};
+		std::uint32_t mesh{};
+	};
+
+	// Returns the subtree's SAH cost, not yet divided by the root's area:
+	auto Refit(std::uint32_t node, std::uint32_t depth, DXRJobSystem* jobs)
+		-> float;
+
+	DXRRayTopLevelDesc m_desc{};
+	std::span<const DXRRayScene> m_meshes{};
+	std::vector<Instance> m_instances{};
+	// World bounds of the instances, what the leaves are refitted to:
+	std::vector<DXRBvhBounds> m_bounds{};
+	DXRBvh m_bvh{};
+	// Refits below this depth run their children as separate jobs:
+	std::uint32_t m_parallelDepth{};
+	DXRRayTopLevelStats m_stats{};
+};
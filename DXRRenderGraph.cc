@@ -0,0 +1,573 @@
+#include "DXRRenderGraph.h"
+
+#include <algorithm>
+#include <bit>
+#include <string>
+#include <utility>
+
+namespace
+{
+constexpr std::uint32_t k_NoPass{~0u};
+
+constexpr auto k_ReadOnlyStates =
+	static_cast<std::uint32_t>(DXRResourceState::VertexAndConstantBuffer |
+							   DXRResourceState::IndexBuffer |
+							   DXRResourceState::DepthRead |
+							   DXRResourceState::NonPixelShaderResource |
+							   DXRResourceState::PixelShaderResource |
+							   DXRResourceState::IndirectArgument |
+							   DXRResourceState::CopySource);
+
+constexpr std::pair<DXRResourceState, const char*> k_StateNames[]{
+	{DXRResourceState::VertexAndConstantBuffer, "VertexAndConstantBuffer"},
+	{DXRResourceState::IndexBuffer, "IndexBuffer"},
+	{DXRResourceState::RenderTarget, "RenderTarget"},
+	{DXRResourceState::UnorderedAccess, "UnorderedAccess"},
+	{DXRResourceState::DepthWrite, "DepthWrite"},
+	{DXRResourceState::DepthRead, "DepthRead"},
+	{DXRResourceState::NonPixelShaderResource, "NonPixelShaderResource"},
+	{DXRResourceState::PixelShaderResource, "PixelShaderResource"},
+	{DXRResourceState::IndirectArgument, "IndirectArgument"},
+	{DXRResourceState::CopyDest, "CopyDest"},
+	{DXRResourceState::CopySource, "CopySource"},
+};
+
+auto ToBits(DXRResourceState state) -> std::uint32_t
+{
+	return static_cast<std::uint32_t>(state);
+}
+
+auto AlignUp(std::uint64_t value, std::uint64_t alignment) -> std::uint64_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Reads that don't need a barrier after the current state:
+auto Contains(DXRResourceState current, DXRResourceState wanted) -> bool
+{
+	return IsReadOnlyState(current) && IsReadOnlyState(wanted) &&
+		   (ToBits(current) & ToBits(wanted)) == ToBits(wanted);
+}
+} // namespace
+
+auto IsReadOnlyState(DXRResourceState state) -> bool
+{
+	const auto bits = ToBits(state);
+	return bits && !(bits & ~k_ReadOnlyStates);
+}
+
+auto GetResourceStateName(DXRResourceState state) -> std::string
+{
+	if (!ToBits(state))
+		return "Common";
+	std::string name{};
+	for (const auto& [bit, bitName] : k_StateNames)
+	{
+		if (!(ToBits(state) & ToBits(bit)))
+			continue;
+		if (!name.empty())
+			name += '|';
+		name += bitName;
+	}
+	return name;
+}
+
+auto DXRRenderGraphPlan::GetBatchCount() const -> std::uint32_t
+{
+	std::uint32_t count{finalBarrierCount ? 1u : 0u};
+	for (const auto& pass : passes)
+	{
+		count += pass.barrierCount ? 1 : 0;
+	}
+	return count;
+}
+
+auto DXRRenderGraph::Reset() -> void
+{
+	m_resources.clear();
+	m_passes.clear();
+}
+
+auto DXRRenderGraph::Import(std::string_view name,
+							DXRResourceState initialState,
+							DXRResourceState finalState)
+	-> DXRRenderGraphResource
+{
+	m_resources.push_back({std::string{name}, 0, 0, initialState, finalState,
+						   true});
+	return {GetResourceCount() - 1};
+}
+
+auto DXRRenderGraph::CreateTransient(std::string_view name, std::uint64_t size,
+									 std::uint64_t alignment)
+	-> DXRRenderGraphResource
+{
+	DXRASSERT(alignment && !(alignment & (alignment - 1)));
+	m_resources.push_back({std::string{name}, size, alignment,
+						   DXRResourceState::Common, DXRResourceState::Common,
+						   false});
+	return {GetResourceCount() - 1};
+}
+
+auto DXRRenderGraph::AddPass(std::string_view name, bool sideEffects)
+	-> DXRRenderGraphPass
+{
+	m_passes.push_back({std::string{name}, sideEffects, {}});
+	return {GetPassCount() - 1};
+}
+
+auto DXRRenderGraph::Read(DXRRenderGraphPass pass,
+						  DXRRenderGraphResource resource,
+						  DXRResourceState state) -> void
+{
+	AddAccess(pass, resource, state, false);
+}
+
+auto DXRRenderGraph::Write(DXRRenderGraphPass pass,
+						   DXRRenderGraphResource resource,
+						   DXRResourceState state) -> void
+{
+	AddAccess(pass, resource, state, true);
+}
+
+auto DXRRenderGraph::AddAccess(DXRRenderGraphPass pass,
+							   DXRRenderGraphResource resource,
+							   DXRResourceState state, bool write) -> void
+{
+	DXRASSERT(pass.index < GetPassCount());
+	DXRASSERT(resource.index < GetResourceCount());
+	m_passes[pass.index].accesses.push_back(
+		{resource.index, state, !write, write});
+}
+
+auto DXRRenderGraph::GetResourceName(DXRRenderGraphResource resource) const
+	-> std::string_view
+{
+	return resource.IsValid() ? std::string_view{m_resources[resource.index].name}
+							  : std::string_view{"*"};
+}
+
+auto DXRRenderGraph::GetPassName(DXRRenderGraphPass pass) const
+	-> std::string_view
+{
+	return m_passes[pass.index].name;
+}
+
+auto DXRRenderGraph::Compile(DXRRenderGraphPlan& plan) -> bool
+{
+	plan.passes.clear();
+	plan.barriers.clear();
+	plan.finalBarrierBegin = 0;
+	plan.finalBarrierCount = 0;
+	plan.allocations.assign(m_resources.size(), {});
+	plan.heapSize = 0;
+	plan.unaliasedSize = 0;
+	plan.culledPasses = 0;
+
+	if (!MergeAccesses())
+		return false;
+	CullPasses();
+	plan.culledPasses = GetPassCount() - static_cast<std::uint32_t>(m_alive.size());
+
+	// Per resource, what the surviving passes do with it:
+	m_uses.resize(m_resources.size());
+	for (auto& uses : m_uses)
+	{
+		uses.clear();
+	}
+	for (std::uint32_t i{}; i < m_alive.size(); i++)
+	{
+		for (const auto& access : m_passes[m_alive[i]].accesses)
+		{
+			m_uses[access.resource].push_back({i, access.state, access.write});
+		}
+	}
+
+	m_pending.clear();
+	PlaceTransients(plan);
+	BuildBarriers(plan);
+	SortBarriers(plan);
+	return true;
+}
+
+auto DXRRenderGraph::MergeAccesses() -> bool
+{
+	// One access per resource and pass, with everything the pass does to it:
+	for (auto& pass : m_passes)
+	{
+		auto& accesses = pass.accesses;
+		std::sort(accesses.begin(), accesses.end(),
+				  [](const Access& a, const Access& b) {
+					  return a.resource < b.resource;
+				  });
+		std::size_t count{};
+		for (std::size_t i{}; i < accesses.size(); i++)
+		{
+			if (count && accesses[count - 1].resource == accesses[i].resource)
+			{
+				auto& merged = accesses[count - 1];
+				if ((merged.write || accesses[i].write) &&
+					merged.state != accesses[i].state)
+					return false;
+				merged.state = merged.state | accesses[i].state;
+				merged.read |= accesses[i].read;
+				merged.write |= accesses[i].write;
+			}
+			else
+			{
+				accesses[count++] = accesses[i];
+			}
+
+			// Writes need their one write state, reads can't mix a write
+			// state with others:
+			const auto& merged = accesses[count - 1];
+			if (merged.write && IsReadOnlyState(merged.state))
+				return false;
+			if (!IsReadOnlyState(merged.state) &&
+				std::popcount(ToBits(merged.state)) > 1)
+				return false;
+		}
+		accesses.resize(count);
+	}
+	return true;
+}
+
+auto DXRRenderGraph::CullPasses() -> void
+{
+	// Whether the content a resource has at this point is still read later:
+	m_needed.assign(m_resources.size(), 0);
+	for (std::size_t i{}; i < m_resources.size(); i++)
+	{
+		m_needed[i] = m_resources[i].imported;
+	}
+
+	m_alive.clear();
+	for (auto i = GetPassCount(); i-- > 0;)
+	{
+		const auto& pass = m_passes[i];
+		auto alive = pass.sideEffects;
+		for (const auto& access : pass.accesses)
+		{
+			alive |= access.write && m_needed[access.resource];
+		}
+		if (!alive)
+			continue;
+
+		// Overwritten content isn't needed before this pass, read content is:
+		for (const auto& access : pass.accesses)
+		{
+			if (access.write && !access.read)
+				m_needed[access.resource] = 0;
+		}
+		for (const auto& access : pass.accesses)
+		{
+			if (access.read)
+				m_needed[access.resource] = 1;
+		}
+		m_alive.push_back(i);
+	}
+	std::reverse(m_alive.begin(), m_alive.end());
+}
+
+auto DXRRenderGraph::PlaceTransients(DXRRenderGraphPlan& plan) -> void
+{
+	m_placementOrder.clear();
+	for (std::uint32_t i{}; i < m_resources.size(); i++)
+	{
+		const auto& resource = m_resources[i];
+		const auto& uses = m_uses[i];
+		if (resource.imported || uses.empty())
+			continue;
+		auto& allocation = plan.allocations[i];
+		allocation.size = resource.size;
+		allocation.firstPass = uses.front().pass;
+		allocation.lastPass = uses.back().pass;
+		plan.unaliasedSize =
+			AlignUp(plan.unaliasedSize, resource.alignment) + resource.size;
+		m_placementOrder.push_back(i);
+	}
+
+	if (m_placementOrder.empty())
+		return;
+	if (!m_desc.aliasTransients)
+	{
+		for (const auto i : m_placementOrder)
+		{
+			auto& allocation = plan.allocations[i];
+			allocation.offset =
+				AlignUp(plan.heapSize, m_resources[i].alignment);
+			plan.heapSize = allocation.offset + allocation.size;
+		}
+		return;
+	}
+
+	// Biggest first packs tightest, ties in use order keep it stable:
+	std::sort(m_placementOrder.begin(), m_placementOrder.end(),
+			  [&](std::uint32_t a, std::uint32_t b) {
+				  const auto& x = plan.allocations[a];
+				  const auto& y = plan.allocations[b];
+				  if (x.size != y.size)
+					  return x.size > y.size;
+				  return x.firstPass < y.firstPass;
+			  });
+
+	// First fit: of what is already placed and alive at the same time, walk
+	// by offset and skip past everything in the way:
+	m_placed.clear();
+	m_placedFirst.clear();
+	m_placedLast.clear();
+	for (const auto i : m_placementOrder)
+	{
+		auto& allocation = plan.allocations[i];
+		const auto alignment = m_resources[i].alignment;
+
+		m_overlapping.resize(m_placed.size());
+		std::size_t count{};
+		for (std::uint32_t n{}; n < m_placed.size(); n++)
+		{
+			m_overlapping[count] = n;
+			count += m_placedFirst[n] <= allocation.lastPass &&
+					 allocation.firstPass <= m_placedLast[n];
+		}
+		m_overlapping.resize(count);
+		std::sort(m_overlapping.begin(), m_overlapping.end(),
+				  [&](std::uint32_t a, std::uint32_t b) {
+					  return m_placed[a].offset < m_placed[b].offset;
+				  });
+
+		std::uint64_t offset{};
+		for (const auto n : m_overlapping)
+		{
+			const auto& other = m_placed[n];
+			if (other.offset >= offset + allocation.size)
+				break;
+			if (other.end > offset)
+				offset = AlignUp(other.end, alignment);
+		}
+		allocation.offset = offset;
+		plan.heapSize = std::max(plan.heapSize, offset + allocation.size);
+		m_placed.push_back({offset, offset + allocation.size,
+							allocation.firstPass, allocation.lastPass, i});
+		m_placedFirst.push_back(allocation.firstPass);
+		m_placedLast.push_back(allocation.lastPass);
+	}
+	std::sort(m_placed.begin(), m_placed.end(),
+			  [](const Placed& a, const Placed& b) {
+				  return a.offset < b.offset;
+			  });
+
+	// Reused memory gets an aliasing barrier, naming the resource that had it
+	// before if there is exactly one:
+	const auto biggest = plan.allocations[m_placementOrder.front()].size;
+	for (const auto& placed : m_placed)
+	{
+		std::uint32_t before{};
+		std::uint32_t candidates{};
+		// Nothing that starts more than the biggest size below can reach:
+		const auto first = std::lower_bound(
+			m_placed.begin(), m_placed.end(),
+			placed.offset > biggest ? placed.offset - biggest : 0,
+			[](const Placed& other, std::uint64_t value) {
+				return other.offset < value;
+			});
+		for (auto other = first; other != m_placed.end(); other++)
+		{
+			if (other->offset >= placed.end)
+				break;
+			if (other->end <= placed.offset ||
+				other->lastPass >= placed.firstPass)
+				continue;
+			before = other->resource;
+			// Two are as good as any:
+			if (++candidates > 1)
+				break;
+		}
+		if (!candidates)
+			continue;
+
+		plan.allocations[placed.resource].aliased = true;
+		DXRRenderGraphBarrier barrier{};
+		barrier.type = DXRRenderGraphBarrierType::Aliasing;
+		barrier.resource = {placed.resource};
+		if (candidates == 1)
+			barrier.before = {before};
+		m_pending.push_back({placed.firstPass, barrier});
+	}
+}
+
+auto DXRRenderGraph::BuildBarriers(DXRRenderGraphPlan& plan) -> void
+{
+	const auto passCount = static_cast<std::uint32_t>(m_alive.size());
+	for (std::uint32_t r{}; r < m_resources.size(); r++)
+	{
+		const auto& resource = m_resources[r];
+		const auto& uses = m_uses[r];
+		if (!resource.imported && uses.empty())
+			continue;
+
+		auto current = resource.initialState;
+		std::uint32_t lastUse{k_NoPass};
+		bool lastWrite{};
+		for (std::size_t i{}; i < uses.size();)
+		{
+			// A run of plain reads becomes one segment in the combined state:
+			auto state = uses[i].state;
+			auto end = i + 1;
+			if (!uses[i].write && IsReadOnlyState(state))
+			{
+				while (end < uses.size() && !uses[end].write &&
+					   IsReadOnlyState(uses[end].state))
+				{
+					state = state | uses[end].state;
+					end++;
+				}
+			}
+			const auto nextUse = uses[i].pass;
+
+			if (!resource.imported && !i)
+			{
+				// Created in the state it is first used in:
+				plan.allocations[r].initialState = state;
+				current = state;
+			}
+			else if (state != current && !Contains(current, state))
+			{
+				AddTransition(r, current, state, lastUse, nextUse);
+				current = state;
+			}
+			else if (state == DXRResourceState::UnorderedAccess &&
+					 (lastWrite || uses[i].write))
+			{
+				DXRRenderGraphBarrier barrier{};
+				barrier.type = DXRRenderGraphBarrierType::UAV;
+				barrier.resource = {r};
+				m_pending.push_back({nextUse, barrier});
+			}
+
+			lastWrite = uses[i].write;
+			lastUse = uses[end - 1].pass;
+			i = end;
+		}
+
+		if (resource.imported && current != resource.finalState)
+			AddTransition(r, current, resource.finalState, lastUse, passCount);
+	}
+}
+
+auto DXRRenderGraph::AddTransition(std::uint32_t resource,
+								   DXRResourceState before,
+								   DXRResourceState after,
+								   std::uint32_t lastUse, std::uint32_t nextUse)
+	-> void
+{
+	DXRRenderGraphBarrier barrier{};
+	barrier.type = DXRRenderGraphBarrierType::Transition;
+	barrier.resource = {resource};
+	barrier.stateBefore = before;
+	barrier.stateAfter = after;
+
+	const auto begin = lastUse == k_NoPass ? 0 : lastUse + 1;
+	if (m_desc.splitBarriers && begin < nextUse)
+	{
+		barrier.split = DXRRenderGraphBarrierSplit::Begin;
+		m_pending.push_back({begin, barrier});
+		barrier.split = DXRRenderGraphBarrierSplit::End;
+	}
+	m_pending.push_back({nextUse, barrier});
+}
+
+auto DXRRenderGraph::SortBarriers(DXRRenderGraphPlan& plan) -> void
+{
+	// Counting sort by pass, stable so aliasing barriers (added first) stay
+	// ahead of the rest of their batch:
+	const auto passCount = static_cast<std::uint32_t>(m_alive.size());
+	m_batchStarts.assign(passCount + 2, 0);
+	for (const auto& pending : m_pending)
+	{
+		m_batchStarts[pending.pass + 1]++;
+	}
+	for (std::uint32_t i{}; i <= passCount; i++)
+	{
+		m_batchStarts[i + 1] += m_batchStarts[i];
+	}
+
+	plan.passes.resize(passCount);
+	for (std::uint32_t i{}; i < passCount; i++)
+	{
+		plan.passes[i] = {{m_alive[i]},
+						  m_batchStarts[i],
+						  m_batchStarts[i + 1] - m_batchStarts[i]};
+	}
+	plan.finalBarrierBegin = m_batchStarts[passCount];
+	plan.finalBarrierCount =
+		m_batchStarts[passCount + 1] - m_batchStarts[passCount];
+
+	plan.barriers.resize(m_pending.size());
+	for (const auto& pending : m_pending)
+	{
+		plan.barriers[m_batchStarts[pending.pass]++] = pending.barrier;
+	}
+}
+
+auto DumpRenderGraphPlan(const DXRRenderGraph& graph,
+						 const DXRRenderGraphPlan& plan) -> std::string
+{
+	std::string out{};
+	const auto dumpBarriers = [&](std::uint32_t begin, std::uint32_t count) {
+		for (auto i = begin; i < begin + count; i++)
+		{
+			const auto& barrier = plan.barriers[i];
+			const auto name = std::string{graph.GetResourceName(barrier.resource)};
+			switch (barrier.type)
+			{
+			case DXRRenderGraphBarrierType::Aliasing:
+				out += "  aliasing ";
+				out += graph.GetResourceName(barrier.before);
+				out += " -> " + name + "\n";
+				break;
+			case DXRRenderGraphBarrierType::Transition:
+				out += "  transition " + name + " " +
+					   GetResourceStateName(barrier.stateBefore) + " -> " +
+					   GetResourceStateName(barrier.stateAfter);
+				if (barrier.split == DXRRenderGraphBarrierSplit::Begin)
+					out += " begin";
+				else if (barrier.split == DXRRenderGraphBarrierSplit::End)
+					out += " end";
+				out += "\n";
+				break;
+			case DXRRenderGraphBarrierType::UAV:
+				out += "  uav " + name + "\n";
+				break;
+			}
+		}
+	};
+
+	for (const auto& pass : plan.passes)
+	{
+		out += "pass ";
+		out += graph.GetPassName(pass.pass);
+		out += "\n";
+		dumpBarriers(pass.barrierBegin, pass.barrierCount);
+	}
+	out += "final\n";
+	dumpBarriers(plan.finalBarrierBegin, plan.finalBarrierCount);
+
+	for (std::uint32_t i{}; i < plan.allocations.size(); i++)
+	{
+		const auto& allocation = plan.allocations[i];
+		if (!allocation.IsAllocated())
+			continue;
+		out += "transient ";
+		out += graph.GetResourceName({i});
+		out += " offset " + std::to_string(allocation.offset) + " size " +
+			   std::to_string(allocation.size) + " passes " +
+			   std::to_string(allocation.firstPass) + "-" +
+			   std::to_string(allocation.lastPass) + " " +
+			   GetResourceStateName(allocation.initialState) +
+			   (allocation.aliased ? " aliased\n" : "\n");
+	}
+	out += "heap " + std::to_string(plan.heapSize) + " unaliased " +
+		   std::to_string(plan.unaliasedSize) + " culled " +
+		   std::to_string(plan.culledPasses) + "\n";
+	return out;
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Resource states, the values are D3D12_RESOURCE_STATES' so the renderer can
+// cast them. Read states combine, write states stand alone:
+enum struct DXRResourceState : std::uint32_t
+{
+	Common = 0,
+	// Same as Common, like in D3D12:
+	Present = 0,
+	VertexAndConstantBuffer = 0x1,
+	IndexBuffer = 0x2,
+	RenderTarget = 0x4,
+	UnorderedAccess = 0x8,
+	DepthWrite = 0x10,
+	DepthRead = 0x20,
+	NonPixelShaderResource = 0x40,
+	PixelShaderResource = 0x80,
+	IndirectArgument = 0x200,
+	CopyDest = 0x400,
+	CopySource = 0x800,
+};
+
+inline constexpr auto operator|(DXRResourceState a, DXRResourceState b)
+	-> DXRResourceState
+{
+	return static_cast<DXRResourceState>(static_cast<std::uint32_t>(a) |
+										 static_cast<std::uint32_t>(b));
+}
+
+// True for non-empty combinations of read states only:
+auto IsReadOnlyState(DXRResourceState state) -> bool;
+
+// "PixelShaderResource|NonPixelShaderResource":
+auto GetResourceStateName(DXRResourceState state) -> std::string;
+
+struct DXRRenderGraphResource
+{
+	std::uint32_t index{~0u};
+
+	inline auto IsValid() const -> bool
+	{
+		return index != ~0u;
+	}
+};
+
+struct DXRRenderGraphPass
+{
+	std::uint32_t index{~0u};
+};
+
+enum struct DXRRenderGraphBarrierType : std::uint8_t
+{
+	// Memory of `before` (or any resource if it is invalid) becomes
+	// `resource`'s:
+	Aliasing,
+	Transition,
+	// UnorderedAccess writes finish before the next access:
+	UAV,
+};
+
+// D3D12's split barriers: Begin right after the last use, End right before
+// the next one, the GPU can transition in between:
+enum struct DXRRenderGraphBarrierSplit : std::uint8_t
+{
+	None,
+	Begin,
+	End,
+};
+
+struct DXRRenderGraphBarrier
+{
+	DXRRenderGraphBarrierType type{};
+	DXRRenderGraphBarrierSplit split{};
+	DXRRenderGraphResource resource{};
+	// Aliasing only:
+	DXRRenderGraphResource before{};
+	// Transition only:
+	DXRResourceState stateBefore{};
+	DXRResourceState stateAfter{};
+};
+
+// Where a transient resource lives in the shared heap. Passes are indices
+// into DXRRenderGraphPlan::passes:
+struct DXRRenderGraphAllocation
+{
+	std::uint64_t offset{};
+	std::uint64_t size{};
+	std::uint32_t firstPass{~0u};
+	std::uint32_t lastPass{};
+	// Create it in this state, the first use needs no transition:
+	DXRResourceState initialState{};
+	// Shares memory with a resource used before it, so its content is garbage
+	// and the first pass has to write all of it (clear, discard or copy):
+	bool aliased{};
+
+	inline auto IsAllocated() const -> bool
+	{
+		return firstPass != ~0u;
+	}
+};
+
+// One pass that survived culling and the barriers to record before it:
+struct DXRRenderGraphCompiledPass
+{
+	DXRRenderGraphPass pass{};
+	std::uint32_t barrierBegin{};
+	std::uint32_t barrierCount{};
+};
+
+// What Compile() produces: passes in execution order, each with one batch
+// of barriers (one ResourceBarrier() call), a last batch that brings
+// imported resources into their final state, and the transient heap layout.
+struct DXRRenderGraphPlan
+{
+	std::vector<DXRRenderGraphCompiledPass> passes{};
+	std::vector<DXRRenderGraphBarrier> barriers{};
+	std::uint32_t finalBarrierBegin{};
+	std::uint32_t finalBarrierCount{};
+	// One per resource, unallocated for imported and unused ones:
+	std::vector<DXRRenderGraphAllocation> allocations{};
+	std::uint64_t heapSize{};
+	// What the transient resources would take without aliasing:
+	std::uint64_t unaliasedSize{};
+	std::uint32_t culledPasses{};
+
+	// Non-empty barrier batches, ResourceBarrier() calls the plan takes:
+	auto GetBatchCount() const -> std::uint32_t;
+};
+
+struct DXRRenderGraphDesc
+{
+	// Begin/End pairs when a resource sits idle between two passes:
+	bool splitBarriers{};
+	// Off gives every transient resource its own memory:
+	bool aliasTransients{true};
+};
+
+// Frame graph: passes declare which resources they read and write in which
+// state, Compile() works out the rest without touching a GPU API:
+//   1. Culling: walking back from the last pass, a pass survives if it has
+//      side effects or writes something a surviving later pass reads (or an
+//      output resource). A pass that reads and writes the same resource
+//      (e.g. blending into a render target) declares both.
+//   2. Barriers: consecutive reads are merged into one combined read state,
+//      so a resource read by several passes is transitioned once. A read
+//      state already contained in the current one needs no barrier,
+//      UnorderedAccess after UnorderedAccess gets a UAV barrier. All
+//      barriers before a pass go out in one batch.
+//   3. Aliasing: transient resources live from their first to their last
+//      surviving use. Biggest first, each goes to the lowest offset of the
+//      heap not used by a resource alive at the same time; the first use of
+//      reused memory gets an aliasing barrier.
+// Record passes in execution order. Handles stay valid until Reset().
+struct DXRRenderGraph
+{
+	inline DXRRenderGraph(const DXRRenderGraphDesc& desc = {}) : m_desc(desc)
+	{
+	}
+
+	// Starts a new graph:
+	auto Reset() -> void;
+
+	// Lives outside the graph (swap chain buffers, persistent textures). It
+	// is in initialState before the first pass and gets transitioned to
+	// finalState after the last one. Imported resources count as outputs,
+	// passes writing them are never culled:
+	auto Import(std::string_view name, DXRResourceState initialState,
+				DXRResourceState finalState) -> DXRRenderGraphResource;
+
+	// Only exists while passes use it, memory comes from the transient heap.
+	// alignment has to be a power of two:
+	auto CreateTransient(std::string_view name, std::uint64_t size,
+						 std::uint64_t alignment = 65536)
+		-> DXRRenderGraphResource;
+
+	// sideEffects passes are never culled (present, readbacks...):
+	auto AddPass(std::string_view name, bool sideEffects = false)
+		-> DXRRenderGraphPass;
+
+	auto Read(DXRRenderGraphPass pass, DXRRenderGraphResource resource,
+			  DXRResourceState state) -> void;
+	auto Write(DXRRenderGraphPass pass, DXRRenderGraphResource resource,
+			   DXRResourceState state) -> void;
+
+	// Returns false if a pass needs a resource in two states at once (a
+	// write state and anything else):
+	auto Compile(DXRRenderGraphPlan& plan) -> bool;
+
+	auto GetResourceName(DXRRenderGraphResource resource) const
+		-> std::string_view;
+	auto GetPassName(DXRRenderGraphPass pass) const -> std::string_view;
+
+	inline auto GetResourceCount() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_resources.size());
+	}
+
+	inline auto GetPassCount() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_passes.size());
+	}
+
+  private:
+	struct Resource
+	{
+		std::string name{};
+		std::uint64_t size{};
+		std::uint64_t alignment{};
+		DXRResourceState initialState{};
+		DXRResourceState finalState{};
+		bool imported{};
+	};
+
+	struct Access
+	{
+		std::uint32_t resource{};
+		DXRResourceState state{};
+		bool read{};
+		bool write{};
+	};
+
+	struct Pass
+	{
+		std::string name{};
+		bool sideEffects{};
+		std::vector<Access> accesses{};
+	};
+
+	// A surviving pass's access, what the barrier pass walks per resource:
+	struct Use
+	{
+		std::uint32_t pass{};
+		DXRResourceState state{};
+		bool write{};
+	};
+
+	auto AddAccess(DXRRenderGraphPass pass, DXRRenderGraphResource resource,
+				   DXRResourceState state, bool write) -> void;
+	auto MergeAccesses() -> bool;
+	auto CullPasses() -> void;
+	auto PlaceTransients(DXRRenderGraphPlan& plan) -> void;
+	auto BuildBarriers(DXRRenderGraphPlan& plan) -> void;
+	auto AddTransition(std::uint32_t resource, DXRResourceState before,
+					   DXRResourceState after, std::uint32_t lastUse,
+					   std::uint32_t nextUse) -> void;
+	auto SortBarriers(DXRRenderGraphPlan& plan) -> void;
+
+	DXRRenderGraphDesc m_desc{};
+	std::vector<Resource> m_resources{};
+	std::vector<Pass> m_passes{};
+
+	// Compile() scratch, kept between frames:
+	std::vector<std::vector<Use>> m_uses{};
+	std::vector<std::uint8_t> m_needed{};
+	// Surviving passes in execution order:
+	std::vector<std::uint32_t> m_alive{};
+	// Transient resources by placement order, and the placed ones (copies of
+	// their allocations). Lifetimes are kept apart so finding the ones alive
+	// at the same time is a tight loop:
+	struct Placed
+	{
+		std::uint64_t offset{};
+		std::uint64_t end{};
+		std::uint32_t firstPass{};
+		std::uint32_t lastPass{};
+		std::uint32_t resource{};
+	};
+	std::vector<std::uint32_t> m_placementOrder{};
+	std::vector<Placed> m_placed{};
+	std::vector<std::uint32_t> m_placedFirst{};
+	std::vector<std::uint32_t> m_placedLast{};
+	std::vector<std::uint32_t> m_overlapping{};
+	// Barriers with the plan pass they go before, sorted at the end:
+	struct PendingBarrier
+	{
+		std::uint32_t pass{};
+		DXRRenderGraphBarrier barrier{};
+	};
+	std::vector<PendingBarrier> m_pending{};
+	std::vector<std::uint32_t> m_batchStarts{};
+};
+
+// Human readable plan, one line per pass, barrier and allocation. Stable
+// across runs, meant for diffing:
+auto DumpRenderGraphPlan(const DXRRenderGraph& graph,
+						 const DXRRenderGraphPlan& plan) -> std::string;
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <vector>
+
+// Types shared by the D3D12 renderer and the headless/CPU paths.
+// Keep these free of any API headers.
+
+// Vertex layout struct:
+struct DXRVertex3D
+{
+	float x, y, z;
+	float nx, ny, nz;
+	float u, v;
+	std::uint32_t col;
+};
+
+// Compact vertex layout (DXRVertexQuantizer.h), 16 bytes:
+//   x, y, z: position as 16 bit unorm, relative to the mesh bounds.
+//   nx, ny: octahedral normal as 8 bit snorm.
+//   u, v: half floats.
+//   col: same as DXRVertex3D.
+struct DXRVertexQuantized
+{
+	std::uint16_t x, y, z;
+	std::int8_t nx, ny;
+	std::uint16_t u, v;
+	std::uint32_t col;
+};
+static_assert(sizeof(DXRVertexQuantized) == 16);
+
+// Per instance entry of the vertex shader's structured buffer
+// (DXRInstancePacker.h packs these), 64 bytes:
+//   transform: rows of a 3x4 affine transform, world = transform * local.
+//   color: R8G8B8A8_UNORM, multiplied with the vertex color.
+struct DXRInstanceData
+{
+	float transform[3][4];
+	std::uint32_t color;
+	std::uint32_t reserved[3];
+};
+static_assert(sizeof(DXRInstanceData) == 64);
+
+// Index buffer element size, 16 bit whenever the vertex count allows:
+enum struct DXRIndexFormat
+{
+	UInt16,
+	UInt32,
+};
+
+// Triangle list, indices into vertices (DXRMeshBuilder.h builds these):
+struct DXRIndexedMesh
+{
+	std::vector<DXRVertex3D> vertices{};
+	std::vector<std::uint32_t> indices{};
+
+	inline auto GetIndexFormat() const -> DXRIndexFormat
+	{
+		return vertices.size() <= 0xFFFF ? DXRIndexFormat::UInt16
+										 : DXRIndexFormat::UInt32;
+	}
+};
+
+// Constant buffer for shaders:
+struct DXRGraphicsConstants
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::mat4 model;
+	static_assert(sizeof(float[4][4]) == sizeof(glm::mat4),
+				  "Something is terribly wrong! The union is invalid...");
+};
+
+// Camera state of one CameraManager::Update(), published as a whole so a
+// frame never mixes two updates:
+struct DXRCameraMatrices
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 position;
+	glm::vec3 forward;
+	glm::vec3 right;
+	glm::vec3 up;
+	// Number of the Update() that produced it, 0 before the first one:
+	std::uint64_t updateNumber;
+	// Clock time the state stands for (DXRFixedTimestep::GetTickTime()), 0
+	// if the caller didn't say:
+	std::int64_t time;
+};
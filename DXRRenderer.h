@@ -128,6 +128,14 @@ struct DXRRenderer
 		m_renderer->Update(dt);
 	}
 
+	// Same as DXRWindowRenderer::SetInstances():
+	inline auto SetInstances(std::span<const DXRInstance> instances) -> void
+	{
+		if (!IsValid())
+			return;
+		m_renderer->SetInstances(instances);
+	}
+
   private:
 	std::unique_ptr<W32Window> m_window{};
 	std::unique_ptr<DXRWindowRenderer> m_renderer{};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <atomic>
+
+struct DXRResizeDesc
+{
+	// Seconds the requested size has to stay the same before it is applied:
+	double debounce{0.05};
+	// Seconds a drag waits at most, so the swap chain follows a long drag:
+	double maxDelay{0.25};
+};
+
+struct DXRResizeStats
+{
+	std::uint64_t published{};
+	std::uint64_t applied{};
+};
+
+struct DXRResizeSize
+{
+	std::uint32_t width{};
+	std::uint32_t height{};
+};
+
+// Latest-wins resize requests between the window thread and the render
+// thread:
+// Publish() (window thread, never blocks) overwrites the requested size, both
+// halves in one atomic word so the render thread never sees the width of one
+// request with the height of another. Poll() (render thread, at a frame
+// boundary) returns true once a new size stayed put for `debounce` or was
+// first seen `maxDelay` ago, so a drag becomes a handful of resizes instead of
+// one per message. Zero sizes (minimized) are never returned.
+//
+// The clock type is the one of DXRFixedTimestep, only Now() and
+// GetFrequency() are used.
+template <typename Clock> struct DXRResizeCoalescer : DXRNonCopyable
+{
+	inline DXRResizeCoalescer(Clock& clock, const DXRResizeDesc& desc = {})
+		: m_clock(clock)
+	{
+		const auto frequency = static_cast<double>(m_clock.GetFrequency());
+		m_debounce = static_cast<std::int64_t>(desc.debounce * frequency);
+		m_maxDelay = static_cast<std::int64_t>(desc.maxDelay * frequency);
+	}
+
+	// Any thread:
+	inline auto Publish(std::uint32_t width, std::uint32_t height) -> void
+	{
+		m_requested.store(Pack(width, height), std::memory_order_relaxed);
+		m_published.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// The size the last applied one has to be compared against, set by the
+	// render thread when it created the swap chain:
+	inline auto SetCurrent(std::uint32_t width, std::uint32_t height) -> void
+	{
+		m_current = Pack(width, height);
+		m_seen = m_current;
+		m_pending = false;
+	}
+
+	// Render thread, true if size should be applied now:
+	inline auto Poll(DXRResizeSize& size) -> bool
+	{
+		const auto requested = m_requested.load(std::memory_order_relaxed);
+		if (!requested || requested == m_current)
+		{
+			// Dragged back to where it was, or minimized:
+			m_seen = requested;
+			m_pending = false;
+			return false;
+		}
+
+		// The first size, nothing to debounce:
+		if (!m_current)
+		{
+			size = Unpack(requested);
+			m_current = requested;
+			m_seen = requested;
+			m_applied++;
+			return true;
+		}
+
+		const auto now = m_clock.Now();
+		if (!m_pending)
+		{
+			m_pending = true;
+			m_firstSeen = now;
+			m_lastChanged = now;
+		}
+		else if (requested != m_seen)
+		{
+			m_lastChanged = now;
+		}
+		m_seen = requested;
+
+		if (now - m_lastChanged < m_debounce && now - m_firstSeen < m_maxDelay)
+			return false;
+
+		// Zero sized requests never get here, both halves are non-zero or the
+		// word is 0:
+		size = Unpack(requested);
+		m_current = requested;
+		m_pending = false;
+		m_applied++;
+		return true;
+	}
+
+	inline auto IsPending() const -> bool
+	{
+		return m_pending;
+	}
+
+	inline auto GetStats() const -> DXRResizeStats
+	{
+		return {m_published.load(std::memory_order_relaxed), m_applied};
+	}
+
+  private:
+	// 0 for anything with a zero side:
+	static inline auto Pack(std::uint32_t width, std::uint32_t height)
+		-> std::uint64_t
+	{
+		if (!width || !height)
+			return 0;
+		return std::uint64_t{width} << 32 | height;
+	}
+
+	static inline auto Unpack(std::uint64_t packed) -> DXRResizeSize
+	{
+		return {static_cast<std::uint32_t>(packed >> 32),
+				static_cast<std::uint32_t>(packed)};
+	}
+
+	Clock& m_clock;
+	std::int64_t m_debounce{};
+	std::int64_t m_maxDelay{};
+
+	// Window thread -> render thread:
+	std::atomic<std::uint64_t> m_requested{};
+	std::atomic<std::uint64_t> m_published{};
+
+	// Render thread only:
+	std::uint64_t m_current{};
+	std::uint64_t m_seen{};
+	bool m_pending{};
+	std::int64_t m_firstSeen{};
+	std::int64_t m_lastChanged{};
+	std::uint64_t m_applied{};
+};
@@ -0,0 +1,288 @@
+#include "DXRShaderCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace
+{
+// 64-bit FNV-1a. Strings go in with their length so ("ab", "c") and
+// ("a", "bc") hash differently:
+struct ShaderHasher
+{
+	std::uint64_t hash{14695981039346656037ull};
+
+	inline auto Add(const void* data, std::size_t size) -> void
+	{
+		const auto bytes = static_cast<const unsigned char*>(data);
+		for (std::size_t n{}; n < size; n++)
+		{
+			hash = (hash ^ bytes[n]) * 1099511628211ull;
+		}
+	}
+
+	inline auto Add(std::uint64_t value) -> void
+	{
+		Add(&value, sizeof value);
+	}
+
+	inline auto Add(std::string_view text) -> void
+	{
+		Add(text.size());
+		Add(text.data(), text.size());
+	}
+
+	// Final avalanche, the key ends up in a file name and a hash table:
+	inline auto Get() const -> std::uint64_t
+	{
+		auto value = hash;
+		value ^= value >> 33;
+		value *= 0xFF51AFD7ED558CCDull;
+		value ^= value >> 33;
+		value *= 0xC4CEB9FE1A85EC53ull;
+		value ^= value >> 33;
+		return value;
+	}
+};
+
+auto GetChecksum(const unsigned char* data, std::size_t size) -> std::uint64_t
+{
+	ShaderHasher hasher{};
+	hasher.Add(data, size);
+	return hasher.Get();
+}
+
+auto GetFileName(std::uint64_t key) -> std::string
+{
+	constexpr char k_Digits[]{"0123456789abcdef"};
+	std::string name(16, '0');
+	for (std::size_t n{}; n < 16; n++)
+	{
+		name[15 - n] = k_Digits[(key >> (n * 4)) & 0xF];
+	}
+	return name + ".dxrs";
+}
+} // namespace
+
+DXRShaderCache::DXRShaderCache(const DXRShaderCacheDesc& desc)
+	: m_memoryBudget(desc.memoryBudget)
+{
+	ShaderHasher salt{};
+	salt.Add(k_Version);
+	salt.Add(desc.salt);
+	m_salt = salt.Get();
+
+	if (!desc.directory.empty())
+	{
+		// Without a directory it still works, from memory:
+		std::error_code error{};
+		std::filesystem::create_directories(desc.directory, error);
+		if (!error)
+			m_directory = desc.directory;
+	}
+}
+
+auto DXRShaderCache::GetKey(const DXRShaderDesc& desc) const -> std::uint64_t
+{
+	ShaderHasher hasher{};
+	hasher.Add(m_salt);
+	hasher.Add(desc.source);
+	hasher.Add(desc.entry);
+	hasher.Add(desc.target);
+	hasher.Add(desc.defines.size());
+	for (const auto& define : desc.defines)
+	{
+		hasher.Add(define.name);
+		hasher.Add(define.value);
+	}
+	return hasher.Get();
+}
+
+auto DXRShaderCache::Find(std::uint64_t key) -> DXRShaderBytecode
+{
+	{
+		std::lock_guard lock{m_mutex};
+		if (const auto entry = m_entries.find(key); entry != m_entries.end())
+		{
+			m_lru.splice(m_lru.begin(), m_lru, entry->second);
+			m_stats.memoryHits++;
+			return entry->second->bytecode;
+		}
+	}
+
+	// File IO outside the lock, two threads loading the same key both end
+	// up with the same bytes:
+	auto bytecode = Load(key);
+	std::lock_guard lock{m_mutex};
+	if (!bytecode)
+	{
+		m_stats.misses++;
+		return {};
+	}
+	m_stats.diskHits++;
+	Keep(key, bytecode);
+	return bytecode;
+}
+
+auto DXRShaderCache::Insert(std::uint64_t key,
+							std::vector<unsigned char> bytecode)
+	-> DXRShaderBytecode
+{
+	const auto stored = Store(key, bytecode);
+	auto shared = std::make_shared<const std::vector<unsigned char>>(
+		std::move(bytecode));
+
+	std::lock_guard lock{m_mutex};
+	if (!m_directory.empty())
+	{
+		if (stored)
+			m_stats.diskWrites++;
+		else
+			m_stats.diskWriteFailures++;
+	}
+	Keep(key, shared);
+	return shared;
+}
+
+auto DXRShaderCache::ClearMemory() -> void
+{
+	std::lock_guard lock{m_mutex};
+	m_entries.clear();
+	m_lru.clear();
+	m_stats.memoryBytes = 0;
+	m_stats.memoryEntries = 0;
+}
+
+auto DXRShaderCache::GetStats() const -> DXRShaderCacheStats
+{
+	std::lock_guard lock{m_mutex};
+	return m_stats;
+}
+
+auto DXRShaderCache::GetFilePath(std::uint64_t key) const
+	-> std::filesystem::path
+{
+	if (m_directory.empty())
+		return {};
+	return m_directory / GetFileName(key);
+}
+
+auto DXRShaderCache::Keep(std::uint64_t key, DXRShaderBytecode bytecode)
+	-> void
+{
+	if (const auto entry = m_entries.find(key); entry != m_entries.end())
+	{
+		// Someone else got here first, same key means same bytes:
+		m_lru.splice(m_lru.begin(), m_lru, entry->second);
+		return;
+	}
+
+	m_stats.memoryBytes += bytecode->size();
+	m_stats.memoryEntries++;
+	m_lru.push_front({key, std::move(bytecode)});
+	m_entries.emplace(key, m_lru.begin());
+
+	// The newest one stays even if it alone is over budget:
+	while (m_stats.memoryBytes > m_memoryBudget && m_lru.size() > 1)
+	{
+		const auto& oldest = m_lru.back();
+		m_stats.memoryBytes -= oldest.bytecode->size();
+		m_stats.memoryEntries--;
+		m_stats.evictions++;
+		m_entries.erase(oldest.key);
+		m_lru.pop_back();
+	}
+}
+
+auto DXRShaderCache::Load(std::uint64_t key) -> DXRShaderBytecode
+{
+	if (m_directory.empty())
+		return {};
+
+	const auto path = GetFilePath(key);
+	std::error_code error{};
+	const auto fileSize = std::filesystem::file_size(path, error);
+	if (error)
+		return {};
+	const auto file = std::fopen(path.string().c_str(), "rb");
+	if (!file)
+		return {};
+
+	// The size is checked against the file before anything is allocated
+	// for it:
+	DXRShaderCacheFileHeader header{};
+	std::vector<unsigned char> bytecode{};
+	auto valid = std::fread(&header, sizeof header, 1, file) == 1 &&
+				 header.magic == k_Magic && header.version == k_Version &&
+				 header.salt == m_salt && header.key == key &&
+				 header.size == fileSize - sizeof header;
+	if (valid)
+	{
+		bytecode.resize(static_cast<std::size_t>(header.size));
+		valid = std::fread(bytecode.data(), 1, bytecode.size(), file) ==
+					bytecode.size() &&
+				GetChecksum(bytecode.data(), bytecode.size()) ==
+					header.checksum;
+	}
+	std::fclose(file);
+
+	if (!valid)
+	{
+		// Truncated, bit rot or a leftover from an older format. Gone, the
+		// recompile writes a good one:
+		std::filesystem::remove(path, error);
+		std::lock_guard lock{m_mutex};
+		m_stats.corruptFiles++;
+		return {};
+	}
+	return std::make_shared<const std::vector<unsigned char>>(
+		std::move(bytecode));
+}
+
+auto DXRShaderCache::Store(std::uint64_t key,
+						   const std::vector<unsigned char>& bytecode) -> bool
+{
+	if (m_directory.empty())
+		return false;
+
+	DXRShaderCacheFileHeader header{};
+	header.magic = k_Magic;
+	header.version = k_Version;
+	header.salt = m_salt;
+	header.key = key;
+	header.size = bytecode.size();
+	header.checksum = GetChecksum(bytecode.data(), bytecode.size());
+
+	std::vector<unsigned char> file(sizeof header + bytecode.size());
+	memcpy(file.data(), &header, sizeof header);
+	std::copy(bytecode.begin(), bytecode.end(), file.begin() + sizeof header);
+	return WriteFileAtomically(GetFilePath(key), file);
+}
+
+auto WriteFileAtomically(const std::filesystem::path& path,
+						 std::span<const unsigned char> data) -> bool
+{
+	// Unique between threads and processes sharing the directory:
+	thread_local std::mt19937_64 random{std::random_device{}()};
+	auto tempPath = path;
+	tempPath += ".tmp" + std::to_string(random());
+
+	const auto file = std::fopen(tempPath.string().c_str(), "wb");
+	if (!file)
+		return false;
+	auto written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	written = std::fclose(file) == 0 && written;
+
+	// rename() replaces the old file in one step. A crash before it leaves a
+	// .tmp behind, never a half written file:
+	std::error_code error{};
+	if (written)
+		std::filesystem::rename(tempPath, path, error);
+	if (!written || error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct DXRShaderDefine
+{
+	std::string_view name{};
+	std::string_view value{};
+};
+
+// Everything that goes into a compile, the cache key is a hash of all of it:
+struct DXRShaderDesc
+{
+	std::string_view source{};
+	std::string_view entry{"main"};
+	std::string_view target{"vs_5_0"};
+	std::span<const DXRShaderDefine> defines{};
+};
+
+// Shared so eviction never pulls bytecode from under a pipeline being built:
+using DXRShaderBytecode = std::shared_ptr<const std::vector<unsigned char>>;
+
+struct DXRShaderCacheDesc
+{
+	// Compiled shaders are kept here between runs, empty keeps them in memory
+	// only:
+	std::string directory{};
+	// Bytecode kept in memory, the least recently used goes first:
+	std::size_t memoryBudget{4u << 20};
+	// Compiler name, version and flags. Goes into every key, so a new
+	// compiler never picks up an old compiler's output:
+	std::string salt{};
+};
+
+struct DXRShaderCacheStats
+{
+	std::uint64_t memoryHits{};
+	std::uint64_t diskHits{};
+	std::uint64_t misses{};
+	std::uint64_t compileFailures{};
+	// Files that failed validation, they get deleted and recompiled:
+	std::uint64_t corruptFiles{};
+	std::uint64_t evictions{};
+	std::uint64_t diskWrites{};
+	std::uint64_t diskWriteFailures{};
+	std::size_t memoryBytes{};
+	std::uint32_t memoryEntries{};
+};
+
+// One file per shader, named after its key:
+//   DXRShaderCacheFileHeader
+//   bytecode[size]
+struct DXRShaderCacheFileHeader
+{
+	std::uint32_t magic{};
+	std::uint32_t version{};
+	std::uint64_t salt{};
+	std::uint64_t key{};
+	std::uint64_t size{};
+	// Of the bytecode:
+	std::uint64_t checksum{};
+};
+static_assert(sizeof(DXRShaderCacheFileHeader) == 40);
+
+// Content addressed shader bytecode cache: an LRU in memory in front of a
+// directory of files. Files are written to a temporary name and renamed into
+// place, so readers see a whole file or none; everything read back is
+// checked against its header (salt, key, size, checksum) before use.
+// The compiler is whatever GetOrCompile() gets, the cache never calls a
+// platform API for it. Thread safe.
+struct DXRShaderCache : DXRNonCopyable
+{
+	// "DXRS":
+	static inline constexpr std::uint32_t k_Magic{0x53525844};
+	static inline constexpr std::uint32_t k_Version{1};
+
+	DXRShaderCache(const DXRShaderCacheDesc& desc = {});
+
+	auto GetKey(const DXRShaderDesc& desc) const -> std::uint64_t;
+
+	// Memory first, then disk (a disk hit is kept in memory). Null on a
+	// miss:
+	auto Find(std::uint64_t key) -> DXRShaderBytecode;
+
+	// Keeps freshly compiled bytecode in memory and writes it to disk:
+	auto Insert(std::uint64_t key, std::vector<unsigned char> bytecode)
+		-> DXRShaderBytecode;
+
+	// Find(), or compile(desc, bytecodeOut) -> bool and Insert(). Null if the
+	// compiler fails, failures aren't cached:
+	template <typename Compiler>
+	inline auto GetOrCompile(const DXRShaderDesc& desc, Compiler&& compile)
+		-> DXRShaderBytecode
+	{
+		const auto key = GetKey(desc);
+		if (auto bytecode = Find(key))
+			return bytecode;
+
+		std::vector<unsigned char> bytecode{};
+		if (!compile(desc, bytecode))
+		{
+			std::lock_guard lock{m_mutex};
+			m_stats.compileFailures++;
+			return {};
+		}
+		return Insert(key, std::move(bytecode));
+	}
+
+	// Drops the in-memory entries, the files stay:
+	auto ClearMemory() -> void;
+
+	auto GetStats() const -> DXRShaderCacheStats;
+
+	// Empty when memory only:
+	auto GetFilePath(std::uint64_t key) const -> std::filesystem::path;
+
+  private:
+	struct Entry
+	{
+		std::uint64_t key{};
+		DXRShaderBytecode bytecode{};
+	};
+
+	// Caller holds m_mutex:
+	auto Keep(std::uint64_t key, DXRShaderBytecode bytecode) -> void;
+	// File IO, without the lock:
+	auto Load(std::uint64_t key) -> DXRShaderBytecode;
+	auto Store(std::uint64_t key, const std::vector<unsigned char>& bytecode)
+		-> bool;
+
+	std::filesystem::path m_directory{};
+	std::size_t m_memoryBudget{};
+	std::uint64_t m_salt{};
+
+	mutable std::mutex m_mutex{};
+	// Most recently used first:
+	std::list<Entry> m_lru{};
+	std::unordered_map<std::uint64_t, std::list<Entry>::iterator> m_entries{};
+	DXRShaderCacheStats m_stats{};
+};
+
+// Writes data to a temporary file next to path and renames it over path, so
+// readers see the old file or the whole new one. Also used for the pipeline
+// library blob:
+auto WriteFileAtomically(const std::filesystem::path& path,
+						 std::span<const unsigned char> data) -> bool;
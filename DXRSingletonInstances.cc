@@ -1,13 +1,19 @@
 #include "DXRSingleton.h"
 
 #include "CameraManager.h"
+#include "DXRJobSystem.h"
 
 struct AllEngineSingletons
 {
 	DXRSingleton<CameraManager> g_cameraManager{};
+	// Last, members go away in reverse: its workers and dedicated threads
+	// (the update loop) are joined before the singletons they use are
+	// deleted. The thread calling InitializeSingletonInstances() becomes its
+	// main thread:
+	DXRSingleton<DXRJobSystem> g_jobSystem{};
 };
 
 auto InitializeSingletonInstances() -> void
 {
 	static AllEngineSingletons g_Singletons{};
-}
\ No newline at end of file
+}
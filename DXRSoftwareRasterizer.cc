@@ -0,0 +1,563 @@
+#include "DXRSoftwareRasterizer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define DXRRASTERIZERSSE
+#include <emmintrin.h>
+#endif
+
+static auto PackColor(float r, float g, float b, float a) -> std::uint32_t
+{
+	const auto toUnorm = [](float v) -> std::uint32_t {
+		v = std::clamp(v, 0.f, 1.f);
+		return static_cast<std::uint32_t>(v * 255.f + 0.5f);
+	};
+	return toUnorm(r) | (toUnorm(g) << 8) | (toUnorm(b) << 16) |
+		   (toUnorm(a) << 24);
+}
+
+static auto UnpackChannel(std::uint32_t color, std::uint32_t channel) -> float
+{
+	return static_cast<float>((color >> (channel * 8)) & 0xFF) * (1.f / 255.f);
+}
+
+DXRSoftwareRasterizer::DXRSoftwareRasterizer(std::uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	// The thread calling Execute() works too:
+	for (std::uint32_t n{1}; n < threadCount; n++)
+	{
+		m_workers.emplace_back(
+			[this](std::stop_token token) { WorkerMain(token); });
+	}
+}
+
+DXRSoftwareRasterizer::~DXRSoftwareRasterizer()
+{
+	for (auto& worker : m_workers)
+	{
+		worker.request_stop();
+	}
+	// Wake everyone up so they can see the stop request:
+	m_dispatchFence.Signal(UINT64_MAX);
+	m_workers.clear();
+}
+
+auto DXRSoftwareRasterizer::Resize(std::uint32_t width, std::uint32_t height)
+	-> void
+{
+	if (m_width == width && m_height == height)
+		return;
+
+	m_width = width;
+	m_height = height;
+	m_tilesX = (width + k_TileSize - 1) / k_TileSize;
+	m_tilesY = (height + k_TileSize - 1) / k_TileSize;
+
+	const auto pixels = static_cast<std::size_t>(width) * height;
+	m_color.assign(pixels, 0);
+	m_depth.assign(pixels, 1.f);
+	m_tileBins.clear();
+	m_tileBins.resize(static_cast<std::size_t>(m_tilesX) * m_tilesY);
+	m_triangles.clear();
+}
+
+auto DXRSoftwareRasterizer::Clear(const float color[4], float depth) -> void
+{
+	std::fill(m_color.begin(), m_color.end(),
+			  PackColor(color[0], color[1], color[2], color[3]));
+	std::fill(m_depth.begin(), m_depth.end(), depth);
+}
+
+auto DXRSoftwareRasterizer::SetTexture(const DXRImageRGBA8* texture) -> void
+{
+	m_texture = texture;
+}
+
+auto DXRSoftwareRasterizer::DrawInstanced(
+	std::span<const DXRVertex3D> vertices,
+	const DXRGraphicsConstants& constants) -> void
+{
+	if (m_width == 0 || m_height == 0)
+		return;
+
+	for (std::size_t n{}; n + 2 < vertices.size(); n += 3)
+	{
+		ClipTriangle(ToClip(vertices[n + 0], constants),
+					 ToClip(vertices[n + 1], constants),
+					 ToClip(vertices[n + 2], constants));
+	}
+}
+
+auto DXRSoftwareRasterizer::DrawIndexedInstanced(
+	std::span<const DXRVertex3D> vertices,
+	std::span<const std::uint32_t> indices,
+	const DXRGraphicsConstants& constants) -> void
+{
+	DrawIndexed(vertices, indices, constants, nullptr);
+}
+
+auto DXRSoftwareRasterizer::DrawIndexedInstanced(
+	std::span<const DXRVertex3D> vertices,
+	std::span<const std::uint32_t> indices,
+	std::span<const DXRInstanceData> instances,
+	const DXRGraphicsConstants& constants) -> void
+{
+	for (const auto& instance : instances)
+	{
+		DrawIndexed(vertices, indices, constants, &instance);
+	}
+}
+
+auto DXRSoftwareRasterizer::DrawIndexed(std::span<const DXRVertex3D> vertices,
+										std::span<const std::uint32_t> indices,
+										const DXRGraphicsConstants& constants,
+										const DXRInstanceData* instance)
+	-> void
+{
+	if (m_width == 0 || m_height == 0)
+		return;
+
+	// Every vertex is shaded once, triangles share the results like the
+	// post-transform cache would let them:
+	m_clipVertices.resize(vertices.size());
+	for (std::size_t n{}; n < vertices.size(); n++)
+	{
+		m_clipVertices[n] = ToClip(vertices[n], constants, instance);
+	}
+
+	for (std::size_t n{}; n + 2 < indices.size(); n += 3)
+	{
+		const auto a = indices[n + 0];
+		const auto b = indices[n + 1];
+		const auto c = indices[n + 2];
+		// Out of range indices drop the triangle, D3D would read zeroes:
+		if (a >= vertices.size() || b >= vertices.size() ||
+			c >= vertices.size())
+			continue;
+		ClipTriangle(m_clipVertices[a], m_clipVertices[b], m_clipVertices[c]);
+	}
+}
+
+auto DXRSoftwareRasterizer::ToClip(const DXRVertex3D& v,
+								   const DXRGraphicsConstants& constants,
+								   const DXRInstanceData* instance)
+	-> ClipVertex
+{
+	// vertexShader2DText: mul(mul(mul(pos, model), view), projection) with
+	// the instance transform between model and view.
+	// glm's vec * mat is the same row vector multiply as HLSL's mul().
+	ClipVertex out{};
+	out.position = glm::vec4{v.x, v.y, v.z, 1.f} * constants.model;
+	if (instance)
+	{
+		const auto& t = instance->transform;
+		const auto local = out.position;
+		for (int row{}; row < 3; row++)
+		{
+			out.position[row] = t[row][0] * local.x + t[row][1] * local.y +
+								t[row][2] * local.z + t[row][3] * local.w;
+		}
+	}
+	out.position = out.position * constants.view;
+	out.position = out.position * constants.projection;
+	out.u = v.u;
+	out.v = v.v;
+	return out;
+}
+
+auto DXRSoftwareRasterizer::ClipTriangle(const ClipVertex& a,
+										 const ClipVertex& b,
+										 const ClipVertex& c) -> void
+{
+	// Clip against the near (z >= 0) and far (z <= w) planes, x/y are
+	// handled by the tile bounds:
+	ClipVertex polygon[2][5]{};
+	std::uint32_t count = 3;
+	polygon[0][0] = a;
+	polygon[0][1] = b;
+	polygon[0][2] = c;
+
+	std::uint32_t src{};
+	for (std::uint32_t plane{}; plane < 2 && count >= 3; plane++)
+	{
+		const auto distance = [plane](const ClipVertex& v) -> float {
+			return plane == 0 ? v.position.z : v.position.w - v.position.z;
+		};
+
+		const auto dst = src ^ 1u;
+		std::uint32_t outCount{};
+		for (std::uint32_t i{}; i < count; i++)
+		{
+			const auto& p = polygon[src][i];
+			const auto& q = polygon[src][(i + 1) % count];
+			const auto dp = distance(p);
+			const auto dq = distance(q);
+			if (dp >= 0.f)
+			{
+				polygon[dst][outCount++] = p;
+			}
+			if ((dp >= 0.f) != (dq >= 0.f))
+			{
+				const auto t = dp / (dp - dq);
+				auto& out = polygon[dst][outCount++];
+				out.position = p.position + (q.position - p.position) * t;
+				out.u = p.u + (q.u - p.u) * t;
+				out.v = p.v + (q.v - p.v) * t;
+			}
+		}
+		count = outCount;
+		src = dst;
+	}
+
+	for (std::uint32_t i{1}; i + 1 < count; i++)
+	{
+		SetupTriangle(polygon[src][0], polygon[src][i], polygon[src][i + 1]);
+	}
+}
+
+auto DXRSoftwareRasterizer::SetupTriangle(const ClipVertex& a,
+										  const ClipVertex& b,
+										  const ClipVertex& c) -> void
+{
+	Triangle tri{};
+	const ClipVertex* verts[3] = {&a, &b, &c};
+	const auto w = static_cast<float>(m_width);
+	const auto h = static_cast<float>(m_height);
+	for (std::uint32_t i{}; i < 3; i++)
+	{
+		const auto& p = verts[i]->position;
+		const auto invW = 1.f / p.w;
+		// Viewport transform, D3D has y pointing down:
+		tri.x[i] = (p.x * invW * 0.5f + 0.5f) * w;
+		tri.y[i] = (0.5f - p.y * invW * 0.5f) * h;
+		tri.z[i] = p.z * invW;
+		tri.invW[i] = invW;
+		tri.uOverW[i] = verts[i]->u * invW;
+		tri.vOverW[i] = verts[i]->v * invW;
+	}
+
+	auto area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) -
+				(tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+	if (!(std::abs(area) > 0.f) || !std::isfinite(area))
+		return;
+
+	// CullMode is NONE, flip back facing triangles so the edge functions are
+	// always positive inside:
+	if (area < 0.f)
+	{
+		std::swap(tri.x[1], tri.x[2]);
+		std::swap(tri.y[1], tri.y[2]);
+		std::swap(tri.z[1], tri.z[2]);
+		std::swap(tri.invW[1], tri.invW[2]);
+		std::swap(tri.uOverW[1], tri.uOverW[2]);
+		std::swap(tri.vOverW[1], tri.vOverW[2]);
+		area = -area;
+	}
+	tri.invArea = 1.f / area;
+
+	const auto minX = std::min({tri.x[0], tri.x[1], tri.x[2]});
+	const auto minY = std::min({tri.y[0], tri.y[1], tri.y[2]});
+	const auto maxX = std::max({tri.x[0], tri.x[1], tri.x[2]});
+	const auto maxY = std::max({tri.y[0], tri.y[1], tri.y[2]});
+	if (maxX < 0.f || maxY < 0.f || minX > w || minY > h)
+		return;
+
+	// Clamp in float first, vertices close to the near plane can land far
+	// outside of int range:
+	tri.minX = static_cast<std::int32_t>(std::floor(std::max(minX, 0.f)));
+	tri.minY = static_cast<std::int32_t>(std::floor(std::max(minY, 0.f)));
+	tri.maxX = std::min(static_cast<std::int32_t>(m_width) - 1,
+						static_cast<std::int32_t>(std::ceil(std::min(maxX, w))));
+	tri.maxY = std::min(static_cast<std::int32_t>(m_height) - 1,
+						static_cast<std::int32_t>(std::ceil(std::min(maxY, h))));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	tri.texture = m_texture;
+
+	const auto index = static_cast<std::uint32_t>(m_triangles.size());
+	m_triangles.push_back(tri);
+
+	const auto tileMinX = static_cast<std::uint32_t>(tri.minX) / k_TileSize;
+	const auto tileMinY = static_cast<std::uint32_t>(tri.minY) / k_TileSize;
+	const auto tileMaxX = static_cast<std::uint32_t>(tri.maxX) / k_TileSize;
+	const auto tileMaxY = static_cast<std::uint32_t>(tri.maxY) / k_TileSize;
+	for (auto ty = tileMinY; ty <= tileMaxY; ty++)
+	{
+		for (auto tx = tileMinX; tx <= tileMaxX; tx++)
+		{
+			m_tileBins[ty * m_tilesX + tx].push_back(index);
+		}
+	}
+}
+
+auto DXRSoftwareRasterizer::Execute() -> void
+{
+	if (m_triangles.empty())
+		return;
+
+	m_generation++;
+	m_nextTile.store(0, std::memory_order_relaxed);
+	m_workersFinished.store(0, std::memory_order_relaxed);
+	m_dispatchFence.Signal(m_generation);
+
+	RasterizeTiles();
+
+	if (!m_workers.empty())
+	{
+		m_completeFence.Wait(m_generation);
+	}
+
+	for (auto& bin : m_tileBins)
+	{
+		bin.clear();
+	}
+	m_triangles.clear();
+}
+
+auto DXRSoftwareRasterizer::RasterizeTiles() -> void
+{
+	const auto tileCount = static_cast<std::uint32_t>(m_tileBins.size());
+	for (;;)
+	{
+		const auto tile = m_nextTile.fetch_add(1, std::memory_order_relaxed);
+		if (tile >= tileCount)
+			break;
+		RasterizeTile(tile);
+	}
+}
+
+auto DXRSoftwareRasterizer::WorkerMain(std::stop_token token) -> void
+{
+	std::uint64_t generation{};
+	for (;;)
+	{
+		generation++;
+		m_dispatchFence.Wait(generation);
+		if (token.stop_requested())
+			return;
+
+		RasterizeTiles();
+
+		const auto finished =
+			m_workersFinished.fetch_add(1, std::memory_order_acq_rel) + 1;
+		if (finished == m_workers.size())
+		{
+			m_completeFence.Signal(generation);
+		}
+	}
+}
+
+auto DXRSoftwareRasterizer::RasterizeTile(std::uint32_t tileIndex) -> void
+{
+	const auto& bin = m_tileBins[tileIndex];
+	if (bin.empty())
+		return;
+
+	const auto tx = tileIndex % m_tilesX;
+	const auto ty = tileIndex / m_tilesX;
+	const auto tileMinX = static_cast<std::int32_t>(tx * k_TileSize);
+	const auto tileMinY = static_cast<std::int32_t>(ty * k_TileSize);
+	const auto tileMaxX = std::min(tileMinX + static_cast<std::int32_t>(k_TileSize),
+								   static_cast<std::int32_t>(m_width)) - 1;
+	const auto tileMaxY = std::min(tileMinY + static_cast<std::int32_t>(k_TileSize),
+								   static_cast<std::int32_t>(m_height)) - 1;
+
+	for (const auto index : bin)
+	{
+		RasterizeTriangle(m_triangles[index], tileMinX, tileMinY, tileMaxX,
+						  tileMaxY);
+	}
+}
+
+auto DXRSoftwareRasterizer::RasterizeTriangle(const Triangle& tri,
+											  std::int32_t tileMinX,
+											  std::int32_t tileMinY,
+											  std::int32_t tileMaxX,
+											  std::int32_t tileMaxY) -> void
+{
+	const auto minX = std::max(tri.minX, tileMinX);
+	const auto minY = std::max(tri.minY, tileMinY);
+	const auto maxX = std::min(tri.maxX, tileMaxX);
+	const auto maxY = std::min(tri.maxY, tileMaxY);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// Edge i is opposite vertex i, E(x, y) = A * x + B * y + C.
+	float edgeA[3], edgeB[3], edgeC[3];
+	bool topLeft[3];
+	for (std::uint32_t i{}; i < 3; i++)
+	{
+		const auto from = (i + 1) % 3;
+		const auto to = (i + 2) % 3;
+		const auto dx = tri.x[to] - tri.x[from];
+		const auto dy = tri.y[to] - tri.y[from];
+		edgeA[i] = -dy;
+		edgeB[i] = dx;
+		edgeC[i] = dy * tri.x[from] - dx * tri.y[from];
+		// D3D top-left fill rule (y down, clockwise after setup):
+		topLeft[i] = (dy == 0.f && dx > 0.f) || dy < 0.f;
+	}
+
+	const auto stride = static_cast<std::size_t>(m_width);
+	const auto shade = [&](std::int32_t px, std::int32_t py, float b0, float b1,
+						   float b2, float z) -> void {
+		const auto index =
+			static_cast<std::size_t>(py) * stride + static_cast<std::size_t>(px);
+		const auto oneOverW =
+			b0 * tri.invW[0] + b1 * tri.invW[1] + b2 * tri.invW[2];
+		const auto u = (b0 * tri.uOverW[0] + b1 * tri.uOverW[1] +
+						b2 * tri.uOverW[2]) /
+					   oneOverW;
+		const auto v = (b0 * tri.vOverW[0] + b1 * tri.vOverW[1] +
+						b2 * tri.vOverW[2]) /
+					   oneOverW;
+		const auto texel = SampleTexturePointPacked(tri.texture, u, v);
+
+		// SRC_ALPHA / INV_SRC_ALPHA, alpha ONE / ZERO:
+		const auto dst = m_color[index];
+		const auto srcA = UnpackChannel(texel, 3);
+		float out[4];
+		for (std::uint32_t c{}; c < 3; c++)
+		{
+			out[c] = UnpackChannel(texel, c) * srcA +
+					 UnpackChannel(dst, c) * (1.f - srcA);
+		}
+		out[3] = srcA;
+		m_color[index] = PackColor(out[0], out[1], out[2], out[3]);
+		m_depth[index] = z;
+	};
+
+#ifdef DXRRASTERIZERSSE
+	const auto laneOffsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+	const auto zero = _mm_setzero_ps();
+	__m128 stepX[3];
+	for (std::uint32_t i{}; i < 3; i++)
+	{
+		stepX[i] = _mm_set1_ps(edgeA[i] * 4.f);
+	}
+	const auto invArea = _mm_set1_ps(tri.invArea);
+	const auto z0 = _mm_set1_ps(tri.z[0]);
+	const auto z1 = _mm_set1_ps(tri.z[1]);
+	const auto z2 = _mm_set1_ps(tri.z[2]);
+#endif
+
+	for (auto py = minY; py <= maxY; py++)
+	{
+		const auto cy = static_cast<float>(py) + 0.5f;
+		auto* depthRow = m_depth.data() + static_cast<std::size_t>(py) * stride;
+
+#ifdef DXRRASTERIZERSSE
+		const auto cx = _mm_add_ps(
+			_mm_set1_ps(static_cast<float>(minX) + 0.5f), laneOffsets);
+		__m128 e[3];
+		for (std::uint32_t i{}; i < 3; i++)
+		{
+			e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[i]), cx),
+							  _mm_set1_ps(edgeB[i] * cy + edgeC[i]));
+		}
+#else
+		float e[3];
+		for (std::uint32_t i{}; i < 3; i++)
+		{
+			e[i] = edgeA[i] * (static_cast<float>(minX) + 0.5f) +
+				   edgeB[i] * cy + edgeC[i];
+		}
+#endif
+
+		for (auto px = minX; px <= maxX; px += 4)
+		{
+			const auto lanes = std::min(4, maxX - px + 1);
+			float laneDepth[4]{};
+			float laneB[3][4]{};
+
+#ifdef DXRRASTERIZERSSE
+			auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (std::uint32_t i{}; i < 3; i++)
+			{
+				inside = _mm_and_ps(inside, topLeft[i]
+												? _mm_cmpge_ps(e[i], zero)
+												: _mm_cmpgt_ps(e[i], zero));
+			}
+			auto bits = static_cast<std::uint32_t>(_mm_movemask_ps(inside)) &
+						((1u << lanes) - 1u);
+			if (bits)
+			{
+				const auto b0 = _mm_mul_ps(e[0], invArea);
+				const auto b1 = _mm_mul_ps(e[1], invArea);
+				const auto b2 = _mm_mul_ps(e[2], invArea);
+				const auto z = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(b0, z0), _mm_mul_ps(b1, z1)),
+					_mm_mul_ps(b2, z2));
+
+				float stored[4]{1.f, 1.f, 1.f, 1.f};
+				memcpy(stored, depthRow + px,
+					   static_cast<std::size_t>(lanes) * sizeof(float));
+				// DepthFunc LESS:
+				bits &= static_cast<std::uint32_t>(
+					_mm_movemask_ps(_mm_cmplt_ps(z, _mm_loadu_ps(stored))));
+
+				_mm_storeu_ps(laneDepth, z);
+				_mm_storeu_ps(laneB[0], b0);
+				_mm_storeu_ps(laneB[1], b1);
+				_mm_storeu_ps(laneB[2], b2);
+			}
+			for (std::uint32_t i{}; i < 3; i++)
+			{
+				e[i] = _mm_add_ps(e[i], stepX[i]);
+			}
+#else
+			std::uint32_t bits{};
+			for (std::int32_t lane{}; lane < lanes; lane++)
+			{
+				const auto offset = static_cast<float>(lane);
+				bool inside = true;
+				float laneE[3];
+				for (std::uint32_t i{}; i < 3; i++)
+				{
+					laneE[i] = e[i] + edgeA[i] * offset;
+					inside = inside && (topLeft[i] ? laneE[i] >= 0.f
+												   : laneE[i] > 0.f);
+				}
+				if (!inside)
+					continue;
+				for (std::uint32_t i{}; i < 3; i++)
+				{
+					laneB[i][lane] = laneE[i] * tri.invArea;
+				}
+				laneDepth[lane] = laneB[0][lane] * tri.z[0] +
+								  laneB[1][lane] * tri.z[1] +
+								  laneB[2][lane] * tri.z[2];
+				if (laneDepth[lane] < depthRow[px + lane])
+				{
+					bits |= 1u << lane;
+				}
+			}
+			for (std::uint32_t i{}; i < 3; i++)
+			{
+				e[i] += edgeA[i] * 4.f;
+			}
+#endif
+
+			while (bits)
+			{
+				const auto lane = std::countr_zero(bits);
+				bits &= bits - 1;
+				const auto z = laneDepth[lane];
+				// DepthClipEnable, viewport depth range [0, 1]:
+				if (z < 0.f || z > 1.f)
+					continue;
+				shade(px + lane, py, laneB[0][lane], laneB[1][lane],
+					  laneB[2][lane], z);
+			}
+		}
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRAssets.h"
+#include "DXRFenceEvent.h"
+#include "DXRRenderTypes.h"
+
+#include <atomic>
+#include <span>
+#include <thread>
+#include <vector>
+
+// CPU reference implementation of the one pipeline CreateD3D12PipelineState
+// builds:
+//   VS: vertexShader2DText (model, instance transform, view, projection)
+//   PS: pixelShader2DText (point sampled texture0, transparent black border)
+//   Depth: D32, LESS, write all, clip to [0, w]
+//   Blend: SRC_ALPHA / INV_SRC_ALPHA, alpha ONE / ZERO
+//   Cull: none
+// Draw*() transforms, clips and bins triangles into screen tiles, Execute()
+// rasterizes the tiles in parallel. Triangles keep submission order per tile.
+struct DXRSoftwareRasterizer : DXRNonCopyable
+{
+	static inline constexpr std::uint32_t k_TileSize{64};
+
+	// threadCount = 0 uses every core:
+	DXRSoftwareRasterizer(std::uint32_t threadCount = 0);
+	~DXRSoftwareRasterizer();
+
+	// Render target and depth buffer, swapchain size dependent:
+	auto Resize(std::uint32_t width, std::uint32_t height) -> void;
+
+	// ClearRenderTargetView + ClearDepthStencilView:
+	auto Clear(const float color[4], float depth = 1.f) -> void;
+
+	// Texture bound to t0 for following draws.
+	// Must stay alive until Execute() returns.
+	auto SetTexture(const DXRImageRGBA8* texture) -> void;
+
+	// DrawInstanced(vertexCount, 1, 0, 0) with a triangle list:
+	auto DrawInstanced(std::span<const DXRVertex3D> vertices,
+					   const DXRGraphicsConstants& constants) -> void;
+
+	// DrawIndexedInstanced(indexCount, 1, 0, 0, 0) with a triangle list:
+	auto DrawIndexedInstanced(std::span<const DXRVertex3D> vertices,
+							  std::span<const std::uint32_t> indices,
+							  const DXRGraphicsConstants& constants) -> void;
+
+	// DrawIndexedInstanced(indexCount, instances.size(), 0, 0, 0) with
+	// instances bound to t1, the overloads above draw an identity instance:
+	auto DrawIndexedInstanced(std::span<const DXRVertex3D> vertices,
+							  std::span<const std::uint32_t> indices,
+							  std::span<const DXRInstanceData> instances,
+							  const DXRGraphicsConstants& constants) -> void;
+
+	// Rasterizes everything binned since the last Execute():
+	auto Execute() -> void;
+
+	inline auto GetWidth() const -> std::uint32_t
+	{
+		return m_width;
+	}
+
+	inline auto GetHeight() const -> std::uint32_t
+	{
+		return m_height;
+	}
+
+	// R8G8B8A8_UNORM, top-down, tightly packed:
+	inline auto GetColorBuffer() const -> const std::vector<std::uint32_t>&
+	{
+		return m_color;
+	}
+
+	inline auto GetDepthBuffer() const -> const std::vector<float>&
+	{
+		return m_depth;
+	}
+
+	inline auto GetThreadCount() const -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(m_workers.size()) + 1;
+	}
+
+  private:
+	// Post-setup triangle, everything the tile loop needs:
+	struct Triangle
+	{
+		// Screen space positions:
+		float x[3], y[3];
+		// Viewport depth, interpolated linearly in screen space:
+		float z[3];
+		// Perspective correction, 1/w and attributes divided by w:
+		float invW[3];
+		float uOverW[3], vOverW[3];
+		// 1 / doubled area:
+		float invArea;
+		// Clamped bounding box:
+		std::int32_t minX, minY, maxX, maxY;
+		const DXRImageRGBA8* texture;
+	};
+
+	struct ClipVertex
+	{
+		glm::vec4 position;
+		float u, v;
+	};
+
+	auto DrawIndexed(std::span<const DXRVertex3D> vertices,
+					 std::span<const std::uint32_t> indices,
+					 const DXRGraphicsConstants& constants,
+					 const DXRInstanceData* instance) -> void;
+	static auto ToClip(const DXRVertex3D& v,
+					   const DXRGraphicsConstants& constants,
+					   const DXRInstanceData* instance = nullptr)
+		-> ClipVertex;
+	auto ClipTriangle(const ClipVertex& a, const ClipVertex& b,
+					  const ClipVertex& c) -> void;
+	auto SetupTriangle(const ClipVertex& a, const ClipVertex& b,
+					   const ClipVertex& c) -> void;
+	auto RasterizeTile(std::uint32_t tileIndex) -> void;
+	auto RasterizeTriangle(const Triangle& tri, std::int32_t tileMinX,
+						   std::int32_t tileMinY, std::int32_t tileMaxX,
+						   std::int32_t tileMaxY) -> void;
+	auto RasterizeTiles() -> void;
+	auto WorkerMain(std::stop_token token) -> void;
+
+	std::uint32_t m_width{}, m_height{};
+	std::uint32_t m_tilesX{}, m_tilesY{};
+
+	std::vector<std::uint32_t> m_color{};
+	std::vector<float> m_depth{};
+
+	const DXRImageRGBA8* m_texture{};
+
+	// Shaded vertices of the current indexed draw:
+	std::vector<ClipVertex> m_clipVertices{};
+	std::vector<Triangle> m_triangles{};
+	// Triangle indices per tile, in submission order:
+	std::vector<std::vector<std::uint32_t>> m_tileBins{};
+
+	// Workers wait on m_dispatchFence for the next Execute() generation,
+	// grab tiles from m_nextTile and the last one to finish signals
+	// m_completeFence:
+	std::vector<std::jthread> m_workers{};
+	DXRFenceEvent m_dispatchFence{};
+	DXRFenceEvent m_completeFence{};
+	std::uint64_t m_generation{};
+	std::atomic<std::uint32_t> m_nextTile{};
+	std::atomic<std::uint32_t> m_workersFinished{};
+};
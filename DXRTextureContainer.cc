@@ -0,0 +1,295 @@
+#include "DXRTextureContainer.h"
+#include "DXRBlockCompression.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static auto AlignUp(std::uint64_t value, std::uint64_t alignment)
+	-> std::uint64_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Bytes in one row of texels/blocks, rows in a mip:
+static auto GetRowSize(const DXRTextureFormatInfo& info, std::uint32_t width)
+	-> std::uint32_t
+{
+	return (width + info.blockSize - 1) / info.blockSize * info.bytesPerBlock;
+}
+
+static auto GetRowCount(const DXRTextureFormatInfo& info, std::uint32_t height)
+	-> std::uint32_t
+{
+	return (height + info.blockSize - 1) / info.blockSize;
+}
+
+auto DXRTextureContainer::Open(const char* path) -> bool
+{
+	Close();
+	if (!m_file.Open(path))
+		return false;
+
+	if (!Load(m_file.GetData(), m_file.GetSize()))
+	{
+		m_file.Close();
+		return false;
+	}
+	return true;
+}
+
+auto DXRTextureContainer::Load(const unsigned char* data, std::size_t size)
+	-> bool
+{
+	m_base = nullptr;
+	if (!data || size < sizeof(DXRTextureContainerHeader))
+		return false;
+
+	DXRTextureContainerHeader header{};
+	memcpy(&header, data, sizeof header);
+	if (header.magic != k_Magic || header.version != k_Version)
+		return false;
+
+	const auto info = GetTextureFormatInfo(header.format);
+	if (!info.bytesPerBlock || !header.width || !header.height ||
+		!header.mipCount || header.mipCount > k_MaxMips)
+		return false;
+
+	const auto tableEnd = sizeof header +
+						  header.mipCount * sizeof(DXRTextureContainerMip);
+	if (size < tableEnd || header.dataOffset < tableEnd ||
+		header.dataOffset % k_PlacementAlignment ||
+		header.dataOffset > size || header.dataSize > size - header.dataOffset)
+		return false;
+
+	memcpy(m_mips.data(), data + sizeof header,
+		   header.mipCount * sizeof(DXRTextureContainerMip));
+
+	// Every mip has to be inside the payload and match the chain:
+	for (std::uint32_t n{}; n < header.mipCount; n++)
+	{
+		const auto& mip = m_mips[n];
+		if (mip.width != std::max(1u, header.width >> n) ||
+			mip.height != std::max(1u, header.height >> n) ||
+			mip.rowCount != GetRowCount(info, mip.height) ||
+			mip.rowPitch < GetRowSize(info, mip.width) ||
+			mip.rowPitch % k_PitchAlignment ||
+			mip.offset % k_PlacementAlignment ||
+			mip.size <
+				static_cast<std::uint64_t>(mip.rowPitch) * mip.rowCount ||
+			mip.offset > header.dataSize ||
+			mip.size > header.dataSize - mip.offset)
+			return false;
+	}
+
+	m_header = header;
+	m_base = data;
+	return true;
+}
+
+auto DXRTextureContainer::Close() -> void
+{
+	m_base = nullptr;
+	m_header = {};
+	m_file.Close();
+}
+
+namespace
+{
+// One mip as the cooker sees it, tightly packed rows:
+struct MipSource
+{
+	std::uint32_t width{};
+	std::uint32_t height{};
+	const unsigned char* data{};
+	std::size_t size{};
+};
+
+auto CookMips(DXRTextureFormat format, std::span<const MipSource> mips,
+			  std::vector<unsigned char>& out) -> bool
+{
+	const auto info = GetTextureFormatInfo(format);
+	if (!info.bytesPerBlock || mips.empty() ||
+		mips.size() > DXRTextureContainer::k_MaxMips)
+		return false;
+
+	DXRTextureContainerHeader header{};
+	header.magic = DXRTextureContainer::k_Magic;
+	header.version = DXRTextureContainer::k_Version;
+	header.format = format;
+	header.width = mips[0].width;
+	header.height = mips[0].height;
+	header.mipCount = static_cast<std::uint32_t>(mips.size());
+	header.flags = DXRTextureContainer::k_FlagFlipped;
+
+	std::vector<DXRTextureContainerMip> table(mips.size());
+	std::uint64_t dataSize{};
+	for (std::uint32_t n{}; n < header.mipCount; n++)
+	{
+		const auto& source = mips[n];
+		auto& mip = table[n];
+		mip.width = source.width;
+		mip.height = source.height;
+		mip.rowCount = GetRowCount(info, mip.height);
+		const auto rowSize = GetRowSize(info, mip.width);
+		if (mip.width != std::max(1u, header.width >> n) ||
+			mip.height != std::max(1u, header.height >> n) ||
+			source.size != static_cast<std::size_t>(rowSize) * mip.rowCount)
+			return false;
+
+		mip.rowPitch = static_cast<std::uint32_t>(
+			AlignUp(rowSize, DXRTextureContainer::k_PitchAlignment));
+		mip.offset =
+			AlignUp(dataSize, DXRTextureContainer::k_PlacementAlignment);
+		mip.size = static_cast<std::uint64_t>(mip.rowPitch) * mip.rowCount;
+		dataSize = mip.offset + mip.size;
+	}
+
+	header.dataOffset = AlignUp(
+		sizeof header + table.size() * sizeof(DXRTextureContainerMip),
+		DXRTextureContainer::k_PlacementAlignment);
+	header.dataSize = dataSize;
+
+	// Padding is zeroed so cooking is deterministic:
+	out.assign(static_cast<std::size_t>(header.dataOffset + dataSize), 0);
+	memcpy(out.data(), &header, sizeof header);
+	memcpy(out.data() + sizeof header, table.data(),
+		   table.size() * sizeof(DXRTextureContainerMip));
+
+	const auto payload = out.data() + header.dataOffset;
+	for (std::uint32_t n{}; n < header.mipCount; n++)
+	{
+		const auto& mip = table[n];
+		const std::size_t rowSize = GetRowSize(info, mip.width);
+		for (std::uint32_t y{}; y < mip.rowCount; y++)
+		{
+			memcpy(payload + mip.offset +
+					   static_cast<std::size_t>(y) * mip.rowPitch,
+				   mips[n].data + y * rowSize, rowSize);
+		}
+	}
+	return true;
+}
+
+template <typename Image>
+auto GetMipSources(std::span<const Image> mips) -> std::vector<MipSource>
+{
+	std::vector<MipSource> sources{};
+	for (const auto& image : mips)
+	{
+		sources.push_back({static_cast<std::uint32_t>(image.width),
+						   static_cast<std::uint32_t>(image.height),
+						   reinterpret_cast<const unsigned char*>(
+							   image.pixels.data()),
+						   image.pixels.size() * sizeof(image.pixels[0])});
+	}
+	return sources;
+}
+} // namespace
+
+auto CookTextureContainer(std::span<const DXRImageRGBA8> mips,
+						  std::vector<unsigned char>& out) -> bool
+{
+	return CookMips(DXRTextureFormat::RGBA8Unorm, GetMipSources(mips), out);
+}
+
+auto CookTextureContainer(std::span<const DXRImageRGBA32F> mips,
+						  std::vector<unsigned char>& out) -> bool
+{
+	return CookMips(DXRTextureFormat::RGBA32Float, GetMipSources(mips), out);
+}
+
+auto CookTextureContainer(std::span<const DXRCompressedImage> mips,
+						  std::vector<unsigned char>& out) -> bool
+{
+	if (mips.empty())
+		return false;
+
+	std::vector<MipSource> sources{};
+	for (const auto& image : mips)
+	{
+		if (image.format != mips[0].format)
+			return false;
+		sources.push_back({static_cast<std::uint32_t>(image.width),
+						   static_cast<std::uint32_t>(image.height),
+						   image.blocks.data(), image.blocks.size()});
+	}
+	return CookMips(mips[0].format, sources, out);
+}
+
+auto WriteTextureContainer(const char* path,
+						   std::span<const unsigned char> container) -> bool
+{
+	const auto file = std::fopen(path, "wb");
+	if (!file)
+		return false;
+
+	const auto written =
+		std::fwrite(container.data(), 1, container.size(), file);
+	const auto closed = std::fclose(file) == 0;
+	return written == container.size() && closed;
+}
+
+auto CopyTextureContainerMip(const DXRTextureContainer& container,
+							 std::uint32_t mip, DXRImageRGBA8& out) -> bool
+{
+	if (!container.IsValid() || mip >= container.GetMipCount())
+		return false;
+
+	const auto format = container.GetFormat();
+	const auto info = GetTextureFormatInfo(format);
+	const auto& desc = container.GetMip(mip);
+	const auto src = container.GetMipData(mip);
+	const std::size_t rowSize = GetRowSize(info, desc.width);
+
+	// Gather the block rows and decode them:
+	if (info.blockSize == 4)
+	{
+		DXRCompressedImage image{};
+		image.format = format;
+		image.width = static_cast<int>(desc.width);
+		image.height = static_cast<int>(desc.height);
+		image.blocks.resize(rowSize * desc.rowCount);
+		for (std::uint32_t y{}; y < desc.rowCount; y++)
+		{
+			memcpy(image.blocks.data() + y * rowSize,
+				   src + static_cast<std::size_t>(y) * desc.rowPitch, rowSize);
+		}
+		return DecodeBlockCompressed(image, out);
+	}
+
+	if (format != DXRTextureFormat::RGBA8Unorm)
+		return false;
+
+	out.width = static_cast<int>(desc.width);
+	out.height = static_cast<int>(desc.height);
+	out.pixels.resize(out.GetRowPitch() * desc.height);
+	for (std::uint32_t y{}; y < desc.rowCount; y++)
+	{
+		memcpy(out.pixels.data() + y * rowSize,
+			   src + static_cast<std::size_t>(y) * desc.rowPitch, rowSize);
+	}
+	return true;
+}
+
+auto CopyTextureContainerMip(const DXRTextureContainer& container,
+							 std::uint32_t mip, DXRImageRGBA32F& out) -> bool
+{
+	if (!container.IsValid() || mip >= container.GetMipCount() ||
+		container.GetFormat() != DXRTextureFormat::RGBA32Float)
+		return false;
+
+	const auto& desc = container.GetMip(mip);
+	const auto src = container.GetMipData(mip);
+	out.width = static_cast<int>(desc.width);
+	out.height = static_cast<int>(desc.height);
+	out.pixels.resize(static_cast<std::size_t>(desc.width) * 4 * desc.height);
+	const auto rowSize = out.GetRowPitch();
+	for (std::uint32_t y{}; y < desc.rowCount; y++)
+	{
+		memcpy(reinterpret_cast<unsigned char*>(out.pixels.data()) +
+				   y * rowSize,
+			   src + static_cast<std::size_t>(y) * desc.rowPitch, rowSize);
+	}
+	return true;
+}
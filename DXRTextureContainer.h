@@ -0,0 +1,161 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRAssets.h"
+#include "DXRMappedFile.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+// Pre-cooked texture file (.dxrt), written offline by DXRTextureCooker:
+// A small header, a mip table, then every mip already decoded (or block
+// compressed), flipped and laid out the way the GPU copy wants it (rows of
+// texels or 4x4 blocks padded to
+// k_PitchAlignment, mips starting on k_PlacementAlignment). At runtime the
+// file is mapped and the payload is handed to the upload as is, there is no
+// decode step.
+//
+// Layout:
+//   DXRTextureContainerHeader
+//   DXRTextureContainerMip[mipCount]
+//   (padding to k_PlacementAlignment)
+//   payload, mip offsets are relative to its start
+
+struct DXRTextureContainerHeader
+{
+	std::uint32_t magic{};
+	std::uint32_t version{};
+	DXRTextureFormat format{};
+	std::uint32_t width{};
+	std::uint32_t height{};
+	std::uint32_t mipCount{};
+	std::uint32_t flags{};
+	std::uint32_t reserved{};
+	std::uint64_t dataOffset{};
+	std::uint64_t dataSize{};
+};
+static_assert(sizeof(DXRTextureContainerHeader) == 48);
+
+struct DXRTextureContainerMip
+{
+	std::uint64_t offset{};
+	std::uint64_t size{};
+	std::uint32_t width{};
+	std::uint32_t height{};
+	std::uint32_t rowPitch{};
+	// Rows of texels, rows of blocks for block compressed formats:
+	std::uint32_t rowCount{};
+};
+static_assert(sizeof(DXRTextureContainerMip) == 32);
+
+struct DXRTextureContainer : DXRNonCopyable
+{
+	// "DXRT":
+	static inline constexpr std::uint32_t k_Magic{0x54525844};
+	static inline constexpr std::uint32_t k_Version{1};
+	static inline constexpr std::uint32_t k_MaxMips{16};
+
+	// Same as D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and
+	// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT:
+	static inline constexpr std::uint32_t k_PitchAlignment{256};
+	static inline constexpr std::uint32_t k_PlacementAlignment{512};
+
+	// Rows are bottom-up, like DecodeImageRGBA8() output:
+	static inline constexpr std::uint32_t k_FlagFlipped{1u << 0};
+
+	DXRTextureContainer() = default;
+
+	// Maps a .dxrt file and validates it:
+	auto Open(const char* path) -> bool;
+
+	// Validates a container that is already in memory, the memory has to
+	// outlive this:
+	auto Load(const unsigned char* data, std::size_t size) -> bool;
+
+	auto Close() -> void;
+
+	inline auto IsValid() const -> bool
+	{
+		return m_base != nullptr;
+	}
+
+	inline auto GetFormat() const -> DXRTextureFormat
+	{
+		return m_header.format;
+	}
+
+	inline auto GetWidth() const -> std::uint32_t
+	{
+		return m_header.width;
+	}
+
+	inline auto GetHeight() const -> std::uint32_t
+	{
+		return m_header.height;
+	}
+
+	inline auto GetMipCount() const -> std::uint32_t
+	{
+		return m_header.mipCount;
+	}
+
+	inline auto GetFlags() const -> std::uint32_t
+	{
+		return m_header.flags;
+	}
+
+	inline auto GetMip(std::uint32_t mip) const
+		-> const DXRTextureContainerMip&
+	{
+		DXRASSERT(mip < GetMipCount());
+		return m_mips[mip];
+	}
+
+	inline auto GetMipData(std::uint32_t mip) const -> const unsigned char*
+	{
+		return GetData() + GetMip(mip).offset;
+	}
+
+	// The whole payload, every mip at its offset:
+	inline auto GetData() const -> const unsigned char*
+	{
+		return m_base + m_header.dataOffset;
+	}
+
+	inline auto GetDataSize() const -> std::size_t
+	{
+		return static_cast<std::size_t>(m_header.dataSize);
+	}
+
+  private:
+	DXRMappedFile m_file{};
+	const unsigned char* m_base{};
+	// Copied out of the file, the payload is the only thing read in place:
+	DXRTextureContainerHeader m_header{};
+	std::array<DXRTextureContainerMip, k_MaxMips> m_mips{};
+};
+
+// Cooker side:
+// Lays out mips (level 0 first, each half the size of the previous one) as a
+// container. Returns false if the chain doesn't make sense.
+auto CookTextureContainer(std::span<const DXRImageRGBA8> mips,
+						  std::vector<unsigned char>& out) -> bool;
+auto CookTextureContainer(std::span<const DXRImageRGBA32F> mips,
+						  std::vector<unsigned char>& out) -> bool;
+// All mips need the same format:
+auto CookTextureContainer(std::span<const DXRCompressedImage> mips,
+						  std::vector<unsigned char>& out) -> bool;
+
+// Writes a cooked container to disk:
+auto WriteTextureContainer(const char* path,
+						   std::span<const unsigned char> container) -> bool;
+
+// Copies one mip back into a tightly packed image (for the CPU rasterizer),
+// block compressed mips are decoded:
+auto CopyTextureContainerMip(const DXRTextureContainer& container,
+							 std::uint32_t mip, DXRImageRGBA8& out) -> bool;
+// Same for RGBA32Float containers (HDR images, golden images), no
+// conversions:
+auto CopyTextureContainerMip(const DXRTextureContainer& container,
+							 std::uint32_t mip, DXRImageRGBA32F& out) -> bool;
@@ -0,0 +1,164 @@
+#include "DXRAssets.h"
+#include "DXRBlockCompression.h"
+#include "DXRMipGenerator.h"
+#include "DXRTextureContainer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// DXRTextureCooker <input image> <output.dxrt> [options]
+//   --no-mips      only the base level
+//   --box          box filter instead of Kaiser
+//   --srgb         average colors in linear space
+//   --bc1/--bc3/--bc7  block compress every mip
+//   --fast/--high  block compression quality (default in between)
+// Decodes anything stb_image understands and writes a .dxrt container with
+// the full mip chain, so the renderers never decode at startup. Block
+// compressed output has its base resized up to a multiple of 4, D3D12
+// doesn't take partial blocks on the top level.
+
+static auto ReadWholeFile(const char* path, std::vector<unsigned char>& out)
+	-> bool
+{
+	const auto file = std::fopen(path, "rb");
+	if (!file)
+		return false;
+
+	std::fseek(file, 0, SEEK_END);
+	const auto size = std::ftell(file);
+	std::fseek(file, 0, SEEK_SET);
+	if (size <= 0)
+	{
+		std::fclose(file);
+		return false;
+	}
+
+	out.resize(static_cast<std::size_t>(size));
+	const auto read = std::fread(out.data(), 1, out.size(), file);
+	std::fclose(file);
+	return read == out.size();
+}
+
+int main(int argc, const char* const* argv)
+{
+	if (argc < 3)
+	{
+		std::fprintf(stderr,
+					 "usage: DXRTextureCooker <input image> <output.dxrt> "
+					 "[--no-mips] [--box] [--srgb] [--bc1|--bc3|--bc7] "
+					 "[--fast|--high]\n");
+		return 1;
+	}
+	const auto inputPath = argv[1];
+	const auto outputPath = argv[2];
+
+	DXRMipGeneratorDesc desc{};
+	desc.filter = DXRMipFilter::Kaiser;
+	DXRBCEncodeDesc bcDesc{};
+	bcDesc.format = DXRTextureFormat::Unknown;
+	for (int n{3}; n < argc; n++)
+	{
+		const std::string_view option{argv[n]};
+		if (option == "--no-mips")
+		{
+			desc.maxMips = 1;
+		}
+		else if (option == "--box")
+		{
+			desc.filter = DXRMipFilter::Box;
+		}
+		else if (option == "--srgb")
+		{
+			desc.srgb = true;
+		}
+		else if (option == "--bc1")
+		{
+			bcDesc.format = DXRTextureFormat::BC1Unorm;
+		}
+		else if (option == "--bc3")
+		{
+			bcDesc.format = DXRTextureFormat::BC3Unorm;
+		}
+		else if (option == "--bc7")
+		{
+			bcDesc.format = DXRTextureFormat::BC7Unorm;
+		}
+		else if (option == "--fast")
+		{
+			bcDesc.quality = DXRBCQuality::Fast;
+		}
+		else if (option == "--high")
+		{
+			bcDesc.quality = DXRBCQuality::High;
+		}
+		else
+		{
+			std::fprintf(stderr, "DXRTextureCooker: unknown option %s\n",
+						 argv[n]);
+			return 1;
+		}
+	}
+	// The container can't hold more:
+	if (!desc.maxMips || desc.maxMips > DXRTextureContainer::k_MaxMips)
+	{
+		desc.maxMips = DXRTextureContainer::k_MaxMips;
+	}
+
+	std::vector<unsigned char> encoded{};
+	if (!ReadWholeFile(inputPath, encoded))
+	{
+		std::fprintf(stderr, "DXRTextureCooker: can't read %s\n", inputPath);
+		return 1;
+	}
+
+	DXRImageRGBA8 image{};
+	if (!DecodeImageRGBA8(encoded.data(), static_cast<int>(encoded.size()),
+						  image))
+	{
+		std::fprintf(stderr, "DXRTextureCooker: can't decode %s\n", inputPath);
+		return 1;
+	}
+
+	const auto compressed = bcDesc.format != DXRTextureFormat::Unknown;
+	if (compressed && (image.width % 4 || image.height % 4))
+	{
+		DXRImageRGBA8 resized{};
+		ResampleRGBA8(image, (image.width + 3) & ~3, (image.height + 3) & ~3,
+					  resized);
+		image = std::move(resized);
+	}
+
+	std::vector<DXRImageRGBA8> mips{};
+	if (!GenerateMipChainRGBA8(image, mips, desc))
+	{
+		std::fprintf(stderr, "DXRTextureCooker: can't build mips of %s\n",
+					 inputPath);
+		return 1;
+	}
+
+	std::vector<unsigned char> container{};
+	auto cooked = false;
+	if (compressed)
+	{
+		std::vector<DXRCompressedImage> blocks{};
+		cooked = EncodeBlockCompressedMips(mips, blocks, bcDesc) &&
+				 CookTextureContainer(blocks, container);
+	}
+	else
+	{
+		cooked = CookTextureContainer(mips, container);
+	}
+	if (!cooked || !WriteTextureContainer(outputPath, container))
+	{
+		std::fprintf(stderr, "DXRTextureCooker: can't write %s\n", outputPath);
+		return 1;
+	}
+
+	std::printf("DXRTextureCooker: %s -> %s (%dx%d, %zu mips, %zu bytes)\n",
+				inputPath, outputPath, mips[0].width, mips[0].height,
+				mips.size(), container.size());
+	return 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <array>
+#include <atomic>
+
+// Wait-free handoff of whole snapshots from one producer thread to one
+// consumer thread (std::atomic<T> of anything bigger than a register takes a
+// lock inside libatomic).
+// Three copies of T: the producer owns one (back), the consumer owns one
+// (front), the third (middle) is the latest published one. Publish() and
+// Acquire() each swap their copy with the middle one in a single atomic
+// exchange, so neither side ever waits for the other, and the consumer always
+// sees a complete T: the newest one published, or the one it already had.
+//
+// Exactly one thread may call the producer functions and exactly one thread
+// the consumer functions (they may be the same thread).
+template <typename T> struct DXRTripleBuffer : DXRNonCopyable
+{
+	inline DXRTripleBuffer(const T& initial = {})
+	{
+		for (auto& buffer : m_buffers)
+		{
+			buffer.value = initial;
+		}
+	}
+
+	// Producer: the copy to fill in before Publish(). Holds what was written
+	// there two publishes ago, not the latest value:
+	inline auto GetWriteBuffer() -> T&
+	{
+		return m_buffers[m_back].value;
+	}
+
+	// Producer: makes the write buffer the latest snapshot.
+	inline auto Publish() -> void
+	{
+		const auto previous = m_middle.exchange(
+			static_cast<std::uint8_t>(m_back | k_Fresh),
+			std::memory_order_acq_rel);
+		m_back = static_cast<std::uint8_t>(previous & k_IndexMask);
+	}
+
+	// Producer: copies value into the write buffer and publishes it.
+	inline auto Publish(const T& value) -> void
+	{
+		GetWriteBuffer() = value;
+		Publish();
+	}
+
+	// Consumer: the latest published snapshot (or the previous one if nothing
+	// was published since). Stays valid and unchanged until the next
+	// Acquire():
+	inline auto Acquire() -> const T&
+	{
+		if (m_middle.load(std::memory_order_relaxed) & k_Fresh)
+		{
+			const auto previous =
+				m_middle.exchange(m_front, std::memory_order_acq_rel);
+			m_front = static_cast<std::uint8_t>(previous & k_IndexMask);
+		}
+		return m_buffers[m_front].value;
+	}
+
+	// Consumer: what the last Acquire() returned, without looking for a
+	// newer one:
+	inline auto GetReadBuffer() const -> const T&
+	{
+		return m_buffers[m_front].value;
+	}
+
+  private:
+	static inline constexpr std::uint8_t k_IndexMask{3};
+	// Set in m_middle when the producer published it and the consumer
+	// hasn't taken it yet:
+	static inline constexpr std::uint8_t k_Fresh{4};
+
+	// Every copy and index on its own cache line, producer and consumer only
+	// share m_middle:
+	struct alignas(64) Buffer
+	{
+		T value{};
+	};
+
+	std::array<Buffer, 3> m_buffers{};
+	alignas(64) std::atomic<std::uint8_t> m_middle{1};
+	alignas(64) std::uint8_t m_back{0};
+	alignas(64) std::uint8_t m_front{2};
+};
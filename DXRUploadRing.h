@@ -0,0 +1,268 @@
+#pragma once
+
+#include "DXRCommon.h"
+
+#include <array>
+#include <utility>
+#include <vector>
+
+// Offsets into one persistent, persistently mapped upload buffer.
+// Allocations are handed out front to back and wrap around. Submit() tags
+// everything allocated since the last Submit() with the fence value that is
+// signaled after the copies reading it, Retire() frees it once the fence got
+// there. The buffer itself lives with the caller, this only does the
+// bookkeeping so it runs against any fence.
+//
+// The queue type is the same as DXRFramePacer's:
+//   auto GetCompletedValue() -> std::uint64_t;
+//   auto Wait(std::uint64_t value) -> void;    // block until completed
+// DXRWindowRenderer adapts m_d3dCommandQueue/m_d3dFence to it, benchmarks use
+// a fake fence.
+struct DXRUploadRing
+{
+	// Submits older than this many get merged into the newest one, which
+	// only delays their retirement:
+	static inline constexpr std::uint32_t k_MaxPendingSubmits{64};
+
+	inline DXRUploadRing(std::uint64_t capacity = 0)
+	{
+		Reset(capacity);
+	}
+
+	// Forgets every allocation, only call while the queue is idle or when the
+	// buffer was recreated:
+	inline auto Reset(std::uint64_t capacity) -> void
+	{
+		m_capacity = capacity;
+		m_head = 0;
+		m_tail = 0;
+		m_allocated = 0;
+		m_retired = 0;
+		m_submitBegin = 0;
+		m_submitCount = 0;
+	}
+
+	// alignment has to be a power of two. Returns false if there is no room
+	// right now, nothing is waited for:
+	inline auto Allocate(std::uint64_t size, std::uint64_t alignment,
+						 std::uint64_t& offset) -> bool
+	{
+		DXRASSERT(alignment && !(alignment & (alignment - 1)));
+		if (size > m_capacity)
+			return false;
+
+		// Nothing in use, start over at the front for the most room:
+		const auto used = GetUsedSize();
+		if (!used)
+		{
+			m_head = 0;
+			m_tail = 0;
+		}
+
+		const auto start = (m_tail + alignment - 1) & ~(alignment - 1);
+		if (!used || m_tail > m_head)
+		{
+			// Free: [tail, capacity) and [0, head)
+			if (start + size <= m_capacity)
+			{
+				return Commit(start, size, start + size - m_tail, offset);
+			}
+			// The end gets skipped, it retires with this allocation:
+			if (size <= m_head)
+			{
+				return Commit(0, size, m_capacity - m_tail + size, offset);
+			}
+		}
+		else if (m_tail < m_head)
+		{
+			// Free: [tail, head)
+			if (start + size <= m_head)
+			{
+				return Commit(start, size, start + size - m_tail, offset);
+			}
+		}
+		// tail == head with something in use: full.
+		return false;
+	}
+
+	// Allocates, retiring what the queue finished and waiting for the
+	// oldest submits if that isn't enough. Returns false if the request
+	// can't fit even with every submit retired (larger than the ring, or
+	// the ring is full of allocations that weren't submitted yet), the
+	// caller falls back to a dedicated buffer then.
+	template <typename Queue>
+	inline auto Allocate(Queue& queue, std::uint64_t size,
+						 std::uint64_t alignment, std::uint64_t& offset)
+		-> bool
+	{
+		if (Allocate(size, alignment, offset))
+			return true;
+
+		Retire(queue.GetCompletedValue());
+		if (Allocate(size, alignment, offset))
+			return true;
+
+		while (m_submitCount && size <= m_capacity)
+		{
+			const auto value = m_submits[m_submitBegin].fenceValue;
+			m_stalls++;
+			queue.Wait(value);
+			Retire(value);
+			if (Allocate(size, alignment, offset))
+				return true;
+		}
+		m_overflows++;
+		return false;
+	}
+
+	// Everything allocated since the last Submit() can be reused once
+	// fenceValue completed:
+	inline auto Submit(std::uint64_t fenceValue) -> void
+	{
+		if (m_allocated == GetSubmittedSize())
+			return;
+
+		if (m_submitCount == k_MaxPendingSubmits)
+		{
+			auto& newest = m_submits[(m_submitBegin + m_submitCount - 1) %
+									 k_MaxPendingSubmits];
+			newest = {fenceValue, m_tail, m_allocated};
+			return;
+		}
+		m_submits[(m_submitBegin + m_submitCount) % k_MaxPendingSubmits] = {
+			fenceValue, m_tail, m_allocated};
+		m_submitCount++;
+	}
+
+	// Frees every submit whose fence value is <= completedValue:
+	inline auto Retire(std::uint64_t completedValue) -> void
+	{
+		while (m_submitCount &&
+			   m_submits[m_submitBegin].fenceValue <= completedValue)
+		{
+			const auto& submit = m_submits[m_submitBegin];
+			m_head = submit.tail;
+			m_retired = submit.allocated;
+			m_submitBegin = (m_submitBegin + 1) % k_MaxPendingSubmits;
+			m_submitCount--;
+		}
+	}
+
+	inline auto GetCapacity() const -> std::uint64_t
+	{
+		return m_capacity;
+	}
+
+	// Bytes not reusable yet, including alignment padding and skipped ends:
+	inline auto GetUsedSize() const -> std::uint64_t
+	{
+		return m_allocated - m_retired;
+	}
+
+	// Bytes allocated since the last Submit():
+	inline auto GetPendingSize() const -> std::uint64_t
+	{
+		return m_allocated - GetSubmittedSize();
+	}
+
+	inline auto GetPendingSubmitCount() const -> std::uint32_t
+	{
+		return m_submitCount;
+	}
+
+	// How many queue allocations had to block on the GPU:
+	inline auto GetStallCount() const -> std::uint64_t
+	{
+		return m_stalls;
+	}
+
+	// How many queue allocations didn't fit at all:
+	inline auto GetOverflowCount() const -> std::uint64_t
+	{
+		return m_overflows;
+	}
+
+  private:
+	struct PendingSubmit
+	{
+		std::uint64_t fenceValue{};
+		// m_tail and m_allocated when it was submitted:
+		std::uint64_t tail{};
+		std::uint64_t allocated{};
+	};
+
+	inline auto Commit(std::uint64_t start, std::uint64_t size,
+					   std::uint64_t consumed, std::uint64_t& offset) -> bool
+	{
+		offset = start;
+		m_tail = start + size;
+		m_allocated += consumed;
+		return true;
+	}
+
+	inline auto GetSubmittedSize() const -> std::uint64_t
+	{
+		if (!m_submitCount)
+			return m_retired;
+		return m_submits[(m_submitBegin + m_submitCount - 1) %
+						 k_MaxPendingSubmits]
+			.allocated;
+	}
+
+	std::uint64_t m_capacity{};
+	// Oldest byte in use, next free byte:
+	std::uint64_t m_head{};
+	std::uint64_t m_tail{};
+	// Monotonic byte counters, their difference is what's in use:
+	std::uint64_t m_allocated{};
+	std::uint64_t m_retired{};
+
+	std::array<PendingSubmit, k_MaxPendingSubmits> m_submits{};
+	std::uint32_t m_submitBegin{};
+	std::uint32_t m_submitCount{};
+
+	std::uint64_t m_stalls{};
+	std::uint64_t m_overflows{};
+};
+
+// Objects that have to outlive the GPU work using them (the dedicated
+// buffers DXRUploadRing overflows into), same Submit()/Retire() protocol:
+template <typename Resource> struct DXRDeferredRelease
+{
+	inline auto Add(Resource resource) -> void
+	{
+		m_pending.push_back(std::move(resource));
+	}
+
+	inline auto Submit(std::uint64_t fenceValue) -> void
+	{
+		for (auto& resource : m_pending)
+		{
+			m_submitted.emplace_back(fenceValue, std::move(resource));
+		}
+		m_pending.clear();
+	}
+
+	// Drops everything whose fence value is <= completedValue:
+	inline auto Retire(std::uint64_t completedValue) -> void
+	{
+		std::erase_if(m_submitted, [completedValue](const auto& entry) {
+			return entry.first <= completedValue;
+		});
+	}
+
+	inline auto Clear() -> void
+	{
+		m_pending.clear();
+		m_submitted.clear();
+	}
+
+	inline auto GetCount() const -> std::size_t
+	{
+		return m_pending.size() + m_submitted.size();
+	}
+
+  private:
+	std::vector<Resource> m_pending{};
+	std::vector<std::pair<std::uint64_t, Resource>> m_submitted{};
+};
@@ -0,0 +1,135 @@
+#include "DXRVertexQuantizer.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+auto SignNotZero(float value) -> float
+{
+	return value < 0.f ? -1.f : 1.f;
+}
+
+auto DecodeSnorm8(std::int8_t value) -> float
+{
+	return std::max(static_cast<float>(value) / 127.f, -1.f);
+}
+
+// Quantized position component, scale has to be > 0:
+auto QuantizeUnorm16(float value, float offset, float scale) -> std::uint16_t
+{
+	const auto unorm = std::clamp(
+		(static_cast<double>(value) - offset) / scale, 0.0, 1.0);
+	return static_cast<std::uint16_t>(std::lround(unorm * 65535.0));
+}
+} // namespace
+
+auto EncodeOctahedral(glm::vec3 normal, std::int8_t& x, std::int8_t& y)
+	-> void
+{
+	const auto length =
+		std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (!(length > 0.f))
+	{
+		x = 0;
+		y = 0;
+		return;
+	}
+	normal /= length;
+	glm::vec2 oct{normal.x, normal.y};
+	if (normal.z < 0.f)
+	{
+		oct = {(1.f - std::abs(normal.y)) * SignNotZero(normal.x),
+			   (1.f - std::abs(normal.x)) * SignNotZero(normal.y)};
+	}
+
+	// Rounding each component on its own isn't the closest direction, try
+	// both neighbours of both:
+	const auto target = glm::normalize(normal);
+	const auto baseX = std::floor(std::clamp(oct.x, -1.f, 1.f) * 127.f);
+	const auto baseY = std::floor(std::clamp(oct.y, -1.f, 1.f) * 127.f);
+	auto bestDot = -2.f;
+	for (int n{}; n < 4; n++)
+	{
+		const auto cx = static_cast<std::int8_t>(
+			std::clamp(baseX + static_cast<float>(n & 1), -127.f, 127.f));
+		const auto cy = static_cast<std::int8_t>(
+			std::clamp(baseY + static_cast<float>(n >> 1), -127.f, 127.f));
+		const auto d = glm::dot(DecodeOctahedral(cx, cy), target);
+		if (d > bestDot)
+		{
+			bestDot = d;
+			x = cx;
+			y = cy;
+		}
+	}
+}
+
+auto DecodeOctahedral(std::int8_t x, std::int8_t y) -> glm::vec3
+{
+	glm::vec3 normal{DecodeSnorm8(x), DecodeSnorm8(y), 0.f};
+	normal.z = 1.f - std::abs(normal.x) - std::abs(normal.y);
+	if (normal.z < 0.f)
+	{
+		const auto nx = normal.x;
+		normal.x = (1.f - std::abs(normal.y)) * SignNotZero(nx);
+		normal.y = (1.f - std::abs(nx)) * SignNotZero(normal.y);
+	}
+	return glm::normalize(normal);
+}
+
+auto QuantizeVertices(std::span<const DXRVertex3D> vertices,
+					  DXRQuantizedVertices& out) -> void
+{
+	out.vertices.clear();
+	out.offset = {};
+	out.scale = 0.f;
+	if (vertices.empty())
+		return;
+
+	glm::vec3 lower{vertices[0].x, vertices[0].y, vertices[0].z};
+	auto upper = lower;
+	for (const auto& vertex : vertices)
+	{
+		const glm::vec3 position{vertex.x, vertex.y, vertex.z};
+		lower = glm::min(lower, position);
+		upper = glm::max(upper, position);
+	}
+	const auto extent = upper - lower;
+	out.offset = lower;
+	out.scale = std::max({extent.x, extent.y, extent.z});
+	// A single point, anything non-zero works:
+	const auto scale = out.scale > 0.f ? out.scale : 1.f;
+
+	out.vertices.resize(vertices.size());
+	for (std::size_t n{}; n < vertices.size(); n++)
+	{
+		const auto& in = vertices[n];
+		auto& quantized = out.vertices[n];
+		quantized.x = QuantizeUnorm16(in.x, lower.x, scale);
+		quantized.y = QuantizeUnorm16(in.y, lower.y, scale);
+		quantized.z = QuantizeUnorm16(in.z, lower.z, scale);
+		EncodeOctahedral({in.nx, in.ny, in.nz}, quantized.nx, quantized.ny);
+		quantized.u = glm::packHalf1x16(in.u);
+		quantized.v = glm::packHalf1x16(in.v);
+		quantized.col = in.col;
+	}
+}
+
+auto DequantizeVertex(const DXRVertexQuantized& vertex, glm::vec3 offset,
+					  float scale) -> DXRVertex3D
+{
+	const auto s = scale / 65535.f;
+	const auto normal = DecodeOctahedral(vertex.nx, vertex.ny);
+	return {offset.x + static_cast<float>(vertex.x) * s,
+			offset.y + static_cast<float>(vertex.y) * s,
+			offset.z + static_cast<float>(vertex.z) * s,
+			normal.x,
+			normal.y,
+			normal.z,
+			glm::unpackHalf1x16(vertex.u),
+			glm::unpackHalf1x16(vertex.v),
+			vertex.col};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+
+#include <span>
+#include <vector>
+
+// DXRVertex3D (36 bytes) to DXRVertexQuantized (16 bytes):
+//   Position: one uniform scale for all axes (the largest bounds extent),
+//   so the dequantization is a translate + uniform scale that can be folded
+//   into the model matrix and normals stay unaffected. Error per axis is at
+//   most scale / 65535 / 2, plus float rounding.
+//   Normal: octahedral, the snorm8 pair out of the 4 nearest that decodes
+//   closest to the input (Cigolle et al. 2014), under 0.7 degrees off.
+//   UV: half floats, within [0, 1] off by at most 1/4096.
+//   Color: copied.
+struct DXRQuantizedVertices
+{
+	std::vector<DXRVertexQuantized> vertices{};
+	// position = offset + scale * (xyz / 65535):
+	glm::vec3 offset{};
+	float scale{};
+
+	// The dequantization of the unorm (0 to 1) position the input assembler
+	// fetches, as a model matrix for DXRGraphicsConstants (row vector
+	// convention, like CameraManager's matrices):
+	inline auto GetPositionTransform() const -> glm::mat4
+	{
+		glm::mat4 transform{1.f};
+		transform[0][0] = scale;
+		transform[1][1] = scale;
+		transform[2][2] = scale;
+		transform[3] = glm::vec4{offset, 1.f};
+		return glm::transpose(transform);
+	}
+};
+
+// Empty input gives empty output:
+auto QuantizeVertices(std::span<const DXRVertex3D> vertices,
+					  DXRQuantizedVertices& out) -> void;
+
+// What the quantized vertex shader computes before the model matrix, with
+// the position already dequantized:
+auto DequantizeVertex(const DXRVertexQuantized& vertex, glm::vec3 offset,
+					  float scale) -> DXRVertex3D;
+
+// Octahedral normal mapping, snorm8 in and out. Input doesn't need to be
+// normalized, zero vectors map to +Z:
+auto EncodeOctahedral(glm::vec3 normal, std::int8_t& x, std::int8_t& y)
+	-> void;
+auto DecodeOctahedral(std::int8_t x, std::int8_t y) -> glm::vec3;
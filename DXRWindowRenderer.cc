@@ -8,8 +8,52 @@
 #include <sstream>
 #endif
 
+// D3DCompile's output changes with the compiler, part of every cache key:
+static auto GetShaderCacheDesc() -> DXRShaderCacheDesc
+{
+	DXRShaderCacheDesc desc{};
+	desc.directory = "shadercache";
+	desc.salt = std::string{"D3DCompile "} +
+				std::to_string(D3D_COMPILER_VERSION) + " flags 0";
+	return desc;
+}
+
 DXRWindowRenderer::DXRWindowRenderer(W32Window* window)
+	: m_shaderCache(GetShaderCacheDesc()),
+	  m_pipelines({this}, DXRJobSystem::GetInstance())
 {
+	using Object = D3D12Object;
+	m_objects.DependsOn(Object::DeviceAndSwapChain,
+						{Object::FactoryAndAdapter});
+	m_objects.DependsOn(Object::SwapChainSize, {Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::Heaps, {Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::RenderTargets,
+						{Object::SwapChainSize, Object::Heaps});
+	m_objects.DependsOn(Object::CommandAllocators,
+						{Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::CommandList, {Object::CommandAllocators});
+	m_objects.DependsOn(Object::Fence, {Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::UploadRing, {Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::InstanceBuffers, {Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::RootSignature, {Object::DeviceAndSwapChain});
+	m_objects.DependsOn(Object::PipelineState, {Object::RootSignature});
+	m_objects.DependsOn(Object::DepthBuffer,
+						{Object::SwapChainSize, Object::Heaps});
+#ifndef DXRDISABLED2D
+	m_objects.DependsOn(Object::D3D11On12DeviceAndContext,
+						{Object::SwapChainSize, Object::CommandList});
+	m_objects.DependsOn(Object::D2DFactory, {Object::SwapChainSize});
+	m_objects.DependsOn(
+		Object::D2DDeviceAndContext,
+		{Object::D3D11On12DeviceAndContext, Object::D2DFactory});
+	m_objects.DependsOn(Object::D2DBrushes, {Object::D2DDeviceAndContext});
+	m_objects.DependsOn(Object::D2D1RenderTargets,
+						{Object::RenderTargets, Object::D2DDeviceAndContext});
+#endif
+	m_objects.DependsOn(Object::RenderingAssets,
+						{Object::Heaps, Object::CommandList, Object::Fence,
+						 Object::UploadRing});
+
 	m_window = window;
 	if (m_window)
 	{
@@ -23,6 +67,7 @@ DXRWindowRenderer::DXRWindowRenderer(W32Window* window)
 			}
 		}
 	}
+	m_resizes.SetCurrent(m_width, m_height);
 }
 
 DXRWindowRenderer::~DXRWindowRenderer()
@@ -32,6 +77,7 @@ DXRWindowRenderer::~DXRWindowRenderer()
 		SignalFence();
 		WaitFence();
 	}
+	SaveD3D12PipelineLibrary();
 }
 
 auto DXRWindowRenderer::DebugPrint(std::string_view msg) -> void
@@ -49,18 +95,31 @@ auto DXRWindowRenderer::TestSucceeded(NTNamespace::HRESULT hr) -> bool
 	return false;
 }
 
-auto DXRWindowRenderer::CompileShaderToByteCode(const char* source,
-												size_t& size_out,
-												const char* entry,
-												const char* target)
-	-> unsigned char*
+auto DXRWindowRenderer::CompileShaderToByteCode(const DXRShaderDesc& desc,
+												std::vector<unsigned char>& out)
+	-> bool
 {
+	// D3DCompile wants zero terminated strings, the desc has views:
+	std::vector<std::string> strings{};
+	strings.reserve(desc.defines.size() * 2 + 2);
+	std::vector<::D3D_SHADER_MACRO> macros{};
+	for (const auto& define : desc.defines)
+	{
+		const auto& name = strings.emplace_back(define.name);
+		const auto& value = strings.emplace_back(define.value);
+		macros.push_back({name.c_str(), value.c_str()});
+	}
+	macros.push_back({nullptr, nullptr});
+	const auto& entry = strings.emplace_back(desc.entry);
+	const auto& target = strings.emplace_back(desc.target);
+
 	COMPtr<::ID3DBlob> shaderBlob;
 	COMPtr<::ID3DBlob> errorBlob;
-	auto hr =
-		::D3DCompile(source, strlen(source), nullptr, nullptr, nullptr, entry,
-					 target, 0, 0, shaderBlob.Out(), errorBlob.Out());
-	if (!DXRSUCCESSTEST(hr))
+	auto hr = ::D3DCompile(desc.source.data(), desc.source.size(), nullptr,
+						   macros.data(), nullptr, entry.c_str(),
+						   target.c_str(), 0, 0, shaderBlob.Out(),
+						   errorBlob.Out());
+	if (!DXRSUCCESSTEST(hr) || !shaderBlob)
 	{
 		if (errorBlob)
 		{
@@ -69,20 +128,23 @@ auto DXRWindowRenderer::CompileShaderToByteCode(const char* source,
 					   errorBlob->GetBufferSize());
 			DebugPrint(err);
 		}
-		DXRASSERT(0);
+		return false;
 	}
-	DXRASSERT(shaderBlob);
-	size_out = shaderBlob->GetBufferSize();
-	const auto buffer = new unsigned char[size_out];
-	memcpy(buffer, shaderBlob->GetBufferPointer(), size_out);
-	return buffer;
+	const auto data =
+		static_cast<const unsigned char*>(shaderBlob->GetBufferPointer());
+	out.assign(data, data + shaderBlob->GetBufferSize());
+	return true;
 }
 
 auto DXRWindowRenderer::DeviceLost() -> void
 {
-	for (NTNamespace::UINT n{}; n < k_NumSwapChainBuffers; n++)
+	for (NTNamespace::UINT n{}; n < k_MaxFramesInFlight; n++)
 	{
 		m_d3dCommandAllocators[n].Reset();
+		m_d3dSoftwareUploadBuffers[n].Reset();
+	}
+	for (NTNamespace::UINT n{}; n < k_NumSwapChainBuffers; n++)
+	{
 		m_d3dRenderTargets[n].Reset();
 #ifndef DXRDISABLED2D
 		m_d3d11WrappedRenderTargets[n].Reset();
@@ -99,13 +161,36 @@ auto DXRWindowRenderer::DeviceLost() -> void
 	m_d3d11Device.Reset();
 #endif
 
+	m_d3dUploadOverflow.Clear();
+	m_d3dUploadRingBuffer.Reset();
+	m_uploadRingMapped = nullptr;
+	m_d3dUploadCommandAllocator.Reset();
+	m_uploadsRecording = false;
+	m_uploadFenceValue = 0;
+	for (auto& buffer : m_d3dInstanceBuffers)
+	{
+		buffer.Reset();
+	}
+	m_instanceBuffersMapped = {};
+	m_d3dTexture.Reset();
 	m_d3dFence.Reset();
 	m_d3dDepthStencilBuffer.Reset();
 	m_d3dDsvDescriptorHeap.Reset();
-	m_d3dPipelineState.Reset();
+	SaveD3D12PipelineLibrary();
+	m_pipelines.Clear();
+	m_scenePipeline = {};
+	m_d3dPipelineLibrary.Reset();
 	m_d3dSrvDescriptorHeap.Reset();
 	m_d3dRtvDescriptorHeap.Reset();
 	m_d3dVertexBuffer.Reset();
+	m_d3dIndexBuffer.Reset();
+	// Every placed resource is gone, their heaps go with the device:
+	m_vertexBufferMemory = {};
+	m_indexBufferMemory = {};
+	m_textureMemory = {};
+	m_depthBufferMemory = {};
+	m_d3dHeaps.clear();
+	m_gpuMemory.Reset();
 	m_d3dRootSignature.Reset();
 	m_d3dCommandList.Reset();
 	m_d3dRtvDescriptorHeap.Reset();
@@ -119,147 +204,208 @@ auto DXRWindowRenderer::DeviceLost() -> void
 	m_dxgiDebug.Reset();
 #endif
 
+	m_objects.InvalidateAll();
 	ValidateAndCreateObjects();
 }
 
 auto DXRWindowRenderer::OnResize(NTNamespace::UINT w, NTNamespace::UINT h)
 -> void
 {
-	std::lock_guard<std::mutex> lock{m_renderExecutionMutex};
-	if (m_width != w || m_height != h)
-	{
-		m_width = w;
-		m_height = h;
+	// No lock and no GPU wait, dragging the window edge must not stall
+	// either thread:
+	m_resizes.Publish(w, h);
+}
+
+auto DXRWindowRenderer::ApplyResize() -> void
+{
+	DXRResizeSize size{};
+	if (!m_resizes.Poll(size))
+		return;
 
-		if (m_dxgiSwapChain)
+	m_width = size.width;
+	m_height = size.height;
+
+	if (m_dxgiSwapChain)
+	{
+		if (m_d3dCommandQueue && m_d3dFence)
 		{
-			if (m_width > 0 && m_height > 0)
-			{
-				if (m_d3dCommandQueue && m_d3dFence)
-				{
-					SignalFence();
-					WaitFence();
-				}
+			SignalFence();
+			WaitFence();
+		}
 
 #ifndef DXRDISABLED2D
-				if (m_d2dDeviceContext)
-					m_d2dDeviceContext->SetTarget(nullptr);
-				if (m_d3d11DeviceContext)
-					m_d3d11DeviceContext->Flush();
+		if (m_d2dDeviceContext)
+			m_d2dDeviceContext->SetTarget(nullptr);
+		if (m_d3d11DeviceContext)
+			m_d3d11DeviceContext->Flush();
 
-				m_d2dSolidColorBrush.Reset();
-				for (auto& v : m_d2dRenderTargets)
-				{
-					v.Reset();
-				}
-				m_d2dDeviceContext.Reset();
-				m_d2dDevice.Reset();
-				m_d2dFactory.Reset();
+		m_d2dSolidColorBrush.Reset();
+		for (auto& v : m_d2dRenderTargets)
+		{
+			v.Reset();
+		}
+		m_d2dDeviceContext.Reset();
+		m_d2dDevice.Reset();
+		m_d2dFactory.Reset();
 
-				if (m_d3d11On12Device)
+		if (m_d3d11On12Device)
+		{
+			for (auto& v : m_d3d11WrappedRenderTargets)
+			{
+				if (v.Get())
 				{
-					for (auto& v : m_d3d11WrappedRenderTargets)
-					{
-						if (v.Get())
-						{
-							ID3D11Resource* ppResources[] = {v.Get()};
-							m_d3d11On12Device->ReleaseWrappedResources(
-								ppResources, 1);
-							v.Reset();
-						}
-					}
+					ID3D11Resource* ppResources[] = {v.Get()};
+					m_d3d11On12Device->ReleaseWrappedResources(ppResources, 1);
+					v.Reset();
 				}
+			}
+		}
 
-				m_d3d11On12Device.Reset();
-				m_d3d11DeviceContext.Reset();
-				m_d3d11Device.Reset();
+		m_d3d11On12Device.Reset();
+		m_d3d11DeviceContext.Reset();
+		m_d3d11Device.Reset();
 
 #endif
 
-				m_fenceValue = 0;
+		for (auto& v : m_d3dRenderTargets)
+		{
+			v.Reset();
+		}
+		for (auto& v : m_d3dSoftwareUploadBuffers)
+		{
+			v.Reset();
+		}
 
-				for (auto& v : m_d3dRenderTargets)
-				{
-					v.Reset();
-				}
+		m_d3dDepthStencilBuffer.Reset();
+		m_gpuMemory.Free(m_depthBufferMemory);
+		m_depthBufferMemory = {};
+		ReleaseD3D12Heaps();
+
+		// Not inside DXRASSERT, release builds have to resize too:
+		::DXGI_SWAP_CHAIN_DESC1 desc{};
+		auto hr = m_dxgiSwapChain->GetDesc1(&desc);
+		DXRASSERT(DXRSUCCESSTEST(hr));
+		hr = m_dxgiSwapChain->ResizeBuffers(k_NumSwapChainBuffers, m_width,
+											m_height, desc.Format, desc.Flags);
+		DXRASSERT(DXRSUCCESSTEST(hr));
+		(void)hr;
+	}
 
-				m_d3dDepthStencilBuffer.Reset();
+	// Everything released above, or nothing created yet:
+	m_objects.Invalidate(D3D12Object::SwapChainSize);
+}
 
-				::DXGI_SWAP_CHAIN_DESC1 desc{};
-				DXRASSERT(DXRSUCCESSTEST(m_dxgiSwapChain->GetDesc1(&desc)));
-				DXRASSERT(DXRSUCCESSTEST(m_dxgiSwapChain->ResizeBuffers(
-					k_NumSwapChainBuffers, m_width, m_height, desc.Format,
-					desc.Flags)));
-			}
-		}
+auto DXRWindowRenderer::SetFramesInFlight(NTNamespace::UINT frames) -> void
+{
+	std::lock_guard<std::mutex> lock{m_renderExecutionMutex};
+	if (m_d3dCommandQueue && m_d3dFence)
+	{
+		SignalFence();
+		WaitFence();
 	}
+	// Missing command allocators get created by the next
+	// ValidateAndCreateObjects():
+	m_framePacer.SetFramesInFlight(frames);
+	m_objects.Invalidate(D3D12Object::CommandAllocators);
 }
 
-auto DXRWindowRenderer::ValidateAndCreateObjects() -> bool
+auto DXRWindowRenderer::CreateD3D12Object(D3D12Object object) -> bool
 {
-	if (!CreateDXGIFactoryAndAdapter())
-		return false;
-
-	if (!CreateD3D12DeviceAndSwapChain())
-		return false;
-
-	if (!CreateD3D12Heaps())
-		return false;
-
-	if (!CreateD3D12RenderTargets())
-		return false;
-
-	if (!CreateD3D12CommandAllocators())
-		return false;
-
-	if (!CreateD3D12CommandList())
-		return false;
-
-	if (!CreateD3D12Fence())
-		return false;
-
-	if (!CreateD3D12RootSignature())
-		return false;
-
-	if (!CreateD3D12PipelineState())
-		return false;
-
-	if (!CreateD3D12DepthBuffer())
-		return false;
-
+	switch (object)
+	{
+	case D3D12Object::FactoryAndAdapter:
+		return CreateDXGIFactoryAndAdapter();
+	case D3D12Object::DeviceAndSwapChain:
+		return CreateD3D12DeviceAndSwapChain();
+	case D3D12Object::SwapChainSize:
+		// OnResize() already resized the buffers:
+		return true;
+	case D3D12Object::Heaps:
+		return CreateD3D12Heaps();
+	case D3D12Object::RenderTargets:
+		return CreateD3D12RenderTargets();
+	case D3D12Object::CommandAllocators:
+		return CreateD3D12CommandAllocators();
+	case D3D12Object::CommandList:
+		return CreateD3D12CommandList();
+	case D3D12Object::Fence:
+		return CreateD3D12Fence();
+	case D3D12Object::UploadRing:
+		return CreateD3D12UploadRing();
+	case D3D12Object::InstanceBuffers:
+		return CreateD3D12InstanceBuffers();
+	case D3D12Object::RootSignature:
+		return CreateD3D12RootSignature();
+	case D3D12Object::PipelineState:
+		// Optional, pipelines are created without it:
+		CreateD3D12PipelineLibrary();
+		return CreateD3D12PipelineState();
+	case D3D12Object::DepthBuffer:
+		return CreateD3D12DepthBuffer();
 #ifndef DXRDISABLED2D
-
-	if (!CreateD3D11On12DeviceAndContext())
-		return false;
-
-	if (!CreateD2DFactory())
-		return false;
-
-	if (!CreateD2DDeviceAndContext())
-		return false;
-
-	if (!CreateD2DBrushes())
-		return false;
-
-	if (!CreateD2D1RenderTargets())
-		return false;
-
+	case D3D12Object::D3D11On12DeviceAndContext:
+		return CreateD3D11On12DeviceAndContext();
+	case D3D12Object::D2DFactory:
+		return CreateD2DFactory();
+	case D3D12Object::D2DDeviceAndContext:
+		return CreateD2DDeviceAndContext();
+	case D3D12Object::D2DBrushes:
+		return CreateD2DBrushes();
+	case D3D12Object::D2D1RenderTargets:
+		return CreateD2D1RenderTargets();
 #endif
+	case D3D12Object::RenderingAssets:
+		return LoadRenderingAssets();
+	case D3D12Object::Count:
+		break;
+	}
+	return false;
+}
 
-	return true;
+auto DXRWindowRenderer::ValidateAndCreateObjects() -> bool
+{
+	// Assets go through the upload path, RenderAll() loads them once the
+	// frame slot is known:
+	constexpr auto k_DeviceObjects =
+		~decltype(m_objects)::GetMask(D3D12Object::RenderingAssets);
+	return m_objects.Rebuild(
+		[this](D3D12Object object) { return CreateD3D12Object(object); },
+		k_DeviceObjects);
 }
 
 auto DXRWindowRenderer::RenderAll() -> bool
 {
 	std::lock_guard<std::mutex> lock{m_renderExecutionMutex};
 
-	if (!ValidateAndCreateObjects())
+	// Between frames, the previous one is submitted:
+	ApplyResize();
+
+	// Nothing to do unless a resize, device loss or asset reload
+	// invalidated something:
+	if (!m_objects.IsClean() && !ValidateAndCreateObjects())
 		return false;
 
-	if (!LoadRenderingAssets())
+	// Only blocks if this slot's previous frame is still on the GPU:
+	D3D12FrameQueue queue{this};
+	m_frameSlot = m_framePacer.BeginFrame(queue);
+	const auto completed = queue.GetCompletedValue();
+	m_srvDescriptors.Retire(completed);
+	m_rtvDescriptors.Retire(completed);
+	m_dsvDescriptors.Retire(completed);
+
+	if (!m_objects.IsClean() &&
+		!m_objects.Rebuild(
+			[this](D3D12Object object) { return CreateD3D12Object(object); }))
 		return false;
 
-	SubmitD3D12();
+	if (m_isWARPAdapter)
+	{
+		SubmitSoftware();
+	}
+	else
+	{
+		SubmitD3D12();
+	}
 
 #ifndef DXRDISABLED2D
 
@@ -267,7 +413,12 @@ auto DXRWindowRenderer::RenderAll() -> bool
 
 #endif
 
-	SignalFence();
+	m_framePacer.EndFrame(queue);
+	// Transient tables and freed views of this frame come back with it:
+	const auto frameFenceValue = m_framePacer.GetLastSignaledValue();
+	m_srvDescriptors.Submit(frameFenceValue);
+	m_rtvDescriptors.Submit(frameFenceValue);
+	m_dsvDescriptors.Submit(frameFenceValue);
 
 	auto hr = m_dxgiSwapChain->Present(m_presentWithVsync ? 1 : 0, 0);
 	if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
@@ -275,14 +426,33 @@ auto DXRWindowRenderer::RenderAll() -> bool
 		DeviceLost();
 	}
 
-	WaitFence();
-
 	m_previousFrameIndex = m_frameIndex;
 	m_frameIndex = m_dxgiSwapChain->GetCurrentBackBufferIndex();
 
 	return true;
 }
 
+auto DXRWindowRenderer::ReloadRenderingAssets() -> void
+{
+	std::lock_guard<std::mutex> lock{m_renderExecutionMutex};
+	if (m_d3dCommandQueue && m_d3dFence)
+	{
+		SignalFence();
+		WaitFence();
+	}
+	m_d3dVertexBuffer.Reset();
+	m_d3dIndexBuffer.Reset();
+	m_d3dTexture.Reset();
+	for (auto* memory :
+		 {&m_vertexBufferMemory, &m_indexBufferMemory, &m_textureMemory})
+	{
+		m_gpuMemory.Free(*memory);
+		*memory = {};
+	}
+	ReleaseD3D12Heaps();
+	m_objects.Invalidate(D3D12Object::RenderingAssets);
+}
+
 auto DXRWindowRenderer::Update(float dt) -> void
 {
 	(void)dt;
@@ -297,12 +467,13 @@ auto DXRWindowRenderer::Update(float dt) -> void
 	m_d3dScissorRect.top = 0;
 	m_d3dScissorRect.right = static_cast<NTNamespace::LONG>(m_width);
 	m_d3dScissorRect.bottom = static_cast<NTNamespace::LONG>(m_height);
+}
 
-	const auto cam = CameraManager::GetInstance();
-	CameraMatrices matrices{};
-	matrices.view = cam->GetViewMatrix();
-	matrices.projection = cam->GetProjectionMatrix();
-	m_atomicCamera.store(matrices);
-	
-	
+auto DXRWindowRenderer::SetInstances(std::span<const DXRInstance> instances)
+	-> void
+{
+	// The render thread keeps reading the set it acquired last:
+	auto& buffer = m_instances.GetWriteBuffer();
+	buffer.assign(instances.begin(), instances.end());
+	m_instances.Publish();
 }
\ No newline at end of file
@@ -3,6 +3,27 @@
 // Define to disable D2D rendering alltogether:
 #define DXRDISABLED2D
 
+// DXRQUANTIZEDVERTICES draws with DXRVertexQuantized (16 bytes) instead of
+// DXRVertex3D (36 bytes). Off by default, CMake defines it with
+// -DDXR_QUANTIZED_VERTICES=ON.
+
+#include "DXRCommon.h"
+#include "DXRRenderTypes.h"
+#include "DXRAssets.h"
+#include "DXRDescriptorAllocator.h"
+#include "DXRFixedTimestep.h"
+#include "DXRFramePacer.h"
+#include "DXRGpuHeapAllocator.h"
+#include "DXRInstancePacker.h"
+#include "DXRObjectLifetime.h"
+#include "DXRResizeCoalescer.h"
+#include "DXRPipelineRegistry.h"
+#include "DXRRenderGraph.h"
+#include "DXRShaderCache.h"
+#include "DXRSoftwareRasterizer.h"
+#include "DXRTextureContainer.h"
+#include "DXRTripleBuffer.h"
+#include "DXRUploadRing.h"
 #include "COMPtr.h"
 #include "W32Handle.h"
 #include "W32Platform.h"
@@ -23,12 +44,14 @@
 
 #include <array>
 #include <cassert>
+#include <memory>
 #include <mutex>
+#include <span>
+#include <vector>
 #include <atomic>
 
 #include <glm/glm.hpp>
 
-#define DXRASSERT(x) assert(x)
 #define DXRSUCCESSTEST DXRWindowRenderer::TestSucceeded
 
 struct DXRWindowRenderer
@@ -42,16 +65,16 @@ struct DXRWindowRenderer
 // Mark functions that should only be called from the win32 thread:
 #define DXRWIN32THREAD
 
-	// Called by the win32 wndproc handler (on a seperate thread):
+	// Called by the win32 wndproc handler (on a seperate thread). Only
+	// publishes the size, RenderAll() resizes the swap chain:
 	auto OnResize(NTNamespace::UINT w,
 				  NTNamespace::UINT h) DXRWIN32THREAD->void;
 
-	// Compiles a shader to bytecode:
-	// Returns an owning pointer from new unsigned char[].
-	static auto CompileShaderToByteCode(const char* source, size_t& size_out,
-										const char* entry = "main",
-										const char* target = "vs_5_0")
-		-> unsigned char*;
+	// Compiles a shader to bytecode with D3DCompile, errors go to
+	// DebugPrint(). m_shaderCache calls this on a miss:
+	static auto CompileShaderToByteCode(const DXRShaderDesc& desc,
+										std::vector<unsigned char>& out)
+		-> bool;
 
 	auto DeviceLost() -> void;
 
@@ -61,9 +84,20 @@ struct DXRWindowRenderer
 	// m_d3dDevice, m_d3dCommandQueue, m_d3dSwapChain:
 	auto CreateD3D12DeviceAndSwapChain() -> bool;
 
-	// m_d3dRtvDescriptorHeap, m_d3dDsvDescriptorHeap:
+	// m_d3dRtvDescriptorHeap, m_d3dDsvDescriptorHeap, m_d3dSrvDescriptorHeap
+	// and the views every renderer has (back buffers, depth, texture):
 	auto CreateD3D12Heaps() -> bool;
 
+	// Handles of a descriptor index in a heap:
+	static auto GetD3D12CPUDescriptorHandle(::ID3D12DescriptorHeap* heap,
+											NTNamespace::UINT size,
+											std::uint32_t index)
+		-> ::D3D12_CPU_DESCRIPTOR_HANDLE;
+	static auto GetD3D12GPUDescriptorHandle(::ID3D12DescriptorHeap* heap,
+											NTNamespace::UINT size,
+											std::uint32_t index)
+		-> ::D3D12_GPU_DESCRIPTOR_HANDLE;
+
 	// m_d3dRenderTargets:
 	// Render targets are swapchain size dependent:
 	auto CreateD3D12RenderTargets() -> bool;
@@ -80,17 +114,56 @@ struct DXRWindowRenderer
 	// m_d3dRootSignature:
 	auto CreateD3D12RootSignature() -> bool;
 
-	// m_d3dPipelineState:
+	// m_scenePipeline, waits until it is created:
 	auto CreateD3D12PipelineState() -> bool;
 
+	// One pipeline of m_pipelines, on a worker thread. Its shaders have to be
+	// in m_shaderCache. Comes from m_d3dPipelineLibrary if it has it and
+	// goes into it otherwise:
+	auto CreateD3D12PipelineState(const DXRPipelineKey& key,
+								  COMPtr<::ID3D12PipelineState>& out) -> bool;
+
+	// m_d3dPipelineLibrary, from last run's blob if the driver still takes
+	// it. Without ID3D12Device1 pipelines are created without a library:
+	auto CreateD3D12PipelineLibrary() -> bool;
+
+	// Serializes m_d3dPipelineLibrary if pipelines were added to it:
+	auto SaveD3D12PipelineLibrary() -> void;
+
 	// m_d3dDepthStencilBuffer
 	// Depth stencil buffer is swapchain size dependent:
 	auto CreateD3D12DepthBuffer() -> bool;
 
+	// Textures are placed in m_gpuMemory, Free() allocation with them:
 	auto
 	CreateD3D12TextureFromImageData(const void* imageData, int size,
-									COMPtr<::ID3D12Resource>& textureResource)
-		-> bool;
+									COMPtr<::ID3D12Resource>& textureResource,
+									DXRGpuAllocation& allocation) -> bool;
+
+	// Pre-compressed BCn mips (DXRBlockCompression.h), level 0 first:
+	auto
+	CreateD3D12TextureFromImageData(std::span<const DXRCompressedImage> mips,
+									COMPtr<::ID3D12Resource>& textureResource,
+									DXRGpuAllocation& allocation) -> bool;
+
+	// Uploads every mip of a cooked container, no decoding:
+	auto
+	CreateD3D12TextureFromContainer(const DXRTextureContainer& container,
+									COMPtr<::ID3D12Resource>& textureResource,
+									DXRGpuAllocation& allocation) -> bool;
+
+	// Places a default heap resource in m_gpuMemory, creating the
+	// ID3D12Heap when the allocation lands in a new one:
+	auto CreateD3D12PlacedResource(const ::D3D12_RESOURCE_DESC& desc,
+								   DXRGpuHeapKind kind,
+								   ::D3D12_RESOURCE_STATES initialState,
+								   const ::D3D12_CLEAR_VALUE* clearValue,
+								   COMPtr<::ID3D12Resource>& resourceOut,
+								   DXRGpuAllocation& allocation) -> bool;
+
+	// Destroys the ID3D12Heaps m_gpuMemory released, only once the GPU is
+	// done with the resources that were placed in them:
+	auto ReleaseD3D12Heaps() -> void;
 
 #ifndef DXRDISABLED2D
 	// All D2D related resources are swapchain size dependent:
@@ -111,24 +184,88 @@ struct DXRWindowRenderer
 	auto CreateD2DBrushes() -> bool;
 #endif
 
-	// Creates Vertex3D buffer:
+	// Creates a buffer in the upload heap (CPU writable, GPU readable):
 	auto CreateD3D12GPUUploadBuffer(std::intptr_t size,
 									COMPtr<::ID3D12Resource>& resourceOut)
 		-> bool;
 
+	// m_d3dUploadRingBuffer, m_d3dUploadCommandAllocator:
+	auto CreateD3D12UploadRing() -> bool;
+
+	// m_d3dInstanceBuffers, one persistently mapped upload buffer per frame
+	// slot:
+	auto CreateD3D12InstanceBuffers() -> bool;
+
+	// Where one upload's data goes, the copy reads it from resource at
+	// offset:
+	struct D3D12UploadAllocation
+	{
+		::ID3D12Resource* resource{};
+		NTNamespace::UINT64 offset{};
+		unsigned char* cpuAddress{};
+	};
+
+	// Upload memory for the current batch, opens it if needed.
+	// Comes from m_uploadRing, or a dedicated upload buffer if the ring
+	// can't fit it:
+	auto AllocateD3D12Upload(NTNamespace::UINT64 size,
+							 NTNamespace::UINT64 alignment,
+							 D3D12UploadAllocation& out) -> bool;
+
+	// Starts recording copies on m_d3dCommandList (no-op if already
+	// recording):
+	auto BeginD3D12Uploads() -> void;
+
+	// Submits every copy recorded since BeginD3D12Uploads() in one
+	// ExecuteCommandLists() and signals the fence that retires its upload
+	// memory. Doesn't wait, later work on the queue runs after the copies:
+	auto FlushD3D12Uploads() -> void;
+
+	// Default heap buffer placed in m_gpuMemory and filled through the
+	// upload ring, ends up in stateAfter:
+	auto CreateD3D12BufferFromData(const void* data, NTNamespace::UINT64 size,
+								   ::D3D12_RESOURCE_STATES stateAfter,
+								   COMPtr<::ID3D12Resource>& resourceOut,
+								   DXRGpuAllocation& allocation) -> bool;
+
 	// Creates assets:
 	auto LoadRenderingAssets() -> bool;
 
-	// Creates all objects that are needed for rendering:
+	// Drops the mesh and texture, the next frame loads them again:
+	auto ReloadRenderingAssets() -> void;
+
+	// Resizes the swap chain to the last size OnResize() published once it
+	// settled. Waits for the frames in flight first, ResizeBuffers() needs
+	// the GPU done with the old buffers:
+	auto ApplyResize() -> void;
+
+	// Creates the device objects that are needed for rendering and were
+	// invalidated since the last call (all of them the first time). Assets
+	// are left to RenderAll():
 	auto ValidateAndCreateObjects() -> bool;
 
 	// Signals m_d3dFence:
 	auto SignalFence() -> void;
 	// Wait for m_d3dFence:
+	// SignalFence() + WaitFence() drains the GPU completely.
 	auto WaitFence() -> void;
 
+	// How many frames the CPU may record ahead of the GPU:
+	auto SetFramesInFlight(NTNamespace::UINT frames) -> void;
+
+	// Camera + model constants for this frame:
+	auto GetFrameGraphicsConstants() -> GraphicsConstants;
+
 	// Submits the D3D12 command list to the command queue:
 	auto SubmitD3D12() -> void;
+	// One batch of m_renderGraphPlan's barriers as one ResourceBarrier().
+	// resources maps the graph's resource indices to D3D12 resources:
+	auto RecordRenderGraphBarriers(std::span<::ID3D12Resource* const> resources,
+								   std::uint32_t begin, std::uint32_t count)
+		-> void;
+	// WARP fallback: rasterizes the frame on the CPU and copies it into the
+	// back buffer:
+	auto SubmitSoftware() -> void;
 	// Submits D2D's command list to the command queue:
 	auto SubmitD2D() -> void;
 
@@ -138,27 +275,20 @@ struct DXRWindowRenderer
 	// Updates everything:
 	auto Update(float dt) -> void;
 
+	// Cube instances drawn by the scene pass, one identity instance by
+	// default, at most k_MaxInstances are drawn. Published to the render
+	// thread, its next frame draws the newest set. One thread (the update
+	// loop):
+	auto SetInstances(std::span<const DXRInstance> instances) -> void;
+
 	// Viewport:
 	::D3D12_VIEWPORT m_d3dViewport{};
 	::D3D12_RECT m_d3dScissorRect{};
 
 	// Vertex layout struct:
-	struct Vertex3D
-	{
-		float x, y, z;
-		float nx, ny, nz;
-		float u, v;
-		uint32_t col;
-	};
+	using Vertex3D = DXRVertex3D;
 	// Constant buffer for shaders:
-	struct GraphicsConstants
-	{
-		glm::mat4 projection;
-		glm::mat4 view;
-		glm::mat4 model;
-		static_assert(sizeof(float[4][4]) == sizeof(glm::mat4),
-					  "Something is terribly wrong! The union is invalid...");
-	};
+	using GraphicsConstants = DXRGraphicsConstants;
 
 	static constexpr auto k_GraphicsConstantsSize{sizeof(GraphicsConstants)};
 	static constexpr auto k_GraphicsConstantsNum32Bit{k_GraphicsConstantsSize /
@@ -169,6 +299,42 @@ struct DXRWindowRenderer
 	// Use m_frameIndex to index the current buffer.
 	static inline constexpr auto k_NumSwapChainBuffers{2};
 
+	// Per-frame resources (command allocators, upload memory) are indexed by
+	// m_frameSlot, which m_framePacer hands out:
+	static inline constexpr auto k_MaxFramesInFlight{
+		DXRFramePacer::k_MaxFramesInFlight};
+
+	// Upload ring size, big enough for the startup texture with all its mips:
+	static inline constexpr NTNamespace::UINT64 k_UploadRingSize{32ull << 20};
+
+	// Instances per draw, 8MB of DXRInstanceData per frame slot:
+	static inline constexpr NTNamespace::UINT k_MaxInstances{1u << 17};
+
+	// Descriptor heap sizes, persistent and per frame. The SRV heap is the
+	// shader visible one, bindless indices are offsets into it:
+	static inline constexpr DXRDescriptorAllocatorDesc k_SrvDescriptors{4096,
+																		4096};
+	static inline constexpr DXRDescriptorAllocatorDesc k_RtvDescriptors{64, 0};
+	static inline constexpr DXRDescriptorAllocatorDesc k_DsvDescriptors{16, 0};
+
+	// DXRFramePacer's (and DXRUploadRing's) view of
+	// m_d3dCommandQueue/m_d3dFence:
+	struct D3D12FrameQueue
+	{
+		DXRWindowRenderer* renderer{};
+		auto Signal(std::uint64_t value) -> void;
+		auto GetCompletedValue() -> std::uint64_t;
+		auto Wait(std::uint64_t value) -> void;
+	};
+
+	// m_pipelines' factory:
+	struct D3D12PipelineFactory
+	{
+		using Pipeline = COMPtr<::ID3D12PipelineState>;
+		DXRWindowRenderer* renderer{};
+		auto Create(const DXRPipelineKey& key, Pipeline& out) -> bool;
+	};
+
 	// Clear color:
 	static inline constexpr float k_ClearColor[]{0.0f, 0.0f, 0.0f, 0.0f};
 
@@ -177,6 +343,10 @@ struct DXRWindowRenderer
 	NTNamespace::UINT m_width{}, m_height{};
 	bool m_presentWithVsync{};
 
+	// Sizes from OnResize(), RenderAll() applies them between frames:
+	DXRPlatformClock m_clock{};
+	DXRResizeCoalescer<DXRPlatformClock> m_resizes{m_clock};
+
 	// RenderAll() will lock this mutex.
 	// Window events come from a different thread, they will also lock this when
 	// needed.
@@ -189,9 +359,45 @@ struct DXRWindowRenderer
 	COMPtr<::IDXGIDebug1> m_dxgiDebug{};
 #endif
 
-	// Used to mark which resources need to be released on resize:
+	// Used to mark which resources need to be released on resize, they
+	// belong to the objects depending on D3D12Object::SwapChainSize:
 #define DXRSWAPCHAINSIZEDEPENDENT
 
+	// What ValidateAndCreateObjects() and RenderAll() (RenderingAssets)
+	// create, in creation order. Dependencies are set up in the constructor:
+	enum struct D3D12Object : std::uint32_t
+	{
+		FactoryAndAdapter,
+		DeviceAndSwapChain,
+		// Nothing to create, OnResize() invalidates it:
+		SwapChainSize,
+		Heaps,
+		RenderTargets,
+		CommandAllocators,
+		CommandList,
+		Fence,
+		UploadRing,
+		InstanceBuffers,
+		RootSignature,
+		PipelineState,
+		DepthBuffer,
+#ifndef DXRDISABLED2D
+		D3D11On12DeviceAndContext,
+		D2DFactory,
+		D2DDeviceAndContext,
+		D2DBrushes,
+		D2D1RenderTargets,
+#endif
+		RenderingAssets,
+		Count,
+	};
+
+	// Calls the Create*() function of one object:
+	auto CreateD3D12Object(D3D12Object object) -> bool;
+
+	// Dirty objects get created, the rest is assumed valid:
+	DXRObjectLifetime<D3D12Object> m_objects{};
+
 	// DXGI:
 	using DXGIMinFactory_t = ::IDXGIFactory4;
 	using DXGIMinAdapter_t = ::IDXGIAdapter1;
@@ -205,13 +411,21 @@ struct DXRWindowRenderer
 	// Set if fallback to WARP was needed:
 	bool m_isWARPAdapter{};
 
+	// CPU rasterizer, replaces the D3D12 pipeline on WARP:
+	std::unique_ptr<DXRSoftwareRasterizer> m_softwareRasterizer{};
+	DXRImageRGBA8 m_softwareTexture{};
+	std::vector<DXRInstanceData> m_softwareInstances{};
+	// One per frame slot, a buffer can't be rewritten while the GPU copies:
+	std::array<COMPtr<::ID3D12Resource>, k_MaxFramesInFlight>
+		DXRSWAPCHAINSIZEDEPENDENT m_d3dSoftwareUploadBuffers{};
+
 	// D3D12:
 	// Device:
 	::D3D_FEATURE_LEVEL m_d3dDeviceFeatureLevel{};
 	COMPtr<::ID3D12Device> m_d3dDevice{};
 
 	// Commands:
-	std::array<COMPtr<::ID3D12CommandAllocator>, k_NumSwapChainBuffers>
+	std::array<COMPtr<::ID3D12CommandAllocator>, k_MaxFramesInFlight>
 		m_d3dCommandAllocators{};
 	COMPtr<::ID3D12GraphicsCommandList> m_d3dCommandList{};
 	COMPtr<::ID3D12CommandQueue> m_d3dCommandQueue{};
@@ -219,6 +433,9 @@ struct DXRWindowRenderer
 	// Render target objects:
 	COMPtr<::ID3D12DescriptorHeap> m_d3dRtvDescriptorHeap{};
 	NTNamespace::UINT m_d3dRtvDescriptorSize{};
+	DXRDescriptorAllocator m_rtvDescriptors{};
+	// One per swap chain buffer:
+	DXRDescriptorAllocation m_swapChainRtvs{};
 	std::array<COMPtr<::ID3D12Resource>, k_NumSwapChainBuffers>
 		DXRSWAPCHAINSIZEDEPENDENT m_d3dRenderTargets{};
 
@@ -227,37 +444,96 @@ struct DXRWindowRenderer
 
 	// Mesh objects:
 	COMPtr<::ID3D12Resource> m_d3dVertexBuffer{};
+	DXRGpuAllocation m_vertexBufferMemory{};
 	::D3D12_VERTEX_BUFFER_VIEW m_d3dVertexBufferView{};
+	COMPtr<::ID3D12Resource> m_d3dIndexBuffer{};
+	DXRGpuAllocation m_indexBufferMemory{};
+	::D3D12_INDEX_BUFFER_VIEW m_d3dIndexBufferView{};
+	NTNamespace::UINT m_d3dIndexCount{};
+	// Model matrix that dequantizes the vertex buffer's positions, identity
+	// for DXRVertex3D:
+	glm::mat4 m_vertexPositionTransform{1.f};
+
+	// Cube instances from SetInstances(), all drawn with one
+	// DrawIndexedInstanced(), packed into the frame slot's
+	// m_d3dInstanceBuffers every frame:
+	DXRTripleBuffer<std::vector<DXRInstance>> m_instances{
+		std::vector<DXRInstance>(1)};
+	std::array<COMPtr<::ID3D12Resource>, k_MaxFramesInFlight>
+		m_d3dInstanceBuffers{};
+	std::array<DXRInstanceData*, k_MaxFramesInFlight> m_instanceBuffersMapped{};
 
 	// Texture objects:
 	COMPtr<::ID3D12Resource> m_d3dTexture{};
+	DXRGpuAllocation m_textureMemory{};
 	COMPtr<::ID3D12DescriptorHeap> m_d3dSrvDescriptorHeap{};
+	NTNamespace::UINT m_d3dSrvDescriptorSize{};
+	DXRDescriptorAllocator m_srvDescriptors{};
+	DXRDescriptorAllocation m_textureSrv{};
+
+	// Shader bytecode by source, kept across DeviceLost() in memory and
+	// across runs in the working directory's shadercache/:
+	DXRShaderCache m_shaderCache;
 
 	// Pipeline states:
-	COMPtr<::ID3D12PipelineState> m_d3dPipelineState{};
+	// The driver's compiled pipelines, kept in shadercache/ between runs.
+	// The blob it was created from has to outlive it:
+	COMPtr<::ID3D12PipelineLibrary> m_d3dPipelineLibrary{};
+	std::vector<unsigned char> m_d3dPipelineLibraryBlob{};
+	std::atomic<bool> m_pipelineLibraryChanged{};
+	// One per distinct DXRPipelineKey, created on the job system. After the
+	// library, its jobs use it:
+	DXRPipelineRegistry<D3D12PipelineFactory> m_pipelines;
+	DXRPipelineHandle m_scenePipeline{};
+
+	// Frame graph, rebuilt and compiled every frame, and the scratch space
+	// its barriers are translated in:
+	DXRRenderGraph m_renderGraph{};
+	DXRRenderGraphPlan m_renderGraphPlan{};
+	std::vector<::D3D12_RESOURCE_BARRIER> m_d3dBarriers{};
 
 	// Depth stencil objects:
 	COMPtr<::ID3D12DescriptorHeap> m_d3dDsvDescriptorHeap{};
 	NTNamespace::UINT m_d3dDsvDescriptorSize{};
+	DXRDescriptorAllocator m_dsvDescriptors{};
+	DXRDescriptorAllocation m_depthDsv{};
 	COMPtr<::ID3D12Resource> DXRSWAPCHAINSIZEDEPENDENT
 		m_d3dDepthStencilBuffer{};
+	DXRGpuAllocation DXRSWAPCHAINSIZEDEPENDENT m_depthBufferMemory{};
+
+	// Placed resources:
+	// Default heap memory carved out of a few big heaps instead of one
+	// committed allocation per resource. m_d3dHeaps is by m_gpuMemory's
+	// heap index, released ones are null.
+	DXRGpuHeapAllocator m_gpuMemory{};
+	std::vector<COMPtr<::ID3D12Heap>> m_d3dHeaps{};
+
+	// Uploads:
+	// One persistently mapped buffer, m_uploadRing hands out ranges of it.
+	COMPtr<::ID3D12Resource> m_d3dUploadRingBuffer{};
+	unsigned char* m_uploadRingMapped{};
+	DXRUploadRing m_uploadRing{};
+	// Dedicated buffers for uploads that didn't fit into the ring:
+	DXRDeferredRelease<COMPtr<::ID3D12Resource>> m_d3dUploadOverflow{};
+	// Upload batches are recorded with their own allocator, independent of
+	// the frame slots:
+	COMPtr<::ID3D12CommandAllocator> m_d3dUploadCommandAllocator{};
+	bool m_uploadsRecording{};
+	// Fence value after the last upload batch:
+	NTNamespace::UINT64 m_uploadFenceValue{};
 
 	// Fence:
 	COMPtr<::ID3D12Fence> m_d3dFence{};
 	W32Handle<nullptr> m_fenceEvent{};
+	// Last value SignalFence() signaled:
 	NTNamespace::UINT64 m_fenceValue{};
+	DXRFramePacer m_framePacer{};
 
 	// The backbuffer/rendertarget index:
 	NTNamespace::UINT m_frameIndex{};
 	NTNamespace::UINT m_previousFrameIndex{};
-
-	// Camera constants:
-	struct CameraMatrices
-	{
-		glm::mat4 projection;
-		glm::mat4 view;
-	};
-	std::atomic<CameraMatrices> m_atomicCamera{};;
+	// The frames-in-flight slot being recorded:
+	NTNamespace::UINT m_frameSlot{};
 
 #ifndef DXRDISABLED2D
 
@@ -88,9 +88,10 @@ auto DXRWindowRenderer::CreateD2DBrushes() -> bool
 {
 	if (!m_d2dSolidColorBrush)
 	{
-		DXRASSERT(DXRSUCCESSTEST(m_d2dDeviceContext->CreateSolidColorBrush(
-			::D2D1::ColorF(::D2D1::ColorF::Black),
-			m_d2dSolidColorBrush.Out())));
+		if (!DXRSUCCESSTEST(m_d2dDeviceContext->CreateSolidColorBrush(
+				::D2D1::ColorF(::D2D1::ColorF::Black),
+				m_d2dSolidColorBrush.Out())))
+			return false;
 	}
 	return m_d2dSolidColorBrush;
 }
@@ -103,21 +104,22 @@ auto DXRWindowRenderer::CreateD2D1RenderTargets() -> bool
 		if (!m_d3d11WrappedRenderTargets[n])
 		{
 			::D3D11_RESOURCE_FLAGS flags{::D3D11_BIND_RENDER_TARGET};
-			DXRASSERT(DXRSUCCESSTEST(m_d3d11On12Device->CreateWrappedResource(
-				m_d3dRenderTargets[n].Get(), &flags,
-				::D3D12_RESOURCE_STATE_RENDER_TARGET,
-				::D3D12_RESOURCE_STATE_PRESENT,
-				m_d3d11WrappedRenderTargets[n].static_uuid,
-				m_d3d11WrappedRenderTargets[n].Out())));
+			if (!DXRSUCCESSTEST(m_d3d11On12Device->CreateWrappedResource(
+					m_d3dRenderTargets[n].Get(), &flags,
+					::D3D12_RESOURCE_STATE_RENDER_TARGET,
+					::D3D12_RESOURCE_STATE_PRESENT,
+					m_d3d11WrappedRenderTargets[n].static_uuid,
+					m_d3d11WrappedRenderTargets[n].Out())))
+				return false;
 			DXRASSERT(m_d3d11WrappedRenderTargets[n]);
 		}
 
 		if (!m_d2dRenderTargets[n])
 		{
 			COMPtr<::IDXGISurface> surf{};
-			DXRASSERT(
-				DXRSUCCESSTEST(m_d3d11WrappedRenderTargets[n]->QueryInterface(
-					surf.static_uuid, surf.Out())));
+			if (!DXRSUCCESSTEST(m_d3d11WrappedRenderTargets[n]->QueryInterface(
+					surf.static_uuid, surf.Out())))
+				return false;
 			DXRASSERT(surf);
 
 			::D2D1_BITMAP_PROPERTIES1 bitmapProperties =
@@ -126,10 +128,10 @@ auto DXRWindowRenderer::CreateD2D1RenderTargets() -> bool
 						::D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
 					D2D1::PixelFormat(::DXGI_FORMAT_UNKNOWN,
 									  ::D2D1_ALPHA_MODE_PREMULTIPLIED));
-			DXRASSERT(
-				DXRSUCCESSTEST(m_d2dDeviceContext->CreateBitmapFromDxgiSurface(
+			if (!DXRSUCCESSTEST(m_d2dDeviceContext->CreateBitmapFromDxgiSurface(
 					surf.Get(), &bitmapProperties,
-					m_d2dRenderTargets[n].Out())));
+					m_d2dRenderTargets[n].Out())))
+				return false;
 		}
 	}
 	return true;
@@ -160,7 +162,9 @@ auto DXRWindowRenderer::SubmitD2D() -> void
 						static_cast<float>(m_height) * v),
 		m_d2dSolidColorBrush.Get());
 
-	DXRASSERT(DXRSUCCESSTEST(m_d2dDeviceContext->EndDraw()));
+	const auto hr = m_d2dDeviceContext->EndDraw();
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	(void)hr;
 
 	m_d3d11On12Device->ReleaseWrappedResources(&d2dRenderTarget, 1);
 
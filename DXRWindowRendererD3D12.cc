@@ -6,9 +6,16 @@
 #include "d3dx12.h"
 #pragma warning(pop)
 
-#include "RawImage.h"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "CameraManager.h"
+#include "DXRAssets.h"
+#include "DXRMeshBuilder.h"
+#include "DXRMipGenerator.h"
+#include "DXRVertexQuantizer.h"
+
+#include <algorithm>
+
+// Next to m_shaderCache's files:
+static constexpr auto k_PipelineLibraryPath{"shadercache/pipelines.bin"};
 
 auto DXRWindowRenderer::CreateDXGIFactoryAndAdapter() -> bool
 {
@@ -132,6 +139,16 @@ auto DXRWindowRenderer::CreateD3D12DeviceAndSwapChain() -> bool
 		{
 			DXRASSERT(m_d3dDevice);
 			m_d3dDevice->SetName(L"m_d3dDevice");
+
+			// Placed resources fail instead of paging once the local
+			// segment's budget is used up:
+			COMPtr<::IDXGIAdapter3> adapter3{};
+			::DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo{};
+			if (DXRSUCCESSTEST(m_dxgiAdapter->QueryInterface(
+					adapter3.static_uuid, adapter3.Out())) &&
+				DXRSUCCESSTEST(adapter3->QueryVideoMemoryInfo(
+					0, ::DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo)))
+				m_gpuMemory.SetBudget(memoryInfo.Budget);
 		}
 	}
 
@@ -192,8 +209,9 @@ auto DXRWindowRenderer::CreateD3D12Heaps() -> bool
 	DXRASSERT(m_d3dDevice);
 	if (!m_d3dRtvDescriptorHeap)
 	{
+		m_rtvDescriptors.Reset(k_RtvDescriptors);
 		::D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc{};
-		rtvHeapDesc.NumDescriptors = k_NumSwapChainBuffers;
+		rtvHeapDesc.NumDescriptors = m_rtvDescriptors.GetCapacity();
 		rtvHeapDesc.Type = ::D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 		rtvHeapDesc.Flags = ::D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 		if (DXRSUCCESSTEST(m_d3dDevice->CreateDescriptorHeap(
@@ -207,6 +225,8 @@ auto DXRWindowRenderer::CreateD3D12Heaps() -> bool
 			m_d3dRtvDescriptorSize =
 				m_d3dDevice->GetDescriptorHandleIncrementSize(
 					::D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+			m_swapChainRtvs =
+				m_rtvDescriptors.AllocatePersistent(k_NumSwapChainBuffers);
 		}
 	}
 	if (!m_d3dRtvDescriptorHeap)
@@ -214,8 +234,9 @@ auto DXRWindowRenderer::CreateD3D12Heaps() -> bool
 
 	if (!m_d3dDsvDescriptorHeap)
 	{
+		m_dsvDescriptors.Reset(k_DsvDescriptors);
 		::D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc{};
-		dsvHeapDesc.NumDescriptors = 1;
+		dsvHeapDesc.NumDescriptors = m_dsvDescriptors.GetCapacity();
 		dsvHeapDesc.Type = ::D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
 		dsvHeapDesc.Flags = ::D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 		auto hr = m_d3dDevice->CreateDescriptorHeap(
@@ -225,14 +246,16 @@ auto DXRWindowRenderer::CreateD3D12Heaps() -> bool
 		m_d3dDsvDescriptorHeap->SetName(L"m_d3dDsvDescriptorHeap");
 		m_d3dDsvDescriptorSize = m_d3dDevice->GetDescriptorHandleIncrementSize(
 			::D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+		m_depthDsv = m_dsvDescriptors.AllocatePersistent(1);
 	}
 	if (!m_d3dDsvDescriptorHeap)
 		return false;
 
 	if (!m_d3dSrvDescriptorHeap)
 	{
+		m_srvDescriptors.Reset(k_SrvDescriptors);
 		::D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc{};
-		srvHeapDesc.NumDescriptors = 1;
+		srvHeapDesc.NumDescriptors = m_srvDescriptors.GetCapacity();
 		srvHeapDesc.Type = ::D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 		srvHeapDesc.Flags = ::D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -242,6 +265,10 @@ auto DXRWindowRenderer::CreateD3D12Heaps() -> bool
 		{
 			DXRASSERT(m_d3dSrvDescriptorHeap);
 			m_d3dSrvDescriptorHeap->SetName(L"m_d3dSrvDescriptorHeap");
+			m_d3dSrvDescriptorSize =
+				m_d3dDevice->GetDescriptorHandleIncrementSize(
+					::D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			m_textureSrv = m_srvDescriptors.AllocatePersistent(1);
 		}
 	}
 	if (!m_d3dSrvDescriptorHeap)
@@ -249,25 +276,48 @@ auto DXRWindowRenderer::CreateD3D12Heaps() -> bool
 	return true;
 }
 
+auto DXRWindowRenderer::GetD3D12CPUDescriptorHandle(
+	::ID3D12DescriptorHeap* heap, NTNamespace::UINT size, std::uint32_t index)
+	-> ::D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	DXRASSERT(heap);
+	auto handle = heap->GetCPUDescriptorHandleForHeapStart();
+	handle.ptr += static_cast<NTNamespace::SIZE_T>(index) * size;
+	return handle;
+}
+
+auto DXRWindowRenderer::GetD3D12GPUDescriptorHandle(
+	::ID3D12DescriptorHeap* heap, NTNamespace::UINT size, std::uint32_t index)
+	-> ::D3D12_GPU_DESCRIPTOR_HANDLE
+{
+	DXRASSERT(heap);
+	auto handle = heap->GetGPUDescriptorHandleForHeapStart();
+	handle.ptr += static_cast<NTNamespace::UINT64>(index) * size;
+	return handle;
+}
+
 auto DXRWindowRenderer::CreateD3D12RenderTargets() -> bool
 {
 	DXRASSERT(m_d3dRtvDescriptorHeap);
 	DXRASSERT(m_dxgiSwapChain);
 	DXRASSERT(m_d3dDevice);
-	auto rtvHandle{
-		m_d3dRtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart()};
+	DXRASSERT(m_swapChainRtvs.IsValid());
 
 	for (NTNamespace::UINT n{}; n < m_d3dRenderTargets.size(); n++)
 	{
 		if (!m_d3dRenderTargets[n])
 		{
-			DXRASSERT(DXRSUCCESSTEST(m_dxgiSwapChain->GetBuffer(n, __uuidof(::ID3D12Resource),
-									   m_d3dRenderTargets[n].Out())));
+			if (!DXRSUCCESSTEST(m_dxgiSwapChain->GetBuffer(
+					n, __uuidof(::ID3D12Resource),
+					m_d3dRenderTargets[n].Out())))
+				return false;
 			DXRASSERT(m_d3dRenderTargets[n]);
 			m_d3dRenderTargets[n]->SetName(L"m_d3dRenderTargets[n]");
-			m_d3dDevice->CreateRenderTargetView(m_d3dRenderTargets[n].Get(),
-												nullptr, rtvHandle);
-			rtvHandle.ptr += m_d3dRtvDescriptorSize;
+			m_d3dDevice->CreateRenderTargetView(
+				m_d3dRenderTargets[n].Get(), nullptr,
+				GetD3D12CPUDescriptorHandle(m_d3dRtvDescriptorHeap.Get(),
+											m_d3dRtvDescriptorSize,
+											m_swapChainRtvs.index + n));
 
 			m_frameIndex = 0;
 			m_previousFrameIndex = 1;
@@ -279,8 +329,9 @@ auto DXRWindowRenderer::CreateD3D12RenderTargets() -> bool
 auto DXRWindowRenderer::CreateD3D12CommandAllocators() -> bool
 {
 	DXRASSERT(m_d3dDevice);
-	for (auto& v : m_d3dCommandAllocators)
+	for (NTNamespace::UINT n{}; n < m_framePacer.GetFramesInFlight(); n++)
 	{
+		auto& v = m_d3dCommandAllocators[n];
 		if (!v)
 		{
 			if (DXRSUCCESSTEST(m_d3dDevice->CreateCommandAllocator(
@@ -311,7 +362,8 @@ auto DXRWindowRenderer::CreateD3D12CommandList() -> bool
 			DXRASSERT(m_d3dCommandList);
 			m_d3dCommandList->SetName(L"m_d3dCommandList");
 
-			DXRASSERT(DXRSUCCESSTEST(m_d3dCommandList->Close()));
+			if (!DXRSUCCESSTEST(m_d3dCommandList->Close()))
+				m_d3dCommandList.Release();
 		}
 	}
 	return m_d3dCommandList;
@@ -331,7 +383,9 @@ auto DXRWindowRenderer::CreateD3D12Fence() -> bool
 			m_fenceEvent = ::CreateEventW(0, false, false, 0);
 			DXRASSERT(m_fenceEvent);
 
-			m_fenceValue = 1;
+			// New fence starts at zero:
+			m_fenceValue = 0;
+			m_framePacer.Reset();
 		}
 	}
 	return m_d3dFence;
@@ -349,7 +403,7 @@ auto DXRWindowRenderer::CreateD3D12RootSignature() -> bool
 		descRange.RegisterSpace = 0;
 		descRange.OffsetInDescriptorsFromTableStart = 0;
 
-		::D3D12_ROOT_PARAMETER param[2] = {};
+		::D3D12_ROOT_PARAMETER param[3] = {};
 
 		param[0].ParameterType = ::D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
 		param[0].Constants.ShaderRegister = 0;
@@ -362,6 +416,12 @@ auto DXRWindowRenderer::CreateD3D12RootSignature() -> bool
 		param[1].DescriptorTable.pDescriptorRanges = &descRange;
 		param[1].ShaderVisibility = ::D3D12_SHADER_VISIBILITY_PIXEL;
 
+		// Instance buffer, a root SRV needs no descriptor:
+		param[2].ParameterType = ::D3D12_ROOT_PARAMETER_TYPE_SRV;
+		param[2].Descriptor.ShaderRegister = 1;
+		param[2].Descriptor.RegisterSpace = 0;
+		param[2].ShaderVisibility = ::D3D12_SHADER_VISIBILITY_VERTEX;
+
 		::D3D12_STATIC_SAMPLER_DESC staticSampler{};
 		staticSampler.Filter = ::D3D12_FILTER_MIN_MAG_MIP_POINT;
 		staticSampler.AddressU = ::D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -410,103 +470,268 @@ auto DXRWindowRenderer::CreateD3D12RootSignature() -> bool
 auto DXRWindowRenderer::CreateD3D12PipelineState() -> bool
 {
 	DXRASSERT(m_d3dDevice);
-	if (!m_d3dPipelineState)
-	{
-		size_t vertexShaderbcSize{};
-		const auto vertexShaderbc = CompileShaderToByteCode(
-			vertexShader2DText, vertexShaderbcSize, "main", "vs_5_0");
-		DXRASSERT(vertexShaderbc);
-		size_t pixelShaderbcSize{};
-		const auto pixelShaderbc = CompileShaderToByteCode(
-			pixelShader2DText, pixelShaderbcSize, "main", "ps_5_0");
-		DXRASSERT(pixelShaderbc);
-		::D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
-		psoDesc.pRootSignature = m_d3dRootSignature.Get();
-
-		psoDesc.VS.pShaderBytecode = vertexShaderbc;
-		psoDesc.VS.BytecodeLength = vertexShaderbcSize;
-
-		psoDesc.PS.pShaderBytecode = pixelShaderbc;
-		psoDesc.PS.BytecodeLength = pixelShaderbcSize;
-
-		psoDesc.BlendState.AlphaToCoverageEnable = false;
-		psoDesc.BlendState.IndependentBlendEnable = false;
-		psoDesc.BlendState.RenderTarget[0].BlendEnable = true;
-		psoDesc.BlendState.RenderTarget[0].SrcBlend = ::D3D12_BLEND_SRC_ALPHA;
-		psoDesc.BlendState.RenderTarget[0].DestBlend =
-			::D3D12_BLEND_INV_SRC_ALPHA;
-		psoDesc.BlendState.RenderTarget[0].BlendOp = ::D3D12_BLEND_OP_ADD;
-		psoDesc.BlendState.RenderTarget[0].SrcBlendAlpha = ::D3D12_BLEND_ONE;
-		psoDesc.BlendState.RenderTarget[0].DestBlendAlpha = ::D3D12_BLEND_ZERO;
-		psoDesc.BlendState.RenderTarget[0].BlendOpAlpha = ::D3D12_BLEND_OP_ADD;
-		psoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask =
-			::D3D12_COLOR_WRITE_ENABLE_ALL;
-
-		psoDesc.SampleMask = UINT_MAX;
-
-		psoDesc.RasterizerState.FillMode = ::D3D12_FILL_MODE_SOLID;
-		psoDesc.RasterizerState.CullMode = ::D3D12_CULL_MODE_NONE;
-		psoDesc.RasterizerState.FrontCounterClockwise = false;
-		psoDesc.RasterizerState.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
-		psoDesc.RasterizerState.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
-		psoDesc.RasterizerState.SlopeScaledDepthBias =
-			D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
-		psoDesc.RasterizerState.DepthClipEnable = true;
-		psoDesc.RasterizerState.MultisampleEnable = false;
-		psoDesc.RasterizerState.AntialiasedLineEnable = false;
-		psoDesc.RasterizerState.ForcedSampleCount = 0;
-		psoDesc.RasterizerState.ConservativeRaster =
-			::D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
-
-		psoDesc.DepthStencilState.DepthEnable = true;
-		psoDesc.DepthStencilState.DepthWriteMask = ::D3D12_DEPTH_WRITE_MASK_ALL;
-		psoDesc.DepthStencilState.DepthFunc = ::D3D12_COMPARISON_FUNC_LESS;
-		psoDesc.DepthStencilState.StencilEnable = false;
-		psoDesc.DepthStencilState.FrontFace.StencilPassOp =
-			::D3D12_STENCIL_OP_KEEP;
-		psoDesc.DepthStencilState.FrontFace.StencilFailOp =
-			::D3D12_STENCIL_OP_KEEP;
-		psoDesc.DepthStencilState.FrontFace.StencilDepthFailOp =
-			::D3D12_STENCIL_OP_KEEP;
-		psoDesc.DepthStencilState.BackFace =
-			psoDesc.DepthStencilState.FrontFace;
-
-		::D3D12_INPUT_ELEMENT_DESC layout[] = {
-			{"POSITION", 0, ::DXGI_FORMAT_R32G32B32_FLOAT, 0,
-			 offsetof(Vertex3D, x),
-			 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-			{"NORMAL", 0, ::DXGI_FORMAT_R32G32B32_FLOAT, 0,
-			 offsetof(Vertex3D, nx),
-			 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-			{"TEXCOORD", 0, ::DXGI_FORMAT_R32G32_FLOAT, 0,
-			 offsetof(Vertex3D, u),
-			 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-			{"COLOR", 0, ::DXGI_FORMAT_R8G8B8A8_UNORM, 0,
-			 offsetof(Vertex3D, col),
-			 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		};
-		psoDesc.InputLayout = {layout, 4};
-
-		psoDesc.PrimitiveTopologyType =
-			::D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		psoDesc.NumRenderTargets = 1;
-		psoDesc.RTVFormats[0] = ::DXGI_FORMAT_R8G8B8A8_UNORM;
-		psoDesc.DSVFormat = ::DXGI_FORMAT_D32_FLOAT;
-
-		psoDesc.SampleDesc.Count = 1;
-
-		psoDesc.NodeMask = 1;
-
-		psoDesc.Flags = ::D3D12_PIPELINE_STATE_FLAG_NONE;
-
-		auto hr = m_d3dDevice->CreateGraphicsPipelineState(
-			&psoDesc, m_d3dPipelineState.static_uuid, m_d3dPipelineState.Out());
-		DXRASSERT(DXRSUCCESSTEST(hr));
-		m_d3dPipelineState->SetName(L"m_d3dPipelineState");
-		delete[] vertexShaderbc;
-		delete[] pixelShaderbc;
+	if (!m_scenePipeline.IsValid())
+	{
+#ifdef DXRQUANTIZEDVERTICES
+		const auto vertexShaderText = vertexShaderQuantizedText;
+#else
+		const auto vertexShaderText = vertexShader2DText;
+#endif
+		DXRShaderDesc vertexShader{};
+		vertexShader.source = vertexShaderText;
+		vertexShader.target = "vs_5_0";
+		DXRShaderDesc pixelShader{};
+		pixelShader.source = pixelShader2DText;
+		pixelShader.target = "ps_5_0";
+		// Compiled once per source, a DeviceLost() or the next start gets
+		// the bytecode from the cache:
+		if (!m_shaderCache.GetOrCompile(vertexShader, CompileShaderToByteCode) ||
+			!m_shaderCache.GetOrCompile(pixelShader, CompileShaderToByteCode))
+			return false;
+
+		DXRPipelineKey key{};
+		key.vertexShader = m_shaderCache.GetKey(vertexShader);
+		key.pixelShader = m_shaderCache.GetKey(pixelShader);
+		key.renderTargetCount = 1;
+		key.renderTargetFormats[0] = DXRPipelineFormat::RGBA8Unorm;
+		key.depthFormat = DXRPipelineFormat::D32Float;
+		key.blend = DXRBlendMode::Alpha;
+		key.cull = DXRCullMode::None;
+		key.depth = DXRDepthMode::TestWrite;
+#ifdef DXRQUANTIZEDVERTICES
+		key.vertexLayout = DXRVertexLayout::Quantized;
+#else
+		key.vertexLayout = DXRVertexLayout::Vertex3D;
+#endif
+		m_scenePipeline = m_pipelines.Request(key);
 	}
-	return m_d3dPipelineState;
+	// The first frame draws with it:
+	return m_pipelines.Wait(m_scenePipeline);
+}
+
+auto DXRWindowRenderer::CreateD3D12PipelineState(
+	const DXRPipelineKey& key, COMPtr<::ID3D12PipelineState>& out) -> bool
+{
+	DXRASSERT(m_d3dDevice);
+	const auto vertexShaderbc = m_shaderCache.Find(key.vertexShader);
+	const auto pixelShaderbc = m_shaderCache.Find(key.pixelShader);
+	if (!vertexShaderbc || !pixelShaderbc)
+		return false;
+
+	::D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
+	psoDesc.pRootSignature = m_d3dRootSignature.Get();
+
+	psoDesc.VS.pShaderBytecode = vertexShaderbc->data();
+	psoDesc.VS.BytecodeLength = vertexShaderbc->size();
+
+	psoDesc.PS.pShaderBytecode = pixelShaderbc->data();
+	psoDesc.PS.BytecodeLength = pixelShaderbc->size();
+
+	// Same blend on every target:
+	auto& blend = psoDesc.BlendState.RenderTarget[0];
+	psoDesc.BlendState.AlphaToCoverageEnable = false;
+	psoDesc.BlendState.IndependentBlendEnable = false;
+	blend.BlendEnable = key.blend != DXRBlendMode::Opaque;
+	blend.BlendOp = ::D3D12_BLEND_OP_ADD;
+	blend.BlendOpAlpha = ::D3D12_BLEND_OP_ADD;
+	switch (key.blend)
+	{
+	case DXRBlendMode::Opaque:
+	case DXRBlendMode::Alpha:
+		blend.SrcBlend = ::D3D12_BLEND_SRC_ALPHA;
+		blend.DestBlend = ::D3D12_BLEND_INV_SRC_ALPHA;
+		blend.SrcBlendAlpha = ::D3D12_BLEND_ONE;
+		blend.DestBlendAlpha = ::D3D12_BLEND_ZERO;
+		break;
+	case DXRBlendMode::Additive:
+		blend.SrcBlend = ::D3D12_BLEND_ONE;
+		blend.DestBlend = ::D3D12_BLEND_ONE;
+		blend.SrcBlendAlpha = ::D3D12_BLEND_ONE;
+		blend.DestBlendAlpha = ::D3D12_BLEND_ONE;
+		break;
+	case DXRBlendMode::Premultiplied:
+		blend.SrcBlend = ::D3D12_BLEND_ONE;
+		blend.DestBlend = ::D3D12_BLEND_INV_SRC_ALPHA;
+		blend.SrcBlendAlpha = ::D3D12_BLEND_ONE;
+		blend.DestBlendAlpha = ::D3D12_BLEND_INV_SRC_ALPHA;
+		break;
+	}
+	blend.RenderTargetWriteMask = ::D3D12_COLOR_WRITE_ENABLE_ALL;
+
+	psoDesc.SampleMask = UINT_MAX;
+
+	constexpr ::D3D12_CULL_MODE cullModes[]{
+		::D3D12_CULL_MODE_NONE, ::D3D12_CULL_MODE_FRONT, ::D3D12_CULL_MODE_BACK};
+	psoDesc.RasterizerState.FillMode = key.fill == DXRFillMode::Wireframe
+										   ? ::D3D12_FILL_MODE_WIREFRAME
+										   : ::D3D12_FILL_MODE_SOLID;
+	psoDesc.RasterizerState.CullMode =
+		cullModes[static_cast<std::size_t>(key.cull)];
+	psoDesc.RasterizerState.FrontCounterClockwise = false;
+	psoDesc.RasterizerState.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
+	psoDesc.RasterizerState.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
+	psoDesc.RasterizerState.SlopeScaledDepthBias =
+		D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
+	psoDesc.RasterizerState.DepthClipEnable = true;
+	psoDesc.RasterizerState.MultisampleEnable = key.sampleCount > 1;
+	psoDesc.RasterizerState.AntialiasedLineEnable = false;
+	psoDesc.RasterizerState.ForcedSampleCount = 0;
+	psoDesc.RasterizerState.ConservativeRaster =
+		::D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
+
+	psoDesc.DepthStencilState.DepthEnable = key.depth != DXRDepthMode::Off;
+	psoDesc.DepthStencilState.DepthWriteMask =
+		key.depth == DXRDepthMode::TestWrite ? ::D3D12_DEPTH_WRITE_MASK_ALL
+											 : ::D3D12_DEPTH_WRITE_MASK_ZERO;
+	psoDesc.DepthStencilState.DepthFunc = key.depth == DXRDepthMode::Equal
+											  ? ::D3D12_COMPARISON_FUNC_EQUAL
+											  : ::D3D12_COMPARISON_FUNC_LESS;
+	psoDesc.DepthStencilState.StencilEnable = false;
+	psoDesc.DepthStencilState.FrontFace.StencilPassOp = ::D3D12_STENCIL_OP_KEEP;
+	psoDesc.DepthStencilState.FrontFace.StencilFailOp = ::D3D12_STENCIL_OP_KEEP;
+	psoDesc.DepthStencilState.FrontFace.StencilDepthFailOp =
+		::D3D12_STENCIL_OP_KEEP;
+	psoDesc.DepthStencilState.BackFace = psoDesc.DepthStencilState.FrontFace;
+
+	// There is no three component 16 bit format, z gets its own element:
+	static const ::D3D12_INPUT_ELEMENT_DESC quantizedLayout[] = {
+		{"POSITION", 0, ::DXGI_FORMAT_R16G16_UNORM, 0,
+		 offsetof(DXRVertexQuantized, x),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"POSITION", 1, ::DXGI_FORMAT_R16_UNORM, 0,
+		 offsetof(DXRVertexQuantized, z),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, ::DXGI_FORMAT_R8G8_SNORM, 0,
+		 offsetof(DXRVertexQuantized, nx),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"TEXCOORD", 0, ::DXGI_FORMAT_R16G16_FLOAT, 0,
+		 offsetof(DXRVertexQuantized, u),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"COLOR", 0, ::DXGI_FORMAT_R8G8B8A8_UNORM, 0,
+		 offsetof(DXRVertexQuantized, col),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+	};
+	static const ::D3D12_INPUT_ELEMENT_DESC vertex3DLayout[] = {
+		{"POSITION", 0, ::DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex3D, x),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, ::DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex3D, nx),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"TEXCOORD", 0, ::DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Vertex3D, u),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"COLOR", 0, ::DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(Vertex3D, col),
+		 ::D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+	};
+	switch (key.vertexLayout)
+	{
+	case DXRVertexLayout::None:
+		break;
+	case DXRVertexLayout::Vertex3D:
+		psoDesc.InputLayout = {vertex3DLayout, static_cast<NTNamespace::UINT>(
+												   std::size(vertex3DLayout))};
+		break;
+	case DXRVertexLayout::Quantized:
+		psoDesc.InputLayout = {quantizedLayout,
+							   static_cast<NTNamespace::UINT>(
+								   std::size(quantizedLayout))};
+		break;
+	}
+
+	constexpr ::D3D12_PRIMITIVE_TOPOLOGY_TYPE primitiveTypes[]{
+		::D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE,
+		::D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE,
+		::D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT};
+	psoDesc.PrimitiveTopologyType =
+		primitiveTypes[static_cast<std::size_t>(key.primitive)];
+	psoDesc.NumRenderTargets = key.renderTargetCount;
+	for (std::uint32_t n{}; n < key.renderTargetCount; n++)
+	{
+		psoDesc.RTVFormats[n] =
+			static_cast<::DXGI_FORMAT>(key.renderTargetFormats[n]);
+	}
+	psoDesc.DSVFormat = static_cast<::DXGI_FORMAT>(key.depthFormat);
+
+	psoDesc.SampleDesc.Count = key.sampleCount;
+
+	psoDesc.NodeMask = 1;
+
+	psoDesc.Flags = ::D3D12_PIPELINE_STATE_FLAG_NONE;
+
+	// Named after the key's hash. A hash collision or a changed root
+	// signature makes the load fail on the desc check, it is created anew:
+	wchar_t name[17]{};
+	const auto hash = GetPipelineKeyHash(key);
+	for (std::size_t n{}; n < 16; n++)
+	{
+		name[n] = L"0123456789abcdef"[(hash >> ((15 - n) * 4)) & 0xF];
+	}
+	if (m_d3dPipelineLibrary &&
+		SUCCEEDED(m_d3dPipelineLibrary->LoadGraphicsPipeline(
+			name, &psoDesc, out.static_uuid, out.Out())))
+		return true;
+
+	auto hr = m_d3dDevice->CreateGraphicsPipelineState(
+		&psoDesc, out.static_uuid, out.Out());
+	if (!DXRSUCCESSTEST(hr))
+		return false;
+	out->SetName(name);
+	if (m_d3dPipelineLibrary &&
+		SUCCEEDED(m_d3dPipelineLibrary->StorePipeline(name, out.Get())))
+		m_pipelineLibraryChanged.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+auto DXRWindowRenderer::CreateD3D12PipelineLibrary() -> bool
+{
+	DXRASSERT(m_d3dDevice);
+	if (!m_d3dPipelineLibrary)
+	{
+		COMPtr<::ID3D12Device1> device1{};
+		if (!DXRSUCCESSTEST(m_d3dDevice->QueryInterface(device1.static_uuid,
+														device1.Out())))
+			return false;
+
+		m_d3dPipelineLibraryBlob.clear();
+		DXRMappedFile file{};
+		if (file.Open(k_PipelineLibraryPath))
+			m_d3dPipelineLibraryBlob.assign(file.GetData(),
+											file.GetData() + file.GetSize());
+		auto hr = device1->CreatePipelineLibrary(
+			m_d3dPipelineLibraryBlob.data(), m_d3dPipelineLibraryBlob.size(),
+			m_d3dPipelineLibrary.static_uuid, m_d3dPipelineLibrary.Out());
+		if (FAILED(hr) && !m_d3dPipelineLibraryBlob.empty())
+		{
+			// Another driver or adapter (D3D12_ERROR_DRIVER_VERSION_MISMATCH,
+			// D3D12_ERROR_ADAPTER_NOT_FOUND) or a damaged file. Starts empty,
+			// the next save replaces it:
+			m_d3dPipelineLibraryBlob.clear();
+			hr = device1->CreatePipelineLibrary(
+				nullptr, 0, m_d3dPipelineLibrary.static_uuid,
+				m_d3dPipelineLibrary.Out());
+		}
+		if (!DXRSUCCESSTEST(hr))
+			return false;
+		m_d3dPipelineLibrary->SetName(L"m_d3dPipelineLibrary");
+	}
+	return m_d3dPipelineLibrary;
+}
+
+auto DXRWindowRenderer::SaveD3D12PipelineLibrary() -> void
+{
+	// Creations in flight may still store into it:
+	m_pipelines.WaitAll();
+	if (!m_d3dPipelineLibrary ||
+		!m_pipelineLibraryChanged.exchange(false, std::memory_order_relaxed))
+		return;
+
+	std::vector<unsigned char> blob(m_d3dPipelineLibrary->GetSerializedSize());
+	if (DXRSUCCESSTEST(m_d3dPipelineLibrary->Serialize(blob.data(), blob.size())))
+		WriteFileAtomically(k_PipelineLibraryPath, blob);
+}
+
+auto DXRWindowRenderer::D3D12PipelineFactory::Create(const DXRPipelineKey& key,
+													 Pipeline& out) -> bool
+{
+	return renderer->CreateD3D12PipelineState(key, out);
 }
 
 auto DXRWindowRenderer::CreateD3D12DepthBuffer() -> bool
@@ -514,13 +739,6 @@ auto DXRWindowRenderer::CreateD3D12DepthBuffer() -> bool
 	DXRASSERT(m_d3dDevice);
 	if (!m_d3dDepthStencilBuffer)
 	{
-		::D3D12_HEAP_PROPERTIES heapProperties{};
-		heapProperties.Type = ::D3D12_HEAP_TYPE_DEFAULT;
-		heapProperties.CPUPageProperty = ::D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-		heapProperties.MemoryPoolPreference = ::D3D12_MEMORY_POOL_UNKNOWN;
-		heapProperties.CreationNodeMask = 1;
-		heapProperties.VisibleNodeMask = 1;
-
 		::D3D12_RESOURCE_DESC resourceDesc{};
 		resourceDesc.Dimension = ::D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 		resourceDesc.Alignment = 0;
@@ -539,11 +757,11 @@ auto DXRWindowRenderer::CreateD3D12DepthBuffer() -> bool
 		clearValue.DepthStencil.Depth = 1.0f;
 		clearValue.DepthStencil.Stencil = 0;
 
-		auto hr = m_d3dDevice->CreateCommittedResource(
-			&heapProperties, ::D3D12_HEAP_FLAG_NONE, &resourceDesc,
-			::D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearValue,
-			m_d3dDepthStencilBuffer.static_uuid, m_d3dDepthStencilBuffer.Out());
-		DXRASSERT(DXRSUCCESSTEST(hr));
+		if (!CreateD3D12PlacedResource(
+				resourceDesc, DXRGpuHeapKind::RenderTarget,
+				::D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearValue,
+				m_d3dDepthStencilBuffer, m_depthBufferMemory))
+			return false;
 		m_d3dDepthStencilBuffer->SetName(L"m_d3dDepthStencilBuffer");
 
 		::D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc{};
@@ -552,106 +770,163 @@ auto DXRWindowRenderer::CreateD3D12DepthBuffer() -> bool
 		dsvDesc.Flags = ::D3D12_DSV_FLAG_NONE;
 		m_d3dDevice->CreateDepthStencilView(
 			m_d3dDepthStencilBuffer.Get(), &dsvDesc,
-			m_d3dDsvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+			GetD3D12CPUDescriptorHandle(m_d3dDsvDescriptorHeap.Get(),
+										m_d3dDsvDescriptorSize,
+										m_depthDsv.index));
 	}
 	return m_d3dDepthStencilBuffer;
 }
-auto DXRWindowRenderer::CreateD3D12TextureFromImageData(const void* imageData, int size, COMPtr<::ID3D12Resource>& textureResource) -> bool
+auto DXRWindowRenderer::CreateD3D12TextureFromImageData(const void* imageData, int size, COMPtr<::ID3D12Resource>& textureResource, DXRGpuAllocation& allocation) -> bool
+{
+	// Slow path, decode, build the mip chain and cook in memory:
+	DXRImageRGBA8 image{};
+	if (!DecodeImageRGBA8(imageData, size, image))
+		return false;
+
+	std::vector<DXRImageRGBA8> mips{};
+	DXRMipGeneratorDesc mipDesc{};
+	mipDesc.jobs = DXRJobSystem::GetInstance();
+	if (!GenerateMipChainRGBA8(image, mips, mipDesc))
+		return false;
+
+	std::vector<unsigned char> cooked{};
+	if (!CookTextureContainer(mips, cooked))
+		return false;
+
+	DXRTextureContainer container{};
+	if (!container.Load(cooked.data(), cooked.size()))
+		return false;
+
+	return CreateD3D12TextureFromContainer(container, textureResource, allocation);
+}
+
+auto DXRWindowRenderer::CreateD3D12TextureFromImageData(std::span<const DXRCompressedImage> mips, COMPtr<::ID3D12Resource>& textureResource, DXRGpuAllocation& allocation) -> bool
+{
+	// Already encoded, only the layout is left to do:
+	std::vector<unsigned char> cooked{};
+	if (!CookTextureContainer(mips, cooked))
+		return false;
+
+	DXRTextureContainer container{};
+	if (!container.Load(cooked.data(), cooked.size()))
+		return false;
+
+	return CreateD3D12TextureFromContainer(container, textureResource, allocation);
+}
+
+auto DXRWindowRenderer::CreateD3D12TextureFromContainer(const DXRTextureContainer& container, COMPtr<::ID3D12Resource>& textureResource, DXRGpuAllocation& allocation) -> bool
 {
 	DXRASSERT(m_d3dDevice);
 	DXRASSERT(m_d3dCommandList);
 	DXRASSERT(m_d3dCommandQueue);
-	int width{};
-	int height{};
-	stbi_set_flip_vertically_on_load(1);
-	const auto bitmap_image_data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(imageData),size, &width, &height, NULL, 4);
-	if (!bitmap_image_data)
+	static_assert(DXRTextureContainer::k_PitchAlignment == D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+	static_assert(DXRTextureContainer::k_PlacementAlignment == D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	if (!container.IsValid())
 		return false;
 
-	::D3D12_HEAP_PROPERTIES defHeapProperties{};
-	defHeapProperties.Type = ::D3D12_HEAP_TYPE_DEFAULT;
-	defHeapProperties.CPUPageProperty = ::D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	defHeapProperties.MemoryPoolPreference = ::D3D12_MEMORY_POOL_UNKNOWN;
-	defHeapProperties.CreationNodeMask = 1;
-	defHeapProperties.VisibleNodeMask = 1;
+	::DXGI_FORMAT format{};
+	switch (container.GetFormat())
+	{
+	case DXRTextureFormat::RGBA8Unorm:
+		format = ::DXGI_FORMAT_R8G8B8A8_UNORM;
+		break;
+	case DXRTextureFormat::RGBA32Float:
+		format = ::DXGI_FORMAT_R32G32B32A32_FLOAT;
+		break;
+	case DXRTextureFormat::BC1Unorm:
+		format = ::DXGI_FORMAT_BC1_UNORM;
+		break;
+	case DXRTextureFormat::BC3Unorm:
+		format = ::DXGI_FORMAT_BC3_UNORM;
+		break;
+	case DXRTextureFormat::BC7Unorm:
+		format = ::DXGI_FORMAT_BC7_UNORM;
+		break;
+	default:
+		return false;
+	}
+
+	// D3D12 wants the top level of a BCn texture in whole blocks:
+	const auto formatInfo = GetTextureFormatInfo(container.GetFormat());
+	if (container.GetWidth() % formatInfo.blockSize || container.GetHeight() % formatInfo.blockSize)
+		return false;
+
+	const auto mipCount = container.GetMipCount();
 
 	::D3D12_RESOURCE_DESC textureDesc{};
 	textureDesc.Dimension = ::D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 	textureDesc.Alignment = 0;
-	textureDesc.Width = width;
-	textureDesc.Height = height;
+	textureDesc.Width = container.GetWidth();
+	textureDesc.Height = container.GetHeight();
 	textureDesc.DepthOrArraySize = 1;
-	textureDesc.MipLevels = 1;
-	textureDesc.Format = ::DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.MipLevels = static_cast<NTNamespace::UINT16>(mipCount);
+	textureDesc.Format = format;
 	textureDesc.SampleDesc.Count = 1;
 	textureDesc.SampleDesc.Quality = 0;
 	textureDesc.Layout = ::D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	textureDesc.Flags = ::D3D12_RESOURCE_FLAG_NONE;
-	
-	auto hr = m_d3dDevice->CreateCommittedResource(&defHeapProperties, ::D3D12_HEAP_FLAG_NONE, &textureDesc,
-		::D3D12_RESOURCE_STATE_COPY_DEST, NULL, textureResource.static_uuid, textureResource.InOut());
-	DXRASSERT(DXRSUCCESSTEST(hr));
 
-	::D3D12_RESOURCE_DESC bufferDesc{};
-	bufferDesc.Dimension = ::D3D12_RESOURCE_DIMENSION_BUFFER;
-	bufferDesc.Alignment = 0;
-	const NTNamespace::UINT uploadpitch = (width * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
-	const NTNamespace::UINT uploadsize = height * uploadpitch;
-	bufferDesc.Width = uploadsize;
-	bufferDesc.Height = 1;
-	bufferDesc.DepthOrArraySize = 1;
-	bufferDesc.MipLevels = 1;
-	bufferDesc.Format = ::DXGI_FORMAT_UNKNOWN;
-	bufferDesc.SampleDesc.Count = 1;
-	bufferDesc.SampleDesc.Quality = 0;
-	bufferDesc.Layout = ::D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-	bufferDesc.Flags = ::D3D12_RESOURCE_FLAG_NONE;
-	
-	::D3D12_HEAP_PROPERTIES uploadHeapProperties{};
-	uploadHeapProperties.Type = ::D3D12_HEAP_TYPE_UPLOAD;
-	uploadHeapProperties.CPUPageProperty =
-		::D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	uploadHeapProperties.MemoryPoolPreference = ::D3D12_MEMORY_POOL_UNKNOWN;
-	uploadHeapProperties.CreationNodeMask = 1;
-	uploadHeapProperties.VisibleNodeMask = 1;
-
-	COMPtr<::ID3D12Resource> uploadHeap{};
-	hr = m_d3dDevice->CreateCommittedResource(&uploadHeapProperties, ::D3D12_HEAP_FLAG_NONE, &bufferDesc,
-		::D3D12_RESOURCE_STATE_GENERIC_READ, 0, uploadHeap.static_uuid, uploadHeap.Out());
-	DXRASSERT(DXRSUCCESSTEST(hr));
+	// Where the copy wants every mip, relative to the upload allocation:
+	std::array<::D3D12_PLACED_SUBRESOURCE_FOOTPRINT, DXRTextureContainer::k_MaxMips> footprints{};
+	std::array<NTNamespace::UINT, DXRTextureContainer::k_MaxMips> rowCounts{};
+	NTNamespace::UINT64 uploadsize{};
+	m_d3dDevice->GetCopyableFootprints(&textureDesc, 0, mipCount, 0, footprints.data(), rowCounts.data(), nullptr, &uploadsize);
 
-	void* mapped{};
-	::D3D12_RANGE range{ 0, uploadsize };
-	hr = uploadHeap->Map(0, &range, &mapped);
-	DXRASSERT(DXRSUCCESSTEST(hr));
-	for (auto y{0}; y < height; y++)
+	// Staged before the texture is created, a texture that can't be filled
+	// must not be left behind for the next Rebuild() to skip:
+	D3D12UploadAllocation upload{};
+	if (!AllocateD3D12Upload(uploadsize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, upload))
+		return false;
+
+	// The cooker uses the same alignment rules as the runtime, so normally
+	// the whole payload is one copy. Row by row if a driver disagrees:
+	auto sameLayout = container.GetDataSize() <= uploadsize;
+	for (NTNamespace::UINT n{}; n < mipCount; n++)
 	{
-		const auto dst = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(mapped) + y * uploadpitch);
-		const auto src = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(bitmap_image_data) + y * width * 4);
-		memcpy(dst, src, width * 4);
+		const auto& mip = container.GetMip(n);
+		sameLayout = sameLayout && footprints[n].Offset == mip.offset &&
+					 footprints[n].Footprint.RowPitch == mip.rowPitch &&
+					 rowCounts[n] == mip.rowCount;
+	}
+	if (sameLayout)
+	{
+		memcpy(upload.cpuAddress, container.GetData(), container.GetDataSize());
+	}
+	else
+	{
+		for (NTNamespace::UINT n{}; n < mipCount; n++)
+		{
+			const auto& mip = container.GetMip(n);
+			const auto& footprint = footprints[n];
+			const auto src = container.GetMipData(n);
+			const std::size_t rowSize = (mip.width + formatInfo.blockSize - 1) / formatInfo.blockSize * formatInfo.bytesPerBlock;
+			for (NTNamespace::UINT y{}; y < rowCounts[n]; y++)
+			{
+				const auto dst = upload.cpuAddress + footprint.Offset + static_cast<std::size_t>(y) * footprint.Footprint.RowPitch;
+				memcpy(dst, src + static_cast<std::size_t>(y) * mip.rowPitch, rowSize);
+			}
+		}
 	}
-	uploadHeap->Unmap(0, &range);
-
-	
-
-	
-
-	DXRASSERT(DXRSUCCESSTEST(m_d3dCommandList->Reset(m_d3dCommandAllocators[m_frameIndex].Get(), m_d3dPipelineState.Get())));
 
-	::D3D12_TEXTURE_COPY_LOCATION srcLocation{};
-	srcLocation.pResource = uploadHeap.Get();
-	srcLocation.Type = ::D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-	srcLocation.PlacedFootprint.Footprint.Format = ::DXGI_FORMAT_R8G8B8A8_UNORM;
-	srcLocation.PlacedFootprint.Footprint.Width = width;
-	srcLocation.PlacedFootprint.Footprint.Height = height;
-	srcLocation.PlacedFootprint.Footprint.Depth = 1;
-	srcLocation.PlacedFootprint.Footprint.RowPitch = uploadpitch;
+	if (!CreateD3D12PlacedResource(textureDesc, DXRGpuHeapKind::Texture, ::D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+								   textureResource, allocation))
+		return false;
 
-	::D3D12_TEXTURE_COPY_LOCATION dstLocation{};
-	dstLocation.pResource = textureResource.Get();
-	dstLocation.Type = ::D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-	dstLocation.SubresourceIndex = 0;
-	m_d3dCommandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, NULL);
+	for (NTNamespace::UINT n{}; n < mipCount; n++)
+	{
+		::D3D12_TEXTURE_COPY_LOCATION srcLocation{};
+		srcLocation.pResource = upload.resource;
+		srcLocation.Type = ::D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+		srcLocation.PlacedFootprint = footprints[n];
+		srcLocation.PlacedFootprint.Offset += upload.offset;
+
+		::D3D12_TEXTURE_COPY_LOCATION dstLocation{};
+		dstLocation.pResource = textureResource.Get();
+		dstLocation.Type = ::D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+		dstLocation.SubresourceIndex = n;
+		m_d3dCommandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, NULL);
+	}
 
 	::D3D12_RESOURCE_BARRIER barrier{};
 	barrier.Type = ::D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -662,23 +937,18 @@ auto DXRWindowRenderer::CreateD3D12TextureFromImageData(const void* imageData, i
 	barrier.Transition.StateAfter = ::D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
 	m_d3dCommandList->ResourceBarrier(1, &barrier);
 
-	m_d3dCommandList->Close();
-
-	::ID3D12CommandList* cmdList[] = { m_d3dCommandList.Get() };
-	m_d3dCommandQueue->ExecuteCommandLists(1, cmdList);
-
-	SignalFence();
-	WaitFence();
-	
+	// Submitted with the rest of the batch by FlushD3D12Uploads():
 	::D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-	srvDesc.Format = ::DXGI_FORMAT_R8G8B8A8_UNORM;
+	srvDesc.Format = format;
 	srvDesc.ViewDimension = ::D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MipLevels = textureDesc.MipLevels;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	m_d3dDevice->CreateShaderResourceView(textureResource.Get(), &srvDesc, m_d3dSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	stbi_image_free(bitmap_image_data);
+	m_d3dDevice->CreateShaderResourceView(
+		textureResource.Get(), &srvDesc,
+		GetD3D12CPUDescriptorHandle(m_d3dSrvDescriptorHeap.Get(),
+									m_d3dSrvDescriptorSize,
+									m_textureSrv.index));
 
 	return true;
 }
@@ -716,79 +986,335 @@ auto DXRWindowRenderer::CreateD3D12GPUUploadBuffer(std::intptr_t size, COMPtr<::
 	return resourceOut;
 }
 
+auto DXRWindowRenderer::CreateD3D12UploadRing() -> bool
+{
+	DXRASSERT(m_d3dDevice);
+	if (!m_d3dUploadCommandAllocator)
+	{
+		if (!DXRSUCCESSTEST(m_d3dDevice->CreateCommandAllocator(
+				::D3D12_COMMAND_LIST_TYPE_DIRECT,
+				m_d3dUploadCommandAllocator.static_uuid,
+				m_d3dUploadCommandAllocator.Out())))
+			return false;
+		m_d3dUploadCommandAllocator->SetName(L"m_d3dUploadCommandAllocator");
+	}
+	if (!m_d3dUploadRingBuffer)
+	{
+		if (!CreateD3D12GPUUploadBuffer(k_UploadRingSize, m_d3dUploadRingBuffer))
+			return false;
+		m_d3dUploadRingBuffer->SetName(L"m_d3dUploadRingBuffer");
+
+		// Stays mapped for the lifetime of the buffer, the CPU never reads:
+		void* mapped{};
+		::D3D12_RANGE range{0, 0};
+		if (!DXRSUCCESSTEST(m_d3dUploadRingBuffer->Map(0, &range, &mapped)))
+			return false;
+		m_uploadRingMapped = reinterpret_cast<unsigned char*>(mapped);
+		m_uploadRing.Reset(k_UploadRingSize);
+	}
+	return m_uploadRingMapped;
+}
+
+auto DXRWindowRenderer::CreateD3D12InstanceBuffers() -> bool
+{
+	DXRASSERT(m_d3dDevice);
+	for (std::size_t slot{}; slot < m_d3dInstanceBuffers.size(); slot++)
+	{
+		auto& buffer = m_d3dInstanceBuffers[slot];
+		if (buffer)
+			continue;
+
+		// Read once per frame by the vertex shader, straight from the upload
+		// heap beats a copy to a default heap:
+		constexpr auto size = sizeof(DXRInstanceData) * k_MaxInstances;
+		if (!CreateD3D12GPUUploadBuffer(static_cast<std::intptr_t>(size),
+										buffer))
+			return false;
+		buffer->SetName(L"m_d3dInstanceBuffers[n]");
+
+		void* mapped{};
+		::D3D12_RANGE range{0, 0};
+		if (!DXRSUCCESSTEST(buffer->Map(0, &range, &mapped)))
+			return false;
+		m_instanceBuffersMapped[slot] =
+			reinterpret_cast<DXRInstanceData*>(mapped);
+	}
+	return m_instanceBuffersMapped[0];
+}
+
+auto DXRWindowRenderer::AllocateD3D12Upload(NTNamespace::UINT64 size,
+											NTNamespace::UINT64 alignment,
+											D3D12UploadAllocation& out) -> bool
+{
+	DXRASSERT(m_d3dUploadRingBuffer);
+	BeginD3D12Uploads();
+
+	D3D12FrameQueue queue{this};
+	std::uint64_t offset{};
+	if (m_uploadRing.Allocate(queue, size, alignment, offset))
+	{
+		out.resource = m_d3dUploadRingBuffer.Get();
+		out.offset = offset;
+		out.cpuAddress = m_uploadRingMapped + offset;
+		return true;
+	}
+
+	// Too big for the ring, or the batch filled it. A dedicated buffer that
+	// is released when this batch retires:
+	COMPtr<::ID3D12Resource> overflow{};
+	if (!CreateD3D12GPUUploadBuffer(static_cast<std::intptr_t>(size), overflow))
+		return false;
+	overflow->SetName(L"m_d3dUploadOverflow[n]");
+
+	void* mapped{};
+	::D3D12_RANGE range{0, 0};
+	if (!DXRSUCCESSTEST(overflow->Map(0, &range, &mapped)))
+		return false;
+	out.resource = overflow.Get();
+	out.offset = 0;
+	out.cpuAddress = reinterpret_cast<unsigned char*>(mapped);
+	m_d3dUploadOverflow.Add(std::move(overflow));
+	return true;
+}
+
+auto DXRWindowRenderer::BeginD3D12Uploads() -> void
+{
+	DXRASSERT(m_d3dCommandList);
+	DXRASSERT(m_d3dUploadCommandAllocator);
+	if (m_uploadsRecording)
+		return;
+
+	// The allocator can only be reset once its last batch is done, that
+	// one was submitted at least a frame ago:
+	D3D12FrameQueue queue{this};
+	queue.Wait(m_uploadFenceValue);
+	m_d3dUploadOverflow.Retire(queue.GetCompletedValue());
+
+	auto hr = m_d3dUploadCommandAllocator->Reset();
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	hr = m_d3dCommandList->Reset(m_d3dUploadCommandAllocator.Get(), nullptr);
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	(void)hr;
+	m_uploadsRecording = true;
+}
+
+auto DXRWindowRenderer::FlushD3D12Uploads() -> void
+{
+	if (!m_uploadsRecording)
+		return;
+	m_uploadsRecording = false;
+
+	const auto hr = m_d3dCommandList->Close();
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	(void)hr;
+	::ID3D12CommandList* commandLists[] = {m_d3dCommandList.Get()};
+	m_d3dCommandQueue->ExecuteCommandLists(1, commandLists);
+
+	SignalFence();
+	m_uploadFenceValue = m_fenceValue;
+	m_uploadRing.Submit(m_uploadFenceValue);
+	m_d3dUploadOverflow.Submit(m_uploadFenceValue);
+}
+
+auto DXRWindowRenderer::CreateD3D12PlacedResource(
+	const ::D3D12_RESOURCE_DESC& desc, DXRGpuHeapKind kind,
+	::D3D12_RESOURCE_STATES initialState,
+	const ::D3D12_CLEAR_VALUE* clearValue,
+	COMPtr<::ID3D12Resource>& resourceOut, DXRGpuAllocation& allocation)
+	-> bool
+{
+	DXRASSERT(m_d3dDevice);
+	DXRASSERT(!allocation.IsValid());
+
+	const auto info = m_d3dDevice->GetResourceAllocationInfo(0, 1, &desc);
+	if (info.SizeInBytes == ~NTNamespace::UINT64{})
+		return false;
+	allocation = m_gpuMemory.Allocate(info.SizeInBytes, info.Alignment,
+									  DXRGpuMemoryType::Default, kind);
+	if (!allocation.IsValid())
+		return false;
+
+	if (allocation.heap >= m_d3dHeaps.size())
+		m_d3dHeaps.resize(m_gpuMemory.GetHeapCount());
+	auto& heap = m_d3dHeaps[allocation.heap];
+	if (!heap)
+	{
+		// Heap tier 1: buffers, textures and render targets can't share:
+		const auto& heapInfo = m_gpuMemory.GetHeapInfo(allocation.heap);
+		::D3D12_HEAP_DESC heapDesc{};
+		heapDesc.SizeInBytes = heapInfo.size;
+		heapDesc.Properties.Type = ::D3D12_HEAP_TYPE_DEFAULT;
+		heapDesc.Properties.CPUPageProperty = ::D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+		heapDesc.Properties.MemoryPoolPreference = ::D3D12_MEMORY_POOL_UNKNOWN;
+		heapDesc.Properties.CreationNodeMask = 1;
+		heapDesc.Properties.VisibleNodeMask = 1;
+		heapDesc.Alignment = heapInfo.alignment;
+		switch (kind)
+		{
+		case DXRGpuHeapKind::Buffer:
+			heapDesc.Flags = ::D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+			break;
+		case DXRGpuHeapKind::Texture:
+			heapDesc.Flags = ::D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+			break;
+		case DXRGpuHeapKind::RenderTarget:
+		case DXRGpuHeapKind::Count:
+			heapDesc.Flags = ::D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+			break;
+		}
+		if (!DXRSUCCESSTEST(m_d3dDevice->CreateHeap(&heapDesc, heap.static_uuid,
+													heap.Out())))
+		{
+			m_gpuMemory.Free(allocation);
+			allocation = {};
+			return false;
+		}
+		heap->SetName(L"m_d3dHeaps");
+	}
+
+	if (!DXRSUCCESSTEST(m_d3dDevice->CreatePlacedResource(
+			heap.Get(), allocation.offset, &desc, initialState, clearValue,
+			resourceOut.static_uuid, resourceOut.InOut())))
+	{
+		m_gpuMemory.Free(allocation);
+		allocation = {};
+		return false;
+	}
+	return true;
+}
+
+auto DXRWindowRenderer::ReleaseD3D12Heaps() -> void
+{
+	std::vector<std::uint32_t> released{};
+	m_gpuMemory.CollectReleasedHeaps(released);
+	for (const auto heap : released)
+	{
+		m_d3dHeaps[heap].Reset();
+	}
+}
+
+auto DXRWindowRenderer::CreateD3D12BufferFromData(const void* data, NTNamespace::UINT64 size,
+												  ::D3D12_RESOURCE_STATES stateAfter,
+												  COMPtr<::ID3D12Resource>& resourceOut,
+												  DXRGpuAllocation& allocation) -> bool
+{
+	DXRASSERT(m_d3dDevice);
+
+	::D3D12_RESOURCE_DESC resourceDesc{};
+	resourceDesc.Dimension = ::D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDesc.Alignment = 0;
+	resourceDesc.Width = size;
+	resourceDesc.Height = 1;
+	resourceDesc.DepthOrArraySize = 1;
+	resourceDesc.MipLevels = 1;
+	resourceDesc.Format = ::DXGI_FORMAT_UNKNOWN;
+	resourceDesc.SampleDesc.Count = 1;
+	resourceDesc.SampleDesc.Quality = 0;
+	resourceDesc.Layout = ::D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resourceDesc.Flags = ::D3D12_RESOURCE_FLAG_NONE;
+
+	// Staged first, so a failed upload leaves no unfilled buffer behind:
+	D3D12UploadAllocation upload{};
+	if (!AllocateD3D12Upload(size, 16, upload))
+		return false;
+	memcpy(upload.cpuAddress, data, static_cast<std::size_t>(size));
+
+	// Buffers start out in COMMON and get promoted to COPY_DEST by the copy:
+	if (!CreateD3D12PlacedResource(resourceDesc, DXRGpuHeapKind::Buffer,
+								   ::D3D12_RESOURCE_STATE_COMMON, nullptr,
+								   resourceOut, allocation))
+		return false;
+	m_d3dCommandList->CopyBufferRegion(resourceOut.Get(), 0, upload.resource, upload.offset, size);
+
+	::D3D12_RESOURCE_BARRIER barrier{};
+	barrier.Type = ::D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	barrier.Flags = ::D3D12_RESOURCE_BARRIER_FLAG_NONE;
+	barrier.Transition.pResource = resourceOut.Get();
+	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	barrier.Transition.StateBefore = ::D3D12_RESOURCE_STATE_COPY_DEST;
+	barrier.Transition.StateAfter = stateAfter;
+	m_d3dCommandList->ResourceBarrier(1, &barrier);
+	return true;
+}
+
 auto DXRWindowRenderer::LoadRenderingAssets() -> bool
 {
+	// Everything created here goes out in one upload batch:
+	const auto& mesh = GetCubeMesh();
 	if (!m_d3dVertexBuffer)
 	{
-		// x, y, z, nx, ny, nz, u, v, col
-		Vertex3D vertices[] = {
-			// -z
-			{ -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
-			{ -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
-			{  1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
-			{ -1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
-			// +z
-			{ -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
-			{ -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
-			{  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
-			{ -1.0f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
-			// -y
-			{ -1.0f, -1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f, -1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
-			{ -1.0f, -1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
-			{  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
-			{ -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
-			// +y
-			{ -1.0f, 1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f, 1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
-			{  1.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
-			{ -1.0f, 1.0f,-1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
-			{  1.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
-			{ -1.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
-			// -x
-			{ -1.0f,-1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
-			{ -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
-			{ -1.0f, 1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
-			{ -1.0f,-1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
-			{ -1.0f, 1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
-			{ -1.0f,-1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
-			// +x
-			{ 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF }, 
-			{ 1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0xFFFFFFFF }, 
-			{ 1.0f,  1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF }, 
-			{ 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0xFFFFFFFF },
-			{ 1.0f,  1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0xFFFFFFFF },
-			{ 1.0f, -1.0f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0xFFFFFFFF }, 
-		};
-
-		DXRASSERT(CreateD3D12GPUUploadBuffer(sizeof vertices, m_d3dVertexBuffer));
+#ifdef DXRQUANTIZEDVERTICES
+		DXRQuantizedVertices quantized{};
+		QuantizeVertices(mesh.vertices, quantized);
+		m_vertexPositionTransform = quantized.GetPositionTransform();
+		const auto vertices = std::span{quantized.vertices};
+#else
+		m_vertexPositionTransform = glm::mat4{1.f};
+		const auto vertices = std::span{mesh.vertices};
+#endif
+		const auto verticesSize =
+			static_cast<NTNamespace::UINT>(vertices.size_bytes());
+
+		if (!CreateD3D12BufferFromData(
+				vertices.data(), verticesSize,
+				::D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+				m_d3dVertexBuffer, m_vertexBufferMemory))
+			return false;
 		DXRASSERT(m_d3dVertexBuffer);
 		m_d3dVertexBuffer->SetName(L"m_d3dVertexBuffer");
-		void* pVertexDataBegin{};
-		auto hr = m_d3dVertexBuffer->Map(0, nullptr, &pVertexDataBegin);
-		DXRASSERT(DXRSUCCESSTEST(hr));
-		memcpy(pVertexDataBegin, vertices, sizeof vertices);
-		m_d3dVertexBuffer->Unmap(0, nullptr);
 
 		m_d3dVertexBufferView.BufferLocation =
 			m_d3dVertexBuffer->GetGPUVirtualAddress();
-		m_d3dVertexBufferView.StrideInBytes = sizeof(Vertex3D);
-		m_d3dVertexBufferView.SizeInBytes = sizeof vertices;
+		m_d3dVertexBufferView.StrideInBytes =
+			static_cast<NTNamespace::UINT>(sizeof vertices[0]);
+		m_d3dVertexBufferView.SizeInBytes = verticesSize;
 	}
 	if (!m_d3dVertexBuffer)
 		return false;
 
+	if (!m_d3dIndexBuffer)
+	{
+		std::vector<unsigned char> indices{};
+		const auto format = PackIndices(mesh, indices);
+		const auto indicesSize = static_cast<NTNamespace::UINT>(indices.size());
+
+		if (!CreateD3D12BufferFromData(indices.data(), indicesSize,
+									   ::D3D12_RESOURCE_STATE_INDEX_BUFFER,
+									   m_d3dIndexBuffer, m_indexBufferMemory))
+			return false;
+		DXRASSERT(m_d3dIndexBuffer);
+		m_d3dIndexBuffer->SetName(L"m_d3dIndexBuffer");
+
+		m_d3dIndexBufferView.BufferLocation =
+			m_d3dIndexBuffer->GetGPUVirtualAddress();
+		m_d3dIndexBufferView.SizeInBytes = indicesSize;
+		m_d3dIndexBufferView.Format = format == DXRIndexFormat::UInt16
+										  ? ::DXGI_FORMAT_R16_UINT
+										  : ::DXGI_FORMAT_R32_UINT;
+		m_d3dIndexCount = static_cast<NTNamespace::UINT>(mesh.indices.size());
+	}
+	if (!m_d3dIndexBuffer)
+		return false;
+
 	if (!m_d3dTexture)
 	{
-		DXRASSERT(CreateD3D12TextureFromImageData(textureDataRaw, sizeof textureDataRaw, m_d3dTexture));
+		// Cooked container if it's there and usable, decoding the PNG
+		// otherwise:
+		DXRTextureContainer container{};
+		if (!container.Open(GetCookedTexturePath()) ||
+			!CreateD3D12TextureFromContainer(container, m_d3dTexture, m_textureMemory))
+		{
+			if (!CreateD3D12TextureFromImageData(GetEmbeddedTextureData(), GetEmbeddedTextureSize(), m_d3dTexture, m_textureMemory))
+			{
+				// Whatever made it into the batch still goes out:
+				FlushD3D12Uploads();
+				return false;
+			}
+		}
 		DXRASSERT(m_d3dTexture);
 		m_d3dTexture->SetName(L"m_d3dTexture");
 	}
+	FlushD3D12Uploads();
 
 	if (!m_d3dTexture)
 		return false;
@@ -796,48 +1322,86 @@ auto DXRWindowRenderer::LoadRenderingAssets() -> bool
 	return true;
 }
 
-auto DXRWindowRenderer::SignalFence() -> void
+auto DXRWindowRenderer::D3D12FrameQueue::Signal(std::uint64_t value) -> void
 {
-	DXRASSERT(m_d3dCommandQueue);
-	DXRASSERT(m_d3dFence);
-	DXRASSERT(DXRSUCCESSTEST(
-		m_d3dCommandQueue->Signal(m_d3dFence.Get(), m_fenceValue)));
+	DXRASSERT(renderer->m_d3dCommandQueue);
+	DXRASSERT(renderer->m_d3dFence);
+	const auto hr = renderer->m_d3dCommandQueue->Signal(
+		renderer->m_d3dFence.Get(), value);
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	(void)hr;
 }
 
-auto DXRWindowRenderer::WaitFence() -> void
+auto DXRWindowRenderer::D3D12FrameQueue::GetCompletedValue() -> std::uint64_t
 {
-	DXRASSERT(m_d3dFence);
-	DXRASSERT(m_fenceEvent);
-	if (m_d3dFence->GetCompletedValue() < m_fenceValue)
+	DXRASSERT(renderer->m_d3dFence);
+	return renderer->m_d3dFence->GetCompletedValue();
+}
+
+auto DXRWindowRenderer::D3D12FrameQueue::Wait(std::uint64_t value) -> void
+{
+	DXRASSERT(renderer->m_d3dFence);
+	DXRASSERT(renderer->m_fenceEvent);
+	if (renderer->m_d3dFence->GetCompletedValue() < value)
 	{
-		DXRASSERT(DXRSUCCESSTEST(
-			m_d3dFence->SetEventOnCompletion(m_fenceValue, m_fenceEvent)));
-		WaitForSingleObject(m_fenceEvent, INFINITE);
+		const auto hr = renderer->m_d3dFence->SetEventOnCompletion(
+			value, renderer->m_fenceEvent);
+		DXRASSERT(DXRSUCCESSTEST(hr));
+		(void)hr;
+		WaitForSingleObject(renderer->m_fenceEvent, INFINITE);
 	}
+}
+
+auto DXRWindowRenderer::SignalFence() -> void
+{
+	D3D12FrameQueue queue{this};
+	m_fenceValue = m_framePacer.Signal(queue);
+}
 
-	m_fenceValue++;
+auto DXRWindowRenderer::WaitFence() -> void
+{
+	D3D12FrameQueue queue{this};
+	queue.Wait(m_fenceValue);
+}
+
+auto DXRWindowRenderer::GetFrameGraphicsConstants() -> GraphicsConstants
+{
+	GraphicsConstants constants{};
+	// Render thread is the snapshot's one consumer. The update thread stamps
+	// states with platform ticks:
+	const auto matrices =
+		CameraManager::GetInstance()->AcquireInterpolatedSnapshot(
+			static_cast<std::int64_t>(GetPlatformTickValue()));
+	memcpy(&constants.projection, &matrices.projection[0][0],
+		   sizeof constants.projection);
+	memcpy(&constants.view, &matrices.view[0][0], sizeof constants.view);
+	glm::mat4 model{1.f};
+	memcpy(&constants.model, &model[0][0], sizeof constants.model);
+	return constants;
 }
 
 auto DXRWindowRenderer::SubmitD3D12() -> void
 {
-	const auto cmdallocator = m_d3dCommandAllocators[m_frameIndex].Get();
+	const auto cmdallocator = m_d3dCommandAllocators[m_frameSlot].Get();
 	const auto rendertarget = m_d3dRenderTargets[m_frameIndex].Get();
 
 	DXRASSERT(cmdallocator);
 	DXRASSERT(rendertarget);
 	DXRASSERT(m_d3dCommandQueue);
 	DXRASSERT(m_d3dCommandList);
-	DXRASSERT(m_d3dPipelineState);
+	const auto pipeline = m_pipelines.Get(m_scenePipeline);
+	DXRASSERT(pipeline);
 	DXRASSERT(m_d3dRootSignature);
 	DXRASSERT(m_d3dSrvDescriptorHeap);
 	DXRASSERT(m_d3dRtvDescriptorHeap);
 	DXRASSERT(m_d3dDsvDescriptorHeap);
 
 
-	DXRASSERT(DXRSUCCESSTEST(cmdallocator->Reset()));
+	auto hr = cmdallocator->Reset();
+	DXRASSERT(DXRSUCCESSTEST(hr));
 
-	DXRASSERT(DXRSUCCESSTEST(
-		m_d3dCommandList->Reset(cmdallocator, m_d3dPipelineState.Get())));
+	hr = m_d3dCommandList->Reset(cmdallocator, pipeline->Get());
+	DXRASSERT(DXRSUCCESSTEST(hr));
 
 	m_d3dCommandList->SetGraphicsRootSignature(m_d3dRootSignature.Get());
 
@@ -845,58 +1409,243 @@ auto DXRWindowRenderer::SubmitD3D12() -> void
 	m_d3dCommandList->SetDescriptorHeaps(1, ppHeaps);
 
 	m_d3dCommandList->SetGraphicsRootDescriptorTable(
-		1, m_d3dSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+		1, GetD3D12GPUDescriptorHandle(m_d3dSrvDescriptorHeap.Get(),
+									   m_d3dSrvDescriptorSize,
+									   m_textureSrv.index));
 
 	m_d3dCommandList->RSSetViewports(1, &m_d3dViewport);
 	m_d3dCommandList->RSSetScissorRects(1, &m_d3dScissorRect);
 
-	// Begin render target:
+	// Passes declare what they touch, the compiled graph has the barriers.
+	// The back buffer starts and ends in PRESENT, depth stays in DEPTH_WRITE:
+	m_renderGraph.Reset();
+	const auto backBuffer = m_renderGraph.Import(
+		"backbuffer", DXRResourceState::Present, DXRResourceState::Present);
+	const auto depthBuffer =
+		m_renderGraph.Import("depth", DXRResourceState::DepthWrite,
+							 DXRResourceState::DepthWrite);
+	const auto scenePass = m_renderGraph.AddPass("scene");
+	m_renderGraph.Write(scenePass, backBuffer, DXRResourceState::RenderTarget);
+	m_renderGraph.Write(scenePass, depthBuffer, DXRResourceState::DepthWrite);
+	const auto compiled = m_renderGraph.Compile(m_renderGraphPlan);
+	DXRASSERT(compiled);
+	(void)compiled;
+	::ID3D12Resource* const graphResources[]{rendertarget,
+											 m_d3dDepthStencilBuffer.Get()};
+
+	const auto recordScene = [&] {
+		// Clear render target:
+		const auto rtvHandle = GetD3D12CPUDescriptorHandle(
+			m_d3dRtvDescriptorHeap.Get(), m_d3dRtvDescriptorSize,
+			m_swapChainRtvs.index + m_frameIndex);
+		const auto dsvHandle = GetD3D12CPUDescriptorHandle(
+			m_d3dDsvDescriptorHeap.Get(), m_d3dDsvDescriptorSize,
+			m_depthDsv.index);
+		m_d3dCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+		m_d3dCommandList->ClearDepthStencilView(
+			dsvHandle, ::D3D12_CLEAR_FLAG_DEPTH, 1.f, 0, 0, nullptr);
+		m_d3dCommandList->ClearRenderTargetView(rtvHandle, k_ClearColor, 0,
+												nullptr);
+
+		// Set camera constants:
+		auto constants = GetFrameGraphicsConstants();
+		constants.model = m_vertexPositionTransform * constants.model;
+		m_d3dCommandList->SetGraphicsRoot32BitConstants(
+			0, sizeof constants / 4, &constants, 0);
+
+		// Draw the vertices:
+		m_d3dCommandList->IASetPrimitiveTopology(
+			::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		m_d3dCommandList->IASetVertexBuffers(0, 1, &m_d3dVertexBufferView);
+		m_d3dCommandList->IASetIndexBuffer(&m_d3dIndexBufferView);
+
+		// The frame slot's instance buffer isn't read by the GPU anymore:
+		const auto& instances = m_instances.Acquire();
+		const auto instanceCount = static_cast<NTNamespace::UINT>(
+			std::min<std::size_t>(instances.size(), k_MaxInstances));
+		PackInstances(std::span{instances}.first(instanceCount),
+					  {m_instanceBuffersMapped[m_frameSlot], instanceCount});
+		m_d3dCommandList->SetGraphicsRootShaderResourceView(
+			2, m_d3dInstanceBuffers[m_frameSlot]->GetGPUVirtualAddress());
+		m_d3dCommandList->DrawIndexedInstanced(m_d3dIndexCount, instanceCount,
+											   0, 0, 0);
+	};
+
+	for (const auto& pass : m_renderGraphPlan.passes)
+	{
+		RecordRenderGraphBarriers(graphResources, pass.barrierBegin,
+								  pass.barrierCount);
+		if (pass.pass.index == scenePass.index)
+			recordScene();
+	}
+	RecordRenderGraphBarriers(graphResources,
+							  m_renderGraphPlan.finalBarrierBegin,
+							  m_renderGraphPlan.finalBarrierCount);
+
+	hr = m_d3dCommandList->Close();
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	(void)hr;
+
+	::ID3D12CommandList* commandLists[] = {m_d3dCommandList.Get()};
+	m_d3dCommandQueue->ExecuteCommandLists(1, commandLists);
+}
+
+auto DXRWindowRenderer::RecordRenderGraphBarriers(
+	std::span<::ID3D12Resource* const> resources, std::uint32_t begin,
+	std::uint32_t count) -> void
+{
+	if (!count)
+		return;
+
+	m_d3dBarriers.clear();
+	for (auto i = begin; i < begin + count; i++)
+	{
+		const auto& barrier = m_renderGraphPlan.barriers[i];
+		::D3D12_RESOURCE_BARRIER d3dBarrier{};
+		switch (barrier.split)
+		{
+		case DXRRenderGraphBarrierSplit::None:
+			d3dBarrier.Flags = ::D3D12_RESOURCE_BARRIER_FLAG_NONE;
+			break;
+		case DXRRenderGraphBarrierSplit::Begin:
+			d3dBarrier.Flags = ::D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+			break;
+		case DXRRenderGraphBarrierSplit::End:
+			d3dBarrier.Flags = ::D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+			break;
+		}
+		switch (barrier.type)
+		{
+		case DXRRenderGraphBarrierType::Aliasing:
+			d3dBarrier.Type = ::D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+			d3dBarrier.Aliasing.pResourceBefore =
+				barrier.before.IsValid() ? resources[barrier.before.index]
+										 : nullptr;
+			d3dBarrier.Aliasing.pResourceAfter =
+				resources[barrier.resource.index];
+			break;
+		case DXRRenderGraphBarrierType::Transition:
+			// DXRResourceState has D3D12_RESOURCE_STATES' values:
+			d3dBarrier.Type = ::D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			d3dBarrier.Transition.pResource = resources[barrier.resource.index];
+			d3dBarrier.Transition.Subresource =
+				::D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+			d3dBarrier.Transition.StateBefore =
+				static_cast<::D3D12_RESOURCE_STATES>(barrier.stateBefore);
+			d3dBarrier.Transition.StateAfter =
+				static_cast<::D3D12_RESOURCE_STATES>(barrier.stateAfter);
+			break;
+		case DXRRenderGraphBarrierType::UAV:
+			d3dBarrier.Type = ::D3D12_RESOURCE_BARRIER_TYPE_UAV;
+			d3dBarrier.UAV.pResource = resources[barrier.resource.index];
+			break;
+		}
+		m_d3dBarriers.push_back(d3dBarrier);
+	}
+	m_d3dCommandList->ResourceBarrier(
+		static_cast<NTNamespace::UINT>(m_d3dBarriers.size()),
+		m_d3dBarriers.data());
+}
+
+auto DXRWindowRenderer::SubmitSoftware() -> void
+{
+	const auto cmdallocator = m_d3dCommandAllocators[m_frameSlot].Get();
+	const auto rendertarget = m_d3dRenderTargets[m_frameIndex].Get();
+
+	DXRASSERT(cmdallocator);
+	DXRASSERT(rendertarget);
+	DXRASSERT(m_d3dCommandQueue);
+	DXRASSERT(m_d3dCommandList);
+
+	if (!m_softwareRasterizer)
+	{
+		m_softwareRasterizer = std::make_unique<DXRSoftwareRasterizer>();
+	}
+	if (m_softwareTexture.pixels.empty())
+	{
+		if (!LoadDefaultTextureRGBA8(m_softwareTexture))
+			return;
+	}
+
+	// Same frame SubmitD3D12 records, just on the CPU:
+	m_softwareRasterizer->Resize(m_width, m_height);
+	m_softwareRasterizer->Clear(k_ClearColor, 1.f);
+	m_softwareRasterizer->SetTexture(&m_softwareTexture);
+	const auto& mesh = GetCubeMesh();
+	const auto& instances = m_instances.Acquire();
+	m_softwareInstances.resize(
+		std::min<std::size_t>(instances.size(), k_MaxInstances));
+	PackInstances(std::span{instances}.first(m_softwareInstances.size()),
+				  m_softwareInstances);
+	m_softwareRasterizer->DrawIndexedInstanced(mesh.vertices, mesh.indices,
+											   m_softwareInstances,
+											   GetFrameGraphicsConstants());
+	m_softwareRasterizer->Execute();
+
+	const NTNamespace::UINT rowSize = m_width * 4;
+	const NTNamespace::UINT uploadpitch =
+		(rowSize + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) &
+		~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+	const NTNamespace::UINT uploadsize = m_height * uploadpitch;
+
+	auto& uploadBuffer = m_d3dSoftwareUploadBuffers[m_frameSlot];
+	if (!uploadBuffer)
+	{
+		if (!CreateD3D12GPUUploadBuffer(uploadsize, uploadBuffer))
+			return;
+		uploadBuffer->SetName(L"m_d3dSoftwareUploadBuffers[n]");
+	}
+
+	void* mapped{};
+	::D3D12_RANGE range{0, uploadsize};
+	if (!DXRSUCCESSTEST(uploadBuffer->Map(0, &range, &mapped)))
+		return;
+	const auto& color = m_softwareRasterizer->GetColorBuffer();
+	for (NTNamespace::UINT y{}; y < m_height; y++)
+	{
+		memcpy(reinterpret_cast<unsigned char*>(mapped) + y * uploadpitch,
+			   color.data() + static_cast<std::size_t>(y) * m_width, rowSize);
+	}
+	uploadBuffer->Unmap(0, &range);
+
+	auto hr = cmdallocator->Reset();
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	hr = m_d3dCommandList->Reset(cmdallocator, nullptr);
+	DXRASSERT(DXRSUCCESSTEST(hr));
+
 	::D3D12_RESOURCE_BARRIER barrier{};
 	barrier.Type = ::D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
 	barrier.Flags = ::D3D12_RESOURCE_BARRIER_FLAG_NONE;
 	barrier.Transition.pResource = rendertarget;
 	barrier.Transition.Subresource = 0;
 	barrier.Transition.StateBefore = ::D3D12_RESOURCE_STATE_COMMON;
-	barrier.Transition.StateAfter = ::D3D12_RESOURCE_STATE_RENDER_TARGET;
+	barrier.Transition.StateAfter = ::D3D12_RESOURCE_STATE_COPY_DEST;
 	m_d3dCommandList->ResourceBarrier(1, &barrier);
 
-	// Clear render target:
-	auto rtvHandle =
-		m_d3dRtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
-	auto dsvHandle =
-		m_d3dDsvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
-	rtvHandle.ptr += m_frameIndex * m_d3dRtvDescriptorSize;
-	m_d3dCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
-	m_d3dCommandList->ClearDepthStencilView(dsvHandle, ::D3D12_CLEAR_FLAG_DEPTH,
-											1.f, 0, 0, nullptr);
-	m_d3dCommandList->ClearRenderTargetView(rtvHandle, k_ClearColor, 0,
-											nullptr);
-
-	// Set camera constants:
-	GraphicsConstants constants{};
-	const auto matrices = m_atomicCamera.load();
-	memcpy(&constants.projection, &matrices.projection[0][0],
-		   sizeof constants.projection);
-	memcpy(&constants.view, &matrices.view[0][0], sizeof constants.view);
-	glm::mat4 model{1.f};
-	memcpy(&constants.model, &model[0][0], sizeof constants.model);
-	m_d3dCommandList->SetGraphicsRoot32BitConstants(0, sizeof constants / 4,
-													&constants, 0);
+	::D3D12_TEXTURE_COPY_LOCATION srcLocation{};
+	srcLocation.pResource = uploadBuffer.Get();
+	srcLocation.Type = ::D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	srcLocation.PlacedFootprint.Footprint.Format = ::DXGI_FORMAT_R8G8B8A8_UNORM;
+	srcLocation.PlacedFootprint.Footprint.Width = m_width;
+	srcLocation.PlacedFootprint.Footprint.Height = m_height;
+	srcLocation.PlacedFootprint.Footprint.Depth = 1;
+	srcLocation.PlacedFootprint.Footprint.RowPitch = uploadpitch;
 
-	// Draw the vertices:
-	m_d3dCommandList->IASetPrimitiveTopology(
-		::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	m_d3dCommandList->IASetVertexBuffers(0, 1, &m_d3dVertexBufferView);
-	m_d3dCommandList->DrawInstanced(m_d3dVertexBufferView.SizeInBytes /
-										m_d3dVertexBufferView.StrideInBytes,
-									1, 0, 0);
+	::D3D12_TEXTURE_COPY_LOCATION dstLocation{};
+	dstLocation.pResource = rendertarget;
+	dstLocation.Type = ::D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dstLocation.SubresourceIndex = 0;
+	m_d3dCommandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation,
+										nullptr);
 
 	// Begin present:
-	barrier.Transition.StateBefore = ::D3D12_RESOURCE_STATE_RENDER_TARGET;
+	barrier.Transition.StateBefore = ::D3D12_RESOURCE_STATE_COPY_DEST;
 	barrier.Transition.StateAfter = ::D3D12_RESOURCE_STATE_PRESENT;
 	m_d3dCommandList->ResourceBarrier(1, &barrier);
 
-	DXRASSERT(DXRSUCCESSTEST(m_d3dCommandList->Close()));
+	hr = m_d3dCommandList->Close();
+	DXRASSERT(DXRSUCCESSTEST(hr));
+	(void)hr;
 
 	::ID3D12CommandList* commandLists[] = {m_d3dCommandList.Get()};
 	m_d3dCommandQueue->ExecuteCommandLists(1, commandLists);
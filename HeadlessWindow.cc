@@ -0,0 +1,83 @@
+#include "HeadlessWindow.h"
+
+auto HeadlessWindow::IsValid() const -> bool
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	return m_created;
+}
+
+auto HeadlessWindow::Create() -> bool
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	if (m_created)
+	{
+		return false;
+	}
+	m_created = true;
+	// Real windows get an initial WM_SIZE, so do the same:
+	m_events.push_back({EventType::Resize, m_w, m_h});
+	return true;
+}
+
+auto HeadlessWindow::Destroy() -> bool
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	if (!m_created)
+	{
+		return false;
+	}
+	m_created = false;
+	m_events.clear();
+	return true;
+}
+
+auto HeadlessWindow::SetSize(std::uint32_t w, std::uint32_t h) -> bool
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	m_w = w;
+	m_h = h;
+	if (m_created)
+	{
+		m_events.push_back({EventType::Resize, w, h});
+	}
+	return true;
+}
+
+auto HeadlessWindow::GetWidth() const -> std::uint32_t
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	return m_w;
+}
+
+auto HeadlessWindow::GetHeight() const -> std::uint32_t
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	return m_h;
+}
+
+auto HeadlessWindow::PostEvent(const Event& event) -> void
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	if (!m_created)
+	{
+		return;
+	}
+	if (event.type == EventType::Resize)
+	{
+		m_w = event.width;
+		m_h = event.height;
+	}
+	m_events.push_back(event);
+}
+
+auto HeadlessWindow::PollEvent(Event& event) -> bool
+{
+	std::lock_guard<std::mutex> lock{m_mutex};
+	if (m_events.empty())
+	{
+		return false;
+	}
+	event = m_events.front();
+	m_events.pop_front();
+	return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// A "window" with nothing behind it:
+// It has a size and an event queue, which is all the renderer core looks at.
+// Benchmarks and servers drive it by posting events from any thread.
+struct HeadlessWindow
+{
+	enum struct EventType
+	{
+		Resize,
+		Close,
+	};
+
+	struct Event
+	{
+		EventType type{};
+		std::uint32_t width{}, height{};
+	};
+
+	inline HeadlessWindow() = default;
+	inline ~HeadlessWindow()
+	{
+		Destroy();
+	}
+
+	inline HeadlessWindow(const HeadlessWindow&) = delete;
+	inline HeadlessWindow(HeadlessWindow&&) = delete;
+	inline HeadlessWindow& operator=(const HeadlessWindow&) = delete;
+	inline HeadlessWindow& operator=(HeadlessWindow&&) = delete;
+
+	// Validation.
+	auto IsValid() const -> bool;
+
+	// Creation and destruction.
+	auto Create() -> bool;
+	auto Destroy() -> bool;
+
+	// May be invoked before or after Create().
+	// After Create() this posts a Resize event like a real window would.
+	auto SetSize(std::uint32_t w, std::uint32_t h) -> bool;
+	auto GetWidth() const -> std::uint32_t;
+	auto GetHeight() const -> std::uint32_t;
+
+	template <typename T> inline auto SetUserData(T&& data) -> void
+	{
+		m_userData = std::forward<T>(data);
+	}
+
+	inline auto GetUserData() -> std::any&
+	{
+		return m_userData;
+	}
+
+	// Messages.
+	// Safe to call from any thread.
+	auto PostEvent(const Event& event) -> void;
+	// Pops the oldest event, returns false if the queue is empty.
+	auto PollEvent(Event& event) -> bool;
+
+  private:
+	mutable std::mutex m_mutex{};
+	bool m_created{};
+	std::uint32_t m_w{640}, m_h{480};
+	std::deque<Event> m_events{};
+
+	std::any m_userData{};
+};
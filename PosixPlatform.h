@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+	Headless counterpart of W32Platform.h.
+	Only the bits the renderer core needs, so it builds without Windows.h.
+*/
+
+#include <cstdint>
+#include <ctime>
+
+inline auto GetPlatformTickValue() -> std::intptr_t
+{
+	::timespec ts{};
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<std::intptr_t>(ts.tv_sec) * 1000000000 +
+		   static_cast<std::intptr_t>(ts.tv_nsec);
+}
+
+inline auto GetPlatformTickFrequency() -> std::intptr_t
+{
+	return 1000000000;
+}
+
+inline auto SecondsFromPlatformTickValue(std::intptr_t v) -> float
+{
+	return static_cast<float>(static_cast<double>(v) /
+							  static_cast<double>(GetPlatformTickFrequency()));
+}
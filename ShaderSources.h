@@ -7,12 +7,70 @@ const auto vertexShader2DText =
             float4x4 viewMatrix;\
             float4x4 modelMatrix;\
             };\
+            struct Instance\
+            {\
+              float4 transform[3];\
+              uint color;\
+              uint3 reserved;\
+            };\
+            StructuredBuffer<Instance> instances : register(t1);\
             struct VS_INPUT\
             {\
               float3 pos : POSITION;\
               float3 normal : NORMAL;\
               float2 uv  : TEXCOORD0;\
               float4 col : COLOR0;\
+              uint instanceID : SV_InstanceID;\
+            };\
+            \
+            struct PS_INPUT\
+            {\
+              float4 pos : SV_POSITION;\
+              float4 normal : NORMAL;\
+              float2 uv  : TEXCOORD0;\
+              float4 col : COLOR0;\
+            };\
+            \
+            PS_INPUT main(VS_INPUT input)\
+            {\
+              PS_INPUT output;\
+              Instance instance = instances[input.instanceID];\
+              float4 local = mul(float4(input.pos.xyz, 1.0), modelMatrix);\
+              float3 world = float3(dot(instance.transform[0], local), dot(instance.transform[1], local), dot(instance.transform[2], local));\
+              float3 normal = mul(float4(input.normal, 0.0), modelMatrix).xyz;\
+              normal = float3(dot(instance.transform[0].xyz, normal), dot(instance.transform[1].xyz, normal), dot(instance.transform[2].xyz, normal));\
+              output.pos = mul(mul(float4(world, 1.0), viewMatrix), projectionMatrix);\
+              output.normal = float4(normal, 0.0);\
+              output.uv  = input.uv;\
+              output.col = input.col * (float4((instance.color >> uint4(0, 8, 16, 24)) & 0xFF) / 255.0);\
+              return output;\
+            }";
+
+// vertexShader2DText for DXRVertexQuantized, modelMatrix includes
+// DXRQuantizedVertices::GetPositionTransform(). The normal skips modelMatrix,
+// the dequantization doesn't rotate:
+const auto vertexShaderQuantizedText =
+"cbuffer vertexBuffer : register(b0) \
+            {\
+            float4x4 projectionMatrix;\
+            float4x4 viewMatrix;\
+            float4x4 modelMatrix;\
+            };\
+            struct Instance\
+            {\
+              float4 transform[3];\
+              uint color;\
+              uint3 reserved;\
+            };\
+            StructuredBuffer<Instance> instances : register(t1);\
+            struct VS_INPUT\
+            {\
+              float2 posXY : POSITION0;\
+              float posZ : POSITION1;\
+              float2 oct : NORMAL;\
+              float2 uv  : TEXCOORD0;\
+              float4 col : COLOR0;\
+              uint instanceID : SV_InstanceID;\
             };\
             \
             struct PS_INPUT\
@@ -26,10 +84,18 @@ const auto vertexShader2DText =
             PS_INPUT main(VS_INPUT input)\
             {\
               PS_INPUT output;\
-              output.pos = mul(mul(mul(float4(input.pos.xyz, 1.0), modelMatrix), viewMatrix), projectionMatrix);\
-              output.normal = mul(float4(input.normal, 0.0), modelMatrix);\
+              float3 pos = float3(input.posXY, input.posZ);\
+              float3 normal = float3(input.oct, 1.0 - abs(input.oct.x) - abs(input.oct.y));\
+              float fold = saturate(-normal.z);\
+              normal.xy += normal.xy >= 0.0 ? -fold : fold;\
+              Instance instance = instances[input.instanceID];\
+              float4 local = mul(float4(pos, 1.0), modelMatrix);\
+              float3 world = float3(dot(instance.transform[0], local), dot(instance.transform[1], local), dot(instance.transform[2], local));\
+              normal = float3(dot(instance.transform[0].xyz, normal), dot(instance.transform[1].xyz, normal), dot(instance.transform[2].xyz, normal));\
+              output.pos = mul(mul(float4(world, 1.0), viewMatrix), projectionMatrix);\
+              output.normal = float4(normalize(normal), 0.0);\
               output.uv  = input.uv;\
-              output.col = input.col;\
+              output.col = input.col * (float4((instance.color >> uint4(0, 8, 16, 24)) & 0xFF) / 255.0);\
               return output;\
             }";
 
@@ -47,4 +113,4 @@ const auto pixelShader2DText = "struct PS_INPUT\
             {\
               float4 out_col = texture0.Sample(sampler0, input.uv); \
               return out_col; \
-            }";
\ No newline at end of file
+            }";
@@ -22,9 +22,15 @@ inline auto GetPlatformTickValue() -> std::intptr_t
 	return static_cast<std::intptr_t>(i.QuadPart);
 }
 
-inline auto SecondsFromPlatformTickValue(std::intptr_t v) -> float
+inline auto GetPlatformTickFrequency() -> std::intptr_t
 {
 	NTNamespace::LARGE_INTEGER i{};
 	NTNamespace::QueryPerformanceFrequency(&i);
-	return static_cast<float>(static_cast<double>(v) / static_cast<double>(i.QuadPart));
+	return static_cast<std::intptr_t>(i.QuadPart);
+}
+
+inline auto SecondsFromPlatformTickValue(std::intptr_t v) -> float
+{
+	return static_cast<float>(static_cast<double>(v) /
+							  static_cast<double>(GetPlatformTickFrequency()));
 }
\ No newline at end of file
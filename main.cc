@@ -1,11 +1,13 @@
-﻿#include <iostream>
-#include <thread>
+﻿#include <atomic>
+#include <iostream>
 #include <string>
 
 #include "W32Platform.h"
 #include "DXRRenderer.h"
 #include "W32Window.h"
 #include "DXRSingleton.h"
+#include "DXRFixedTimestep.h"
+#include "DXRJobSystem.h"
 
 int main(int, const char* const*, const char* const*)
 {
@@ -21,30 +23,37 @@ int main(int, const char* const*, const char* const*)
 		if (renderer.IsValid())
 		{
 
-			std::jthread updateWorker([&renderer](std::stop_token itoken) {
-				auto lastTick = GetPlatformTickValue();
-				while (!itoken.stop_requested())
-				{
-					const auto tick = GetPlatformTickValue();
-					const auto time = SecondsFromPlatformTickValue(tick - lastTick);
-
-					renderer.Update(time);
-
+			// The update loop gets a thread of its own for the whole run,
+			// its ticks can hand work to the workers:
+			const auto jobs = DXRJobSystem::GetInstance();
+			std::atomic<bool> stopUpdate{};
+			DXRJobCounter updateDone{};
+			jobs->RunDedicated(
+				[&renderer, &stopUpdate] {
+					// Sleeps between ticks instead of burning a core:
+					DXRPlatformClock clock{};
+					DXRFixedTimestep scheduler{clock};
 					auto cam = CameraManager::GetInstance();
-					cam->Update(time);
-
-					lastTick = tick; 
-				}
-				});
+					while (!stopUpdate.load(std::memory_order_relaxed))
+					{
+						scheduler.WaitForNextTick();
+						scheduler.Step([&](float dt) {
+							renderer.Update(dt);
+							cam->Update(dt, scheduler.GetTickTime());
+						});
+					}
+				},
+				&updateDone);
 			while (1)
 			{
 				if (!W32Window::DispatchMessagesThisThread())
 					break;
 
+				jobs->RunMainThreadJobs();
 				renderer.Render();
 			}
-			updateWorker.request_stop();
-			updateWorker.join();
+			stopUpdate.store(true, std::memory_order_relaxed);
+			jobs->Wait(updateDone);
 		}
 		else
 		{